@@ -0,0 +1,286 @@
+#include "beacon.h"
+#include "sdkconfig.h"
+
+#if CONFIG_BT_NIMBLE_ENABLED
+#include "ble_core.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "host/ble_hs.h"
+#include <string.h>
+
+#define BEACON_INSTANCE 0
+#define HEARTBEAT_US ((int64_t)CONFIG_BEACON_HEARTBEAT_S * 1000000)
+// AD types added for apps with services
+#define AD_UUID16_ALL 0x03
+#define AD_NAME_SHORT 0x08
+#define AD_NAME_COMPLETE 0x09
+#define AD_MAX 31
+
+static const char *TAG = "BEACON";
+
+static const beacon_deadband_t deadband = {
+  .temperature = CONFIG_BEACON_TEMP_DEADBAND,
+  .humidity = CONFIG_BEACON_HUM_DEADBAND,
+  .battery = CONFIG_BEACON_BATTERY_DEADBAND,
+};
+
+// guards the state below, NimBLE calls come from the host task (sync, GAP
+// events) and the sensor task (updates)
+static SemaphoreHandle_t lock;
+static StaticSemaphore_t lock_buf;
+
+static beacon_cfg_t cfg;
+static beacon_reading_t sent = {.battery = BEACON_BATTERY_UNKNOWN};
+static int64_t sent_us;
+// the beacon payload, plus the service uuid AD when there are services
+static uint8_t adv[BEACON_ADV_LEN + 4];
+static size_t adv_len;
+// name AD, the scan response of a connectable legacy advertisement
+static uint8_t name_ad[AD_MAX];
+static size_t name_ad_len;
+static uint8_t own_addr_type;
+static beacon_stats_t stats;
+
+static int on_gap_event(struct ble_gap_event *event, void *arg);
+
+static bool connectable(void) { return cfg.svcs != NULL && !stats.connected; }
+
+static void encode(void) {
+  adv_len = beacon_encode_adv(&sent, stats.seq, adv, sizeof(adv));
+  if (cfg.svcs != NULL && adv_len > 0) {
+    adv[adv_len++] = 3;
+    adv[adv_len++] = AD_UUID16_ALL;
+    adv[adv_len++] = (uint8_t)cfg.svc_uuid;
+    adv[adv_len++] = (uint8_t)(cfg.svc_uuid >> 8);
+  }
+}
+
+static void encode_name(void) {
+  size_t len = cfg.name != NULL ? strlen(cfg.name) : 0;
+  if (len == 0) {
+    return;
+  }
+  uint8_t type = AD_NAME_COMPLETE;
+  if (len > AD_MAX - 2) {
+    len = AD_MAX - 2;
+    type = AD_NAME_SHORT;
+  }
+  name_ad[0] = (uint8_t)(len + 1);
+  name_ad[1] = type;
+  memcpy(name_ad + 2, cfg.name, len);
+  name_ad_len = len + 2;
+}
+
+#if CONFIG_BT_NIMBLE_EXT_ADV
+static int set_data(void) {
+  // no scan response, the name rides along while connectable
+  size_t name_len = connectable() ? name_ad_len : 0;
+  struct os_mbuf *data = os_msys_get_pkthdr(adv_len + name_len, 0);
+  if (data == NULL) {
+    return BLE_HS_ENOMEM;
+  }
+  int nimble_err = os_mbuf_append(data, adv, adv_len);
+  if (nimble_err == 0 && name_len > 0) {
+    nimble_err = os_mbuf_append(data, name_ad, name_len);
+  }
+  if (nimble_err != 0) {
+    os_mbuf_free_chain(data);
+    return nimble_err;
+  }
+  // takes the mbuf either way
+  return ble_gap_ext_adv_set_data(BEACON_INSTANCE, data);
+}
+
+static int start(void) {
+  struct ble_gap_ext_adv_params params;
+  memset(&params, 0, sizeof(params));
+  params.connectable = connectable();
+  params.own_addr_type = own_addr_type;
+  params.itvl_min = BLE_GAP_ADV_ITVL_MS(CONFIG_BEACON_INTERVAL_MS);
+  params.itvl_max = BLE_GAP_ADV_ITVL_MS(CONFIG_BEACON_INTERVAL_MS);
+  params.tx_power = 127; // no preference
+  params.sid = BEACON_INSTANCE;
+#if CONFIG_BEACON_CODED_PHY
+  params.primary_phy = BLE_HCI_LE_PHY_CODED;
+  params.secondary_phy = BLE_HCI_LE_PHY_CODED;
+#else
+  params.primary_phy = BLE_HCI_LE_PHY_1M;
+  params.secondary_phy = BLE_HCI_LE_PHY_1M;
+#endif
+
+  int nimble_err = ble_gap_ext_adv_configure(
+    BEACON_INSTANCE, &params, NULL, on_gap_event, NULL);
+  if (nimble_err != 0) {
+    ESP_LOGE(TAG, "ble_gap_ext_adv_configure; error code: %d ", nimble_err);
+    return nimble_err;
+  }
+  nimble_err = set_data();
+  if (nimble_err != 0) {
+    ESP_LOGE(TAG, "ble_gap_ext_adv_set_data; error code: %d ", nimble_err);
+    return nimble_err;
+  }
+  stats.extended = true;
+  return ble_gap_ext_adv_start(BEACON_INSTANCE, 0, 0);
+}
+
+static int stop(void) { return ble_gap_ext_adv_stop(BEACON_INSTANCE); }
+#else
+static int set_data(void) { return ble_gap_adv_set_data(adv, adv_len); }
+
+static int start(void) {
+  int nimble_err = set_data();
+  if (nimble_err != 0) {
+    ESP_LOGE(TAG, "ble_gap_adv_set_data; error code: %d ", nimble_err);
+    return nimble_err;
+  }
+
+  // a plain beacon is neither connectable nor scannable, the controller
+  // only ever transmits
+  bool conn = connectable();
+  if (conn && name_ad_len > 0) {
+    nimble_err = ble_gap_adv_rsp_set_data(name_ad, name_ad_len);
+    if (nimble_err != 0) {
+      ESP_LOGE(TAG, "ble_gap_adv_rsp_set_data; error code: %d ", nimble_err);
+      return nimble_err;
+    }
+  }
+  struct ble_gap_adv_params params;
+  memset(&params, 0, sizeof(params));
+  params.conn_mode = conn ? BLE_GAP_CONN_MODE_UND : BLE_GAP_CONN_MODE_NON;
+  params.disc_mode = conn ? BLE_GAP_DISC_MODE_GEN : BLE_GAP_DISC_MODE_NON;
+  params.itvl_min = BLE_GAP_ADV_ITVL_MS(CONFIG_BEACON_INTERVAL_MS);
+  params.itvl_max = BLE_GAP_ADV_ITVL_MS(CONFIG_BEACON_INTERVAL_MS);
+  return ble_gap_adv_start(
+    own_addr_type, NULL, BLE_HS_FOREVER, &params, on_gap_event, NULL);
+}
+
+static int stop(void) { return ble_gap_adv_stop(); }
+#endif
+
+// with the lock held. a connection ends connectable advertising, the beacon
+// goes on without it, and back to connectable once the client is gone
+static void restart(void) {
+  // fails when the connection already stopped it
+  stop();
+  int nimble_err = start();
+  stats.advertising = nimble_err == 0;
+  if (nimble_err != 0) {
+    ESP_LOGE(TAG, "advertising restart; error code: %d ", nimble_err);
+  }
+}
+
+static int on_gap_event(struct ble_gap_event *event, void *arg) {
+  switch (event->type) {
+  case BLE_GAP_EVENT_CONNECT:
+    xSemaphoreTake(lock, portMAX_DELAY);
+    stats.connected = event->connect.status == 0;
+    restart();
+    xSemaphoreGive(lock);
+    break;
+  case BLE_GAP_EVENT_DISCONNECT:
+    xSemaphoreTake(lock, portMAX_DELAY);
+    stats.connected = false;
+    restart();
+    xSemaphoreGive(lock);
+    break;
+  }
+  return cfg.on_gap != NULL ? cfg.on_gap(event, arg) : 0;
+}
+
+static void on_stack_sync(void) {
+  // a public address when there is one, so a node keeps its identity
+  int nimble_err = ble_hs_id_infer_auto(0, &own_addr_type);
+  if (nimble_err != 0) {
+    ESP_LOGE(TAG, "ble_hs_id_infer_auto; error code: %d ", nimble_err);
+    return;
+  }
+
+  xSemaphoreTake(lock, portMAX_DELAY);
+  nimble_err = start();
+  stats.advertising = nimble_err == 0;
+  xSemaphoreGive(lock);
+  if (nimble_err != 0) {
+    ESP_LOGE(TAG, "advertising start; error code: %d ", nimble_err);
+    return;
+  }
+  ESP_LOGI(TAG,
+    "%s%s advertising every %d ms",
+    stats.extended ? "extended" : "legacy",
+    cfg.svcs != NULL ? " connectable" : "",
+    CONFIG_BEACON_INTERVAL_MS);
+}
+
+esp_err_t beacon_init(const beacon_cfg_t *app_cfg) {
+  if (app_cfg != NULL) {
+    cfg = *app_cfg;
+  }
+  lock = xSemaphoreCreateMutexStatic(&lock_buf);
+  encode();
+  encode_name();
+
+  ble_core_cfg_t core_cfg = {
+    .name = cfg.name,
+    .svcs = cfg.svcs,
+    .on_sync = on_stack_sync,
+  };
+  esp_err_t esp_err = ble_core_init(&core_cfg);
+  if (esp_err != ESP_OK) {
+    return esp_err;
+  }
+  ble_core_start();
+  return ESP_OK;
+}
+
+void beacon_update(const beacon_reading_t *reading) {
+  if (lock == NULL) {
+    return;
+  }
+  int64_t now = esp_timer_get_time();
+
+  xSemaphoreTake(lock, portMAX_DELAY);
+  bool stale = HEARTBEAT_US > 0 && now - sent_us >= HEARTBEAT_US;
+  if (!stale && !beacon_past_deadband(&sent, reading, &deadband)) {
+    stats.suppressed++;
+    xSemaphoreGive(lock);
+    return;
+  }
+
+  sent = *reading;
+  sent_us = now;
+  stats.seq++;
+  encode();
+  // before sync the payload goes out with the first advertisement
+  int nimble_err = stats.advertising ? set_data() : 0;
+  if (nimble_err == 0) {
+    stats.updates++;
+  }
+  xSemaphoreGive(lock);
+
+  if (nimble_err != 0) {
+    ESP_LOGE(TAG, "beacon_update; error code: %d ", nimble_err);
+  }
+}
+
+void beacon_get_stats(beacon_stats_t *out) {
+  if (lock == NULL) {
+    memset(out, 0, sizeof(*out));
+    return;
+  }
+  xSemaphoreTake(lock, portMAX_DELAY);
+  *out = stats;
+  xSemaphoreGive(lock);
+}
+
+#else
+
+#include <string.h>
+
+esp_err_t beacon_init(const beacon_cfg_t *cfg) { return ESP_ERR_NOT_SUPPORTED; }
+
+void beacon_update(const beacon_reading_t *reading) {}
+
+void beacon_get_stats(beacon_stats_t *out) { memset(out, 0, sizeof(*out)); }
+
+#endif
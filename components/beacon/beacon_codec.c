@@ -0,0 +1,93 @@
+#include "beacon_codec.h"
+#include <stdlib.h>
+
+#define AD_FLAGS 0x01
+#define AD_MFG_DATA 0xff
+// LE general discoverable, BR/EDR not supported
+#define AD_FLAGS_VALUE 0x06
+
+static bool moved(int a, int b, int deadband) {
+  return abs(a - b) >= (deadband > 0 ? deadband : 1);
+}
+
+bool beacon_past_deadband(const beacon_reading_t *sent,
+  const beacon_reading_t *now,
+  const beacon_deadband_t *deadband) {
+  if (sent->valid != now->valid) {
+    return true;
+  }
+  if (sent->battery != now->battery &&
+      (sent->battery == BEACON_BATTERY_UNKNOWN ||
+        now->battery == BEACON_BATTERY_UNKNOWN ||
+        moved(sent->battery, now->battery, deadband->battery))) {
+    return true;
+  }
+  return moved(sent->temperature, now->temperature, deadband->temperature) ||
+         moved(sent->humidity, now->humidity, deadband->humidity);
+}
+
+static void put_u16(uint8_t *p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+  return (uint16_t)(p[0] | p[1] << 8);
+}
+
+size_t beacon_encode_adv(const beacon_reading_t *reading,
+  uint16_t seq,
+  uint8_t *buf,
+  size_t len) {
+  if (len < BEACON_ADV_LEN) {
+    return 0;
+  }
+  uint8_t *p = buf;
+  *p++ = 2;
+  *p++ = AD_FLAGS;
+  *p++ = AD_FLAGS_VALUE;
+
+  *p++ = 1 + 2 + BEACON_PAYLOAD_LEN;
+  *p++ = AD_MFG_DATA;
+  put_u16(p, BEACON_COMPANY_ID);
+  p += 2;
+  *p++ = BEACON_VERSION;
+  *p++ = reading->valid ? BEACON_FLAG_VALID : 0;
+  put_u16(p, seq);
+  p += 2;
+  put_u16(p, (uint16_t)reading->temperature);
+  p += 2;
+  put_u16(p, reading->humidity);
+  p += 2;
+  *p++ = reading->battery;
+  return p - buf;
+}
+
+int beacon_decode_adv(const uint8_t *adv, size_t len, beacon_frame_t *out) {
+  size_t i = 0;
+  while (i < len) {
+    size_t ad_len = adv[i];
+    if (ad_len == 0 || i + 1 + ad_len > len) {
+      return -1;
+    }
+    const uint8_t *ad = adv + i + 1;
+    i += 1 + ad_len;
+    if (ad[0] != AD_MFG_DATA || ad_len != 1 + 2 + BEACON_PAYLOAD_LEN) {
+      continue;
+    }
+
+    const uint8_t *p = ad + 1;
+    if (get_u16(p) != BEACON_COMPANY_ID || p[2] != BEACON_VERSION) {
+      continue;
+    }
+    out->company = get_u16(p);
+    out->version = p[2];
+    out->reading.valid = p[3] & BEACON_FLAG_VALID;
+    out->seq = get_u16(p + 4);
+    out->reading.temperature = (int16_t)get_u16(p + 6);
+    out->reading.humidity = get_u16(p + 8);
+    out->reading.battery = p[10];
+    return 0;
+  }
+  return -1;
+}
@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+"""Collect sensor beacons without connecting to any node.
+
+Decodes the manufacturer data laid out in include/beacon_codec.h. Scanning
+needs bleak (pip install bleak) and a BLE adapter on the gateway; decoding
+hex advertising data, e.g. from btmon or another scanner, does not.
+
+    python beacon_scan.py                      # scan, one line per new reading
+    python beacon_scan.py -t 60 --json out.json # scan 60 s, keep latest per node
+    python beacon_scan.py --hex 020106...      # decode advertising data
+"""
+import argparse
+import asyncio
+import json
+import struct
+import sys
+import time
+
+COMPANY_ID = 0xFFFF
+VERSION = 1
+FLAG_VALID = 0x01
+BATTERY_UNKNOWN = 0xFF
+AD_MFG_DATA = 0xFF
+# after the company id
+PAYLOAD = struct.Struct("<BBHhHB")
+
+
+def decode_mfg(data):
+    """data is manufacturer data after the company id, returns a dict or None"""
+    if len(data) != PAYLOAD.size:
+        return None
+    version, flags, seq, temp, hum, batt = PAYLOAD.unpack(data)
+    if version != VERSION:
+        return None
+    return {
+        "seq": seq,
+        "valid": bool(flags & FLAG_VALID),
+        "temperature": temp / 10,
+        "humidity": hum / 10,
+        "battery": None if batt == BATTERY_UNKNOWN else batt,
+    }
+
+
+def decode_adv(adv):
+    """walks the AD structures of raw advertising data"""
+    i = 0
+    while i < len(adv):
+        n = adv[i]
+        if n == 0 or i + 1 + n > len(adv):
+            return None
+        ad = adv[i + 1 : i + 1 + n]
+        i += 1 + n
+        if ad[0] != AD_MFG_DATA or len(ad) < 3:
+            continue
+        if struct.unpack_from("<H", ad, 1)[0] != COMPANY_ID:
+            continue
+        frame = decode_mfg(bytes(ad[3:]))
+        if frame:
+            return frame
+    return None
+
+
+def fmt(addr, rssi, frame):
+    if not frame["valid"]:
+        reading = "no reading yet"
+    else:
+        reading = f"{frame['temperature']:.1f}C {frame['humidity']:.1f}%"
+    batt = frame["battery"]
+    return (
+        f"{addr} seq {frame['seq']:5d} {reading}"
+        f" battery {'?' if batt is None else f'{batt}%'} rssi {rssi}"
+    )
+
+
+async def scan(seconds):
+    from bleak import BleakScanner
+
+    latest = {}
+
+    def on_adv(device, adv):
+        data = adv.manufacturer_data.get(COMPANY_ID)
+        frame = decode_mfg(data) if data else None
+        if frame is None:
+            return
+        prev = latest.get(device.address)
+        # a node advertises the same seq until its reading moves, a reboot
+        # restarts it, so only exact repeats are dropped
+        if prev and prev["seq"] == frame["seq"]:
+            prev["seen"] = time.time()
+            prev["rssi"] = adv.rssi
+            return
+        frame.update(seen=time.time(), rssi=adv.rssi)
+        latest[device.address] = frame
+        print(fmt(device.address, adv.rssi, frame), flush=True)
+
+    # passive, nodes are not scannable anyway
+    async with BleakScanner(on_adv, scanning_mode="passive"):
+        if seconds:
+            await asyncio.sleep(seconds)
+        else:
+            await asyncio.Event().wait()
+    return latest
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("-t", "--time", type=float, default=0, help="scan seconds")
+    ap.add_argument("--json", help="write the latest reading of every node")
+    ap.add_argument("--hex", help="decode advertising data instead")
+    args = ap.parse_args()
+
+    if args.hex:
+        frame = decode_adv(bytes.fromhex(args.hex))
+        if frame is None:
+            sys.exit("not a sensor beacon")
+        print(fmt("-", "-", frame))
+        return
+
+    try:
+        latest = asyncio.run(scan(args.time))
+    except KeyboardInterrupt:
+        return
+    print(f"{len(latest)} nodes")
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(latest, f, indent=1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,250 @@
+/*
+  host check of the beacon payload: encode/decode round trips over the
+  value ranges, advertising data a scanner really sees (other ADs around
+  ours, other companies, cut short) and the deadband edges that decide
+  when the advertiser bumps seq.
+
+    gcc -O2 -I../include beacon_test.c ../beacon_codec.c -o beacon_test
+    ./beacon_test
+
+  exits 1 when a check fails.
+*/
+#include "beacon_codec.h"
+#include <stdio.h>
+#include <string.h>
+
+static int failures;
+
+static void check(int ok, const char *what) {
+  if (!ok) {
+    printf("FAIL %s\n", what);
+    failures++;
+  }
+}
+
+static bool same(const beacon_reading_t *a, const beacon_reading_t *b) {
+  return a->valid == b->valid && a->temperature == b->temperature &&
+         a->humidity == b->humidity && a->battery == b->battery;
+}
+
+static void check_round_trip(void) {
+  const beacon_reading_t readings[] = {
+    {true, 231, 450, 87},
+    {false, 0, 0, BEACON_BATTERY_UNKNOWN},
+    {true, -1, 1000, 0},
+    {true, -400, 0, 100},
+    {true, INT16_MIN, UINT16_MAX, 254},
+    {true, INT16_MAX, 1, BEACON_BATTERY_UNKNOWN},
+  };
+  const uint16_t seqs[] = {0, 1, 0x1234, UINT16_MAX};
+  int bad = 0;
+  for (size_t i = 0; i < sizeof(readings) / sizeof(readings[0]); i++) {
+    for (size_t j = 0; j < sizeof(seqs) / sizeof(seqs[0]); j++) {
+      uint8_t adv[31];
+      beacon_frame_t f;
+      size_t n = beacon_encode_adv(&readings[i], seqs[j], adv, sizeof(adv));
+      if (n != BEACON_ADV_LEN || beacon_decode_adv(adv, n, &f) != 0 ||
+          f.company != BEACON_COMPANY_ID || f.version != BEACON_VERSION ||
+          f.seq != seqs[j] || !same(&f.reading, &readings[i])) {
+        bad++;
+      }
+    }
+  }
+  check(bad == 0, "round trip");
+
+  // little endian two's complement on the air, gateways decode it by hand
+  const beacon_reading_t cold = {true, -123, 456, BEACON_BATTERY_UNKNOWN};
+  uint8_t adv[BEACON_ADV_LEN];
+  beacon_encode_adv(&cold, 0x0201, adv, sizeof(adv));
+  const uint8_t want[BEACON_ADV_LEN] = {2, 0x01, 0x06, 12, 0xff, 0xff, 0xff,
+    BEACON_VERSION, BEACON_FLAG_VALID, 0x01, 0x02, 0x85, 0xff, 0xc8, 0x01,
+    0xff};
+  check(memcmp(adv, want, sizeof(want)) == 0, "wire bytes");
+
+  check(beacon_encode_adv(&cold, 0, adv, BEACON_ADV_LEN - 1) == 0,
+    "encode into a short buffer");
+}
+
+static void check_truncated(void) {
+  const beacon_reading_t r = {true, 231, 450, 87};
+  uint8_t adv[BEACON_ADV_LEN];
+  beacon_frame_t f;
+  beacon_encode_adv(&r, 7, adv, sizeof(adv));
+  int bad = 0;
+  for (size_t len = 0; len < BEACON_ADV_LEN; len++) {
+    if (beacon_decode_adv(adv, len, &f) == 0) {
+      bad++;
+    }
+  }
+  check(bad == 0, "truncated advertising data");
+
+  // a length byte past the end, before our AD
+  uint8_t over[2 + BEACON_ADV_LEN] = {30, 0x09};
+  memcpy(over + 2, adv, BEACON_ADV_LEN);
+  check(beacon_decode_adv(over, sizeof(over), &f) != 0, "AD overruns");
+
+  // a zero length ends the significant part, nothing after it counts
+  uint8_t end[1 + BEACON_ADV_LEN] = {0};
+  memcpy(end + 1, adv, BEACON_ADV_LEN);
+  check(beacon_decode_adv(end, sizeof(end), &f) != 0, "AD after the end");
+  uint8_t padded[31] = {0};
+  memcpy(padded, adv, BEACON_ADV_LEN);
+  check(beacon_decode_adv(padded, sizeof(padded), &f) == 0 && f.seq == 7,
+    "zero padding after our AD");
+}
+
+static void check_foreign(void) {
+  const beacon_reading_t r = {true, 231, 450, 87};
+  uint8_t adv[BEACON_ADV_LEN];
+  beacon_frame_t f;
+
+  beacon_encode_adv(&r, 7, adv, sizeof(adv));
+  adv[5] = 0x4c; // Apple
+  adv[6] = 0x00;
+  check(beacon_decode_adv(adv, sizeof(adv), &f) != 0, "other company");
+
+  beacon_encode_adv(&r, 7, adv, sizeof(adv));
+  adv[7] = BEACON_VERSION + 1;
+  check(beacon_decode_adv(adv, sizeof(adv), &f) != 0, "other version");
+
+  // our company id with a payload of another length
+  const uint8_t longer[] = {2, 0x01, 0x06, 13, 0xff, 0xff, 0xff,
+    BEACON_VERSION, 1, 0, 0, 0, 0, 0, 0, 0, 0};
+  check(beacon_decode_adv(longer, sizeof(longer), &f) != 0, "other length");
+
+  // same bytes under service data instead of manufacturer data
+  beacon_encode_adv(&r, 7, adv, sizeof(adv));
+  adv[4] = 0x16;
+  check(beacon_decode_adv(adv, sizeof(adv), &f) != 0, "other AD type");
+
+  const uint8_t name_only[] = {2, 0x01, 0x06, 5, 0x09, 't', 'e', 'm', 'p'};
+  check(beacon_decode_adv(name_only, sizeof(name_only), &f) != 0,
+    "no manufacturer data");
+}
+
+static void check_multi_ad(void) {
+  const beacon_reading_t r = {true, -57, 812, 64};
+  uint8_t ours[BEACON_ADV_LEN];
+  beacon_encode_adv(&r, 42, ours, sizeof(ours));
+  // without the flags AD, as in a scan response
+  const uint8_t *mfg = ours + 3;
+  const size_t mfg_len = BEACON_ADV_LEN - 3;
+
+  const uint8_t name[] = {5, 0x09, 't', 'e', 'm', 'p'};
+  const uint8_t other[] = {5, 0xff, 0x4c, 0x00, 0x02, 0x15};
+  const uint8_t newer[] = {12, 0xff, 0xff, 0xff, BEACON_VERSION + 1, 1, 0, 0,
+    0, 0, 0, 0, 0};
+  uint8_t adv[64];
+  beacon_frame_t f;
+  size_t n;
+
+  n = 0;
+  memcpy(adv + n, ours, sizeof(ours));
+  n += sizeof(ours);
+  memcpy(adv + n, name, sizeof(name));
+  n += sizeof(name);
+  check(beacon_decode_adv(adv, n, &f) == 0 && f.seq == 42 &&
+          same(&f.reading, &r),
+    "name after our AD");
+
+  n = 0;
+  memcpy(adv + n, name, sizeof(name));
+  n += sizeof(name);
+  memcpy(adv + n, other, sizeof(other));
+  n += sizeof(other);
+  memcpy(adv + n, mfg, mfg_len);
+  n += mfg_len;
+  check(beacon_decode_adv(adv, n, &f) == 0 && f.seq == 42 &&
+          same(&f.reading, &r),
+    "our AD last");
+
+  // a newer format next to the one we know
+  n = 0;
+  memcpy(adv + n, newer, sizeof(newer));
+  n += sizeof(newer);
+  memcpy(adv + n, mfg, mfg_len);
+  n += mfg_len;
+  check(beacon_decode_adv(adv, n, &f) == 0 && f.version == BEACON_VERSION &&
+          f.seq == 42,
+    "two versions");
+}
+
+static void check_deadband(void) {
+  const beacon_deadband_t db = {.temperature = 5, .humidity = 10, .battery = 5};
+  const beacon_reading_t sent = {true, -2, 500, 80};
+  beacon_reading_t now;
+
+  now = sent;
+  check(!beacon_past_deadband(&sent, &now, &db), "unchanged");
+
+  struct {
+    int16_t temperature;
+    uint16_t humidity;
+    uint8_t battery;
+    bool past;
+    const char *what;
+  } cases[] = {
+    {2, 500, 80, false, "temperature one under"},
+    {3, 500, 80, true, "temperature at the deadband"},
+    {-6, 500, 80, false, "temperature one under, falling"},
+    {-7, 500, 80, true, "temperature at the deadband, falling"},
+    {-2, 509, 80, false, "humidity one under"},
+    {-2, 510, 80, true, "humidity at the deadband"},
+    {-2, 490, 80, true, "humidity at the deadband, falling"},
+    {-2, 500, 76, false, "battery one under"},
+    {-2, 500, 75, true, "battery at the deadband"},
+    {-2, 500, 85, true, "battery at the deadband, charging"},
+    {-2, 500, BEACON_BATTERY_UNKNOWN, true, "battery lost"},
+  };
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    now = sent;
+    now.temperature = cases[i].temperature;
+    now.humidity = cases[i].humidity;
+    now.battery = cases[i].battery;
+    check(beacon_past_deadband(&sent, &now, &db) == cases[i].past,
+      cases[i].what);
+  }
+
+  // unknown is not 255 percent, any step to or from it counts
+  const beacon_reading_t unknown = {true, -2, 500, BEACON_BATTERY_UNKNOWN};
+  now = unknown;
+  now.battery = 254;
+  check(beacon_past_deadband(&unknown, &now, &db), "battery found");
+  now.battery = BEACON_BATTERY_UNKNOWN;
+  check(!beacon_past_deadband(&unknown, &now, &db), "battery still unknown");
+
+  now = sent;
+  now.valid = false;
+  check(beacon_past_deadband(&sent, &now, &db), "validity only");
+
+  // a zero deadband means every change, not no change
+  const beacon_deadband_t zero = {0};
+  now = sent;
+  check(!beacon_past_deadband(&sent, &now, &zero), "unchanged, no deadband");
+  now.temperature = -1;
+  check(beacon_past_deadband(&sent, &now, &zero), "temperature, no deadband");
+  now = sent;
+  now.humidity = 499;
+  check(beacon_past_deadband(&sent, &now, &zero), "humidity, no deadband");
+  now = sent;
+  now.battery = 79;
+  check(beacon_past_deadband(&sent, &now, &zero), "battery, no deadband");
+
+  // the full int16 span does not wrap
+  const beacon_reading_t low = {true, INT16_MIN, 0, 0};
+  now = low;
+  now.temperature = INT16_MAX;
+  const beacon_deadband_t wide = {.temperature = INT16_MAX};
+  check(beacon_past_deadband(&low, &now, &wide), "temperature extremes");
+}
+
+int main(void) {
+  check_round_trip();
+  check_truncated();
+  check_foreign();
+  check_multi_ad();
+  check_deadband();
+
+  printf("%s\n", failures ? "FAILED" : "ok");
+  return failures > 0;
+}
@@ -0,0 +1,49 @@
+#ifndef BEACON_H
+#define BEACON_H
+
+#include "beacon_codec.h"
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+  non-connectable advertising of the latest sensor reading, see beacon_codec.h
+  for the payload. uses extended advertising when NimBLE has it
+  (CONFIG_BT_NIMBLE_EXT_ADV) and legacy ADV_NONCONN_IND otherwise.
+  without NimBLE every call is a no-op.
+
+  an app with GATT services of its own passes them in beacon_cfg_t. the
+  same advertisement is then connectable while nobody is connected, and
+  goes back to a plain beacon for as long as a client is.
+*/
+
+struct ble_gap_event;
+struct ble_gatt_svc_def;
+
+typedef struct {
+  const char *name;
+  // NULL for broadcast only
+  const struct ble_gatt_svc_def *svcs;
+  // listed in the advertisement while connectable
+  uint16_t svc_uuid;
+  // gets every event of the connection, NULL when not needed
+  int (*on_gap)(struct ble_gap_event *event, void *arg);
+} beacon_cfg_t;
+
+typedef struct {
+  uint16_t seq;
+  uint32_t updates;    // payload changes pushed to the controller
+  uint32_t suppressed; // readings inside the deadband
+  bool advertising;
+  bool extended;
+  bool connected;
+} beacon_stats_t;
+
+// brings NimBLE up, advertising starts once the host is in sync. cfg NULL
+// for broadcast only
+esp_err_t beacon_init(const beacon_cfg_t *cfg);
+// call with every reading, the payload only changes past the deadband
+void beacon_update(const beacon_reading_t *reading);
+void beacon_get_stats(beacon_stats_t *out);
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef BEACON_CODEC_H
+#define BEACON_CODEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  sensor beacon payload, hardware independent so gateways can link it too.
+  the advertising data is a flags AD plus one manufacturer specific AD:
+
+    | len | 0xff | company u16 | version u8 | flags u8 | seq u16 |
+    | temperature i16 | humidity u16 | battery u8 |
+
+  little endian, temperature and humidity in tenths, battery in percent or
+  BEACON_BATTERY_UNKNOWN. seq only moves when the payload changes, so a
+  scanner keeps the newest (address, seq) and drops repeats.
+*/
+
+// 0xffff is reserved for testing, a fleet should use its assigned id
+#define BEACON_COMPANY_ID 0xffff
+#define BEACON_VERSION 1
+#define BEACON_BATTERY_UNKNOWN 0xff
+
+#define BEACON_FLAG_VALID 0x01 // a sensor reading has been taken
+
+// manufacturer data after the company id
+#define BEACON_PAYLOAD_LEN 9
+// flags AD + manufacturer AD, fits a legacy 31 byte advertisement
+#define BEACON_ADV_LEN (3 + 2 + 2 + BEACON_PAYLOAD_LEN)
+
+typedef struct {
+  bool valid;
+  int16_t temperature; // tenths of C
+  uint16_t humidity;   // tenths of %
+  uint8_t battery;     // percent, BEACON_BATTERY_UNKNOWN without a sensor
+} beacon_reading_t;
+
+typedef struct {
+  int16_t temperature;
+  uint16_t humidity;
+  uint8_t battery;
+} beacon_deadband_t;
+
+typedef struct {
+  uint16_t company;
+  uint8_t version;
+  uint16_t seq;
+  beacon_reading_t reading;
+} beacon_frame_t;
+
+// true when now differs from what was last advertised by at least the
+// deadband on any value, or validity changed
+bool beacon_past_deadband(const beacon_reading_t *sent,
+  const beacon_reading_t *now,
+  const beacon_deadband_t *deadband);
+
+// full advertising data, returns the length or 0 when buf is too small
+size_t beacon_encode_adv(const beacon_reading_t *reading,
+  uint16_t seq,
+  uint8_t *buf,
+  size_t len);
+
+// finds our manufacturer data in any advertising data.
+// returns 0 on success, -1 when it is not a beacon of a known version
+int beacon_decode_adv(const uint8_t *adv, size_t len, beacon_frame_t *out);
+
+#endif
@@ -0,0 +1,116 @@
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define BENCH_UNIT "cycles"
+
+static inline uint32_t bench_now(void) { return esp_cpu_get_cycle_count(); }
+
+static void bench_pause(uint32_t ms) { vTaskDelay(pdMS_TO_TICKS(ms)); }
+
+static uint32_t bench_clock_hz(void) {
+  return esp_rom_get_cpu_ticks_per_us() * 1000000u;
+}
+#else
+#include <time.h>
+
+#define BENCH_UNIT "ns"
+
+static inline uint32_t bench_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+static void bench_pause(uint32_t ms) {
+  struct timespec ts = {.tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000L};
+  nanosleep(&ts, NULL);
+}
+
+static uint32_t bench_clock_hz(void) { return 1000000000u; }
+#endif
+
+static int cmp_u32(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+// smallest back to back counter delta, subtracted from every sample
+static uint32_t bench_overhead(void) {
+  uint32_t best = UINT32_MAX;
+  for (int i = 0; i < 64; i++) {
+    uint32_t t0 = bench_now();
+    uint32_t t1 = bench_now();
+    if (t1 - t0 < best) {
+      best = t1 - t0;
+    }
+  }
+  return best;
+}
+
+int bench_run(const char *name,
+  bench_fn_t fn,
+  void *ctx,
+  const bench_opts_t *opts,
+  bench_result_t *out) {
+  uint32_t iterations = opts->iterations ? opts->iterations : 1;
+  uint32_t *samples = malloc(iterations * sizeof(uint32_t));
+  if (samples == NULL) {
+    return -1;
+  }
+
+  for (uint32_t i = 0; i < opts->warmup; i++) {
+    fn(ctx);
+    if (opts->pause_ms) {
+      bench_pause(opts->pause_ms);
+    }
+  }
+
+  uint32_t overhead = bench_overhead();
+  for (uint32_t i = 0; i < iterations; i++) {
+    uint32_t t0 = bench_now();
+    fn(ctx);
+    uint32_t dt = bench_now() - t0;
+    samples[i] = dt > overhead ? dt - overhead : 0;
+    if (opts->pause_ms) {
+      bench_pause(opts->pause_ms);
+    }
+  }
+
+  qsort(samples, iterations, sizeof(uint32_t), cmp_u32);
+
+  out->name = name;
+  out->iterations = iterations;
+  out->min = samples[0];
+  out->median = samples[iterations / 2];
+  out->p99 = samples[(uint32_t)(((uint64_t)iterations * 99) / 100)];
+  out->max = samples[iterations - 1];
+  out->unit = BENCH_UNIT;
+
+  free(samples);
+  return 0;
+}
+
+void bench_print_header(void) {
+  printf("BENCH_META,clock_hz,%u,unit,%s\n",
+    (unsigned)bench_clock_hz(),
+    BENCH_UNIT);
+}
+
+void bench_print(const bench_result_t *result) {
+  printf("BENCH,%s,%u,%u,%u,%u,%u,%s\n",
+    result->name,
+    (unsigned)result->iterations,
+    (unsigned)result->min,
+    (unsigned)result->median,
+    (unsigned)result->p99,
+    (unsigned)result->max,
+    result->unit);
+}
@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+"""Compare BENCH lines from a serial log against baseline.csv.
+
+    idf.py monitor | tee monitor.log
+    python bench_compare.py monitor.log              # report, exit 1 on regression
+    python bench_compare.py monitor.log --update     # take the log as new baseline
+
+baseline.csv holds device results. host_test runs are compared against
+baseline_host.csv with --baseline, their nanoseconds don't mix with device
+cycles. a comparison that matched no baseline row exits 1 too.
+"""
+import argparse
+import csv
+import os
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_BASELINE = os.path.join(HERE, "baseline.csv")
+
+
+def read_results(path):
+    results = {}
+    with open(path, errors="replace") as f:
+        for line in f:
+            idx = line.find("BENCH,")
+            if idx < 0:
+                continue
+            fields = line[idx:].strip().split(",")
+            if len(fields) != 8:
+                continue
+            _, name, iters, lo, median, p99, hi, unit = fields
+            results[name] = {
+                "unit": unit,
+                "median": int(median),
+                "p99": int(p99),
+            }
+    return results
+
+
+def read_baseline(path):
+    baseline = {}
+    if not os.path.exists(path):
+        return baseline
+    with open(path) as f:
+        rows = (line for line in f if not line.startswith("#"))
+        for row in csv.DictReader(rows):
+            baseline[row["name"]] = {
+                "unit": row["unit"],
+                "median": int(row["median"]),
+                "p99": int(row["p99"]),
+            }
+    return baseline
+
+
+def write_baseline(path, baseline):
+    with open(path) as f:
+        comments = [line for line in f if line.startswith("#")]
+    with open(path, "w", newline="") as f:
+        f.writelines(comments)
+        writer = csv.writer(f, lineterminator="\n")
+        writer.writerow(["name", "unit", "median", "p99"])
+        for name in sorted(baseline):
+            r = baseline[name]
+            writer.writerow([name, r["unit"], r["median"], r["p99"]])
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("log")
+    parser.add_argument("--baseline", default=DEFAULT_BASELINE)
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="allowed median slowdown in percent")
+    parser.add_argument("--update", action="store_true")
+    args = parser.parse_args()
+
+    results = read_results(args.log)
+    if not results:
+        print("no BENCH lines in", args.log)
+        return 1
+
+    baseline = read_baseline(args.baseline)
+    if args.update:
+        baseline.update(results)
+        write_baseline(args.baseline, baseline)
+        print("updated", len(results), "entries in", args.baseline)
+        return 0
+
+    if not baseline:
+        print("no rows in", args.baseline, "- take one with --update")
+        return 1
+
+    regressions = 0
+    compared = 0
+    print(f"{'name':32} {'base':>10} {'now':>10} {'change':>8}  p99")
+    for name, now in sorted(results.items()):
+        base = baseline.get(name)
+        if base is None or base["unit"] != now["unit"]:
+            print(f"{name:32} {'-':>10} {now['median']:>10} {'new':>8}  {now['p99']}")
+            continue
+        compared += 1
+        change = (now["median"] - base["median"]) * 100.0 / max(base["median"], 1)
+        flag = ""
+        if change > args.threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        print(f"{name:32} {base['median']:>10} {now['median']:>10} "
+              f"{change:>+7.1f}%  {now['p99']}{flag}")
+
+    if compared == 0:
+        print("nothing in", args.log, "matches", args.baseline)
+        return 1
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
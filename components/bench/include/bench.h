@@ -0,0 +1,47 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+/*
+  minimal microbenchmark harness. on target samples are CPU cycles from
+  esp_cpu_get_cycle_count(), on the host nanoseconds from clock_gettime().
+  the cost of reading the counter is measured once and subtracted.
+
+  results are printed as one line per case so they can be grepped out of a
+  serial log and checked against baseline.csv with bench_compare.py:
+    BENCH,<name>,<iterations>,<min>,<median>,<p99>,<max>,<unit>
+*/
+
+typedef void (*bench_fn_t)(void *ctx);
+
+typedef struct {
+  uint32_t warmup;
+  uint32_t iterations;
+  // untimed pause between iterations, for devices with a minimum poll
+  // interval such as the DHT11
+  uint32_t pause_ms;
+} bench_opts_t;
+
+typedef struct {
+  const char *name;
+  uint32_t iterations;
+  uint32_t min;
+  uint32_t median;
+  uint32_t p99;
+  uint32_t max;
+  const char *unit;
+} bench_result_t;
+
+// returns 0 on success, -1 when the sample buffer cannot be allocated
+int bench_run(const char *name,
+  bench_fn_t fn,
+  void *ctx,
+  const bench_opts_t *opts,
+  bench_result_t *out);
+
+// BENCH_META line with the clock so cycles can be converted to time
+void bench_print_header(void);
+void bench_print(const bench_result_t *result);
+
+#endif
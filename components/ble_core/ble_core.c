@@ -0,0 +1,74 @@
+#include "ble_core.h"
+#include "esp_log.h"
+#include "nimble/nimble_port.h"
+#include "nimble/nimble_port_freertos.h"
+#include "services/gap/ble_svc_gap.h"
+#include "services/gatt/ble_svc_gatt.h"
+
+static const char *TAG = "BLE_CORE";
+
+static void on_stack_reset(int reason) {
+  ESP_LOGE(TAG, "Resetting state; reason=%d", reason);
+}
+
+static void host_task(void *param) {
+  ESP_LOGI(TAG, "BLE Host Task Started");
+  nimble_port_run();
+  nimble_port_freertos_deinit();
+}
+
+esp_err_t ble_core_init(const ble_core_cfg_t *cfg) {
+  esp_err_t esp_err = nimble_port_init();
+  if (esp_err != ESP_OK) {
+    ESP_LOGE(TAG, "nimble_port_init; error code: %d ", esp_err);
+    return esp_err;
+  }
+
+  ble_hs_cfg.sync_cb = cfg->on_sync;
+  ble_hs_cfg.reset_cb = on_stack_reset;
+  ble_hs_cfg.store_status_cb = ble_store_util_status_rr;
+
+  ble_svc_gap_init();
+  ble_svc_gatt_init();
+  if (cfg->name) {
+    ble_svc_gap_device_name_set(cfg->name);
+  }
+
+  // broadcast only apps have no services of their own
+  if (cfg->svcs == NULL) {
+    return ESP_OK;
+  }
+
+  int nimble_err = ble_gatts_count_cfg(cfg->svcs);
+  if (nimble_err != 0) {
+    ESP_LOGE(TAG, "ble_gatts_count_cfg; error code: %d ", nimble_err);
+    nimble_port_deinit();
+    return ESP_FAIL;
+  }
+
+  nimble_err = ble_gatts_add_svcs(cfg->svcs);
+  if (nimble_err != 0) {
+    ESP_LOGE(TAG, "ble_gatts_add_svcs; error code: %d ", nimble_err);
+    nimble_port_deinit();
+    return ESP_FAIL;
+  }
+
+  return ESP_OK;
+}
+
+void ble_core_start(void) { nimble_port_freertos_init(host_task); }
+
+esp_err_t ble_core_stop(void) {
+  int nimble_err = nimble_port_stop();
+  if (nimble_err != 0) {
+    ESP_LOGE(TAG, "nimble_port_stop; error code: %d ", nimble_err);
+    return ESP_FAIL;
+  }
+  // the host is down either way, a failure here only keeps the controller
+  // memory allocated
+  esp_err_t esp_err = nimble_port_deinit();
+  if (esp_err != ESP_OK) {
+    ESP_LOGE(TAG, "nimble_port_deinit; error code: %d ", esp_err);
+  }
+  return ESP_OK;
+}
@@ -0,0 +1,28 @@
+#ifndef BLE_CORE_H
+#define BLE_CORE_H
+
+#include "esp_err.h"
+#include "host/ble_hs.h"
+
+/*
+  NimBLE bring up shared by the apps: port init, GAP/GATT services, the
+  app's service table and the host task. anything app specific (security
+  manager, advertising) is set up by the app after ble_core_init() and
+  before ble_core_start()
+*/
+
+typedef struct {
+  const char *name;
+  // NULL for broadcast only
+  const struct ble_gatt_svc_def *svcs;
+  // host and controller are in sync, usually starts advertising
+  void (*on_sync)(void);
+} ble_core_cfg_t;
+
+esp_err_t ble_core_init(const ble_core_cfg_t *cfg);
+// runs the host in its own task
+void ble_core_start(void);
+// returns once the host task exited, also frees the controller
+esp_err_t ble_core_stop(void);
+
+#endif
@@ -0,0 +1,284 @@
+#include "boot_init.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_rtc_time.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+#include <string.h>
+
+#define BOOT_MAGIC (0x42544950u ^ sizeof(boot_prof_t)) // "BTIP"
+#define BUDGET_US ((uint32_t)CONFIG_BOOT_INIT_BUDGET_MS * 1000)
+
+static const char *TAG = "BOOT_INIT";
+
+// [0] this boot, [1] the one before the last reset. left alone by the
+// startup code, garbage after power on until the magic is written
+RTC_NOINIT_ATTR static boot_prof_t rtc_prof[2];
+static boot_prof_t *const cur = &rtc_prof[0];
+static boot_prof_t *const prev = &rtc_prof[1];
+static bool started = false;
+
+static const boot_step_t *steps;
+static size_t n_steps;
+// claimed steps were handed to a worker, finished ones set their bit in
+// done_group too
+static uint32_t claimed, finished, failed;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+static StaticEventGroup_t done_buf;
+static EventGroupHandle_t done_group;
+
+static uint32_t now_us(void) { return (uint32_t)esp_timer_get_time(); }
+
+static void copy_name(char *dst, const char *src) {
+  strncpy(dst, src, BOOT_INIT_NAME_LEN - 1);
+  dst[BOOT_INIT_NAME_LEN - 1] = '\0';
+}
+
+static void start_profile(bool parallel) {
+  if (cur->magic == BOOT_MAGIC) {
+    *prev = *cur;
+  } else {
+    prev->magic = 0;
+  }
+
+  esp_reset_reason_t reason = esp_reset_reason();
+  uint32_t boots = prev->magic == BOOT_MAGIC ? prev->boots + 1 : 0;
+  memset(cur, 0, sizeof(*cur));
+  cur->boots = reason == ESP_RST_POWERON ? 0 : boots;
+  cur->reason = reason;
+  // the RTC timer only restarts with power, on other resets it still counts
+  // from the power on before
+  if (reason == ESP_RST_POWERON) {
+    cur->poweron_us = (uint32_t)(esp_rtc_get_time_us() - esp_timer_get_time());
+  }
+  cur->parallel = parallel;
+  cur->magic = BOOT_MAGIC;
+  started = true;
+}
+
+static void run_step(size_t i) {
+  const boot_step_t *step = &steps[i];
+  boot_event_t *ev = &cur->ev[i];
+  copy_name(ev->name, step->name);
+  ev->core = (int8_t)xPortGetCoreID();
+  ev->start_us = now_us();
+
+  portENTER_CRITICAL(&lock);
+  bool skip = (step->deps & failed) != 0;
+  portEXIT_CRITICAL(&lock);
+
+  esp_err_t err = skip ? ESP_ERR_INVALID_STATE : step->fn();
+  ev->end_us = now_us();
+  ev->err = err;
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "%s; error code: %d ", step->name, err);
+  }
+
+  portENTER_CRITICAL(&lock);
+  finished |= BOOT_DEP(i);
+  if (err != ESP_OK) {
+    failed |= BOOT_DEP(i);
+  }
+  portEXIT_CRITICAL(&lock);
+  if (done_group) {
+    xEventGroupSetBits(done_group, BOOT_DEP(i));
+  }
+}
+
+#if CONFIG_BOOT_INIT_PARALLEL
+// next step this worker may run, -1 when nothing is ready yet
+static int claim(bool any_core_only, bool *none_left) {
+  int found = -1;
+  bool left = false;
+  portENTER_CRITICAL(&lock);
+  for (size_t i = 0; i < n_steps; i++) {
+    uint32_t bit = BOOT_DEP(i);
+    if ((claimed & bit) || (any_core_only && !steps[i].any_core)) {
+      continue;
+    }
+    left = true;
+    if ((steps[i].deps & finished) == steps[i].deps) {
+      claimed |= bit;
+      found = (int)i;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&lock);
+  *none_left = !left;
+  return found;
+}
+
+static void work(bool any_core_only) {
+  uint32_t all = BOOT_DEP(n_steps) - 1;
+  for (;;) {
+    bool none_left;
+    int i = claim(any_core_only, &none_left);
+    if (i >= 0) {
+      run_step(i);
+      continue;
+    }
+    if (none_left) {
+      return;
+    }
+    // wake on the next finished step
+    portENTER_CRITICAL(&lock);
+    uint32_t pending = all & ~finished;
+    portEXIT_CRITICAL(&lock);
+    if (pending) {
+      xEventGroupWaitBits(done_group, pending, pdFALSE, pdFALSE,
+        portMAX_DELAY);
+    }
+  }
+}
+
+static void worker_task(void *arg) {
+  work((bool)(intptr_t)arg);
+  vTaskDelete(NULL);
+}
+#endif
+
+esp_err_t boot_init_run(const boot_step_t *table, size_t count) {
+  if (count > BOOT_INIT_MAX_STEPS) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  for (size_t i = 0; i < count; i++) {
+    if (table[i].deps & ~(BOOT_DEP(i) - 1)) {
+      ESP_LOGE(TAG, "%s depends on a later step", table[i].name);
+      return ESP_ERR_INVALID_ARG;
+    }
+  }
+
+  steps = table;
+  n_steps = count;
+  claimed = finished = failed = 0;
+  start_profile(CONFIG_BOOT_INIT_PARALLEL);
+  cur->steps = count;
+  uint32_t t0 = now_us();
+
+#if CONFIG_BOOT_INIT_PARALLEL
+  done_group = xEventGroupCreateStatic(&done_buf);
+  xEventGroupClearBits(done_group, BOOT_DEP(BOOT_INIT_MAX_STEPS) - 1);
+  BaseType_t core = xPortGetCoreID();
+  UBaseType_t prio = uxTaskPriorityGet(NULL);
+  for (int w = 1; w < CONFIG_BOOT_INIT_WORKERS; w++) {
+    BaseType_t on = (core + w) % portNUM_PROCESSORS;
+    if (xTaskCreatePinnedToCore(worker_task, "boot_init",
+          CONFIG_BOOT_INIT_STACK, (void *)(intptr_t)(on != core), prio, NULL,
+          on) != pdPASS) {
+      ESP_LOGW(TAG, "worker %d not started, fewer steps overlap", w);
+    }
+  }
+  work(false);
+  // the caller ran out of steps, wait for the other workers to finish theirs
+  xEventGroupWaitBits(
+    done_group, BOOT_DEP(count) - 1, pdFALSE, pdTRUE, portMAX_DELAY);
+#else
+  for (size_t i = 0; i < count; i++) {
+    run_step(i);
+  }
+#endif
+
+  cur->total_us = now_us() - t0;
+  for (size_t i = 0; i < count; i++) {
+    if (cur->ev[i].err != ESP_OK) {
+      return cur->ev[i].err;
+    }
+  }
+  return ESP_OK;
+}
+
+void boot_init_mark(const char *name) {
+  if (!started) {
+    return;
+  }
+  uint32_t t = now_us();
+  boot_event_t *ev = NULL;
+  portENTER_CRITICAL(&lock);
+  bool seen = false;
+  for (int i = 0; i < cur->marks; i++) {
+    if (strncmp(cur->ev[cur->steps + i].name, name, BOOT_INIT_NAME_LEN - 1) ==
+        0) {
+      seen = true;
+      break;
+    }
+  }
+  if (!seen && cur->marks < BOOT_INIT_MAX_MARKS) {
+    ev = &cur->ev[cur->steps + cur->marks++];
+    memset(ev, 0, sizeof(*ev));
+    copy_name(ev->name, name);
+    ev->start_us = ev->end_us = t;
+    ev->core = (int8_t)xPortGetCoreID();
+    ev->is_mark = 1;
+  }
+  portEXIT_CRITICAL(&lock);
+  if (ev == NULL) {
+    return;
+  }
+
+  uint32_t since = cur->poweron_us + t;
+  const char *from = cur->poweron_us ? "power on" : "app start";
+  if (since > BUDGET_US) {
+    ESP_LOGW(TAG,
+      "ready: %s %d ms after %s, over the %d ms budget",
+      name,
+      (int)(since / 1000),
+      from,
+      CONFIG_BOOT_INIT_BUDGET_MS);
+  } else {
+    ESP_LOGI(TAG, "ready: %s %d ms after %s", name, (int)(since / 1000), from);
+  }
+}
+
+bool boot_init_get(boot_prof_t *out, bool previous) {
+  const boot_prof_t *p = previous ? prev : cur;
+  if (!started || p->magic != BOOT_MAGIC) {
+    return false;
+  }
+  portENTER_CRITICAL(&lock);
+  *out = *p;
+  portEXIT_CRITICAL(&lock);
+  return true;
+}
+
+void boot_init_report(void) {
+  boot_prof_t p;
+  if (!boot_init_get(&p, false)) {
+    return;
+  }
+  ESP_LOGI(TAG,
+    "%s init: %d us, reset reason %d, boot %d since power on",
+    p.parallel ? "parallel" : "serial",
+    (int)p.total_us,
+    (int)p.reason,
+    (int)p.boots);
+  if (p.poweron_us) {
+    ESP_LOGI(
+      TAG, "app started %d ms after power on", (int)(p.poweron_us / 1000));
+  }
+  for (int i = 0; i < p.steps + p.marks; i++) {
+    const boot_event_t *ev = &p.ev[i];
+    if (ev->is_mark) {
+      ESP_LOGI(TAG, "  %-11s ready at %7d us", ev->name, (int)ev->start_us);
+    } else {
+      ESP_LOGI(TAG,
+        "  %-11s %7d - %7d us, core %d%s",
+        ev->name,
+        (int)ev->start_us,
+        (int)ev->end_us,
+        ev->core,
+        ev->err == ESP_OK ? "" : ", failed");
+    }
+  }
+
+  if (boot_init_get(&p, true)) {
+    ESP_LOGI(TAG,
+      "previous boot: %s init %d us, %d ready marks",
+      p.parallel ? "parallel" : "serial",
+      (int)p.total_us,
+      p.marks);
+  }
+}
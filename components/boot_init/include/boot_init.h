@@ -0,0 +1,70 @@
+#ifndef BOOT_INIT_H
+#define BOOT_INIT_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  app bring up as a table of steps with their dependencies. steps whose
+  dependencies are done run at the same time on a few short lived worker
+  tasks, the caller is one of them. a step may only depend on steps listed
+  before it, so the table order is also a valid serial order, which is what
+  runs with CONFIG_BOOT_INIT_PARALLEL off.
+
+  workers on the caller's core take any step. workers on the other core only
+  take steps marked any_core, everything that allocates an interrupt (gpio
+  isr service, wifi, BLE controller) stays on the core it always ran on.
+
+  start and end of every step and the ready marks (LED lit, advertising) are
+  kept in RTC memory, so the previous boot's profile survives a reset.
+*/
+
+// one event group bit per step
+#define BOOT_INIT_MAX_STEPS 24
+#define BOOT_INIT_MAX_MARKS 8
+#define BOOT_INIT_NAME_LEN 12
+
+#define BOOT_DEP(step) (1u << (step))
+
+typedef struct {
+  const char *name;
+  esp_err_t (*fn)(void);
+  uint32_t deps; // BOOT_DEP() of earlier steps
+  bool any_core;
+} boot_step_t;
+
+typedef struct {
+  char name[BOOT_INIT_NAME_LEN];
+  uint32_t start_us; // esp_timer time, marks have start == end
+  uint32_t end_us;
+  int32_t err;     // ESP_ERR_INVALID_STATE for steps skipped after a failure
+  int8_t core;
+  uint8_t is_mark;
+} boot_event_t;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t boots;    // resets since power on
+  uint32_t reason;   // esp_reset_reason_t
+  uint32_t poweron_us; // RTC time at esp_timer zero, 0 when not a power on
+  uint32_t total_us; // steps only
+  uint8_t parallel;
+  uint8_t steps;
+  uint8_t marks;
+  boot_event_t ev[BOOT_INIT_MAX_STEPS + BOOT_INIT_MAX_MARKS];
+} boot_prof_t;
+
+// runs every step, returns the first error of a failed step. steps that
+// depend on a failed one are skipped
+esp_err_t boot_init_run(const boot_step_t *steps, size_t count);
+// first time a ready point is reached, later marks with the same name are
+// ignored. checked against CONFIG_BOOT_INIT_BUDGET_MS
+void boot_init_mark(const char *name);
+// this boot, or the one before the last reset. false when there is none
+bool boot_init_get(boot_prof_t *out, bool previous);
+// logs this boot's steps and marks, and the previous boot's totals
+void boot_init_report(void);
+
+#endif
@@ -0,0 +1,172 @@
+#include "dht.h"
+#include "dht11_decode.h"
+#include "esp_log.h"
+#include "trace.h"
+#include <esp32/rom/ets_sys.h>
+#include <freertos/FreeRTOS.h>
+
+#define TIMER_INTERVAL 2
+
+static portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+#define PORT_ENTER_CRITICAL() portENTER_CRITICAL(&mux)
+#define PORT_EXIT_CRITICAL() portEXIT_CRITICAL(&mux)
+
+static const char *TAG = "DHT";
+
+/*
+  code is mostly me copying/tweaking the dht.c from
+  https://github.com/esp-idf-lib/dht/blob/main/dht.c to get a better
+  understanding of what is happening
+
+  from temp_humid/datasheets/DHT11-Temperature_Humidity.pdf
+
+  Stage 1. set Data Single-bus voltage level from high to low for at least 18ms
+  Stage 2. pull up voltage and wait 20-40us (microseconds) for DHT’s response
+  Stage 3. DHT sends low for 80us as reponse signal
+  Stage 4. DHT sends high for 80us to prep sending data
+
+  begin sending data
+
+  every bit starts with 50us low then length of following high determines 1 or 0
+  duration < 50us = 0
+  duration > 50us = 1
+
+  total of 40 bits sequentially
+  byte array length 5
+  bytes 1 and 3 are humidity %
+  bytes 2 and 4 are temperature C
+  bytes 2 and 4 zero fill
+  byte 5 is checksum
+
+  byte_5 == (byte_1 + byte_2 + byte_3 + byte_4) & 0xFF
+*/
+
+static esp_err_t await_pin_state(
+  gpio_num_t pin, uint32_t timeout, int expected_state, uint32_t *duration) {
+  gpio_set_direction(pin, GPIO_MODE_INPUT);
+
+  for (uint32_t i = 0; i < timeout; i += TIMER_INTERVAL) {
+    ets_delay_us(TIMER_INTERVAL);
+    if (gpio_get_level(pin) == expected_state) {
+      if (duration) {
+        *duration = i;
+      }
+      return ESP_OK;
+    }
+  }
+
+  return ESP_ERR_TIMEOUT;
+};
+
+// only captures pulse lengths, decoding happens after the critical section
+static inline esp_err_t transmit_data(gpio_num_t pin, dht11_pulses_t *pulses) {
+  esp_err_t err;
+
+  // 1. set voltage from high to low for 20ms
+  gpio_set_direction(pin, GPIO_MODE_OUTPUT_OD);
+  gpio_set_level(pin, 0);
+  ets_delay_us(20000);
+
+  // 2. pull up voltage and wait 40us
+  gpio_set_level(pin, 1);
+  ets_delay_us(40);
+  err = await_pin_state(pin, 40, 0, NULL);
+  if (err != ESP_OK) {
+    PORT_EXIT_CRITICAL();
+    ESP_LOGE(TAG, "transmit_data: Stage 2 error: %d", err);
+    return err;
+  }
+
+  // 3. DHT sends low for 80us as reponse signal
+  err = await_pin_state(pin, 80, 1, NULL);
+  if (err != ESP_OK) {
+    PORT_EXIT_CRITICAL();
+    ESP_LOGE(TAG, "transmit_data: Stage 3 error: %d", err);
+    return err;
+  }
+
+  // 4. DHT sends high for 80us to prep sending data
+  err = await_pin_state(pin, 80, 0, NULL);
+  if (err != ESP_OK) {
+    PORT_EXIT_CRITICAL();
+    ESP_LOGE(TAG, "transmit_data: Stage 4 error: %d", err);
+    return err;
+  }
+
+  // read in bits
+  for (int i = 0; i < DHT11_DATA_BITS; i++) {
+    err = await_pin_state(pin, 65, 1, &pulses->low[i]);
+    if (err != ESP_OK) {
+      PORT_EXIT_CRITICAL();
+      ESP_LOGE(TAG, "transmit_data: low bit timeout");
+      return err;
+    }
+
+    err = await_pin_state(pin, 75, 0, &pulses->high[i]);
+    if (err != ESP_OK) {
+      PORT_EXIT_CRITICAL();
+      ESP_LOGE(TAG, "transmit_data: high bit timeout");
+      return err;
+    }
+  }
+
+  return ESP_OK;
+};
+
+esp_err_t dht_read(gpio_num_t pin, int16_t *humidity, int16_t *temperature) {
+  if (!humidity && !temperature) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  dht11_pulses_t pulses;
+
+  gpio_set_direction(pin, GPIO_MODE_OUTPUT_OD);
+  gpio_set_level(pin, 1);
+
+  TRACE_BEGIN(TRACE_DHT_CRITICAL);
+  PORT_ENTER_CRITICAL();
+  esp_err_t res = transmit_data(pin, &pulses);
+  if (res == ESP_OK) {
+    PORT_EXIT_CRITICAL();
+  }
+  TRACE_END(TRACE_DHT_CRITICAL);
+
+  gpio_set_direction(pin, GPIO_MODE_OUTPUT_OD);
+  gpio_set_level(pin, 1);
+
+  if (res != ESP_OK) {
+    return res;
+  }
+
+  if (!dht11_decode(&pulses, humidity, temperature)) {
+    ESP_LOGE(TAG, "checksum failed");
+    return ESP_ERR_INVALID_CRC;
+  }
+
+  ESP_LOGD(TAG, "Data: humidity=%d, temperature=%d", *humidity, *temperature);
+
+  return ESP_OK;
+};
+
+esp_err_t dht_read_float(gpio_num_t pin, float *humidity, float *temperature) {
+  if (!humidity && !temperature) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  int16_t i_humidity, i_temp;
+
+  esp_err_t res =
+    dht_read(pin, humidity ? &i_humidity : NULL, temperature ? &i_temp : NULL);
+  if (res != ESP_OK) {
+    return res;
+  }
+
+  if (humidity) {
+    *humidity = i_humidity / 10.0;
+  }
+  if (temperature) {
+    *temperature = i_temp / 10.0;
+  }
+
+  return ESP_OK;
+};
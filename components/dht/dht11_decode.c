@@ -0,0 +1,50 @@
+#include "dht11_decode.h"
+#include <stddef.h>
+
+void dht11_decode_bits(
+  const dht11_pulses_t *pulses, uint8_t data[DHT11_DATA_BYTES]) {
+  for (int i = 0; i < DHT11_DATA_BITS; i++) {
+    uint8_t b = i / 8;
+    uint8_t m = i % 8;
+    // if m == 0, initialize element in byte array because it's the start of the
+    // next byte otherwise, b will be the index of the byte array we want to use
+
+    // 8 / 8 = 1 (b == 1)
+    // 8 % 8 = 0 (m == 0)
+
+    // 10 / 8 = 1 (b == 1)
+    // 10 % 8 = 0 (m == 2)
+    if (!m) {
+      data[b] = 0;
+    }
+
+    data[b] |= (pulses->high[i] > pulses->low[i]) << (7 - m);
+  }
+}
+
+bool dht11_checksum_ok(const uint8_t data[DHT11_DATA_BYTES]) {
+  return data[4] == ((data[0] + data[1] + data[2] + data[3]) & 0xFF);
+}
+
+static inline int16_t convert_data(uint8_t most_sig_bit) {
+  int16_t data = most_sig_bit * 10;
+  return data;
+}
+
+bool dht11_decode(
+  const dht11_pulses_t *pulses, int16_t *humidity, int16_t *temperature) {
+  uint8_t data[DHT11_DATA_BYTES];
+  dht11_decode_bits(pulses, data);
+
+  if (!dht11_checksum_ok(data)) {
+    return false;
+  }
+
+  if (humidity) {
+    *humidity = convert_data(data[0]);
+  }
+  if (temperature) {
+    *temperature = convert_data(data[2]);
+  }
+  return true;
+}
@@ -0,0 +1,12 @@
+#ifndef DHT_H
+#define DHT_H
+
+#include "driver/gpio.h"
+#include "esp_err.h"
+#include <stdint.h>
+
+// values are in tenths. the sensor needs about a second between reads
+esp_err_t dht_read(gpio_num_t pin, int16_t *humidity, int16_t *temperature);
+esp_err_t dht_read_float(gpio_num_t pin, float *humidity, float *temperature);
+
+#endif
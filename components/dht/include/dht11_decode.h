@@ -0,0 +1,32 @@
+#ifndef DHT11_DECODE_H
+#define DHT11_DECODE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+  hardware independent part of the DHT11 driver. the capture only measures
+  how long the line stays low and high for each of the 40 bits, turning those
+  into values happens here so it can be fed recorded pulse traces off target
+*/
+
+#define DHT11_DATA_BITS 40
+#define DHT11_DATA_BYTES (DHT11_DATA_BITS / 8)
+
+typedef struct {
+  uint32_t low[DHT11_DATA_BITS];
+  uint32_t high[DHT11_DATA_BITS];
+} dht11_pulses_t;
+
+// a bit is 1 when its high phase outlasts the 50us low phase before it
+void dht11_decode_bits(
+  const dht11_pulses_t *pulses, uint8_t data[DHT11_DATA_BYTES]);
+
+// byte_5 == (byte_1 + byte_2 + byte_3 + byte_4) & 0xFF
+bool dht11_checksum_ok(const uint8_t data[DHT11_DATA_BYTES]);
+
+// returns false on a checksum mismatch. values are in tenths
+bool dht11_decode(
+  const dht11_pulses_t *pulses, int16_t *humidity, int16_t *temperature);
+
+#endif
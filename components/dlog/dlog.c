@@ -0,0 +1,172 @@
+#include "dlog.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#if CONFIG_DLOG_ENABLE
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+typedef struct {
+  const dlog_site_t *site;
+  const char *tag;
+  uint32_t ts_ms;
+  uint32_t suppressed;
+  int args[DLOG_MAX_ARGS];
+} dlog_msg_t;
+
+static const char *TAG = "DLOG";
+
+static dlog_msg_t ring[CONFIG_DLOG_RING_SIZE];
+static uint32_t head = 0; // next write
+static uint32_t tail = 0; // next read
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+static dlog_stats_t stats = {0};
+static uint32_t reported_drops = 0;
+static TaskHandle_t task = NULL;
+
+// hot path: a timestamp, the rate check and a 32 byte copy under a spinlock.
+// only the first message into an empty ring wakes the log task
+void dlog_push(dlog_site_t *site,
+  const char *tag,
+  const int *args,
+  unsigned nargs) {
+  uint32_t now = esp_log_timestamp();
+
+  portENTER_CRITICAL_SAFE(&lock);
+  if (site->every_ms && site->last_ms &&
+      now - site->last_ms < site->every_ms) {
+    site->suppressed++;
+    stats.suppressed++;
+    portEXIT_CRITICAL_SAFE(&lock);
+    return;
+  }
+  if (head - tail >= CONFIG_DLOG_RING_SIZE) {
+    stats.dropped++;
+    portEXIT_CRITICAL_SAFE(&lock);
+    return;
+  }
+  dlog_msg_t *msg = &ring[head % CONFIG_DLOG_RING_SIZE];
+  msg->site = site;
+  msg->tag = tag;
+  msg->ts_ms = now;
+  msg->suppressed = site->suppressed;
+  memcpy(msg->args, args, nargs * sizeof(int));
+  site->last_ms = now ? now : 1;
+  site->suppressed = 0;
+  bool was_empty = head == tail;
+  head++;
+  if (head - tail > stats.high_water) {
+    stats.high_water = head - tail;
+  }
+  portEXIT_CRITICAL_SAFE(&lock);
+
+  if (was_empty && task != NULL) {
+    if (xPortInIsrContext()) {
+      BaseType_t woken = pdFALSE;
+      vTaskNotifyGiveFromISR(task, &woken);
+      portYIELD_FROM_ISR(woken);
+    } else {
+      xTaskNotifyGive(task);
+    }
+  }
+}
+
+static bool pop(dlog_msg_t *out) {
+  bool ok = false;
+  portENTER_CRITICAL(&lock);
+  if (tail != head) {
+    *out = ring[tail % CONFIG_DLOG_RING_SIZE];
+    tail++;
+    stats.written++;
+    ok = true;
+  }
+  portEXIT_CRITICAL(&lock);
+  return ok;
+}
+
+static char level_char(uint8_t level) {
+  switch (level) {
+  case ESP_LOG_ERROR:
+    return 'E';
+  case ESP_LOG_WARN:
+    return 'W';
+  case ESP_LOG_DEBUG:
+    return 'D';
+  case ESP_LOG_VERBOSE:
+    return 'V';
+  default:
+    return 'I';
+  }
+}
+
+static void emit(const dlog_msg_t *msg) {
+  const dlog_site_t *site = msg->site;
+  if (site->level > esp_log_level_get(msg->tag)) {
+    return;
+  }
+  printf("%c (%lu) %s: ", level_char(site->level), (unsigned long)msg->ts_ms,
+    msg->tag);
+  // unused trailing args are ignored by printf
+  printf(site->fmt, msg->args[0], msg->args[1], msg->args[2], msg->args[3]);
+  if (msg->suppressed) {
+    printf(" (+%lu suppressed)", (unsigned long)msg->suppressed);
+  }
+  printf("\n");
+}
+
+void dlog_flush(void) {
+  dlog_msg_t msg;
+  while (pop(&msg)) {
+    emit(&msg);
+  }
+
+  uint32_t dropped = stats.dropped;
+  if (dropped != reported_drops) {
+    printf("W (%lu) %s: %lu messages dropped\n",
+      (unsigned long)esp_log_timestamp(), TAG,
+      (unsigned long)(dropped - reported_drops));
+    reported_drops = dropped;
+  }
+  fflush(stdout);
+}
+
+// blocks while the ring is empty so it never keeps a sleeping chip awake
+void dlog_task(void *arg) {
+  task = xTaskGetCurrentTaskHandle();
+  for (;;) {
+    // also prints anything pushed before the task existed
+    dlog_flush();
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    // let a burst collect before printing it
+    vTaskDelay(pdMS_TO_TICKS(CONFIG_DLOG_FLUSH_MS));
+  }
+}
+
+void dlog_init(void) {
+  if (xTaskCreate(dlog_task, "dlog", DLOG_TASK_STACK, NULL,
+        CONFIG_DLOG_TASK_PRIORITY, NULL) != pdPASS) {
+    ESP_LOGE(TAG, "dlog_init; failed to create task");
+  }
+}
+
+void dlog_get_stats(dlog_stats_t *out) {
+  portENTER_CRITICAL(&lock);
+  *out = stats;
+  portEXIT_CRITICAL(&lock);
+}
+
+#else
+
+void dlog_init(void) {}
+
+void dlog_push(dlog_site_t *site,
+  const char *tag,
+  const int *args,
+  unsigned nargs) {}
+
+void dlog_flush(void) {}
+
+void dlog_get_stats(dlog_stats_t *out) { memset(out, 0, sizeof(*out)); }
+
+#endif
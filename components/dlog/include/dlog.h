@@ -0,0 +1,75 @@
+#ifndef DLOG_H
+#define DLOG_H
+
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include <stdint.h>
+
+/*
+  deferred logging for hot paths. a call site pushes a pointer to its static
+  format plus up to DLOG_MAX_ARGS int args into a ring, a low priority task
+  formats and prints them later. args must be ints (no strings, no floats),
+  the format string and tag must outlive the call (literals).
+
+    DLOGI(TAG, "speed %d", speed);
+    DLOGI_EVERY(TAG, 100, "speed %d", speed); // at most every 100 ms
+
+  when the ring is full the message is dropped and counted. messages skipped
+  by the rate limit are counted per site and reported with the next one.
+*/
+
+#define DLOG_MAX_ARGS 4
+
+typedef struct {
+  const char *fmt;
+  uint8_t level;
+  uint16_t every_ms;
+  uint32_t last_ms;
+  uint32_t suppressed;
+} dlog_site_t;
+
+typedef struct {
+  uint32_t written;
+  uint32_t dropped;
+  uint32_t suppressed;
+  uint32_t high_water; // most messages queued at once
+} dlog_stats_t;
+
+#if CONFIG_DLOG_ENABLE
+#define DLOG_AT(level, tag, every_ms, fmt, ...)                               \
+  do {                                                                        \
+    static dlog_site_t dlog_site_ = {(fmt), (level), (every_ms), 0, 0};      \
+    const int dlog_args_[] = {0, ##__VA_ARGS__};                              \
+    _Static_assert(sizeof(dlog_args_) / sizeof(int) - 1 <= DLOG_MAX_ARGS,     \
+      "too many DLOG args");                                                  \
+    dlog_push(&dlog_site_, (tag), dlog_args_ + 1,                             \
+      sizeof(dlog_args_) / sizeof(int) - 1);                                  \
+  } while (0)
+
+#define DLOGE(tag, fmt, ...) DLOG_AT(ESP_LOG_ERROR, tag, 0, fmt, ##__VA_ARGS__)
+#define DLOGW(tag, fmt, ...) DLOG_AT(ESP_LOG_WARN, tag, 0, fmt, ##__VA_ARGS__)
+#define DLOGI(tag, fmt, ...) DLOG_AT(ESP_LOG_INFO, tag, 0, fmt, ##__VA_ARGS__)
+#define DLOGI_EVERY(tag, ms, fmt, ...)                                        \
+  DLOG_AT(ESP_LOG_INFO, tag, ms, fmt, ##__VA_ARGS__)
+#else
+#define DLOGE(tag, fmt, ...) ESP_LOGE(tag, fmt, ##__VA_ARGS__)
+#define DLOGW(tag, fmt, ...) ESP_LOGW(tag, fmt, ##__VA_ARGS__)
+#define DLOGI(tag, fmt, ...) ESP_LOGI(tag, fmt, ##__VA_ARGS__)
+#define DLOGI_EVERY(tag, ms, fmt, ...) ESP_LOGI(tag, fmt, ##__VA_ARGS__)
+#endif
+
+#define DLOG_TASK_STACK 3072
+
+// starts the log task, messages pushed before this are printed once it runs.
+// apps with a task table list dlog_task there instead
+void dlog_init(void);
+void dlog_task(void *arg);
+void dlog_push(dlog_site_t *site,
+  const char *tag,
+  const int *args,
+  unsigned nargs);
+// prints everything queued from the calling task, e.g. before deep sleep
+void dlog_flush(void);
+void dlog_get_stats(dlog_stats_t *out);
+
+#endif
@@ -0,0 +1,181 @@
+#include "env_fix.h"
+
+// log2(1 + i / 32) in Q12
+static const int16_t log2_lut[33] = {
+  0, 182, 358, 530, 696, 858, 1016, 1169,
+  1319, 1465, 1607, 1746, 1882, 2015, 2145, 2272,
+  2396, 2518, 2637, 2754, 2869, 2982, 3092, 3200,
+  3307, 3412, 3514, 3615, 3715, 3812, 3908, 4003,
+  4096,
+};
+
+// Magnus temperature term b * T / (c + T) in Q12, T from -40 C in 1.6 C steps
+static const int16_t magnus_t_lut[82] = {
+  -14213, -13537, -12873, -12218, -11574, -10939, -10314, -9698,
+  -9092, -8494, -7905, -7324, -6752, -6188, -5632, -5084,
+  -4544, -4011, -3485, -2967, -2456, -1951, -1454, -963,
+  -478, 0, 472, 938, 1397, 1851, 2299, 2742,
+  3178, 3610, 4036, 4456, 4872, 5282, 5688, 6089,
+  6484, 6876, 7262, 7644, 8021, 8394, 8763, 9128,
+  9488, 9844, 10197, 10545, 10889, 11230, 11567, 11900,
+  12229, 12555, 12877, 13196, 13512, 13824, 14133, 14438,
+  14740, 15040, 15336, 15629, 15919, 16206, 16490, 16771,
+  17050, 17325, 17598, 17869, 18136, 18401, 18664, 18923,
+  19181, 19435,
+};
+
+// dew point c * g / (b - g) in tenths << 4, g from -11 in 1/8 steps (Q12)
+static const int16_t dew_lut[129] = {
+  -14951, -14846, -14740, -14633, -14525, -14416, -14306, -14196,
+  -14084, -13971, -13857, -13742, -13626, -13509, -13391, -13272,
+  -13151, -13030, -12907, -12784, -12659, -12532, -12405, -12276,
+  -12147, -12015, -11883, -11749, -11614, -11478, -11340, -11201,
+  -11060, -10918, -10774, -10629, -10483, -10335, -10185, -10034,
+  -9881, -9727, -9571, -9413, -9254, -9093, -8930, -8765,
+  -8598, -8430, -8260, -8088, -7913, -7737, -7559, -7379,
+  -7197, -7013, -6826, -6637, -6446, -6253, -6058, -5860,
+  -5659, -5457, -5251, -5044, -4833, -4620, -4405, -4186,
+  -3965, -3741, -3514, -3285, -3052, -2816, -2577, -2335,
+  -2089, -1840, -1588, -1333, -1073, -811, -544, -274,
+  0, 278, 560, 846, 1136, 1431, 1729, 2033,
+  2341, 2653, 2970, 3292, 3620, 3952, 4289, 4632,
+  4981, 5335, 5694, 6060, 6432, 6810, 7194, 7585,
+  7982, 8386, 8798, 9216, 9642, 10076, 10517, 10966,
+  11424, 11890, 12365, 12849, 13342, 13844, 14357, 14879,
+  15412,
+};
+
+#define LN2_Q16 45426
+// log2_q12(1000), so 100 % RH gives ln 1 = 0 exactly
+#define LOG2_1000_Q12 40819
+#define MAGNUS_T_MIN (-400)
+#define MAGNUS_T_SHIFT 4 // 16 tenths per step
+#define DEW_G_MIN (-11 * 4096)
+#define DEW_G_SHIFT 9 // 1/8 in Q12
+
+// Rothfusz coefficients for the term T^i RH^j with T in hundredths of F, RH
+// in tenths and the result in tenths of F: c * 10 / (100^i 10^j) in Q48
+#define HI_Q 48
+#define HI_K00 -119286280380208896LL
+#define HI_K10 57674651414403LL
+#define HI_K20 -1924678040LL
+#define HI_K01 2855093932991718LL
+#define HI_K11 -632630237953LL
+#define HI_K21 34585956LL
+#define HI_K02 -1542966164909LL
+#define HI_K12 240047490LL
+#define HI_K22 -5601LL
+
+static inline int32_t min32(int32_t a, int32_t b) { return a < b ? a : b; }
+static inline int32_t max32(int32_t a, int32_t b) { return a > b ? a : b; }
+static inline int32_t clamp32(int32_t v, int32_t lo, int32_t hi) {
+  return min32(max32(v, lo), hi);
+}
+
+// divides by a positive d, rounding half away from zero
+static inline int32_t div_round(int32_t v, int32_t d) {
+  return (v + (v < 0 ? -d / 2 : d / 2)) / d;
+}
+
+// log2(x) in Q12 for x >= 1, the top 5 bits below the leading one pick the
+// table entry, the next 10 interpolate
+static inline int32_t log2_q12(uint32_t x) {
+  int32_t e = 31 - __builtin_clz(x);
+  uint32_t norm = x << (31 - e);
+  uint32_t idx = (norm >> 26) & 31;
+  int32_t rem = (norm >> 16) & 1023;
+  int32_t lo = log2_lut[idx];
+  return (e << 12) + lo + (((log2_lut[idx + 1] - lo) * rem) >> 10);
+}
+
+// bit by bit, a fixed 9 rounds for x up to 2^16
+static inline int32_t isqrt16(int32_t x) {
+  int32_t r = 0;
+  for (int32_t bit = 256; bit > 0; bit >>= 1) {
+    int32_t c = r | bit;
+    r = c * c <= x ? c : r;
+  }
+  return r;
+}
+
+void env_filter_run(
+  env_filter_t *f, const int16_t *in, int16_t *out, size_t n, uint8_t shift) {
+  if (f->samples == 0) {
+    for (size_t i = 0; i < n; i++) {
+      f->prev[0][i] = in[i];
+      f->prev[1][i] = in[i];
+      f->ema[i] = in[i] * (1 << ENV_EMA_FRAC);
+    }
+  }
+  for (size_t i = 0; i < n; i++) {
+    int32_t a = in[i];
+    int32_t b = f->prev[0][i];
+    int32_t c = f->prev[1][i];
+    int32_t med = max32(min32(a, b), min32(max32(a, b), c));
+    f->prev[1][i] = (int16_t)b;
+    f->prev[0][i] = (int16_t)a;
+    f->ema[i] += (med * (1 << ENV_EMA_FRAC) - f->ema[i]) >> shift;
+    out[i] = (int16_t)((f->ema[i] + (1 << (ENV_EMA_FRAC - 1))) >> ENV_EMA_FRAC);
+  }
+  f->samples++;
+}
+
+void env_dew_point(
+  const int16_t *temp, const int16_t *hum, int16_t *out, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    // ln(RH / 100) in Q12
+    uint32_t rh = (uint32_t)clamp32(hum[i], 1, 1000);
+    int32_t ln_rh = ((log2_q12(rh) - LOG2_1000_Q12) * LN2_Q16) >> 16;
+
+    int32_t tv = clamp32(temp[i] - MAGNUS_T_MIN, 0, 80 << MAGNUS_T_SHIFT);
+    int32_t ti = tv >> MAGNUS_T_SHIFT;
+    int32_t tr = tv & ((1 << MAGNUS_T_SHIFT) - 1);
+    int32_t t_term = magnus_t_lut[ti] +
+                     (((magnus_t_lut[ti + 1] - magnus_t_lut[ti]) * tr) >>
+                       MAGNUS_T_SHIFT);
+
+    int32_t g = clamp32(
+      ln_rh + t_term - DEW_G_MIN, 0, (128 << DEW_G_SHIFT) - 1);
+    int32_t gi = g >> DEW_G_SHIFT;
+    int32_t gr = g & ((1 << DEW_G_SHIFT) - 1);
+    int32_t d = dew_lut[gi] +
+                (((dew_lut[gi + 1] - dew_lut[gi]) * gr) >> DEW_G_SHIFT);
+    out[i] = (int16_t)((d + 8) >> 4);
+  }
+}
+
+void env_heat_index(
+  const int16_t *temp, const int16_t *hum, int16_t *out, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    // hundredths of F are exact for tenths of C
+    int32_t t = temp[i] * 18 + 3200;
+    int32_t h = clamp32(hum[i], 0, 1000);
+
+    // eighths of a tenth of F from here, the only coarse rounding is the
+    // one to tenths of C at the end. simple formula averaged with T
+    int32_t simple_x = 420 * t - 206000 + 94 * h; // tenths of F * 4000
+    int32_t simple = div_round(simple_x, 500);
+
+    int64_t tl = t;
+    int64_t a = HI_K00 + tl * (HI_K10 + tl * HI_K20);
+    int64_t b = HI_K01 + tl * (HI_K11 + tl * HI_K21);
+    int64_t c = HI_K02 + tl * (HI_K12 + tl * HI_K22);
+    int64_t sum = a + h * (b + h * c);
+    int32_t full = (int32_t)((sum + (1LL << (HI_Q - 4))) >> (HI_Q - 3));
+
+    // dry: minus (13 - RH) / 4 * sqrt((17 - |T - 95|) / 17)
+    int32_t dist = 1700 - (t > 9500 ? t - 9500 : 9500 - t);
+    int32_t root = isqrt16(max32(dist, 0) * 65536 / 1700); // Q8
+    int32_t dry = h < 130 && t > 8000 && t < 11200
+                    ? div_round((130 - h) * root, 128)
+                    : 0;
+    // humid: plus (RH - 85) / 10 * (87 - T) / 5
+    int32_t humid = h > 850 && t > 8000 && t < 8700
+                      ? div_round((h - 850) * (8700 - t), 625)
+                      : 0;
+
+    // the regression from an 80 F average on
+    int32_t hi = simple_x >= 800 * 4000 ? full - dry + humid : simple;
+    out[i] = (int16_t)div_round((hi - 320 * 8) * 5, 9 * 8);
+  }
+}
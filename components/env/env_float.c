@@ -0,0 +1,63 @@
+#include "env_float.h"
+#include <math.h>
+
+#define MAGNUS_B 17.62f
+#define MAGNUS_C 243.12f
+
+static float median3(float a, float b, float c) {
+  return fmaxf(fminf(a, b), fminf(fmaxf(a, b), c));
+}
+
+void env_filter_float_run(env_filter_float_t *f,
+  const float *in,
+  float *out,
+  size_t n,
+  float alpha) {
+  if (f->samples == 0) {
+    for (size_t i = 0; i < n; i++) {
+      f->prev[0][i] = in[i];
+      f->prev[1][i] = in[i];
+      f->ema[i] = in[i];
+    }
+  }
+  for (size_t i = 0; i < n; i++) {
+    float med = median3(in[i], f->prev[0][i], f->prev[1][i]);
+    f->prev[1][i] = f->prev[0][i];
+    f->prev[0][i] = in[i];
+    f->ema[i] += (med - f->ema[i]) * alpha;
+    out[i] = f->ema[i];
+  }
+  f->samples++;
+}
+
+void env_dew_point_float(
+  const float *temp, const float *hum, float *out, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    float rh = fminf(fmaxf(hum[i], 0.1f), 100.0f);
+    float g =
+      logf(rh / 100.0f) + MAGNUS_B * temp[i] / (MAGNUS_C + temp[i]);
+    out[i] = MAGNUS_C * g / (MAGNUS_B - g);
+  }
+}
+
+void env_heat_index_float(
+  const float *temp, const float *hum, float *out, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    float t = temp[i] * 1.8f + 32.0f;
+    float rh = fminf(fmaxf(hum[i], 0.0f), 100.0f);
+    float hi = 0.5f * (t + 61.0f + (t - 68.0f) * 1.2f + rh * 0.094f);
+    hi = (hi + t) / 2.0f;
+    if (hi >= 80.0f) {
+      hi = -42.379f + 2.04901523f * t + 10.14333127f * rh -
+           0.22475541f * t * rh - 0.00683783f * t * t -
+           0.05481717f * rh * rh + 0.00122874f * t * t * rh +
+           0.00085282f * t * rh * rh - 0.00000199f * t * t * rh * rh;
+      if (rh < 13.0f && t > 80.0f && t < 112.0f) {
+        hi -= (13.0f - rh) / 4.0f * sqrtf((17.0f - fabsf(t - 95.0f)) / 17.0f);
+      } else if (rh > 85.0f && t > 80.0f && t < 87.0f) {
+        hi += (rh - 85.0f) / 10.0f * (87.0f - t) / 5.0f;
+      }
+    }
+    out[i] = (hi - 32.0f) / 1.8f;
+  }
+}
@@ -0,0 +1,194 @@
+/*
+  host check of env_fix against the float version in env_float: dew point
+  and heat index over the whole -40..88 C, 0..100 % grid in tenths, the
+  filter on a noisy trace with spikes, then a benchmark of a batch of
+  ENV_BATCH_MAX sensors through both pipelines.
+
+    gcc -O2 -I../include -I../../bench/include env_bench.c ../env_fix.c \
+      ../env_float.c ../../bench/bench.c -lm -o env_bench
+    ./env_bench
+
+  on a desktop the FPU makes the float version look cheap, the figures that
+  matter come from the same cases on target (temp_humid with
+  CONFIG_BENCH_ENABLE). BENCH lines match the device ones, so
+  bench_compare.py reads them too. exits 1 when an error is over its limit.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include "bench.h"
+#include "env_fix.h"
+#include "env_float.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define T_MIN (-400)
+#define T_MAX 880
+#define TRACE_LEN 5000
+#define SPIKE_EVERY 97
+#define EMA_SHIFT 2
+// tenths
+#define DEW_LIMIT 1.0
+#define HEAT_LIMIT 1.0
+#define FILTER_LIMIT 1.0
+
+typedef struct {
+  double max;
+  double sum;
+  uint32_t count;
+  int16_t at_temp;
+  int16_t at_hum;
+} err_t;
+
+static void err_add(err_t *e, double err, int16_t temp, int16_t hum) {
+  err = fabs(err);
+  e->sum += err;
+  e->count++;
+  if (err > e->max) {
+    e->max = err;
+    e->at_temp = temp;
+    e->at_hum = hum;
+  }
+}
+
+static int err_report(const char *name, const err_t *e, double limit) {
+  printf("%-11s max %.2f at %.1f C %.1f %%, mean %.3f (tenths)\n",
+    name,
+    e->max,
+    e->at_temp / 10.0,
+    e->at_hum / 10.0,
+    e->sum / e->count);
+  return e->max > limit;
+}
+
+// every temperature in tenths, one row of humidity per call
+static int check_derived(void) {
+  int16_t temp[1001];
+  int16_t hum[1001];
+  int16_t fix[1001];
+  float temp_f[1001];
+  float hum_f[1001];
+  float ref[1001];
+  err_t dew = {0};
+  err_t heat = {0};
+
+  for (int16_t t = T_MIN; t <= T_MAX; t++) {
+    for (int h = 0; h <= 1000; h++) {
+      temp[h] = t;
+      hum[h] = (int16_t)h;
+      temp_f[h] = t / 10.0f;
+      hum_f[h] = h / 10.0f;
+    }
+    // below 0.1 % the float log runs off, the sensors can't read that
+    env_dew_point(temp + 1, hum + 1, fix + 1, 1000);
+    env_dew_point_float(temp_f + 1, hum_f + 1, ref + 1, 1000);
+    for (int h = 1; h <= 1000; h++) {
+      err_add(&dew, fix[h] - ref[h] * 10.0, t, (int16_t)h);
+    }
+    env_heat_index(temp, hum, fix, 1001);
+    env_heat_index_float(temp_f, hum_f, ref, 1001);
+    for (int h = 0; h <= 1000; h++) {
+      err_add(&heat, fix[h] - ref[h] * 10.0, t, (int16_t)h);
+    }
+  }
+
+  int fail = err_report("dew point", &dew, DEW_LIMIT);
+  fail |= err_report("heat index", &heat, HEAT_LIMIT);
+  return fail;
+}
+
+// a DHT11 like trace (whole degrees) with a spike every SPIKE_EVERY reads
+static int check_filter(void) {
+  env_filter_t fix = {0};
+  env_filter_float_t ref = {0};
+  err_t err = {0};
+  uint32_t leaked = 0;
+
+  srand(1);
+  int16_t level = 230;
+  for (int i = 0; i < TRACE_LEN; i++) {
+    level += (int16_t)(rand() % 3 - 1) * 10;
+    int16_t in = level;
+    if (i % SPIKE_EVERY == SPIKE_EVERY - 1) {
+      in += 400;
+    }
+    float in_f = in / 10.0f;
+    int16_t out;
+    float out_f;
+    env_filter_run(&fix, &in, &out, 1, EMA_SHIFT);
+    env_filter_float_run(&ref, &in_f, &out_f, 1, 1.0f / (1 << EMA_SHIFT));
+    err_add(&err, out - out_f * 10.0, in, 0);
+    // a spike that got through the median moves the output by 10 C / 4
+    if (out > level + 50) {
+      leaked++;
+    }
+  }
+
+  int fail = err_report("filter", &err, FILTER_LIMIT);
+  printf("%-11s %u of %d spikes reached the output\n",
+    "",
+    (unsigned)leaked,
+    TRACE_LEN / SPIKE_EVERY);
+  return fail || leaked > 0;
+}
+
+typedef struct {
+  int16_t temp[ENV_BATCH_MAX];
+  int16_t hum[ENV_BATCH_MAX];
+  env_filter_t temp_filter;
+  env_filter_t hum_filter;
+  int16_t out[4][ENV_BATCH_MAX];
+} fix_batch_t;
+
+typedef struct {
+  float temp[ENV_BATCH_MAX];
+  float hum[ENV_BATCH_MAX];
+  env_filter_float_t temp_filter;
+  env_filter_float_t hum_filter;
+  float out[4][ENV_BATCH_MAX];
+} float_batch_t;
+
+static void bench_fix(void *ctx) {
+  fix_batch_t *b = ctx;
+  env_filter_run(&b->temp_filter, b->temp, b->out[0], ENV_BATCH_MAX, 2);
+  env_filter_run(&b->hum_filter, b->hum, b->out[1], ENV_BATCH_MAX, 2);
+  env_dew_point(b->out[0], b->out[1], b->out[2], ENV_BATCH_MAX);
+  env_heat_index(b->out[0], b->out[1], b->out[3], ENV_BATCH_MAX);
+}
+
+static void bench_float(void *ctx) {
+  float_batch_t *b = ctx;
+  env_filter_float_run(
+    &b->temp_filter, b->temp, b->out[0], ENV_BATCH_MAX, 0.25f);
+  env_filter_float_run(
+    &b->hum_filter, b->hum, b->out[1], ENV_BATCH_MAX, 0.25f);
+  env_dew_point_float(b->out[0], b->out[1], b->out[2], ENV_BATCH_MAX);
+  env_heat_index_float(b->out[0], b->out[1], b->out[3], ENV_BATCH_MAX);
+}
+
+int main(void) {
+  int fail = check_derived();
+  fail |= check_filter();
+
+  // spread over the range so both heat index branches run
+  static fix_batch_t fix_batch;
+  static float_batch_t float_batch;
+  for (int i = 0; i < ENV_BATCH_MAX; i++) {
+    fix_batch.temp[i] = (int16_t)(150 + i * 15);
+    fix_batch.hum[i] = (int16_t)(300 + i * 40);
+    float_batch.temp[i] = fix_batch.temp[i] / 10.0f;
+    float_batch.hum[i] = fix_batch.hum[i] / 10.0f;
+  }
+
+  bench_opts_t opts = {.warmup = 100, .iterations = 10000};
+  bench_result_t result;
+  bench_print_header();
+  if (bench_run(
+        "env_fix_batch", bench_fix, &fix_batch, &opts, &result) == 0) {
+    bench_print(&result);
+  }
+  if (bench_run(
+        "env_float_batch", bench_float, &float_batch, &opts, &result) == 0) {
+    bench_print(&result);
+  }
+  return fail;
+}
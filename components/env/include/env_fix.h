@@ -0,0 +1,48 @@
+#ifndef ENV_FIX_H
+#define ENV_FIX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  processing of decoded temperature and humidity readings without floats, so
+  it costs the same on chips without an FPU (C2, C3) where logf and friends
+  are soft float. values are tenths (degrees C, % RH) like dht_read().
+
+  every call takes a batch of n sensors as plain arrays (one entry per
+  sensor) and the loops carry no per sensor branches. the filter vectorizes
+  where there is SIMD, the table lookups keep the others scalar. a single
+  sensor is a batch of 1.
+
+  hardware independent. env_float.h has the same pipeline in float, the host
+  benchmark in host/ checks one against the other.
+*/
+
+#define ENV_BATCH_MAX 16
+// fraction bits of the smoothed value
+#define ENV_EMA_FRAC 8
+
+// one channel (temperature or humidity) of up to ENV_BATCH_MAX sensors,
+// zeroed state starts over with the next reading
+typedef struct {
+  int16_t prev[2][ENV_BATCH_MAX]; // last two raw readings
+  int32_t ema[ENV_BATCH_MAX];     // tenths << ENV_EMA_FRAC
+  uint32_t samples;
+} env_filter_t;
+
+// median of the reading and the two before it drops single sample spikes,
+// then ema += (median - ema) / 2^shift. the first reading seeds the history
+void env_filter_run(
+  env_filter_t *f, const int16_t *in, int16_t *out, size_t n, uint8_t shift);
+
+// Magnus formula (b 17.62, c 243.12 C) with lookup tables for ln(RH) and
+// the temperature term. within 0.1 C of the float version for -40..88 C
+// and 1..100 % RH
+void env_dew_point(
+  const int16_t *temp, const int16_t *hum, int16_t *out, size_t n);
+// NWS heat index: the simple formula, and the Rothfusz regression with its
+// low and high humidity adjustments from 80 F (26.7 C) on
+void env_heat_index(
+  const int16_t *temp, const int16_t *hum, int16_t *out, size_t n);
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef ENV_FLOAT_H
+#define ENV_FLOAT_H
+
+#include "env_fix.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  env_fix.h in float on dht_read_float() values (degrees C, % RH), written
+  the straightforward way with logf and sqrtf. the reference for accuracy
+  checks and the baseline for benchmarks, not meant for the sensor path.
+*/
+
+typedef struct {
+  float prev[2][ENV_BATCH_MAX];
+  float ema[ENV_BATCH_MAX];
+  uint32_t samples;
+} env_filter_float_t;
+
+// ema += (median - ema) * alpha
+void env_filter_float_run(env_filter_float_t *f,
+  const float *in,
+  float *out,
+  size_t n,
+  float alpha);
+void env_dew_point_float(
+  const float *temp, const float *hum, float *out, size_t n);
+void env_heat_index_float(
+  const float *temp, const float *hum, float *out, size_t n);
+
+#endif
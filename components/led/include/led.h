@@ -0,0 +1,10 @@
+#ifndef LED_H
+#define LED_H
+
+#include <stdint.h>
+
+// RGB LED on three LEDC channels sharing one timer
+void led_init(void);
+void led_set_rgb(uint8_t r, uint8_t g, uint8_t b);
+
+#endif
\ No newline at end of file
@@ -1,9 +1,10 @@
-#include "driver/gpio.h"
+#include "led.h"
 #include "driver/ledc.h"
+#include "sdkconfig.h"
 
-#define GPIO_R GPIO_NUM_23 // pin 37
-#define GPIO_G GPIO_NUM_22 // pin 36
-#define GPIO_B GPIO_NUM_21 // pin 33
+#define GPIO_R CONFIG_LED_R_GPIO
+#define GPIO_G CONFIG_LED_G_GPIO
+#define GPIO_B CONFIG_LED_B_GPIO
 
 #define CH_R LEDC_CHANNEL_0
 #define CH_G LEDC_CHANNEL_1
@@ -17,7 +18,7 @@
 #define LEDC_CLK_SRC LEDC_AUTO_CLK
 #define LEDC_FREQUENCY (4000) // Frequency in Hertz. Set frequency at 4 kHz
 
-void ledc_init(void) {
+void led_init(void) {
   ledc_timer_config_t timer_cfg = {
     .speed_mode = LEDC_MODE,
     .duty_resolution = LEDC_DUTY_RES,
@@ -53,7 +54,7 @@ void ledc_init(void) {
   }
 }
 
-void set_rgb(uint8_t r, uint8_t g, uint8_t b) {
+void led_set_rgb(uint8_t r, uint8_t g, uint8_t b) {
   ledc_set_duty(LEDC_MODE, CH_R, r);
   ledc_update_duty(LEDC_MODE, CH_R);
 
@@ -0,0 +1,17 @@
+#ifndef MOTOR_H
+#define MOTOR_H
+
+#include "motor_mix.h"
+#include <stdint.h>
+
+void motor_init(void);
+void motor_set_speed(int speed);
+// motor A and motor B driven separately, -255 to 255 each
+void motor_set_ab(int a, int b);
+void motor_brake(void);
+void motor_resume(void);
+void motor_stop(void);
+// duties last written to the LEDC channels
+void motor_get_duty(uint32_t duty[MOTOR_CHANNELS]);
+
+#endif
\ No newline at end of file
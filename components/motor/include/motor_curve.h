@@ -0,0 +1,36 @@
+#ifndef MOTOR_CURVE_H
+#define MOTOR_CURVE_H
+
+#include <stdint.h>
+
+// one entry per motor characteristic byte, 127 is stop
+#define MOTOR_CURVE_LEN 256
+#define MOTOR_CURVE_CENTER 127
+
+// response of one motor to the command byte. every field is a byte so the
+// struct doubles as its BLE and NVS layout
+typedef struct {
+  uint8_t deadzone; // command counts either side of center that stop, 0-100
+  uint8_t expo;     // 0 linear to 100 cubic, softens the middle of the stick
+  uint8_t min_duty; // first duty past the deadzone, covers motor stiction
+  uint8_t max_duty; // duty at full command
+  int8_t trim;      // percent added to this motor's duty, -50 to 50
+  uint8_t reverse;  // 1 when the motor is wired the other way round
+} motor_curve_t;
+
+// same output as the old linear ((raw - 127) * 2) mapping
+#define MOTOR_CURVE_LINEAR                                                     \
+  {.deadzone = 0,                                                              \
+   .expo = 0,                                                                  \
+   .min_duty = 0,                                                              \
+   .max_duty = 255,                                                            \
+   .trim = 0,                                                                  \
+   .reverse = 0}
+
+// hardware independent. returns 0 when every field is in range, -1 otherwise
+int motor_curve_check(const motor_curve_t *curve);
+// fills lut with a -255 to 255 speed for every command byte
+void motor_curve_build(const motor_curve_t *curve,
+                       int16_t lut[MOTOR_CURVE_LEN]);
+
+#endif
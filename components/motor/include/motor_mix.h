@@ -0,0 +1,15 @@
+#ifndef MOTOR_MIX_H
+#define MOTOR_MIX_H
+
+#include <stdint.h>
+
+// LEDC channels in the order AIN1, AIN2, BIN1, BIN2
+#define MOTOR_CHANNELS 4
+#define MOTOR_SPEED_MAX 255
+
+// hardware independent, turns a -255 to 255 speed into per channel duties
+void motor_mix(int speed, uint32_t duty[MOTOR_CHANNELS]);
+// same with a separate speed for motor A and motor B
+void motor_mix_ab(int a, int b, uint32_t duty[MOTOR_CHANNELS]);
+
+#endif
@@ -0,0 +1,116 @@
+#include "motor.h"
+#include "dlog.h"
+#include "driver/gpio.h"
+#include "driver/ledc.h"
+#include "esp_log.h"
+#include "motor_mix.h"
+#include "sdkconfig.h"
+#include "trace.h"
+#include <string.h>
+
+#define MOTOR_AIN1 CONFIG_MOTOR_AIN1_GPIO
+#define MOTOR_AIN2 CONFIG_MOTOR_AIN2_GPIO
+
+#define MOTOR_BIN1 CONFIG_MOTOR_BIN1_GPIO
+#define MOTOR_BIN2 CONFIG_MOTOR_BIN2_GPIO
+
+#define MOTOR_STBY CONFIG_MOTOR_STBY_GPIO
+
+static const char *TAG = "MOTOR";
+
+static uint32_t last_duty[MOTOR_CHANNELS];
+
+void motor_init(void) {
+  ledc_timer_config_t timer = {.speed_mode = LEDC_LOW_SPEED_MODE,
+                               .duty_resolution = LEDC_TIMER_8_BIT,
+                               .timer_num = LEDC_TIMER_0,
+                               .freq_hz = 1000,
+                               .clk_cfg = LEDC_AUTO_CLK};
+  ledc_timer_config(&timer);
+
+  ledc_channel_config_t ch1 = {.gpio_num = MOTOR_AIN1,
+                               .speed_mode = LEDC_LOW_SPEED_MODE,
+                               .channel = LEDC_CHANNEL_0,
+                               .timer_sel = LEDC_TIMER_0,
+                               .duty = 0,
+                               .hpoint = 0};
+  ledc_channel_config(&ch1);
+
+  ledc_channel_config_t ch2 = {.gpio_num = MOTOR_AIN2,
+                               .speed_mode = LEDC_LOW_SPEED_MODE,
+                               .channel = LEDC_CHANNEL_1,
+                               .timer_sel = LEDC_TIMER_0,
+                               .duty = 0,
+                               .hpoint = 0};
+  ledc_channel_config(&ch2);
+
+  ledc_channel_config_t ch3 = {.gpio_num = MOTOR_BIN1,
+                               .speed_mode = LEDC_LOW_SPEED_MODE,
+                               .channel = LEDC_CHANNEL_2,
+                               .timer_sel = LEDC_TIMER_0,
+                               .duty = 0,
+                               .hpoint = 0};
+  ledc_channel_config(&ch3);
+
+  ledc_channel_config_t ch4 = {.gpio_num = MOTOR_BIN2,
+                               .speed_mode = LEDC_LOW_SPEED_MODE,
+                               .channel = LEDC_CHANNEL_3,
+                               .timer_sel = LEDC_TIMER_0,
+                               .duty = 0,
+                               .hpoint = 0};
+  ledc_channel_config(&ch4);
+
+  gpio_set_direction(MOTOR_STBY, GPIO_MODE_OUTPUT);
+  gpio_set_level(MOTOR_STBY, 1);
+}
+
+void motor_set_ab(int a, int b) { // -255 to 255 each
+  TRACE_BEGIN(TRACE_MOTOR_UPDATE);
+  uint32_t duty[MOTOR_CHANNELS];
+  motor_mix_ab(a, b, duty);
+
+  ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0, duty[0]);
+  ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_1, duty[1]);
+  ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_2, duty[2]);
+  ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_3, duty[3]);
+  ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0);
+  ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_1);
+  ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_2);
+  ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_3);
+  memcpy(last_duty, duty, sizeof(last_duty));
+  TRACE_END(TRACE_MOTOR_UPDATE);
+
+  DLOGI_EVERY(TAG, 100, "Motor speed: %d %d", a, b);
+}
+
+void motor_set_speed(int speed) { motor_set_ab(speed, speed); }
+
+void motor_brake(void) { gpio_set_level(MOTOR_STBY, 0); }
+
+void motor_resume(void) { gpio_set_level(MOTOR_STBY, 1); }
+
+void motor_stop(void) { motor_set_speed(0); }
+
+void motor_get_duty(uint32_t duty[MOTOR_CHANNELS]) {
+  memcpy(duty, last_duty, sizeof(last_duty));
+}
+
+// void init_pins() {
+//   gpio_reset_pin(MOTOR_AIN1);
+//   gpio_reset_pin(MOTOR_AIN2);
+
+//   gpio_reset_pin(MOTOR_BIN1);
+//   gpio_reset_pin(MOTOR_BIN2);
+
+//   gpio_reset_pin(MOTOR_STBY);
+
+//   gpio_set_direction(MOTOR_AIN1, GPIO_MODE_OUTPUT);
+//   gpio_set_direction(MOTOR_AIN2, GPIO_MODE_OUTPUT);
+
+//   gpio_set_direction(MOTOR_BIN1, GPIO_MODE_OUTPUT);
+//   gpio_set_direction(MOTOR_BIN2, GPIO_MODE_OUTPUT);
+
+//   gpio_set_direction(MOTOR_STBY, GPIO_MODE_OUTPUT);
+
+// gpio_set_level(MOTOR_STBY, 1);
+// }
\ No newline at end of file
@@ -0,0 +1,51 @@
+#include "motor_curve.h"
+#include "motor_mix.h"
+
+int motor_curve_check(const motor_curve_t *curve) {
+  if (curve->deadzone > 100 || curve->expo > 100 ||
+      curve->min_duty > curve->max_duty || curve->trim < -50 ||
+      curve->trim > 50 || curve->reverse > 1) {
+    return -1;
+  }
+  return 0;
+}
+
+// integer only so the host tools build the exact table the car uses
+static int16_t curve_point(const motor_curve_t *curve, int raw) {
+  // the old linear scale first, -254 to 255
+  int in = (raw - MOTOR_CURVE_CENTER) * 2;
+  if (in > MOTOR_SPEED_MAX) {
+    in = MOTOR_SPEED_MAX;
+  }
+  int mag = in < 0 ? -in : in;
+  int dz = curve->deadzone * 2;
+  if (mag <= dz) {
+    return 0;
+  }
+
+  // n / span is the position past the deadzone, shaped by
+  // (1 - e) * x + e * x^3 with e = expo / 100
+  int64_t n = mag - dz;
+  int64_t span = MOTOR_SPEED_MAX - dz;
+  int64_t e = curve->expo;
+  int64_t num = (100 - e) * n * span * span + e * n * n * n;
+  int64_t den = 100 * span * span * span;
+
+  int64_t range = curve->max_duty - curve->min_duty;
+  int64_t scaled = (curve->min_duty * den + range * num) * (100 + curve->trim);
+  int64_t div = den * 100;
+  int64_t duty = (scaled + div / 2) / div;
+  if (duty > MOTOR_SPEED_MAX) {
+    duty = MOTOR_SPEED_MAX;
+  }
+
+  int negative = (in < 0) != (curve->reverse != 0);
+  return (int16_t)(negative ? -duty : duty);
+}
+
+void motor_curve_build(const motor_curve_t *curve,
+                       int16_t lut[MOTOR_CURVE_LEN]) {
+  for (int raw = 0; raw < MOTOR_CURVE_LEN; raw++) {
+    lut[raw] = curve_point(curve, raw);
+  }
+}
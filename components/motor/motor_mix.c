@@ -0,0 +1,32 @@
+#include "motor_mix.h"
+
+static int clamp_speed(int speed) {
+  if (speed > MOTOR_SPEED_MAX) {
+    return MOTOR_SPEED_MAX;
+  }
+  if (speed < -MOTOR_SPEED_MAX) {
+    return -MOTOR_SPEED_MAX;
+  }
+  return speed;
+}
+
+// one bridge of the driver: forward on IN1, reverse on IN2
+static void mix_bridge(int speed, uint32_t *in1, uint32_t *in2) {
+  speed = clamp_speed(speed);
+  if (speed > 0) {
+    *in1 = speed;
+    *in2 = 0;
+  } else {
+    *in1 = 0;
+    *in2 = -speed;
+  }
+}
+
+void motor_mix_ab(int a, int b, uint32_t duty[MOTOR_CHANNELS]) {
+  mix_bridge(a, &duty[0], &duty[1]);
+  mix_bridge(b, &duty[2], &duty[3]);
+}
+
+void motor_mix(int speed, uint32_t duty[MOTOR_CHANNELS]) {
+  motor_mix_ab(speed, speed, duty);
+}
@@ -0,0 +1,52 @@
+#ifndef OTA_H
+#define OTA_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  Streaming update into the inactive app slot. Chunks go to flash as they
+  arrive (sectors are erased as the write reaches them) and into a running
+  SHA-256, so nothing larger than the caller's receive buffer is held in RAM.
+
+    ota_begin(len) -> ota_write(chunk)... -> ota_end(sha or NULL)
+
+  ota_end() lets esp_ota_end() validate the image, checks the digest when one
+  is given and only then switches the boot slot. Any failure aborts the
+  update and leaves the running slot as the boot slot.
+*/
+
+#define OTA_SHA256_LEN 32
+
+typedef struct {
+  uint32_t updates;  // successful updates since boot
+  uint32_t failures;
+  uint32_t bytes;    // last update
+  uint32_t ms;
+  uint32_t kbps;
+  esp_err_t last_err;
+  uint8_t sha256[OTA_SHA256_LEN];
+} ota_stats_t;
+
+// image_size is checked against the slot, 0 when unknown
+esp_err_t ota_begin(size_t image_size);
+esp_err_t ota_write(const void *data, size_t len);
+// expected may be NULL to skip the digest check
+esp_err_t ota_end(const uint8_t expected[OTA_SHA256_LEN]);
+void ota_abort(void);
+bool ota_in_progress(void);
+void ota_get_stats(ota_stats_t *out);
+
+// reboots into the new image after CONFIG_OTA_REBOOT_DELAY_MS, so the caller
+// still gets to answer the request
+void ota_reboot_later(void);
+
+// call early in app_main. when this is the first boot of an update it arms
+// the rollback timer, otherwise it does nothing
+void ota_health_start(void);
+// the app is up and reachable, keep this image
+void ota_mark_healthy(void);
+
+#endif
@@ -0,0 +1,183 @@
+#include "ota.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "mbedtls/sha256.h"
+#include "sdkconfig.h"
+#include <string.h>
+
+static const char *TAG = "OTA";
+
+static esp_ota_handle_t handle = 0;
+static const esp_partition_t *target = NULL;
+static mbedtls_sha256_context sha;
+static int64_t t_begin = 0;
+static uint32_t written = 0;
+static ota_stats_t stats = {0};
+
+static esp_timer_handle_t health_timer = NULL;
+static esp_timer_handle_t reboot_timer = NULL;
+
+static void fail(esp_err_t err) {
+  stats.failures++;
+  stats.last_err = err;
+}
+
+esp_err_t ota_begin(size_t image_size) {
+  if (target != NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  const esp_partition_t *next = esp_ota_get_next_update_partition(NULL);
+  if (next == NULL) {
+    ESP_LOGE(TAG, "ota_begin; no update slot in the partition table ");
+    fail(ESP_ERR_NOT_FOUND);
+    return ESP_ERR_NOT_FOUND;
+  }
+  if (image_size > next->size) {
+    fail(ESP_ERR_INVALID_SIZE);
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  // erase as the write goes instead of the whole slot up front
+  esp_err_t err = esp_ota_begin(next, OTA_WITH_SEQUENTIAL_WRITES, &handle);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "esp_ota_begin; error code: %d ", err);
+    fail(err);
+    return err;
+  }
+
+  target = next;
+  written = 0;
+  t_begin = esp_timer_get_time();
+  mbedtls_sha256_init(&sha);
+  mbedtls_sha256_starts(&sha, 0);
+  ESP_LOGI(TAG, "Writing %u bytes to %s", (unsigned)image_size, next->label);
+  return ESP_OK;
+}
+
+esp_err_t ota_write(const void *data, size_t len) {
+  if (target == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  esp_err_t err = esp_ota_write(handle, data, len);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "esp_ota_write; error code: %d ", err);
+    ota_abort();
+    fail(err);
+    return err;
+  }
+  mbedtls_sha256_update(&sha, data, len);
+  written += len;
+  return ESP_OK;
+}
+
+esp_err_t ota_end(const uint8_t expected[OTA_SHA256_LEN]) {
+  if (target == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  uint8_t digest[OTA_SHA256_LEN];
+  mbedtls_sha256_finish(&sha, digest);
+  mbedtls_sha256_free(&sha);
+  if (expected != NULL && memcmp(digest, expected, sizeof(digest)) != 0) {
+    ESP_LOGE(TAG, "ota_end; sha256 mismatch ");
+    ota_abort();
+    fail(ESP_ERR_INVALID_CRC);
+    return ESP_ERR_INVALID_CRC;
+  }
+
+  // checks the image header, segments and the appended hash
+  esp_err_t err = esp_ota_end(handle);
+  if (err == ESP_OK) {
+    err = esp_ota_set_boot_partition(target);
+  }
+  target = NULL;
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "esp_ota_end; error code: %d ", err);
+    fail(err);
+    return err;
+  }
+
+  int64_t us = esp_timer_get_time() - t_begin;
+  stats.updates++;
+  stats.last_err = ESP_OK;
+  stats.bytes = written;
+  stats.ms = (uint32_t)(us / 1000);
+  stats.kbps = us > 0 ? (uint32_t)(written * 8000LL / us) : 0;
+  memcpy(stats.sha256, digest, sizeof(digest));
+  ESP_LOGI(TAG, "Update of %u bytes done in %u ms, %u kbit/s",
+    (unsigned)stats.bytes, (unsigned)stats.ms, (unsigned)stats.kbps);
+  return ESP_OK;
+}
+
+void ota_abort(void) {
+  if (target == NULL) {
+    return;
+  }
+  esp_ota_abort(handle);
+  mbedtls_sha256_free(&sha);
+  target = NULL;
+}
+
+bool ota_in_progress(void) { return target != NULL; }
+
+void ota_get_stats(ota_stats_t *out) { *out = stats; }
+
+static void reboot_cb(void *arg) { esp_restart(); }
+
+void ota_reboot_later(void) {
+  if (reboot_timer == NULL) {
+    esp_timer_create_args_t args = {
+      .callback = reboot_cb,
+      .name = "ota_reboot",
+    };
+    if (esp_timer_create(&args, &reboot_timer) != ESP_OK) {
+      esp_restart();
+    }
+  }
+  esp_timer_start_once(reboot_timer, CONFIG_OTA_REBOOT_DELAY_MS * 1000LL);
+}
+
+static void health_timeout_cb(void *arg) {
+  ESP_LOGE(TAG, "New image not healthy after %d ms, rolling back",
+    CONFIG_OTA_HEALTH_TIMEOUT_MS);
+  esp_ota_mark_app_invalid_rollback_and_reboot();
+}
+
+void ota_health_start(void) {
+  esp_ota_img_states_t state;
+  const esp_partition_t *running = esp_ota_get_running_partition();
+  if (esp_ota_get_state_partition(running, &state) != ESP_OK ||
+      state != ESP_OTA_IMG_PENDING_VERIFY) {
+    return;
+  }
+
+  ESP_LOGI(TAG, "First boot of %s, waiting for the health check",
+    running->label);
+  esp_timer_create_args_t args = {
+    .callback = health_timeout_cb,
+    .name = "ota_health",
+  };
+  if (esp_timer_create(&args, &health_timer) != ESP_OK) {
+    return;
+  }
+  esp_timer_start_once(health_timer, CONFIG_OTA_HEALTH_TIMEOUT_MS * 1000LL);
+}
+
+void ota_mark_healthy(void) {
+  if (health_timer == NULL) {
+    return;
+  }
+  esp_timer_stop(health_timer);
+  esp_timer_delete(health_timer);
+  health_timer = NULL;
+  esp_err_t err = esp_ota_mark_app_valid_cancel_rollback();
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "esp_ota_mark_app_valid_cancel_rollback; error code: %d ",
+      err);
+    return;
+  }
+  ESP_LOGI(TAG, "New image marked valid");
+}
@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+"""Stream a firmware image to POST /api/ota and measure the upload rate.
+
+    idf.py build
+    export OTA_TOKEN=...                                   # CONFIG_OTA_TOKEN
+    python ota_upload.py <ip> build/rgb_led.bin
+    python ota_upload.py <ip> build/rgb_led.bin --no-sha   # skip digest check
+    python ota_upload.py <ip> build/rgb_led.bin --wait     # poll until it is back
+
+The image is sent in chunks with its SHA-256 in X-Image-SHA256 and the
+token in an Authorization header, from --token or $OTA_TOKEN. The device
+writes each chunk to flash as it arrives and answers with its own timing once
+the image checks out, then reboots into it.
+"""
+import argparse
+import hashlib
+import http.client
+import json
+import os
+import sys
+import time
+
+CHUNK = 4096
+
+
+def upload(host, path, token, send_sha, timeout):
+    size = os.path.getsize(path)
+    with open(path, "rb") as f:
+        digest = hashlib.sha256(f.read()).hexdigest()
+
+    conn = http.client.HTTPConnection(host, timeout=timeout)
+    conn.putrequest("POST", "/api/ota")
+    conn.putheader("Content-Type", "application/octet-stream")
+    conn.putheader("Content-Length", str(size))
+    conn.putheader("Authorization", f"Bearer {token}")
+    if send_sha:
+        conn.putheader("X-Image-SHA256", digest)
+    conn.endheaders()
+
+    start = time.monotonic()
+    sent = 0
+    with open(path, "rb") as f:
+        while True:
+            chunk = f.read(CHUNK)
+            if not chunk:
+                break
+            conn.send(chunk)
+            sent += len(chunk)
+            print(f"\r{sent * 100 // size:3d}% {sent}/{size}", end="",
+                  file=sys.stderr)
+    resp = conn.getresponse()
+    body = resp.read().decode(errors="replace")
+    elapsed = time.monotonic() - start
+    print(file=sys.stderr)
+    conn.close()
+
+    print(f"sha256 {digest}")
+    print(f"client: {size} bytes in {elapsed * 1000:.0f} ms, "
+          f"{size * 8 / elapsed / 1000:.0f} kbit/s")
+    if resp.status != 200:
+        print(f"device: {resp.status} {body}")
+        return False
+    device = json.loads(body)
+    print(f"device: {device['bytes']} bytes in {device['ms']} ms, "
+          f"{device['kbps']} kbit/s")
+    return True
+
+
+def wait_back(host, timeout):
+    deadline = time.monotonic() + timeout
+    time.sleep(2)
+    while time.monotonic() < deadline:
+        try:
+            conn = http.client.HTTPConnection(host, timeout=2)
+            conn.request("GET", "/api/stats")
+            if conn.getresponse().status == 200:
+                print("device is back up on the new image")
+                return True
+        except OSError:
+            pass
+        time.sleep(1)
+    print("device did not come back, it rolls back on its own if the image "
+          "is not healthy")
+    return False
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("host", help="device address, host[:port]")
+    ap.add_argument("image", help="app image, build/<app>.bin")
+    ap.add_argument("--token", default=os.environ.get("OTA_TOKEN"),
+                    help="CONFIG_OTA_TOKEN of the device, else $OTA_TOKEN")
+    ap.add_argument("--no-sha", action="store_true")
+    ap.add_argument("--wait", action="store_true",
+                    help="wait for the device to come back after the reboot")
+    ap.add_argument("--timeout", type=float, default=60)
+    args = ap.parse_args()
+    if not args.token:
+        ap.error("no token, pass --token or set OTA_TOKEN")
+
+    if not upload(args.host, args.image, args.token, not args.no_sha,
+                  args.timeout):
+        return 1
+    if args.wait and not wait_back(args.host, args.timeout):
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,35 @@
+#ifndef JITTER_H
+#define JITTER_H
+
+#include <stdint.h>
+
+/*
+  period jitter of a periodic loop: every sample is the distance between the
+  measured and the nominal period. the histogram buckets end at the bounds in
+  JITTER_BOUNDS_US, the last one is open ended.
+
+  hardware independent, timestamps come from the caller.
+*/
+
+#define JITTER_BUCKETS 6
+#define JITTER_BOUNDS_US {10, 50, 100, 500, 1000}
+
+typedef struct {
+  uint32_t period_us;
+  int64_t last_us; // 0: next sample only sets the reference
+  uint32_t samples;
+  uint32_t max_us;
+  uint64_t sum_us;
+  uint32_t hist[JITTER_BUCKETS];
+} jitter_t;
+
+void jitter_init(jitter_t *j, uint32_t period_us);
+// forget the last timestamp, e.g. after the loop idled
+void jitter_restart(jitter_t *j);
+void jitter_sample(jitter_t *j, int64_t now_us);
+uint32_t jitter_avg_us(const jitter_t *j);
+// upper bound of the bucket holding the pct percentile, UINT32_MAX if it is
+// the open ended one
+uint32_t jitter_percentile_us(const jitter_t *j, uint32_t pct);
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+  single slot, latest value wins. one writer posts, one reader takes, neither
+  blocks or locks. the slot is guarded by a sequence counter that is odd while
+  a post is in progress, a reader that sees it change during its copy retries.
+  a post that lands before the reader took the previous one replaces it.
+
+  hardware independent, builds on the host too.
+*/
+
+typedef struct {
+  uint8_t *buf;
+  uint32_t size;
+  uint32_t seq; // even: stable, odd: post in progress
+  uint32_t overwritten; // posts replaced before they were taken
+} mailbox_t;
+
+#define MAILBOX_DEFINE(name, type)                                            \
+  static uint8_t name##_buf[sizeof(type)];                                    \
+  static mailbox_t name = {.buf = name##_buf, .size = sizeof(type)}
+
+void mailbox_post(mailbox_t *mb, const void *msg);
+// copies the newest message when it is newer than *seen and updates *seen.
+// returns false when there is nothing new or a post kept racing the copy
+bool mailbox_take(mailbox_t *mb, void *out, uint32_t *seen);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef SPSC_H
+#define SPSC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+  lock free single producer / single consumer ring of fixed size elements.
+  exactly one task (or ISR) may push and exactly one may pop. head is only
+  written by the producer and tail only by the consumer, the acquire/release
+  pair on them orders the element copy. capacity must be a power of two,
+  one slot is never used so a full ring holds capacity - 1 elements.
+
+  hardware independent, builds on the host too.
+*/
+
+typedef struct {
+  uint8_t *buf;
+  uint32_t elem_size;
+  uint32_t mask;
+  uint32_t head; // next write, producer owned
+  uint32_t tail; // next read, consumer owned
+  uint32_t dropped; // pushes refused because the ring was full
+} spsc_t;
+
+#define SPSC_DEFINE(name, type, capacity)                                     \
+  _Static_assert(((capacity) & ((capacity) - 1)) == 0,                        \
+    #name " capacity must be a power of two");                                \
+  static uint8_t name##_buf[(capacity) * sizeof(type)];                       \
+  static spsc_t name = {                                                      \
+    .buf = name##_buf,                                                        \
+    .elem_size = sizeof(type),                                                \
+    .mask = (capacity) - 1,                                                   \
+  }
+
+bool spsc_push(spsc_t *q, const void *elem);
+bool spsc_pop(spsc_t *q, void *elem);
+uint32_t spsc_count(const spsc_t *q);
+
+#endif
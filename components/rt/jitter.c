@@ -0,0 +1,50 @@
+#include "jitter.h"
+#include <string.h>
+
+static const uint32_t bounds[JITTER_BUCKETS - 1] = JITTER_BOUNDS_US;
+
+void jitter_init(jitter_t *j, uint32_t period_us) {
+  memset(j, 0, sizeof(*j));
+  j->period_us = period_us;
+}
+
+void jitter_restart(jitter_t *j) { j->last_us = 0; }
+
+void jitter_sample(jitter_t *j, int64_t now_us) {
+  if (j->last_us == 0) {
+    j->last_us = now_us;
+    return;
+  }
+  int64_t dt = now_us - j->last_us;
+  j->last_us = now_us;
+
+  int64_t off = dt - (int64_t)j->period_us;
+  uint32_t dev = (uint32_t)(off < 0 ? -off : off);
+
+  j->samples++;
+  j->sum_us += dev;
+  if (dev > j->max_us) {
+    j->max_us = dev;
+  }
+  int b = 0;
+  while (b < JITTER_BUCKETS - 1 && dev >= bounds[b]) {
+    b++;
+  }
+  j->hist[b]++;
+}
+
+uint32_t jitter_avg_us(const jitter_t *j) {
+  return j->samples ? (uint32_t)(j->sum_us / j->samples) : 0;
+}
+
+uint32_t jitter_percentile_us(const jitter_t *j, uint32_t pct) {
+  uint64_t want = ((uint64_t)j->samples * pct + 99) / 100;
+  uint64_t seen = 0;
+  for (int b = 0; b < JITTER_BUCKETS - 1; b++) {
+    seen += j->hist[b];
+    if (seen >= want) {
+      return bounds[b];
+    }
+  }
+  return UINT32_MAX;
+}
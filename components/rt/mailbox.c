@@ -0,0 +1,38 @@
+#include "mailbox.h"
+#include <string.h>
+
+// bounded so a reader that preempted the writer on the same core gives up
+#define MAILBOX_TAKE_TRIES 4
+
+void mailbox_post(mailbox_t *mb, const void *msg) {
+  uint32_t seq = __atomic_load_n(&mb->seq, __ATOMIC_RELAXED);
+  __atomic_store_n(&mb->seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(mb->buf, msg, mb->size);
+  __atomic_store_n(&mb->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+bool mailbox_take(mailbox_t *mb, void *out, uint32_t *seen) {
+  for (int i = 0; i < MAILBOX_TAKE_TRIES; i++) {
+    uint32_t before = __atomic_load_n(&mb->seq, __ATOMIC_ACQUIRE);
+    if (before == *seen) {
+      return false;
+    }
+    if (before & 1) {
+      continue;
+    }
+    memcpy(out, mb->buf, mb->size);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&mb->seq, __ATOMIC_RELAXED) != before) {
+      continue;
+    }
+    // every post moves seq by 2
+    uint32_t posts = (before - *seen) / 2;
+    if (posts > 1) {
+      mb->overwritten += posts - 1;
+    }
+    *seen = before;
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,31 @@
+#include "spsc.h"
+#include <string.h>
+
+bool spsc_push(spsc_t *q, const void *elem) {
+  uint32_t head = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+  uint32_t tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+  if (((head + 1) & q->mask) == (tail & q->mask)) {
+    q->dropped++;
+    return false;
+  }
+  memcpy(q->buf + (head & q->mask) * q->elem_size, elem, q->elem_size);
+  __atomic_store_n(&q->head, (head + 1) & q->mask, __ATOMIC_RELEASE);
+  return true;
+}
+
+bool spsc_pop(spsc_t *q, void *elem) {
+  uint32_t tail = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+  uint32_t head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+  if (tail == head) {
+    return false;
+  }
+  memcpy(elem, q->buf + tail * q->elem_size, q->elem_size);
+  __atomic_store_n(&q->tail, (tail + 1) & q->mask, __ATOMIC_RELEASE);
+  return true;
+}
+
+uint32_t spsc_count(const spsc_t *q) {
+  uint32_t head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+  uint32_t tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+  return (head - tail) & q->mask;
+}
@@ -0,0 +1,80 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  A settings blob is one plain C struct stored as a single NVS blob:
+
+    | version u16 | size u16 | crc32 u32 | struct bytes ... |
+
+  Reads are served from a RAM cache filled by settings_load(). Changes are
+  made on the cache between settings_edit() and settings_commit(); commit
+  compares the cache against the last persisted image and only writes (one
+  nvs_set_blob + nvs_commit) when something actually changed.
+*/
+
+// called when the stored version differs from the current one. old points at
+// the stored struct bytes, out already holds the defaults. return ESP_OK to
+// keep the migrated values, anything else falls back to the defaults.
+typedef esp_err_t (*settings_migrate_fn)(
+  uint16_t old_version, const void *old, size_t old_size, void *out);
+
+typedef struct {
+  const char *ns;  // NVS namespace, max 15 chars
+  const char *key; // NVS key, max 15 chars
+  uint16_t version;
+  uint16_t size;
+  const void *defaults;
+  settings_migrate_fn migrate; // optional
+  void *cache;
+  void *persisted;
+  bool stored; // persisted holds what is on flash
+  uint32_t writes;
+  uint32_t skipped_writes;
+} settings_blob_t;
+
+#define SETTINGS_BLOB_DEFINE(name, type, ns_, key_, version_, defaults_)      \
+  static type name##_cache;                                                  \
+  static type name##_persisted;                                              \
+  static settings_blob_t name = {                                            \
+    .ns = (ns_),                                                             \
+    .key = (key_),                                                           \
+    .version = (version_),                                                   \
+    .size = sizeof(type),                                                    \
+    .defaults = (defaults_),                                                 \
+    .cache = &name##_cache,                                                  \
+    .persisted = &name##_persisted,                                          \
+  }
+
+// nvs_flash_init with the erase and retry on a full or outdated partition.
+// also creates the settings lock, call it once before any other function
+esp_err_t settings_nvs_init(void);
+
+// fills the RAM cache from flash, or from the defaults / migrate callback
+esp_err_t settings_load(settings_blob_t *blob);
+
+// RAM cache, valid after settings_load(). do not modify, use settings_edit().
+// unlocked, a task that can race with an edit uses settings_read()
+const void *settings_get(const settings_blob_t *blob);
+
+// copies the cache out while holding the settings lock
+void settings_read(const settings_blob_t *blob, void *out);
+
+// locks the settings and returns the cache for changes. every edit must be
+// closed by settings_commit() or settings_revert()
+void *settings_edit(settings_blob_t *blob);
+
+// writes the change set if it differs from flash and unlocks
+esp_err_t settings_commit(settings_blob_t *blob);
+
+// drops the change set and unlocks
+void settings_revert(settings_blob_t *blob);
+
+// back to the defaults on flash and in RAM
+esp_err_t settings_reset(settings_blob_t *blob);
+
+#endif
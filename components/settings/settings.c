@@ -0,0 +1,206 @@
+#include "settings.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "SETTINGS";
+
+typedef struct {
+  uint16_t version;
+  uint16_t size;
+  uint32_t crc;
+} settings_hdr_t;
+
+static SemaphoreHandle_t lock = NULL;
+static StaticSemaphore_t lock_buf;
+
+static void settings_lock(void) {
+  xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+}
+
+static void settings_unlock(void) { xSemaphoreGiveRecursive(lock); }
+
+esp_err_t settings_nvs_init(void) {
+  // boot steps that load settings depend on this one
+  lock = xSemaphoreCreateRecursiveMutexStatic(&lock_buf);
+
+  esp_err_t esp_err = nvs_flash_init();
+  if (esp_err == ESP_ERR_NVS_NO_FREE_PAGES ||
+      esp_err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+    esp_err = nvs_flash_erase();
+    if (esp_err != ESP_OK) {
+      ESP_LOGE(TAG, "nvs_flash_erase; error code: %d ", esp_err);
+      return esp_err;
+    }
+    esp_err = nvs_flash_init();
+  }
+  if (esp_err != ESP_OK) {
+    ESP_LOGE(TAG, "nvs_flash_init; error code: %d ", esp_err);
+  }
+  return esp_err;
+}
+
+static void use_defaults(settings_blob_t *blob) {
+  if (blob->defaults) {
+    memcpy(blob->cache, blob->defaults, blob->size);
+  } else {
+    memset(blob->cache, 0, blob->size);
+  }
+}
+
+esp_err_t settings_load(settings_blob_t *blob) {
+  settings_lock();
+
+  use_defaults(blob);
+  blob->stored = false;
+
+  nvs_handle_t handle;
+  esp_err_t esp_err = nvs_open(blob->ns, NVS_READONLY, &handle);
+  if (esp_err == ESP_ERR_NVS_NOT_FOUND) {
+    // namespace is created on first commit
+    settings_unlock();
+    return ESP_OK;
+  }
+  if (esp_err != ESP_OK) {
+    ESP_LOGE(TAG, "%s: nvs_open; error code: %d ", blob->ns, esp_err);
+    settings_unlock();
+    return esp_err;
+  }
+
+  size_t len = 0;
+  esp_err = nvs_get_blob(handle, blob->key, NULL, &len);
+  if (esp_err != ESP_OK || len < sizeof(settings_hdr_t)) {
+    nvs_close(handle);
+    settings_unlock();
+    return esp_err == ESP_ERR_NVS_NOT_FOUND ? ESP_OK : esp_err;
+  }
+
+  uint8_t *raw = malloc(len);
+  if (raw == NULL) {
+    nvs_close(handle);
+    settings_unlock();
+    return ESP_ERR_NO_MEM;
+  }
+  esp_err = nvs_get_blob(handle, blob->key, raw, &len);
+  nvs_close(handle);
+  if (esp_err != ESP_OK) {
+    free(raw);
+    settings_unlock();
+    return esp_err;
+  }
+
+  settings_hdr_t hdr;
+  memcpy(&hdr, raw, sizeof(hdr));
+  const uint8_t *payload = raw + sizeof(hdr);
+  size_t payload_len = len - sizeof(hdr);
+
+  if (hdr.size != payload_len ||
+      hdr.crc != esp_rom_crc32_le(0, payload, payload_len)) {
+    ESP_LOGE(TAG, "%s/%s corrupt, using defaults", blob->ns, blob->key);
+  } else if (hdr.version == blob->version && hdr.size == blob->size) {
+    memcpy(blob->cache, payload, blob->size);
+    memcpy(blob->persisted, payload, blob->size);
+    blob->stored = true;
+  } else if (blob->migrate &&
+             blob->migrate(hdr.version, payload, payload_len, blob->cache) ==
+               ESP_OK) {
+    ESP_LOGI(TAG,
+      "%s/%s migrated v%d -> v%d",
+      blob->ns,
+      blob->key,
+      hdr.version,
+      blob->version);
+  } else {
+    ESP_LOGI(TAG, "%s/%s v%d dropped", blob->ns, blob->key, hdr.version);
+    use_defaults(blob);
+  }
+
+  free(raw);
+  settings_unlock();
+  return ESP_OK;
+}
+
+const void *settings_get(const settings_blob_t *blob) { return blob->cache; }
+
+void settings_read(const settings_blob_t *blob, void *out) {
+  settings_lock();
+  memcpy(out, blob->cache, blob->size);
+  settings_unlock();
+}
+
+void *settings_edit(settings_blob_t *blob) {
+  settings_lock();
+  return blob->cache;
+}
+
+static esp_err_t write_blob(settings_blob_t *blob) {
+  size_t len = sizeof(settings_hdr_t) + blob->size;
+  uint8_t *raw = malloc(len);
+  if (raw == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  settings_hdr_t hdr = {
+    .version = blob->version,
+    .size = blob->size,
+    .crc = esp_rom_crc32_le(0, blob->cache, blob->size),
+  };
+  memcpy(raw, &hdr, sizeof(hdr));
+  memcpy(raw + sizeof(hdr), blob->cache, blob->size);
+
+  nvs_handle_t handle;
+  esp_err_t esp_err = nvs_open(blob->ns, NVS_READWRITE, &handle);
+  if (esp_err == ESP_OK) {
+    esp_err = nvs_set_blob(handle, blob->key, raw, len);
+    if (esp_err == ESP_OK) {
+      esp_err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+  }
+  free(raw);
+  return esp_err;
+}
+
+esp_err_t settings_commit(settings_blob_t *blob) {
+  esp_err_t esp_err = ESP_OK;
+
+  if (blob->stored && memcmp(blob->cache, blob->persisted, blob->size) == 0) {
+    blob->skipped_writes++;
+  } else {
+    esp_err = write_blob(blob);
+    if (esp_err == ESP_OK) {
+      memcpy(blob->persisted, blob->cache, blob->size);
+      blob->stored = true;
+      blob->writes++;
+    } else {
+      ESP_LOGE(TAG,
+        "%s/%s: commit; error code: %d ",
+        blob->ns,
+        blob->key,
+        esp_err);
+    }
+  }
+
+  settings_unlock();
+  return esp_err;
+}
+
+void settings_revert(settings_blob_t *blob) {
+  if (blob->stored) {
+    memcpy(blob->cache, blob->persisted, blob->size);
+  } else {
+    use_defaults(blob);
+  }
+  settings_unlock();
+}
+
+esp_err_t settings_reset(settings_blob_t *blob) {
+  settings_edit(blob);
+  use_defaults(blob);
+  return settings_commit(blob);
+}
@@ -0,0 +1,69 @@
+#ifndef TASK_TABLE_H
+#define TASK_TABLE_H
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+#include <stddef.h>
+
+/*
+  one table per app listing every task with its stack, priority and core.
+  TASK_STATIC entries use the stack and TCB declared with TASK_STORAGE and
+  are created by task_table_start(). TASK_EXTERNAL entries are tasks IDF or
+  a component creates itself (NimBLE host, httpd, esp_timer), they are
+  listed so the priority plan is in one place and the monitor can watch
+  their stacks.
+
+  with CONFIG_TASK_PARTITION_CORES core 0 runs the radio stacks and
+  services, timing sensitive work goes on core 1.
+*/
+
+#if CONFIG_TASK_PARTITION_CORES
+#define TASK_CORE_RADIO 0 // PRO_CPU
+#define TASK_CORE_RT 1    // APP_CPU
+#define TASK_PARTITION_NAME "partitioned"
+#else
+#define TASK_CORE_RADIO tskNO_AFFINITY
+#define TASK_CORE_RT tskNO_AFFINITY
+#define TASK_PARTITION_NAME "shared"
+#endif
+
+typedef struct {
+  const char *name;
+  TaskFunction_t fn; // NULL for external tasks
+  uint32_t stack_size; // bytes
+  UBaseType_t priority;
+  BaseType_t core; // 0, 1 or tskNO_AFFINITY
+  StackType_t *stack;
+  StaticTask_t *tcb;
+  TaskHandle_t handle;
+} task_def_t;
+
+#define TASK_STORAGE(id, stack_bytes)                                         \
+  static StackType_t id##_stack[(stack_bytes) / sizeof(StackType_t)];         \
+  static StaticTask_t id##_tcb
+
+#define TASK_STATIC(id, name_, fn_, prio_, core_)                             \
+  {                                                                           \
+    .name = (name_), .fn = (fn_), .stack_size = sizeof(id##_stack),           \
+    .priority = (prio_), .core = (core_), .stack = id##_stack,                \
+    .tcb = &id##_tcb,                                                         \
+  }
+
+#define TASK_EXTERNAL(name_, stack_, prio_, core_)                            \
+  {                                                                           \
+    .name = (name_), .stack_size = (stack_), .priority = (prio_),             \
+    .core = (core_),                                                          \
+  }
+
+// creates every TASK_STATIC entry, the table must outlive the tasks
+esp_err_t task_table_start(task_def_t *table, size_t count);
+// entry by task name from the table passed to task_table_start()
+const task_def_t *task_table_find(const char *name);
+// logs stack high water marks for every entry plus heap fragmentation
+void task_table_report(void);
+// reports every CONFIG_TASK_MONITOR_PERIOD_MS, list it in the table
+void task_monitor_task(void *arg);
+
+#endif
@@ -0,0 +1,93 @@
+#include "task_table.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include <inttypes.h>
+#include <string.h>
+
+static const char *TAG = "TASKS";
+
+static task_def_t *tasks = NULL;
+static size_t task_count = 0;
+
+esp_err_t task_table_start(task_def_t *table, size_t count) {
+  tasks = table;
+  task_count = count;
+
+  for (size_t i = 0; i < count; i++) {
+    task_def_t *t = &table[i];
+    if (t->fn == NULL || t->handle != NULL) {
+      continue;
+    }
+    t->handle = xTaskCreateStaticPinnedToCore(t->fn,
+      t->name,
+      t->stack_size / sizeof(StackType_t),
+      NULL,
+      t->priority,
+      t->stack,
+      t->tcb,
+      t->core);
+    if (t->handle == NULL) {
+      ESP_LOGE(TAG, "task_table_start; failed to create %s", t->name);
+      return ESP_FAIL;
+    }
+  }
+  return ESP_OK;
+}
+
+const task_def_t *task_table_find(const char *name) {
+  for (size_t i = 0; i < task_count; i++) {
+    if (strcmp(tasks[i].name, name) == 0) {
+      return &tasks[i];
+    }
+  }
+  return NULL;
+}
+
+void task_table_report(void) {
+  for (size_t i = 0; i < task_count; i++) {
+    task_def_t *t = &tasks[i];
+    TaskHandle_t handle = t->handle ? t->handle : xTaskGetHandle(t->name);
+    if (handle == NULL) {
+      continue; // external task not running (yet)
+    }
+    // high water mark is in bytes on ESP-IDF
+    uint32_t free_bytes = uxTaskGetStackHighWaterMark(handle);
+    uint32_t used = t->stack_size > free_bytes ? t->stack_size - free_bytes : 0;
+    if (free_bytes < CONFIG_TASK_STACK_WARN_BYTES) {
+      ESP_LOGW(TAG,
+        "%-12s stack %" PRIu32 "/%" PRIu32 " used, %" PRIu32 " left",
+        t->name,
+        used,
+        t->stack_size,
+        free_bytes);
+    } else {
+      ESP_LOGI(TAG,
+        "%-12s stack %" PRIu32 "/%" PRIu32 " used, prio %u, core %d",
+        t->name,
+        used,
+        t->stack_size,
+        (unsigned)t->priority,
+        t->core == tskNO_AFFINITY ? -1 : (int)t->core);
+    }
+  }
+
+  size_t free_heap = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  size_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  size_t min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+  // share of the free heap not usable in one allocation
+  unsigned frag = free_heap ? 100 - (unsigned)(largest * 100 / free_heap) : 0;
+  ESP_LOGI(TAG,
+    "heap free %u, min %u, largest block %u, fragmentation %u%%",
+    (unsigned)free_heap,
+    (unsigned)min_free,
+    (unsigned)largest,
+    frag);
+}
+
+void task_monitor_task(void *arg) {
+  for (;;) {
+    vTaskDelay(pdMS_TO_TICKS(CONFIG_TASK_MONITOR_PERIOD_MS));
+    task_table_report();
+  }
+}
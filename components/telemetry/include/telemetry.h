@@ -0,0 +1,53 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "esp_err.h"
+#include "telemetry_batch.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+  batched telemetry over MQTT, QoS 1. telemetry_add() appends a record to the
+  current batch, the telemetry task publishes it every
+  CONFIG_TELEMETRY_PUBLISH_MS (or when it fills up) to
+  <prefix>/<node>/batch, see telemetry_batch.h for the payload.
+
+  while the broker can't be reached batches go to a bounded queue in their
+  own NVS partition, oldest dropped first. after a reconnect the queue is
+  published in bulk, a batch leaves flash once its PUBACK arrived. newer
+  batches queue up behind it so the order is kept.
+*/
+
+typedef struct {
+  // client id and topic level, NULL for "esp32-" plus the last 3 MAC bytes
+  const char *node;
+  // called by the telemetry task before each batch is closed, to add
+  // periodic records
+  void (*on_publish)(void);
+} telemetry_cfg_t;
+
+typedef struct {
+  bool connected;
+  uint32_t records;
+  uint32_t dropped_records; // both batch buffers were full
+  uint32_t batches;
+  uint32_t published; // straight to the broker
+  uint32_t queued;    // went to flash
+  uint32_t drained;   // left flash with a PUBACK
+  uint32_t dropped_batches; // queue full or flash error
+  uint32_t queue_depth;
+  uint32_t bytes;
+  uint32_t connects;
+  // last time the queue was emptied after a reconnect
+  uint32_t last_drain_batches;
+  uint32_t last_drain_ms;
+} telemetry_stats_t;
+
+esp_err_t telemetry_init(const telemetry_cfg_t *cfg);
+// any task, never blocks. false when the record was dropped
+bool telemetry_add(uint8_t type, const void *data, uint8_t len);
+// listed in the app task table
+void telemetry_task(void *param);
+void telemetry_get_stats(telemetry_stats_t *out);
+
+#endif
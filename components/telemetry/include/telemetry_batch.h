@@ -0,0 +1,77 @@
+#ifndef TELEMETRY_BATCH_H
+#define TELEMETRY_BATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  one MQTT payload holding many records, hardware independent so the host
+  tools can link it too. little endian:
+
+    | magic u8 'T' | version u8 | boot u16 | seq u32 | unix_s u32 |
+    | uptime_ms u32 | count u16 | records ... |
+
+    record: | dt_ms varint | type u8 | len u8 | data[len] |
+
+  dt_ms is the time since the previous record (the header for the first).
+  boot is random per boot and seq counts batches within it, a receiver drops
+  repeats of (node, boot, seq) since QoS 1 can deliver twice. unix_s is 0
+  while the clock is not set. record types and layouts belong to the app.
+*/
+
+#define TELEMETRY_BATCH_MAGIC 'T'
+#define TELEMETRY_BATCH_VERSION 1
+#define TELEMETRY_BATCH_HDR 18
+#define TELEMETRY_RECORD_MAX 32
+// worst case size of one record
+#define TELEMETRY_RECORD_SIZE(len) (5 + 2 + (len))
+
+typedef struct {
+  uint16_t boot;
+  uint32_t seq;
+  uint32_t unix_s;
+  uint32_t uptime_ms;
+  uint16_t count;
+} telemetry_hdr_t;
+
+typedef struct {
+  uint8_t *buf;
+  size_t cap;
+  size_t len;
+  uint16_t count;
+  uint32_t last_ms;
+} telemetry_batch_t;
+
+typedef struct {
+  uint32_t uptime_ms;
+  uint8_t type;
+  uint8_t len;
+  const uint8_t *data;
+} telemetry_record_t;
+
+void telemetry_batch_start(telemetry_batch_t *b,
+  uint8_t *buf,
+  size_t cap,
+  const telemetry_hdr_t *hdr);
+// false when the record does not fit, the batch is unchanged then
+bool telemetry_batch_add(telemetry_batch_t *b,
+  uint32_t uptime_ms,
+  uint8_t type,
+  const void *data,
+  uint8_t len);
+// writes the record count, returns the payload length
+size_t telemetry_batch_finish(telemetry_batch_t *b);
+
+// returns 0 and the header when buf holds a batch of a known version
+int telemetry_batch_parse(const uint8_t *buf,
+  size_t len,
+  telemetry_hdr_t *out);
+// record at *off, which is advanced. start at TELEMETRY_BATCH_HDR with
+// rec->uptime_ms set to the header's. returns 0, -1 at the end or on garbage
+int telemetry_batch_next(const uint8_t *buf,
+  size_t len,
+  size_t *off,
+  telemetry_record_t *rec);
+
+#endif
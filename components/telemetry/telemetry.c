@@ -0,0 +1,477 @@
+#include "telemetry.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "mqtt_client.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "task_table.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define BATCH_BYTES CONFIG_TELEMETRY_BATCH_BYTES
+#define QUEUE_LEN CONFIG_TELEMETRY_QUEUE_BATCHES
+#define WINDOW CONFIG_TELEMETRY_DRAIN_WINDOW
+#define NVS_NAMESPACE "tlm_queue"
+#define RECONNECT_MS 2000
+#define KEEPALIVE_S 30
+// a wall clock before this was never set
+#define CLOCK_SET_S 1600000000
+
+static const char *TAG = "TELEMETRY";
+
+static telemetry_cfg_t cfg;
+static bool ready = false;
+static TaskHandle_t task = NULL;
+
+// records go into bufs[cur]. a full batch waits in the other buffer until
+// the task shipped it, records that fit neither are dropped
+static uint8_t bufs[2][BATCH_BYTES];
+static telemetry_batch_t batch;
+static int cur = 0;
+static bool sealed = false;
+static size_t sealed_len = 0;
+static uint16_t boot_id;
+static uint32_t next_seq = 0;
+// batch state and stats
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+static telemetry_stats_t stats;
+
+static esp_mqtt_client_handle_t client = NULL;
+static char node[24];
+static char topic[96];
+static volatile bool connected = false;
+// bumped on every connect, the task restarts the drain when it changes
+static volatile uint32_t conn_epoch = 0;
+// PUBACK message ids from the mqtt task, matched by the telemetry task
+static QueueHandle_t acks;
+static StaticQueue_t acks_buf;
+static uint8_t acks_storage[WINDOW * 2 * sizeof(int)];
+
+// offline queue, owned by the telemetry task. batch i sits under key
+// "b<i % QUEUE_LEN>", [tail, head) are stored, [tail, sent) are in flight
+static nvs_handle_t nvs = 0;
+static uint32_t q_head = 0;
+static uint32_t q_tail = 0;
+static uint32_t q_sent = 0;
+static uint8_t drain_buf[BATCH_BYTES];
+
+typedef struct {
+  int msg_id;
+  uint32_t idx;
+  bool acked;
+} inflight_t;
+
+// oldest first
+static inflight_t inflight[WINDOW];
+static uint32_t n_inflight = 0;
+
+static bool draining = false;
+static int64_t drain_start_us = 0;
+static uint32_t drain_start_count = 0;
+
+static uint32_t uptime_ms(void) {
+  return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static uint32_t unix_s(void) {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec >= CLOCK_SET_S ? (uint32_t)tv.tv_sec : 0;
+}
+
+// lock held
+static void seal(uint32_t now_ms, uint32_t now_s) {
+  sealed_len = telemetry_batch_finish(&batch);
+  sealed = true;
+  cur ^= 1;
+  telemetry_hdr_t hdr = {
+    .boot = boot_id,
+    .seq = next_seq++,
+    .unix_s = now_s,
+    .uptime_ms = now_ms,
+  };
+  telemetry_batch_start(&batch, bufs[cur], BATCH_BYTES, &hdr);
+}
+
+bool telemetry_add(uint8_t type, const void *data, uint8_t len) {
+  if (!ready || len > TELEMETRY_RECORD_MAX) {
+    return false;
+  }
+  // the clock calls take locks of their own, not inside the critical section
+  uint32_t now_ms = uptime_ms();
+  uint32_t now_s = unix_s();
+  bool notify = false;
+
+  portENTER_CRITICAL(&lock);
+  bool ok = telemetry_batch_add(&batch, now_ms, type, data, len);
+  if (!ok && !sealed) {
+    seal(now_ms, now_s);
+    ok = telemetry_batch_add(&batch, now_ms, type, data, len);
+    notify = true;
+  }
+  if (ok) {
+    stats.records++;
+  } else {
+    stats.dropped_records++;
+  }
+  portEXIT_CRITICAL(&lock);
+
+  if (notify && task != NULL) {
+    xTaskNotifyGive(task);
+  }
+  return ok;
+}
+
+// the waiting full batch, or with close set the current one if it has
+// records. stays valid until release_sealed()
+static const uint8_t *take_sealed(bool close, size_t *len) {
+  uint32_t now_ms = uptime_ms();
+  uint32_t now_s = unix_s();
+  const uint8_t *buf = NULL;
+
+  portENTER_CRITICAL(&lock);
+  if (!sealed && close && batch.count > 0) {
+    seal(now_ms, now_s);
+  }
+  if (sealed) {
+    buf = bufs[cur ^ 1];
+    *len = sealed_len;
+  }
+  portEXIT_CRITICAL(&lock);
+  return buf;
+}
+
+static void release_sealed(void) {
+  portENTER_CRITICAL(&lock);
+  sealed = false;
+  portEXIT_CRITICAL(&lock);
+}
+
+static void count(uint32_t *stat, uint32_t n) {
+  portENTER_CRITICAL(&lock);
+  *stat += n;
+  stats.queue_depth = q_head - q_tail;
+  portEXIT_CRITICAL(&lock);
+}
+
+static void queue_key(char *out, size_t len, uint32_t idx) {
+  snprintf(out, len, "b%u", (unsigned)(idx % QUEUE_LEN));
+}
+
+static void queue_save(void) {
+  nvs_set_u32(nvs, "head", q_head);
+  nvs_set_u32(nvs, "tail", q_tail);
+  esp_err_t err = nvs_commit(nvs);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "nvs_commit; error code: %d ", err);
+  }
+}
+
+// lock not needed, only the task moves the queue
+static void queue_drop_oldest(void) {
+  char key[16];
+  queue_key(key, sizeof(key), q_tail);
+  nvs_erase_key(nvs, key);
+  q_tail++;
+  // an in flight copy of it is forgotten by retire()
+  if ((int32_t)(q_sent - q_tail) < 0) {
+    q_sent = q_tail;
+  }
+  count(&stats.dropped_batches, 1);
+}
+
+static void queue_push(const uint8_t *buf, size_t len) {
+  if (nvs == 0) {
+    count(&stats.dropped_batches, 1);
+    return;
+  }
+  if (q_head - q_tail >= QUEUE_LEN) {
+    queue_drop_oldest();
+  }
+
+  char key[16];
+  queue_key(key, sizeof(key), q_head);
+  esp_err_t err = nvs_set_blob(nvs, key, buf, len);
+  if (err == ESP_ERR_NVS_NOT_ENOUGH_SPACE && q_head != q_tail) {
+    // the partition is smaller than the configured queue
+    queue_drop_oldest();
+    err = nvs_set_blob(nvs, key, buf, len);
+  }
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "nvs_set_blob; error code: %d ", err);
+    count(&stats.dropped_batches, 1);
+    return;
+  }
+  q_head++;
+  queue_save();
+  count(&stats.queued, 1);
+}
+
+static void ship(const uint8_t *buf, size_t len) {
+  portENTER_CRITICAL(&lock);
+  stats.batches++;
+  stats.bytes += len;
+  portEXIT_CRITICAL(&lock);
+
+  // behind a non-empty queue it waits its turn, the order is kept
+  if (connected && q_head == q_tail) {
+    int msg_id = esp_mqtt_client_publish(
+      client, topic, (const char *)buf, (int)len, 1, 0);
+    if (msg_id >= 0) {
+      count(&stats.published, 1);
+      return;
+    }
+  }
+  queue_push(buf, len);
+}
+
+static void drain(void) {
+  while (q_sent != q_head && n_inflight < WINDOW) {
+    char key[16];
+    queue_key(key, sizeof(key), q_sent);
+    size_t len = sizeof(drain_buf);
+    esp_err_t err = nvs_get_blob(nvs, key, drain_buf, &len);
+    if (err != ESP_OK) {
+      // unreadable, let retire() step over it
+      ESP_LOGE(TAG, "nvs_get_blob; error code: %d ", err);
+      inflight[n_inflight++] = (inflight_t){-1, q_sent++, true};
+      continue;
+    }
+    int msg_id = esp_mqtt_client_publish(
+      client, topic, (const char *)drain_buf, (int)len, 1, 0);
+    if (msg_id < 0) {
+      return;
+    }
+    inflight[n_inflight++] = (inflight_t){msg_id, q_sent++, false};
+  }
+}
+
+static void take_acks(void) {
+  int msg_id;
+  while (xQueueReceive(acks, &msg_id, 0) == pdTRUE) {
+    for (uint32_t i = 0; i < n_inflight; i++) {
+      if (inflight[i].msg_id == msg_id) {
+        inflight[i].acked = true;
+      }
+    }
+  }
+}
+
+// frees queued batches from the oldest on as long as they are acknowledged
+static void retire(void) {
+  uint32_t freed = 0;
+  while (n_inflight > 0 && inflight[0].acked) {
+    if (inflight[0].idx == q_tail) {
+      char key[16];
+      queue_key(key, sizeof(key), q_tail);
+      nvs_erase_key(nvs, key);
+      q_tail++;
+      freed++;
+    }
+    memmove(inflight, inflight + 1, --n_inflight * sizeof(inflight[0]));
+  }
+  if (freed == 0) {
+    return;
+  }
+  queue_save();
+  count(&stats.drained, freed);
+
+  if (draining && q_tail == q_head) {
+    draining = false;
+    uint32_t ms = (uint32_t)((esp_timer_get_time() - drain_start_us) / 1000);
+    portENTER_CRITICAL(&lock);
+    stats.last_drain_batches = stats.drained - drain_start_count;
+    stats.last_drain_ms = ms;
+    uint32_t batches = stats.last_drain_batches;
+    portEXIT_CRITICAL(&lock);
+    ESP_LOGI(TAG, "drained %u queued batches in %u ms", (unsigned)batches,
+      (unsigned)ms);
+  }
+}
+
+static void on_connect(void) {
+  // whatever was in flight is sent again, QoS 1 allows the duplicate
+  n_inflight = 0;
+  q_sent = q_tail;
+  if (q_head != q_tail) {
+    draining = true;
+    drain_start_us = esp_timer_get_time();
+    portENTER_CRITICAL(&lock);
+    drain_start_count = stats.drained;
+    portEXIT_CRITICAL(&lock);
+    ESP_LOGI(TAG, "connected, %u batches queued", (unsigned)(q_head - q_tail));
+  }
+}
+
+void telemetry_task(void *param) {
+  task = xTaskGetCurrentTaskHandle();
+  while (!ready) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  }
+
+  const TickType_t period = pdMS_TO_TICKS(CONFIG_TELEMETRY_PUBLISH_MS);
+  TickType_t next = xTaskGetTickCount() + period;
+  uint32_t epoch = 0;
+  for (;;) {
+    TickType_t now = xTaskGetTickCount();
+    ulTaskNotifyTake(
+      pdTRUE, (int32_t)(next - now) > 0 ? next - now : 0);
+
+    now = xTaskGetTickCount();
+    bool due = (int32_t)(now - next) >= 0;
+    if (due) {
+      if (cfg.on_publish != NULL) {
+        cfg.on_publish();
+      }
+      next += period;
+      if ((int32_t)(now - next) >= 0) {
+        next = now + period;
+      }
+    }
+
+    size_t len;
+    const uint8_t *buf = take_sealed(due, &len);
+    if (buf != NULL) {
+      ship(buf, len);
+      release_sealed();
+    }
+
+    if (epoch != conn_epoch) {
+      epoch = conn_epoch;
+      on_connect();
+    }
+    take_acks();
+    retire();
+    if (connected) {
+      drain();
+    }
+  }
+}
+
+static void on_mqtt_event(
+  void *arg, esp_event_base_t base, int32_t id, void *data) {
+  esp_mqtt_event_handle_t event = data;
+  switch ((esp_mqtt_event_id_t)id) {
+  case MQTT_EVENT_CONNECTED:
+    connected = true;
+    conn_epoch++;
+    count(&stats.connects, 1);
+    break;
+  case MQTT_EVENT_DISCONNECTED:
+    connected = false;
+    break;
+  case MQTT_EVENT_PUBLISHED:
+    // the task matches it against the queued batches in flight
+    xQueueSend(acks, &event->msg_id, 0);
+    break;
+  case MQTT_EVENT_ERROR:
+    ESP_LOGE(TAG, "mqtt error; error code: %d ",
+      event->error_handle->esp_tls_last_esp_err);
+    break;
+  default:
+    return;
+  }
+  if (task != NULL) {
+    xTaskNotifyGive(task);
+  }
+}
+
+static void queue_open(void) {
+  const char *part = CONFIG_TELEMETRY_NVS_PARTITION;
+  esp_err_t err = nvs_flash_init_partition(part);
+  if (err == ESP_ERR_NVS_NO_FREE_PAGES ||
+      err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+    nvs_flash_erase_partition(part);
+    err = nvs_flash_init_partition(part);
+  }
+  if (err == ESP_OK) {
+    err = nvs_open_from_partition(part, NVS_NAMESPACE, NVS_READWRITE, &nvs);
+  }
+  if (err != ESP_OK) {
+    // still publishes while connected
+    ESP_LOGW(TAG, "no offline queue in \"%s\"; error code: %d ", part, err);
+    nvs = 0;
+    return;
+  }
+  nvs_get_u32(nvs, "head", &q_head);
+  nvs_get_u32(nvs, "tail", &q_tail);
+  if (q_head - q_tail > QUEUE_LEN) {
+    // written with a larger queue, keep the newest
+    q_tail = q_head - QUEUE_LEN;
+  }
+  q_sent = q_tail;
+  stats.queue_depth = q_head - q_tail;
+  ESP_LOGI(TAG, "%u batches queued from before", (unsigned)stats.queue_depth);
+}
+
+esp_err_t telemetry_init(const telemetry_cfg_t *config) {
+  cfg = *config;
+  if (cfg.node != NULL) {
+    snprintf(node, sizeof(node), "%s", cfg.node);
+  } else {
+    uint8_t mac[6];
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    snprintf(node, sizeof(node), "esp32-%02x%02x%02x", mac[3], mac[4], mac[5]);
+  }
+  snprintf(topic, sizeof(topic), "%s/%s/batch", CONFIG_TELEMETRY_TOPIC_PREFIX,
+    node);
+
+  acks = xQueueCreateStatic(WINDOW * 2, sizeof(int), acks_storage, &acks_buf);
+  queue_open();
+
+  boot_id = (uint16_t)esp_random();
+  telemetry_hdr_t hdr = {
+    .boot = boot_id,
+    .seq = next_seq++,
+    .unix_s = unix_s(),
+    .uptime_ms = uptime_ms(),
+  };
+  telemetry_batch_start(&batch, bufs[cur], BATCH_BYTES, &hdr);
+
+  esp_mqtt_client_config_t mqtt_cfg = {
+    .broker.address.uri = CONFIG_TELEMETRY_BROKER_URI,
+    .credentials.client_id = node,
+    .session.keepalive = KEEPALIVE_S,
+    .network.reconnect_timeout_ms = RECONNECT_MS,
+    .buffer.out_size = BATCH_BYTES + 128,
+  };
+  // stack and priority come from the app task table
+  const task_def_t *mqtt_task = task_table_find("mqtt_task");
+  if (mqtt_task != NULL) {
+    mqtt_cfg.task.priority = mqtt_task->priority;
+    mqtt_cfg.task.stack_size = mqtt_task->stack_size;
+  }
+  client = esp_mqtt_client_init(&mqtt_cfg);
+  if (client == NULL) {
+    ESP_LOGE(TAG, "esp_mqtt_client_init failed");
+    return ESP_FAIL;
+  }
+  esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, on_mqtt_event, NULL);
+  // connects once there is a network and keeps reconnecting
+  esp_err_t err = esp_mqtt_client_start(client);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "esp_mqtt_client_start; error code: %d ", err);
+    return err;
+  }
+
+  ready = true;
+  if (task != NULL) {
+    xTaskNotifyGive(task);
+  }
+  ESP_LOGI(TAG, "publishing to %s every %d ms", topic,
+    CONFIG_TELEMETRY_PUBLISH_MS);
+  return ESP_OK;
+}
+
+void telemetry_get_stats(telemetry_stats_t *out) {
+  portENTER_CRITICAL(&lock);
+  *out = stats;
+  portEXIT_CRITICAL(&lock);
+  out->connected = connected;
+}
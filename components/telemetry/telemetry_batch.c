@@ -0,0 +1,126 @@
+#include "telemetry_batch.h"
+#include <string.h>
+
+static void put_u16(uint8_t *p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+  put_u16(p, (uint16_t)v);
+  put_u16(p + 2, (uint16_t)(v >> 16));
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+  return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+  return get_u16(p) | (uint32_t)get_u16(p + 2) << 16;
+}
+
+static size_t put_varint(uint8_t *out, uint32_t v) {
+  size_t n = 0;
+  while (v >= 0x80) {
+    out[n++] = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  out[n++] = (uint8_t)v;
+  return n;
+}
+
+static size_t get_varint(const uint8_t *in, size_t len, uint32_t *v) {
+  uint32_t result = 0;
+  for (size_t i = 0; i < len && i < 5; i++) {
+    result |= (uint32_t)(in[i] & 0x7f) << (7 * i);
+    if ((in[i] & 0x80) == 0) {
+      *v = result;
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+void telemetry_batch_start(telemetry_batch_t *b,
+  uint8_t *buf,
+  size_t cap,
+  const telemetry_hdr_t *hdr) {
+  b->buf = buf;
+  b->cap = cap;
+  b->len = TELEMETRY_BATCH_HDR;
+  b->count = 0;
+  b->last_ms = hdr->uptime_ms;
+
+  buf[0] = TELEMETRY_BATCH_MAGIC;
+  buf[1] = TELEMETRY_BATCH_VERSION;
+  put_u16(buf + 2, hdr->boot);
+  put_u32(buf + 4, hdr->seq);
+  put_u32(buf + 8, hdr->unix_s);
+  put_u32(buf + 12, hdr->uptime_ms);
+  put_u16(buf + 16, 0);
+}
+
+bool telemetry_batch_add(telemetry_batch_t *b,
+  uint32_t uptime_ms,
+  uint8_t type,
+  const void *data,
+  uint8_t len) {
+  if (b->count == UINT16_MAX ||
+      b->len + TELEMETRY_RECORD_SIZE(len) > b->cap) {
+    return false;
+  }
+  // records added out of order keep a zero delta
+  uint32_t dt = uptime_ms > b->last_ms ? uptime_ms - b->last_ms : 0;
+  uint8_t *p = b->buf + b->len;
+  p += put_varint(p, dt);
+  *p++ = type;
+  *p++ = len;
+  memcpy(p, data, len);
+  p += len;
+
+  b->len = p - b->buf;
+  b->last_ms += dt;
+  b->count++;
+  return true;
+}
+
+size_t telemetry_batch_finish(telemetry_batch_t *b) {
+  put_u16(b->buf + 16, b->count);
+  return b->len;
+}
+
+int telemetry_batch_parse(const uint8_t *buf,
+  size_t len,
+  telemetry_hdr_t *out) {
+  if (len < TELEMETRY_BATCH_HDR || buf[0] != TELEMETRY_BATCH_MAGIC ||
+      buf[1] != TELEMETRY_BATCH_VERSION) {
+    return -1;
+  }
+  out->boot = get_u16(buf + 2);
+  out->seq = get_u32(buf + 4);
+  out->unix_s = get_u32(buf + 8);
+  out->uptime_ms = get_u32(buf + 12);
+  out->count = get_u16(buf + 16);
+  return 0;
+}
+
+int telemetry_batch_next(const uint8_t *buf,
+  size_t len,
+  size_t *off,
+  telemetry_record_t *rec) {
+  uint32_t dt;
+  size_t n = get_varint(buf + *off, len - *off, &dt);
+  if (n == 0 || *off + n + 2 > len) {
+    return -1;
+  }
+  const uint8_t *p = buf + *off + n;
+  if (*off + n + 2 + p[1] > len) {
+    return -1;
+  }
+  rec->uptime_ms += dt;
+  rec->type = p[0];
+  rec->len = p[1];
+  rec->data = p + 2;
+  *off += n + 2 + p[1];
+  return 0;
+}
@@ -0,0 +1,233 @@
+#!/usr/bin/env python3
+"""Receive telemetry batches from a local Mosquitto and measure the link.
+
+Runs mosquitto_sub on <prefix>/+/batch and decodes every batch (layout in
+include/telemetry_batch.h). Reports throughput per node, duplicates (QoS 1
+redelivery), seq gaps and the drain burst after an outage. With --outage the
+broker is stopped and started again by the given commands, and the time from
+the restart until the queued batches have all arrived is measured.
+
+    mosquitto -v                                   # on the host
+    python telemetry_sub.py -v                     # print every record
+    python telemetry_sub.py -t 300                 # throughput over 5 min
+    python telemetry_sub.py --outage 60 \\
+      --stop-cmd 'systemctl stop mosquitto' --start-cmd 'systemctl start mosquitto'
+"""
+import argparse
+import struct
+import subprocess
+import sys
+import threading
+import time
+
+MAGIC = ord("T")
+VERSION = 1
+HDR = struct.Struct("<BBHIIIH")
+
+# record types of the apps, as in their report.h
+TYPES = {
+    "rgb_led": {
+        1: ("color", "<BBB", ("r", "g", "b")),
+        2: ("status", "<bBII", ("rssi", "ble", "heap_free", "jitter_max_us")),
+    },
+}
+
+# batches closer than this after a gap count as one drain burst
+BURST_GAP_S = 0.5
+
+
+def varint(buf, off):
+    v = shift = 0
+    while True:
+        b = buf[off]
+        off += 1
+        v |= (b & 0x7F) << shift
+        if not b & 0x80:
+            return v, off
+        shift += 7
+
+
+def decode(buf):
+    magic, ver, boot, seq, unix_s, uptime_ms, count = HDR.unpack_from(buf)
+    if magic != MAGIC or ver != VERSION:
+        raise ValueError("not a telemetry batch")
+    off = HDR.size
+    t = uptime_ms
+    records = []
+    for _ in range(count):
+        dt, off = varint(buf, off)
+        rtype, n = buf[off], buf[off + 1]
+        off += 2
+        t += dt
+        records.append((t, rtype, bytes(buf[off : off + n])))
+        off += n
+    hdr = dict(boot=boot, seq=seq, unix_s=unix_s, uptime_ms=uptime_ms)
+    return hdr, records
+
+
+def describe(app, rtype, data):
+    known = TYPES.get(app, {}).get(rtype)
+    if known is None or len(data) != struct.calcsize(known[1]):
+        return f"type {rtype} {data.hex()}"
+    name, fmt, fields = known
+    values = struct.unpack(fmt, data)
+    return name + " " + " ".join(f"{k}={v}" for k, v in zip(fields, values))
+
+
+class Node:
+    def __init__(self):
+        self.batches = 0
+        self.records = 0
+        self.bytes = 0
+        self.dups = 0
+        self.gaps = 0
+        self.seen = set()
+        self.last = None  # (boot, seq)
+        self.first_t = None
+        self.last_t = None
+
+
+class Stats:
+    def __init__(self):
+        self.nodes = {}
+        self.lock = threading.Lock()
+        self.arrivals = []  # (time, node, late) late: older than newest seen
+
+    def add(self, now, node_id, hdr, records, size):
+        with self.lock:
+            node = self.nodes.setdefault(node_id, Node())
+            key = (hdr["boot"], hdr["seq"])
+            if key in node.seen:
+                node.dups += 1
+                return False
+            node.seen.add(key)
+            late = False
+            if node.last is not None and node.last[0] == key[0]:
+                if key[1] > node.last[1] + 1:
+                    node.gaps += key[1] - node.last[1] - 1
+                late = key[1] < node.last[1]
+            if node.last is None or node.last[0] != key[0] or key[1] > node.last[1]:
+                node.last = key
+            node.batches += 1
+            node.records += len(records)
+            node.bytes += size
+            node.first_t = node.first_t or now
+            node.last_t = now
+            self.arrivals.append((now, node_id, late))
+            return True
+
+    def bursts(self, since=0.0):
+        """runs of batches arriving back to back, i.e. queue drains"""
+        out = []
+        run = []
+        for t, _, _ in (a for a in self.arrivals if a[0] >= since):
+            if run and t - run[-1] > BURST_GAP_S:
+                if len(run) > 2:
+                    out.append(run)
+                run = []
+            run.append(t)
+        if len(run) > 2:
+            out.append(run)
+        return out
+
+
+def subscribe(args, stats, stop):
+    cmd = [
+        "mosquitto_sub", "-h", args.host, "-p", str(args.port), "-q", "1",
+        "-t", f"{args.prefix}/+/batch", "-F", "%U %t %x",
+    ]
+    proc = subprocess.Popen(cmd, stdout=subprocess.PIPE, text=True)
+    for line in proc.stdout:
+        if stop.is_set():
+            break
+        try:
+            _, topic, payload = line.split()
+        except ValueError:
+            continue
+        now = time.monotonic()
+        node_id = topic.split("/")[-2]
+        buf = bytes.fromhex(payload)
+        try:
+            hdr, records = decode(buf)
+        except (ValueError, IndexError, struct.error):
+            print(f"{node_id}: undecodable batch", file=sys.stderr)
+            continue
+        fresh = stats.add(now, node_id, hdr, records, len(buf))
+        if args.verbose and fresh:
+            for t, rtype, data in records:
+                print(f"{node_id} {hdr['boot']:04x}/{hdr['seq']} {t / 1000:.3f}s "
+                      f"{describe(args.app, rtype, data)}")
+    proc.terminate()
+
+
+def report(stats, elapsed):
+    with stats.lock:
+        for node_id, n in sorted(stats.nodes.items()):
+            span = max(n.last_t - n.first_t, 1e-9) if n.batches > 1 else elapsed
+            print(
+                f"{node_id}: {n.batches} batches, {n.records} records, "
+                f"{n.bytes} B, {n.batches / span:.2f} batches/s, "
+                f"{n.records / span:.1f} records/s, {n.bytes / span:.0f} B/s, "
+                f"{n.dups} duplicates, {n.gaps} missing"
+            )
+        for run in stats.bursts():
+            dur = run[-1] - run[0]
+            print(f"burst of {len(run)} batches in {dur * 1000:.0f} ms "
+                  f"({len(run) / max(dur, 1e-9):.0f} batches/s)")
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--host", default="localhost")
+    ap.add_argument("--port", type=int, default=1883)
+    ap.add_argument("--prefix", default="esp32")
+    ap.add_argument("--app", default="rgb_led", help="record types to decode")
+    ap.add_argument("-t", "--time", type=float, default=0, help="seconds")
+    ap.add_argument("-v", "--verbose", action="store_true")
+    ap.add_argument("--outage", type=float, help="broker down for seconds")
+    ap.add_argument("--stop-cmd")
+    ap.add_argument("--start-cmd")
+    args = ap.parse_args()
+
+    stats = Stats()
+    stop = threading.Event()
+    sub = threading.Thread(target=subscribe, args=(args, stats, stop), daemon=True)
+    sub.start()
+    start = time.monotonic()
+
+    try:
+        if args.outage:
+            if not (args.stop_cmd and args.start_cmd):
+                sys.exit("--outage needs --stop-cmd and --start-cmd")
+            time.sleep(args.time or 30)
+            print(f"stopping the broker for {args.outage:.0f} s")
+            subprocess.run(args.stop_cmd, shell=True, check=True)
+            time.sleep(args.outage)
+            subprocess.run(args.start_cmd, shell=True, check=True)
+            restart = time.monotonic()
+            # mosquitto_sub exits with the broker, start a new one
+            sub = threading.Thread(
+                target=subscribe, args=(args, stats, stop), daemon=True)
+            time.sleep(0.5)
+            sub.start()
+            time.sleep(args.outage + 30)
+            runs = stats.bursts(since=restart)
+            if runs:
+                run = runs[0]
+                print(f"drain: {len(run)} batches, last one {run[-1] - restart:.2f} s "
+                      f"after the restart, {(run[-1] - run[0]) * 1000:.0f} ms burst")
+            else:
+                print("no drain burst seen after the restart")
+        elif args.time:
+            time.sleep(args.time)
+        else:
+            while True:
+                time.sleep(3600)
+    except KeyboardInterrupt:
+        pass
+    stop.set()
+    report(stats, time.monotonic() - start)
+
+
+if __name__ == "__main__":
+    main()
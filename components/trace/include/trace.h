@@ -0,0 +1,69 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "sdkconfig.h"
+#include "trace_ids.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  span tracing into per core ring buffers. a record is 12 bytes written with
+  no locks: the slot is reserved with an atomic increment of the core's head,
+  so tasks and ISRs preempting each other on one core never share a slot.
+  the oldest records are overwritten when a ring wraps.
+
+  with CONFIG_TRACE_ENABLE off the macros compile to nothing.
+*/
+
+#define TRACE_EV_BEGIN 0
+#define TRACE_EV_END 1
+#define TRACE_EV_VALUE 2
+
+#define TRACE_DUMP_MAGIC 0x31435254 // "TRC1"
+#define TRACE_MAX_CORES 2
+
+typedef struct {
+  uint32_t ts_us; // esp_timer, wraps after ~71 minutes
+  uint16_t id;
+  uint8_t type;
+  uint8_t core;
+  uint32_t arg;
+} trace_rec_t;
+
+// binary dump layout: header, then for each core its records oldest first
+typedef struct {
+  uint32_t magic;
+  uint16_t cores;
+  uint16_t rec_size;
+  uint32_t count[TRACE_MAX_CORES]; // records that follow, per core
+} trace_dump_hdr_t;
+
+#if CONFIG_TRACE_ENABLE
+#define TRACE_BEGIN(id) trace_record((id), TRACE_EV_BEGIN, 0)
+#define TRACE_END(id) trace_record((id), TRACE_EV_END, 0)
+#define TRACE_VALUE(id, value) trace_record((id), TRACE_EV_VALUE, (value))
+#else
+#define TRACE_BEGIN(id) ((void)0)
+#define TRACE_END(id) ((void)0)
+#define TRACE_VALUE(id, value) ((void)0)
+#endif
+
+// the periodic runtime stats / UART dump task only exists when this is set
+#define TRACE_HAS_TASK (CONFIG_TRACE_ENABLE && CONFIG_TRACE_STATS_PERIOD_MS > 0)
+#define TRACE_TASK_STACK 3072
+
+// starts the stats task when configured. apps with a task table list
+// trace_task there instead, under #if TRACE_HAS_TASK
+void trace_init(void);
+void trace_task(void *arg);
+void trace_record(uint16_t id, uint8_t type, uint32_t arg);
+
+// fills buf with the binary dump, returns bytes written
+size_t trace_dump(uint8_t *buf, size_t len);
+size_t trace_dump_size(void);
+// prints records recorded since the last call as TRC,<core>,<hex> lines
+void trace_dump_uart(void);
+// one "name,core,prio,cpu_permille,stack_hwm" line per task, returns length
+size_t trace_task_stats(char *buf, size_t len);
+
+#endif
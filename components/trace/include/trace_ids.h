@@ -0,0 +1,26 @@
+#ifndef TRACE_IDS_H
+#define TRACE_IDS_H
+
+// span ids shared by all apps. append only, trace_decode.py reads the names
+// from this list in order
+#define TRACE_IDS(X)                                                          \
+  X(TRACE_BLE_MOTOR_WRITE, "ble_motor_write")                                 \
+  X(TRACE_MOTOR_UPDATE, "motor_update")                                       \
+  X(TRACE_DHT_CRITICAL, "dht_critical")                                       \
+  X(TRACE_DHT_READ, "dht_read")                                               \
+  X(TRACE_BLE_PROV_FRAME, "ble_prov_frame")                                   \
+  X(TRACE_BLE_PROV_STATUS, "ble_prov_status")                                 \
+  X(TRACE_HTTP_ROOT, "http_root")                                             \
+  X(TRACE_HTTP_COLOR, "http_color")                                           \
+  X(TRACE_HTTP_STATS, "http_stats")                                           \
+  X(TRACE_HTTP_THROUGHPUT, "http_throughput")                                 \
+  X(TRACE_HTTP_TRACE, "http_trace")                                           \
+  X(TRACE_MOTOR_LATENCY, "motor_latency")                                     \
+  X(TRACE_HTTP_OTA, "http_ota")                                               \
+  X(TRACE_HTTP_SYNC, "http_sync")
+
+#define TRACE_ID_ENUM(id, name) id,
+typedef enum { TRACE_IDS(TRACE_ID_ENUM) TRACE_ID_COUNT } trace_id_t;
+#undef TRACE_ID_ENUM
+
+#endif
@@ -0,0 +1,200 @@
+#include "trace.h"
+#include <stdio.h>
+#include <string.h>
+
+#if CONFIG_TRACE_ENABLE
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdlib.h>
+
+#define TRACE_MASK (CONFIG_TRACE_BUF_RECORDS - 1)
+// tasks that may be created between counting them and taking the snapshot
+#define TRACE_STATS_SPARE_TASKS 4
+// periodic report, about 30 bytes a task
+#define TRACE_STATS_BUF 2048
+#define TRACE_UART_PER_LINE 8
+
+_Static_assert((CONFIG_TRACE_BUF_RECORDS & TRACE_MASK) == 0,
+  "CONFIG_TRACE_BUF_RECORDS must be a power of two");
+_Static_assert(sizeof(trace_rec_t) == 12, "trace_rec_t layout changed");
+
+static const char *TAG = "TRACE";
+
+static trace_rec_t rings[TRACE_MAX_CORES][CONFIG_TRACE_BUF_RECORDS];
+static uint32_t heads[TRACE_MAX_CORES];
+static uint32_t uart_sent[TRACE_MAX_CORES];
+
+void trace_record(uint16_t id, uint8_t type, uint32_t arg) {
+  uint8_t core = (uint8_t)esp_cpu_get_core_id();
+  uint32_t idx = __atomic_fetch_add(&heads[core], 1, __ATOMIC_RELAXED);
+  trace_rec_t *rec = &rings[core][idx & TRACE_MASK];
+  rec->ts_us = (uint32_t)esp_timer_get_time();
+  rec->id = id;
+  rec->type = type;
+  rec->core = core;
+  rec->arg = arg;
+}
+
+// oldest index still in the ring for a head value
+static uint32_t ring_start(uint32_t head) {
+  return head > CONFIG_TRACE_BUF_RECORDS ? head - CONFIG_TRACE_BUF_RECORDS : 0;
+}
+
+size_t trace_dump_size(void) {
+  return sizeof(trace_dump_hdr_t) +
+         TRACE_MAX_CORES * CONFIG_TRACE_BUF_RECORDS * sizeof(trace_rec_t);
+}
+
+// records being written while we copy can come out torn, the decoder drops
+// anything with an unknown id or type
+size_t trace_dump(uint8_t *buf, size_t len) {
+  trace_dump_hdr_t hdr = {
+    .magic = TRACE_DUMP_MAGIC,
+    .cores = TRACE_MAX_CORES,
+    .rec_size = sizeof(trace_rec_t),
+  };
+  if (len < sizeof(hdr)) {
+    return 0;
+  }
+  size_t off = sizeof(hdr);
+  for (int core = 0; core < TRACE_MAX_CORES; core++) {
+    uint32_t head = __atomic_load_n(&heads[core], __ATOMIC_ACQUIRE);
+    for (uint32_t i = ring_start(head); i != head; i++) {
+      if (off + sizeof(trace_rec_t) > len) {
+        break;
+      }
+      memcpy(buf + off, &rings[core][i & TRACE_MASK], sizeof(trace_rec_t));
+      off += sizeof(trace_rec_t);
+      hdr.count[core]++;
+    }
+  }
+  memcpy(buf, &hdr, sizeof(hdr));
+  return off;
+}
+
+void trace_dump_uart(void) {
+  for (int core = 0; core < TRACE_MAX_CORES; core++) {
+    uint32_t head = __atomic_load_n(&heads[core], __ATOMIC_ACQUIRE);
+    uint32_t i = uart_sent[core];
+    if (i < ring_start(head)) {
+      printf("TRC,%d,lost,%lu\n", core, (unsigned long)(ring_start(head) - i));
+      i = ring_start(head);
+    }
+    while (i != head) {
+      printf("TRC,%d,", core);
+      for (int n = 0; n < TRACE_UART_PER_LINE && i != head; n++, i++) {
+        const uint8_t *p = (const uint8_t *)&rings[core][i & TRACE_MASK];
+        for (size_t b = 0; b < sizeof(trace_rec_t); b++) {
+          printf("%02x", p[b]);
+        }
+      }
+      printf("\n");
+    }
+    uart_sent[core] = head;
+  }
+}
+
+static int cmp_task_number(const void *a, const void *b) {
+  const TaskStatus_t *x = a;
+  const TaskStatus_t *y = b;
+  return (x->xTaskNumber > y->xTaskNumber) - (x->xTaskNumber < y->xTaskNumber);
+}
+
+size_t trace_task_stats(char *buf, size_t len) {
+  // sized per call, the task count grows with the app and httpd and the
+  // stats task can ask at the same time
+  UBaseType_t max = uxTaskGetNumberOfTasks() + TRACE_STATS_SPARE_TASKS;
+  TaskStatus_t *tasks = malloc(max * sizeof(TaskStatus_t));
+  if (tasks == NULL) {
+    ESP_LOGE(TAG, "trace_task_stats; no memory for %u tasks ", (unsigned)max);
+    return 0;
+  }
+  configRUN_TIME_COUNTER_TYPE total = 0;
+  UBaseType_t n = uxTaskGetSystemState(tasks, max, &total);
+  if (n == 0) {
+    ESP_LOGE(TAG, "trace_task_stats; more than %u tasks ", (unsigned)max);
+  }
+  qsort(tasks, n, sizeof(tasks[0]), cmp_task_number);
+  // runtime is summed over both cores
+  total *= portNUM_PROCESSORS;
+  size_t off = 0;
+  for (UBaseType_t i = 0; i < n && off < len; i++) {
+    BaseType_t core = xTaskGetCoreID(tasks[i].xHandle);
+    uint32_t permille =
+      total ? (uint32_t)((uint64_t)tasks[i].ulRunTimeCounter * 1000 / total) : 0;
+    int w = snprintf(buf + off, len - off, "%s,%d,%u,%lu,%lu\n",
+      tasks[i].pcTaskName, core == tskNO_AFFINITY ? -1 : (int)core,
+      (unsigned)tasks[i].uxCurrentPriority, (unsigned long)permille,
+      (unsigned long)tasks[i].usStackHighWaterMark);
+    if (w < 0) {
+      break;
+    }
+    off += (size_t)w;
+  }
+  if (off >= len && n > 0) {
+    ESP_LOGE(TAG, "trace_task_stats; %u tasks don't fit in %u bytes ",
+      (unsigned)n, (unsigned)len);
+  }
+  free(tasks);
+  return off < len ? off : len;
+}
+
+void trace_task(void *arg) {
+  static char stats[TRACE_STATS_BUF];
+  for (;;) {
+    vTaskDelay(pdMS_TO_TICKS(CONFIG_TRACE_STATS_PERIOD_MS));
+    trace_task_stats(stats, sizeof(stats));
+    printf("TASKS,%lu\n%s", (unsigned long)(esp_timer_get_time() / 1000), stats);
+#if CONFIG_TRACE_UART_DUMP
+    trace_dump_uart();
+#endif
+  }
+}
+
+void trace_init(void) {
+#if CONFIG_TRACE_STATS_PERIOD_MS > 0
+  if (xTaskCreate(trace_task, "trace", TRACE_TASK_STACK, NULL, 1, NULL) !=
+      pdPASS) {
+    ESP_LOGE(TAG, "trace_init; failed to create task");
+  }
+#endif
+}
+
+#else
+
+void trace_init(void) {}
+
+void trace_record(uint16_t id, uint8_t type, uint32_t arg) {
+  (void)id;
+  (void)type;
+  (void)arg;
+}
+
+size_t trace_dump_size(void) { return sizeof(trace_dump_hdr_t); }
+
+size_t trace_dump(uint8_t *buf, size_t len) {
+  trace_dump_hdr_t hdr = {
+    .magic = TRACE_DUMP_MAGIC,
+    .cores = TRACE_MAX_CORES,
+    .rec_size = sizeof(trace_rec_t),
+  };
+  if (len < sizeof(hdr)) {
+    return 0;
+  }
+  memcpy(buf, &hdr, sizeof(hdr));
+  return sizeof(hdr);
+}
+
+void trace_dump_uart(void) {}
+
+size_t trace_task_stats(char *buf, size_t len) {
+  if (len > 0) {
+    buf[0] = '\0';
+  }
+  return 0;
+}
+
+#endif
@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+"""Decode trace records into a span timeline.
+
+Input is either the binary body of GET /api/trace or a serial log holding
+TRC lines from trace_dump_uart().
+
+    curl -o trace.bin http://<ip>/api/trace
+    python trace_decode.py trace.bin                  # text timeline
+    python trace_decode.py monitor.log --chrome t.json # open in ui.perfetto.dev
+"""
+import argparse
+import json
+import os
+import re
+import struct
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+IDS_HEADER = os.path.join(HERE, "include", "trace_ids.h")
+
+MAGIC = 0x31435254
+REC = struct.Struct("<IHBBI")
+EV_BEGIN, EV_END, EV_VALUE = 0, 1, 2
+
+
+def read_names(path):
+    with open(path) as f:
+        return re.findall(r'X\(\w+,\s*"([^"]+)"\)', f.read())
+
+
+def from_binary(data):
+    magic, cores, rec_size = struct.unpack_from("<IHH", data)
+    if magic != MAGIC or rec_size != REC.size:
+        raise ValueError("not a trace dump")
+    counts = struct.unpack_from(f"<{cores}I", data, 8)
+    off = 8 + 4 * cores
+    recs = []
+    for count in counts:
+        for _ in range(count):
+            recs.append(REC.unpack_from(data, off))
+            off += REC.size
+    return recs
+
+
+def from_log(text):
+    recs = []
+    for m in re.finditer(r"TRC,(\d+),([0-9a-f]+)", text):
+        raw = bytes.fromhex(m.group(2))
+        for off in range(0, len(raw) - REC.size + 1, REC.size):
+            recs.append(REC.unpack_from(raw, off))
+    lost = sum(int(n) for n in re.findall(r"TRC,\d+,lost,(\d+)", text))
+    if lost:
+        print(f"# {lost} records overwritten before they were dumped",
+              file=sys.stderr)
+    return recs
+
+
+def load(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if len(data) >= 4 and struct.unpack_from("<I", data)[0] == MAGIC:
+        return from_binary(data)
+    return from_log(data.decode(errors="replace"))
+
+
+def build_spans(recs, names):
+    """pair BEGIN/END per core, nesting by a per core stack"""
+    spans, values, stacks = [], [], {}
+    # timestamps are 32 bit microseconds, unwrap them in record order per core
+    last, base = {}, {}
+    for ts, ident, kind, core, arg in recs:
+        if ident >= len(names) or kind > EV_VALUE:
+            continue  # torn record
+        if core in last and ts < last[core] and last[core] - ts > 1 << 31:
+            base[core] = base.get(core, 0) + (1 << 32)
+        last[core] = ts
+        t = ts + base.get(core, 0)
+        name = names[ident]
+        stack = stacks.setdefault(core, [])
+        if kind == EV_BEGIN:
+            stack.append((name, t))
+        elif kind == EV_END:
+            for i in range(len(stack) - 1, -1, -1):
+                if stack[i][0] == name:
+                    _, start = stack.pop(i)
+                    spans.append((start, t - start, core, name, len(stack)))
+                    break
+        else:
+            values.append((t, core, name, arg))
+    spans.sort()
+    return spans, values
+
+
+def print_timeline(spans, values):
+    t0 = min([s[0] for s in spans] + [v[0] for v in values], default=0)
+    events = [(s[0], "span", s) for s in spans] + [(v[0], "value", v) for v in values]
+    for t, kind, e in sorted(events, key=lambda x: x[0]):
+        if kind == "span":
+            _, dur, core, name, depth = e
+            print(f"{t - t0:>12} us  core{core}  {'  ' * depth}{name}  {dur} us")
+        else:
+            _, core, name, arg = e
+            print(f"{t - t0:>12} us  core{core}  {name} = {arg}")
+
+    print()
+    print(f"{'span':24} {'count':>7} {'min':>8} {'avg':>8} {'max':>8}")
+    by_name = {}
+    for _, dur, _, name, _ in spans:
+        by_name.setdefault(name, []).append(dur)
+    for name, durs in sorted(by_name.items()):
+        print(f"{name:24} {len(durs):>7} {min(durs):>8} "
+              f"{sum(durs) // len(durs):>8} {max(durs):>8}")
+
+
+def write_chrome(path, spans, values):
+    events = []
+    for start, dur, core, name, _ in spans:
+        events.append({"name": name, "ph": "X", "ts": start, "dur": dur,
+                       "pid": 0, "tid": core})
+    for t, core, name, arg in values:
+        events.append({"name": name, "ph": "C", "ts": t, "pid": 0,
+                       "tid": core, "args": {"value": arg}})
+    with open(path, "w") as f:
+        json.dump({"traceEvents": events}, f)
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("input")
+    parser.add_argument("--ids", default=IDS_HEADER)
+    parser.add_argument("--chrome", help="write a chrome trace json")
+    args = parser.parse_args()
+
+    names = read_names(args.ids)
+    recs = load(args.input)
+    if not recs:
+        print("no trace records in", args.input)
+        return 1
+    spans, values = build_spans(recs, names)
+    if args.chrome:
+        write_chrome(args.chrome, spans, values)
+        print("wrote", len(spans), "spans to", args.chrome)
+    else:
+        print_timeline(spans, values)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
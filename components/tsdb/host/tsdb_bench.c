@@ -0,0 +1,296 @@
+/*
+  host run of the tsdb store against a file standing in for the flash
+  partition. fills it with a synthetic year of 10 s DHT11 samples, checks
+  that a remount and every query agree with a plain scan of the same samples,
+  and benchmarks query latency.
+
+    gcc -O2 -I../include -I../../bench/include tsdb_bench.c ../tsdb.c \
+      ../tsdb_codec.c ../../bench/bench.c -lm -o tsdb_bench
+    ./tsdb_bench                       # 704 KB region, like temp_humid
+    ./tsdb_bench -s 1048576 -f db.img  # other size, keep the image
+
+  BENCH lines match the device ones, so bench_compare.py reads them too.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include "bench.h"
+#include "tsdb.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define YEAR_S (365u * 24 * 3600)
+#define INTERVAL_S 10
+#define FLUSH_EVERY 30
+#define DEFAULT_SIZE 0xb0000
+#define TWO_PI 6.283185307179586
+
+typedef struct {
+  FILE *f;
+  uint32_t writes;
+  uint32_t erases;
+} file_flash_t;
+
+static int file_read(void *ctx, uint32_t off, void *buf, size_t len) {
+  file_flash_t *ff = ctx;
+  if (fseek(ff->f, off, SEEK_SET) != 0) {
+    return -1;
+  }
+  return fread(buf, 1, len, ff->f) == len ? 0 : -1;
+}
+
+// NOR semantics: programming can only clear bits
+static int file_write(void *ctx, uint32_t off, const void *buf, size_t len) {
+  file_flash_t *ff = ctx;
+  uint8_t cur[TSDB_SECTOR_SIZE];
+  const uint8_t *in = buf;
+  while (len > 0) {
+    size_t n = len < sizeof(cur) ? len : sizeof(cur);
+    if (file_read(ctx, off, cur, n) != 0) {
+      return -1;
+    }
+    for (size_t i = 0; i < n; i++) {
+      cur[i] &= in[i];
+    }
+    if (fseek(ff->f, off, SEEK_SET) != 0 || fwrite(cur, 1, n, ff->f) != n) {
+      return -1;
+    }
+    off += n;
+    in += n;
+    len -= n;
+  }
+  ff->writes++;
+  return 0;
+}
+
+static int file_erase(void *ctx, uint32_t off, size_t len) {
+  file_flash_t *ff = ctx;
+  uint8_t ones[TSDB_SECTOR_SIZE];
+  memset(ones, 0xff, sizeof(ones));
+  if (fseek(ff->f, off, SEEK_SET) != 0) {
+    return -1;
+  }
+  for (size_t done = 0; done < len; done += sizeof(ones)) {
+    if (fwrite(ones, 1, sizeof(ones), ff->f) != sizeof(ones)) {
+      return -1;
+    }
+  }
+  ff->erases++;
+  return 0;
+}
+
+// daily swing plus weather over a few days, at DHT11 resolution (whole
+// units), with the odd reading flickering by one unit
+static tsdb_sample_t synth(uint32_t t) {
+  double day = TWO_PI * (t % 86400) / 86400.0;
+  double days = TWO_PI * t / (86400.0 * 5.3);
+  double temp = 22 + 3 * sin(day) + 2 * sin(days);
+  double hum = 50 - 8 * sin(day) + 6 * cos(days);
+  int flicker = rand() % 100 == 0 ? 1 : 0;
+  tsdb_sample_t s = {
+    .t_s = t,
+    .humidity = (int16_t)(lround(hum) * 10),
+    .temperature = (int16_t)((lround(temp) + flicker) * 10),
+  };
+  return s;
+}
+
+static tsdb_t db;
+static tsdb_block_t *index_buf;
+static tsdb_sample_t *samples;
+static uint32_t n_samples;
+
+static void scan(uint32_t from, uint32_t to, tsdb_agg_t *out) {
+  memset(out, 0, sizeof(*out));
+  for (uint32_t i = 0; i < n_samples; i++) {
+    const tsdb_sample_t *s = &samples[i];
+    if (s->t_s < from || s->t_s >= to) {
+      continue;
+    }
+    if (out->count == 0) {
+      out->hum_min = out->hum_max = s->humidity;
+      out->temp_min = out->temp_max = s->temperature;
+      out->t_min = out->t_max = s->t_s;
+    }
+    out->count++;
+    out->hum_min = s->humidity < out->hum_min ? s->humidity : out->hum_min;
+    out->hum_max = s->humidity > out->hum_max ? s->humidity : out->hum_max;
+    out->temp_min =
+      s->temperature < out->temp_min ? s->temperature : out->temp_min;
+    out->temp_max =
+      s->temperature > out->temp_max ? s->temperature : out->temp_max;
+    out->t_min = s->t_s < out->t_min ? s->t_s : out->t_min;
+    out->t_max = s->t_s > out->t_max ? s->t_s : out->t_max;
+    out->hum_sum += s->humidity;
+    out->temp_sum += s->temperature;
+  }
+}
+
+static int same(const tsdb_agg_t *a, const tsdb_agg_t *b) {
+  if (a->count != b->count) {
+    return 0;
+  }
+  return a->count == 0 ||
+         (a->hum_min == b->hum_min && a->hum_max == b->hum_max &&
+           a->temp_min == b->temp_min && a->temp_max == b->temp_max &&
+           a->hum_sum == b->hum_sum && a->temp_sum == b->temp_sum &&
+           a->t_min == b->t_min && a->t_max == b->t_max);
+}
+
+typedef struct {
+  uint32_t from;
+  uint32_t to;
+} window_t;
+
+static void bench_query(void *ctx) {
+  const window_t *w = ctx;
+  tsdb_agg_t agg;
+  tsdb_query(&db, w->from, w->to, &agg);
+}
+
+int main(int argc, char **argv) {
+  uint32_t size = DEFAULT_SIZE;
+  const char *path = NULL;
+  int opt;
+  while ((opt = getopt(argc, argv, "s:f:")) != -1) {
+    switch (opt) {
+    case 's':
+      size = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    case 'f':
+      path = optarg;
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-s bytes] [-f image]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  file_flash_t ff = {.f = path ? fopen(path, "w+b") : tmpfile()};
+  if (ff.f == NULL) {
+    perror("flash image");
+    return 2;
+  }
+  tsdb_flash_t flash = {
+    .read = file_read,
+    .write = file_write,
+    .erase = file_erase,
+    .ctx = &ff,
+    .size = size,
+  };
+  size_t sectors = size / TSDB_SECTOR_SIZE;
+  index_buf = calloc(sectors, sizeof(*index_buf));
+  samples = malloc(sizeof(*samples) * (YEAR_S / INTERVAL_S));
+  if (index_buf == NULL || samples == NULL) {
+    return 2;
+  }
+  // file starts out erased
+  file_erase(&ff, 0, size);
+
+  if (tsdb_mount(&db, &flash, index_buf, sectors) != TSDB_OK) {
+    fprintf(stderr, "mount failed\n");
+    return 1;
+  }
+
+  srand(1);
+  const uint32_t t0 = 1700000000;
+  for (uint32_t t = 0; t < YEAR_S; t += INTERVAL_S) {
+    samples[n_samples] = synth(t0 + t);
+    if (tsdb_append(&db, &samples[n_samples]) != TSDB_OK) {
+      fprintf(stderr, "append failed at %u\n", (unsigned)n_samples);
+      return 1;
+    }
+    n_samples++;
+    if (n_samples % FLUSH_EVERY == 0) {
+      tsdb_flush(&db);
+    }
+  }
+  tsdb_flush(&db);
+
+  tsdb_stats_t st;
+  tsdb_get_stats(&db, &st);
+  printf("year of %u samples: %u blocks, %u bytes on flash (%.3f B/sample), "
+         "%u dropped blocks, %u writes\n",
+    (unsigned)n_samples, (unsigned)st.blocks, (unsigned)st.bytes,
+    (double)st.bytes / st.samples, (unsigned)st.dropped_blocks,
+    (unsigned)ff.writes);
+  if (st.samples != n_samples) {
+    printf("region holds the newest %u samples\n", (unsigned)st.samples);
+  }
+
+  // what is on flash has to come back the same after a remount
+  tsdb_stats_t before = st;
+  if (tsdb_mount(&db, &flash, index_buf, sectors) != TSDB_OK) {
+    fprintf(stderr, "remount failed\n");
+    return 1;
+  }
+  tsdb_get_stats(&db, &st);
+  if (st.samples != before.samples || st.blocks != before.blocks) {
+    fprintf(stderr, "remount: %u samples in %u blocks, expected %u in %u\n",
+      (unsigned)st.samples, (unsigned)st.blocks, (unsigned)before.samples,
+      (unsigned)before.blocks);
+    return 1;
+  }
+
+  const uint32_t end = t0 + YEAR_S;
+  window_t windows[] = {
+    {end - 3600, end},
+    {end - 86400, end},
+    {end - 7 * 86400, end},
+    {end - 30 * 86400 + 1234, end - 15 * 86400 + 77},
+    {t0, end},
+  };
+  const char *names[] = {
+    "tsdb_query_hour",
+    "tsdb_query_day",
+    "tsdb_query_week",
+    "tsdb_query_2weeks_unaligned",
+    "tsdb_query_all",
+  };
+
+  // samples the ring dropped are not expected back
+  uint32_t oldest = UINT32_MAX;
+  for (size_t b = 0; b < sectors; b++) {
+    if (index_buf[b].used && index_buf[b].agg.t_min < oldest) {
+      oldest = index_buf[b].agg.t_min;
+    }
+  }
+
+  int bad = 0;
+  for (size_t i = 0; i < sizeof(windows) / sizeof(windows[0]); i++) {
+    tsdb_agg_t got, want;
+    tsdb_query(&db, windows[i].from, windows[i].to, &got);
+    uint32_t from = windows[i].from > oldest ? windows[i].from : oldest;
+    scan(from, windows[i].to, &want);
+    if (!same(&got, &want)) {
+      printf("%s: got %u samples, expected %u\n", names[i],
+        (unsigned)got.count, (unsigned)want.count);
+      bad = 1;
+    }
+  }
+  for (int i = 0; i < 2000 && !bad; i++) {
+    uint32_t a = t0 + (uint32_t)rand() % YEAR_S;
+    uint32_t b = a + 1 + (uint32_t)rand() % (3 * 86400);
+    tsdb_agg_t got, want;
+    tsdb_query(&db, a, b, &got);
+    scan(a > oldest ? a : oldest, b, &want);
+    if (!same(&got, &want)) {
+      printf("random window %u-%u differs\n", (unsigned)a, (unsigned)b);
+      bad = 1;
+    }
+  }
+  printf("queries %s\n", bad ? "differ from a plain scan" : "match a scan");
+
+  bench_opts_t opts = {.warmup = 10, .iterations = 200};
+  bench_result_t result;
+  bench_print_header();
+  for (size_t i = 0; i < sizeof(windows) / sizeof(windows[0]); i++) {
+    if (bench_run(names[i], bench_query, &windows[i], &opts, &result) == 0) {
+      bench_print(&result);
+    }
+  }
+
+  fclose(ff.f);
+  return bad;
+}
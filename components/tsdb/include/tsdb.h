@@ -0,0 +1,111 @@
+#ifndef TSDB_H
+#define TSDB_H
+
+#include "tsdb_codec.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  Append-only humidity/temperature history in a raw flash region. Hardware
+  independent: all flash access goes through tsdb_flash_t, backed by a
+  partition on the device (tsdb_partition.h) and by a file on the host.
+
+  Every flash sector is one block, used as a ring:
+
+    | header 16 B | body: [len u8][len bytes of tsdb_codec tokens]... | seal 32 B |
+
+  The header carries the first sample raw. Encoded samples are staged in RAM
+  and appended to the body as length prefixed chunks by tsdb_flush(), an
+  erased 0xff length marks the end. A full block gets a seal with its
+  count, time range, min/max and sums, then the next sector is erased and
+  opened, dropping the oldest block once the region is full.
+
+  tsdb_mount() rebuilds a RAM index of every block's aggregates from the
+  headers and seals (decoding only the open block), so a query merges whole
+  blocks from the index and only decodes the blocks at the window edges.
+
+  Not thread safe, use it from one task.
+*/
+
+#define TSDB_SECTOR_SIZE 4096
+// blocks are sealed at this many samples so the sums fit the seal
+#define TSDB_BLOCK_MAX_SAMPLES 65535
+// staged bytes that trigger a chunk write without waiting for tsdb_flush()
+#define TSDB_STAGE_FLUSH 64
+
+enum {
+  TSDB_OK = 0,
+  TSDB_ERR_FLASH = -1,
+  TSDB_ERR_ARG = -2,
+  TSDB_ERR_CORRUPT = -3,
+};
+
+typedef struct {
+  // 0 on success. writes only ever clear bits, like NOR flash
+  int (*read)(void *ctx, uint32_t off, void *buf, size_t len);
+  int (*write)(void *ctx, uint32_t off, const void *buf, size_t len);
+  int (*erase)(void *ctx, uint32_t off, size_t len); // sector aligned
+  void *ctx;
+  uint32_t size; // multiple of TSDB_SECTOR_SIZE
+} tsdb_flash_t;
+
+typedef struct {
+  uint32_t count;
+  uint32_t t_min;
+  uint32_t t_max;
+  int16_t hum_min;
+  int16_t hum_max;
+  int16_t temp_min;
+  int16_t temp_max;
+  int64_t hum_sum;
+  int64_t temp_sum;
+} tsdb_agg_t;
+
+typedef struct {
+  bool used;
+  bool sealed; // closed for appends, the seal itself may be missing
+  uint32_t seq;
+  uint32_t body_len;
+  tsdb_sample_t first;
+  tsdb_agg_t agg;
+} tsdb_block_t;
+
+typedef struct {
+  uint32_t blocks;
+  uint32_t sectors;
+  uint32_t samples;
+  uint32_t bytes; // flash bytes holding samples, headers and seals included
+  uint32_t dropped_blocks; // overwritten by the ring since mount
+} tsdb_stats_t;
+
+typedef struct {
+  tsdb_flash_t flash;
+  tsdb_block_t *index; // one entry per sector
+  uint32_t sectors;
+  uint32_t head; // open sector, or the next one to open
+  bool open;
+  uint32_t next_seq;
+  uint32_t body_len; // bytes of the open body already on flash
+  tsdb_enc_t enc;
+  uint8_t stage[1 + 255]; // chunk length, then the staged tokens
+  uint32_t staged;
+  uint32_t dropped_blocks;
+  uint8_t scratch[TSDB_SECTOR_SIZE];
+} tsdb_t;
+
+// index needs flash->size / TSDB_SECTOR_SIZE entries
+int tsdb_mount(tsdb_t *db,
+  const tsdb_flash_t *flash,
+  tsdb_block_t *index,
+  size_t index_len);
+// erases the region and starts over
+int tsdb_format(tsdb_t *db);
+int tsdb_append(tsdb_t *db, const tsdb_sample_t *s);
+// writes staged samples and the pending run, call before power can go away
+int tsdb_flush(tsdb_t *db);
+// aggregates over from_s <= t < to_s. out->count is 0 when nothing matched
+int tsdb_query(tsdb_t *db, uint32_t from_s, uint32_t to_s, tsdb_agg_t *out);
+void tsdb_get_stats(const tsdb_t *db, tsdb_stats_t *out);
+
+#endif
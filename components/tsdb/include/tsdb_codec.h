@@ -0,0 +1,66 @@
+#ifndef TSDB_CODEC_H
+#define TSDB_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  block body encoding, hardware independent. the first sample of a block is
+  stored raw in the block header, every later one is coded against the one
+  before it:
+
+    tag varint, bit 0 set:   run of tag >> 1 samples, each one step of the
+                             previous interval later with unchanged values
+    tag varint, bit 0 clear: one sample. bits 1-3 flag which of the zigzag
+                             varints follow: interval change, humidity delta,
+                             temperature delta
+
+  a steady sensor at a fixed rate costs one run tag for the whole stretch.
+*/
+
+typedef struct {
+  uint32_t t_s;
+  int16_t humidity;    // tenths of %
+  int16_t temperature; // tenths of C
+} tsdb_sample_t;
+
+typedef struct {
+  tsdb_sample_t last;
+  int32_t dt; // interval between the last two samples
+} tsdb_cursor_t;
+
+typedef struct {
+  tsdb_cursor_t cur;
+  uint32_t run; // samples not yet written out as a run tag
+} tsdb_enc_t;
+
+typedef struct {
+  tsdb_cursor_t cur;
+  uint32_t run_left;
+  const uint8_t *p;
+  const uint8_t *end;
+} tsdb_dec_t;
+
+// worst case bytes from one tsdb_enc_push (run tag + full sample)
+#define TSDB_ENC_MAX 22
+// worst case bytes from tsdb_enc_end_run
+#define TSDB_RUN_MAX 5
+
+size_t tsdb_put_varint(uint8_t *out, uint32_t v);
+// returns the bytes used, 0 when the input ends early or overflows
+size_t tsdb_get_varint(const uint8_t *in, size_t len, uint32_t *v);
+
+void tsdb_enc_start(tsdb_enc_t *enc, const tsdb_sample_t *first);
+// returns the bytes put in out, 0 when the sample only extended the run
+size_t tsdb_enc_push(tsdb_enc_t *enc, const tsdb_sample_t *s, uint8_t *out);
+// writes out the pending run, if any
+size_t tsdb_enc_end_run(tsdb_enc_t *enc, uint8_t *out);
+
+void tsdb_dec_start(tsdb_dec_t *dec,
+  const tsdb_sample_t *first,
+  const uint8_t *body,
+  size_t len);
+// sample after the first. 1: got one, 0: end of body, -1: corrupt body
+int tsdb_dec_next(tsdb_dec_t *dec, tsdb_sample_t *out);
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef TSDB_PARTITION_H
+#define TSDB_PARTITION_H
+
+#include "esp_err.h"
+#include "tsdb.h"
+
+// flash ops on the data partition with this label
+esp_err_t tsdb_partition_flash(const char *label, tsdb_flash_t *out);
+
+#endif
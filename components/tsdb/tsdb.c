@@ -0,0 +1,458 @@
+#include "tsdb.h"
+#include <string.h>
+
+#define TSDB_BLOCK_MAGIC 0x42445354 // "TSDB"
+#define TSDB_SEAL_MAGIC 0x4c414553  // "SEAL"
+#define HDR_SIZE 16
+#define SEAL_SIZE 32
+#define BODY_OFF HDR_SIZE
+#define SEAL_OFF (TSDB_SECTOR_SIZE - SEAL_SIZE)
+#define BODY_MAX (SEAL_OFF - BODY_OFF)
+#define CHUNK_END 0xff
+
+typedef struct {
+  uint32_t magic;
+  uint32_t seq;
+  tsdb_sample_t first;
+} block_hdr_t;
+
+typedef struct {
+  uint16_t count;
+  uint16_t body_len;
+  uint32_t t_min;
+  uint32_t t_max;
+  int16_t hum_min;
+  int16_t hum_max;
+  int16_t temp_min;
+  int16_t temp_max;
+  int32_t hum_sum;
+  int32_t temp_sum;
+  uint32_t magic; // written with the rest, a torn seal fails the check
+} block_seal_t;
+
+_Static_assert(sizeof(block_hdr_t) == HDR_SIZE, "header layout changed");
+_Static_assert(sizeof(block_seal_t) == SEAL_SIZE, "seal layout changed");
+
+static uint32_t sector_off(uint32_t sector) {
+  return sector * TSDB_SECTOR_SIZE;
+}
+
+static void agg_first(tsdb_agg_t *agg, const tsdb_sample_t *s) {
+  agg->count = 1;
+  agg->t_min = agg->t_max = s->t_s;
+  agg->hum_min = agg->hum_max = s->humidity;
+  agg->temp_min = agg->temp_max = s->temperature;
+  agg->hum_sum = s->humidity;
+  agg->temp_sum = s->temperature;
+}
+
+static void agg_add(tsdb_agg_t *agg, const tsdb_sample_t *s) {
+  if (agg->count == 0) {
+    agg_first(agg, s);
+    return;
+  }
+  agg->count++;
+  if (s->t_s < agg->t_min) {
+    agg->t_min = s->t_s;
+  }
+  if (s->t_s > agg->t_max) {
+    agg->t_max = s->t_s;
+  }
+  if (s->humidity < agg->hum_min) {
+    agg->hum_min = s->humidity;
+  }
+  if (s->humidity > agg->hum_max) {
+    agg->hum_max = s->humidity;
+  }
+  if (s->temperature < agg->temp_min) {
+    agg->temp_min = s->temperature;
+  }
+  if (s->temperature > agg->temp_max) {
+    agg->temp_max = s->temperature;
+  }
+  agg->hum_sum += s->humidity;
+  agg->temp_sum += s->temperature;
+}
+
+static void agg_merge(tsdb_agg_t *dst, const tsdb_agg_t *src) {
+  if (src->count == 0) {
+    return;
+  }
+  if (dst->count == 0) {
+    *dst = *src;
+    return;
+  }
+  dst->count += src->count;
+  dst->t_min = src->t_min < dst->t_min ? src->t_min : dst->t_min;
+  dst->t_max = src->t_max > dst->t_max ? src->t_max : dst->t_max;
+  dst->hum_min = src->hum_min < dst->hum_min ? src->hum_min : dst->hum_min;
+  dst->hum_max = src->hum_max > dst->hum_max ? src->hum_max : dst->hum_max;
+  dst->temp_min = src->temp_min < dst->temp_min ? src->temp_min : dst->temp_min;
+  dst->temp_max = src->temp_max > dst->temp_max ? src->temp_max : dst->temp_max;
+  dst->hum_sum += src->hum_sum;
+  dst->temp_sum += src->temp_sum;
+}
+
+// reads the body in one go and strips the chunk framing in place. tokens land
+// in db->scratch, *body_len is what the body takes on flash
+static int load_tokens(tsdb_t *db,
+  uint32_t sector,
+  size_t *tokens,
+  uint32_t *body_len) {
+  uint8_t *buf = db->scratch;
+  if (db->flash.read(db->flash.ctx, sector_off(sector) + BODY_OFF, buf,
+        BODY_MAX) != 0) {
+    return TSDB_ERR_FLASH;
+  }
+
+  size_t in = 0, out = 0;
+  while (in < BODY_MAX && buf[in] != CHUNK_END) {
+    size_t len = buf[in];
+    if (len == 0 || in + 1 + len > BODY_MAX) {
+      break;
+    }
+    memmove(buf + out, buf + in + 1, len);
+    out += len;
+    in += 1 + len;
+  }
+  *tokens = out;
+  *body_len = in;
+  return TSDB_OK;
+}
+
+// decodes a block, stopping quietly at a torn chunk. the open block also
+// takes the staged tokens and the pending run
+static int decode_block(tsdb_t *db,
+  uint32_t sector,
+  tsdb_dec_t *dec,
+  uint32_t *body_len) {
+  size_t tokens;
+  int rc = load_tokens(db, sector, &tokens, body_len);
+  if (rc != TSDB_OK) {
+    return rc;
+  }
+  if (db->open && sector == db->head) {
+    memcpy(db->scratch + tokens, db->stage + 1, db->staged);
+    tokens += db->staged;
+    if (db->enc.run) {
+      tokens += tsdb_put_varint(db->scratch + tokens, db->enc.run << 1 | 1);
+    }
+  }
+  tsdb_dec_start(dec, &db->index[sector].first, db->scratch, tokens);
+  return TSDB_OK;
+}
+
+static int write_stage(tsdb_t *db) {
+  if (db->staged == 0) {
+    return TSDB_OK;
+  }
+  db->stage[0] = (uint8_t)db->staged;
+  uint32_t off = sector_off(db->head) + BODY_OFF + db->body_len;
+  if (db->flash.write(db->flash.ctx, off, db->stage, db->staged + 1) != 0) {
+    return TSDB_ERR_FLASH;
+  }
+  db->body_len += db->staged + 1;
+  db->index[db->head].body_len = db->body_len;
+  db->staged = 0;
+  return TSDB_OK;
+}
+
+int tsdb_flush(tsdb_t *db) {
+  if (!db->open) {
+    return TSDB_OK;
+  }
+  db->staged += tsdb_enc_end_run(&db->enc, db->stage + 1 + db->staged);
+  return write_stage(db);
+}
+
+static int seal(tsdb_t *db) {
+  int rc = tsdb_flush(db);
+  if (rc != TSDB_OK) {
+    return rc;
+  }
+
+  tsdb_block_t *b = &db->index[db->head];
+  block_seal_t s = {
+    .count = (uint16_t)b->agg.count,
+    .body_len = (uint16_t)db->body_len,
+    .t_min = b->agg.t_min,
+    .t_max = b->agg.t_max,
+    .hum_min = b->agg.hum_min,
+    .hum_max = b->agg.hum_max,
+    .temp_min = b->agg.temp_min,
+    .temp_max = b->agg.temp_max,
+    .hum_sum = (int32_t)b->agg.hum_sum,
+    .temp_sum = (int32_t)b->agg.temp_sum,
+    .magic = TSDB_SEAL_MAGIC,
+  };
+  if (db->flash.write(db->flash.ctx, sector_off(db->head) + SEAL_OFF, &s,
+        sizeof(s)) != 0) {
+    return TSDB_ERR_FLASH;
+  }
+  b->sealed = true;
+  db->open = false;
+  db->head = (db->head + 1) % db->sectors;
+  return TSDB_OK;
+}
+
+static int open_block(tsdb_t *db, const tsdb_sample_t *first) {
+  tsdb_block_t *b = &db->index[db->head];
+  if (b->used) {
+    db->dropped_blocks++;
+  }
+  memset(b, 0, sizeof(*b));
+  if (db->flash.erase(db->flash.ctx, sector_off(db->head),
+        TSDB_SECTOR_SIZE) != 0) {
+    return TSDB_ERR_FLASH;
+  }
+
+  block_hdr_t hdr = {
+    .magic = TSDB_BLOCK_MAGIC,
+    .seq = db->next_seq,
+    .first = *first,
+  };
+  if (db->flash.write(db->flash.ctx, sector_off(db->head), &hdr,
+        sizeof(hdr)) != 0) {
+    return TSDB_ERR_FLASH;
+  }
+
+  b->used = true;
+  b->seq = db->next_seq++;
+  b->first = *first;
+  agg_first(&b->agg, first);
+  tsdb_enc_start(&db->enc, first);
+  db->body_len = 0;
+  db->staged = 0;
+  db->open = true;
+  return TSDB_OK;
+}
+
+int tsdb_append(tsdb_t *db, const tsdb_sample_t *s) {
+  if (!db->open) {
+    return open_block(db, s);
+  }
+
+  tsdb_block_t *b = &db->index[db->head];
+  uint8_t tmp[TSDB_ENC_MAX];
+  tsdb_enc_t before = db->enc;
+  size_t n = tsdb_enc_push(&db->enc, s, tmp);
+  // the chunk with this sample, then room for a final run tag
+  bool full = db->body_len + 1 + db->staged + n + 1 + TSDB_RUN_MAX > BODY_MAX;
+  if (full || b->agg.count >= TSDB_BLOCK_MAX_SAMPLES) {
+    db->enc = before;
+    int rc = seal(db);
+    return rc != TSDB_OK ? rc : open_block(db, s);
+  }
+
+  memcpy(db->stage + 1 + db->staged, tmp, n);
+  db->staged += n;
+  agg_add(&b->agg, s);
+  return db->staged >= TSDB_STAGE_FLUSH ? write_stage(db) : TSDB_OK;
+}
+
+// rebuilds the open block's encoder from flash. a block with a torn chunk is
+// closed instead, appending after it would hide everything behind the tear
+static int reopen(tsdb_t *db, uint32_t sector) {
+  tsdb_block_t *b = &db->index[sector];
+  tsdb_dec_t dec;
+  uint32_t body_len;
+  int rc = decode_block(db, sector, &dec, &body_len);
+  if (rc != TSDB_OK) {
+    return rc;
+  }
+
+  agg_first(&b->agg, &b->first);
+  tsdb_sample_t s;
+  while ((rc = tsdb_dec_next(&dec, &s)) == 1) {
+    agg_add(&b->agg, &s);
+  }
+  b->body_len = body_len;
+  if (rc < 0 || dec.p != dec.end) {
+    b->sealed = true;
+    db->head = (sector + 1) % db->sectors;
+    return TSDB_OK;
+  }
+
+  db->head = sector;
+  db->open = true;
+  db->body_len = body_len;
+  db->staged = 0;
+  db->enc.cur = dec.cur;
+  db->enc.run = 0;
+  return TSDB_OK;
+}
+
+int tsdb_mount(tsdb_t *db,
+  const tsdb_flash_t *flash,
+  tsdb_block_t *index,
+  size_t index_len) {
+  uint32_t sectors = flash->size / TSDB_SECTOR_SIZE;
+  if (flash->size % TSDB_SECTOR_SIZE || sectors < 2 || sectors > index_len) {
+    return TSDB_ERR_ARG;
+  }
+
+  db->flash = *flash;
+  db->index = index;
+  db->sectors = sectors;
+  db->head = 0;
+  db->open = false;
+  db->next_seq = 1;
+  db->body_len = 0;
+  db->staged = 0;
+  db->dropped_blocks = 0;
+
+  bool any = false;
+  uint32_t newest = 0;
+  for (uint32_t i = 0; i < sectors; i++) {
+    tsdb_block_t *b = &index[i];
+    memset(b, 0, sizeof(*b));
+
+    block_hdr_t hdr;
+    if (flash->read(flash->ctx, sector_off(i), &hdr, sizeof(hdr)) != 0) {
+      return TSDB_ERR_FLASH;
+    }
+    if (hdr.magic != TSDB_BLOCK_MAGIC) {
+      continue;
+    }
+    b->used = true;
+    b->seq = hdr.seq;
+    b->first = hdr.first;
+
+    block_seal_t s;
+    if (flash->read(flash->ctx, sector_off(i) + SEAL_OFF, &s, sizeof(s)) !=
+        0) {
+      return TSDB_ERR_FLASH;
+    }
+    if (s.magic == TSDB_SEAL_MAGIC) {
+      b->sealed = true;
+      b->body_len = s.body_len;
+      b->agg = (tsdb_agg_t){
+        .count = s.count,
+        .t_min = s.t_min,
+        .t_max = s.t_max,
+        .hum_min = s.hum_min,
+        .hum_max = s.hum_max,
+        .temp_min = s.temp_min,
+        .temp_max = s.temp_max,
+        .hum_sum = s.hum_sum,
+        .temp_sum = s.temp_sum,
+      };
+    }
+
+    if (!any || b->seq > index[newest].seq) {
+      newest = i;
+    }
+    any = true;
+  }
+  if (!any) {
+    return TSDB_OK;
+  }
+  db->next_seq = index[newest].seq + 1;
+
+  // unsealed blocks other than the newest lost power while being sealed
+  for (uint32_t i = 0; i < sectors; i++) {
+    tsdb_block_t *b = &index[i];
+    if (i == newest || !b->used || b->sealed) {
+      continue;
+    }
+    int rc = reopen(db, i);
+    if (rc != TSDB_OK) {
+      return rc;
+    }
+    b->sealed = true;
+    db->open = false;
+  }
+
+  if (!index[newest].sealed) {
+    int rc = reopen(db, newest);
+    if (rc != TSDB_OK) {
+      return rc;
+    }
+  }
+  if (index[newest].sealed) {
+    db->open = false;
+    db->head = (newest + 1) % sectors;
+  }
+  return TSDB_OK;
+}
+
+int tsdb_format(tsdb_t *db) {
+  for (uint32_t i = 0; i < db->sectors; i++) {
+    if (db->flash.erase(db->flash.ctx, sector_off(i), TSDB_SECTOR_SIZE) != 0) {
+      return TSDB_ERR_FLASH;
+    }
+    memset(&db->index[i], 0, sizeof(db->index[i]));
+  }
+  db->head = 0;
+  db->open = false;
+  db->next_seq = 1;
+  db->body_len = 0;
+  db->staged = 0;
+  return TSDB_OK;
+}
+
+static int scan_window(tsdb_t *db,
+  uint32_t sector,
+  uint32_t from_s,
+  uint32_t to_s,
+  tsdb_agg_t *out) {
+  tsdb_dec_t dec;
+  uint32_t body_len;
+  int rc = decode_block(db, sector, &dec, &body_len);
+  if (rc != TSDB_OK) {
+    return rc;
+  }
+
+  tsdb_sample_t s = db->index[sector].first;
+  do {
+    if (s.t_s >= from_s && s.t_s < to_s) {
+      agg_add(out, &s);
+    }
+  } while (tsdb_dec_next(&dec, &s) == 1);
+  return TSDB_OK;
+}
+
+int tsdb_query(tsdb_t *db, uint32_t from_s, uint32_t to_s, tsdb_agg_t *out) {
+  memset(out, 0, sizeof(*out));
+  if (from_s >= to_s) {
+    return TSDB_ERR_ARG;
+  }
+
+  for (uint32_t i = 0; i < db->sectors; i++) {
+    const tsdb_block_t *b = &db->index[i];
+    if (!b->used || b->agg.count == 0) {
+      continue;
+    }
+    if (b->agg.t_max < from_s || b->agg.t_min >= to_s) {
+      continue;
+    }
+    // whole block inside the window, its aggregates are enough
+    if (b->agg.t_min >= from_s && b->agg.t_max < to_s) {
+      agg_merge(out, &b->agg);
+      continue;
+    }
+    int rc = scan_window(db, i, from_s, to_s, out);
+    if (rc != TSDB_OK) {
+      return rc;
+    }
+  }
+  return TSDB_OK;
+}
+
+void tsdb_get_stats(const tsdb_t *db, tsdb_stats_t *out) {
+  memset(out, 0, sizeof(*out));
+  out->sectors = db->sectors;
+  out->dropped_blocks = db->dropped_blocks;
+  for (uint32_t i = 0; i < db->sectors; i++) {
+    const tsdb_block_t *b = &db->index[i];
+    if (!b->used) {
+      continue;
+    }
+    out->blocks++;
+    out->samples += b->agg.count;
+    out->bytes += HDR_SIZE + b->body_len + (b->sealed ? SEAL_SIZE : 0);
+  }
+  if (db->open) {
+    out->bytes += db->staged;
+  }
+}
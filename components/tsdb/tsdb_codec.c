@@ -0,0 +1,148 @@
+#include "tsdb_codec.h"
+
+#define TAG_RUN 0x01
+#define TAG_DT 0x02
+#define TAG_HUM 0x04
+#define TAG_TEMP 0x08
+
+static uint32_t zigzag(int32_t v) {
+  return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v) {
+  return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+size_t tsdb_put_varint(uint8_t *out, uint32_t v) {
+  size_t n = 0;
+  while (v >= 0x80) {
+    out[n++] = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  out[n++] = (uint8_t)v;
+  return n;
+}
+
+size_t tsdb_get_varint(const uint8_t *in, size_t len, uint32_t *v) {
+  uint32_t result = 0;
+  for (size_t i = 0; i < len && i < 5; i++) {
+    result |= (uint32_t)(in[i] & 0x7f) << (7 * i);
+    if ((in[i] & 0x80) == 0) {
+      *v = result;
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+void tsdb_enc_start(tsdb_enc_t *enc, const tsdb_sample_t *first) {
+  enc->cur.last = *first;
+  enc->cur.dt = 0;
+  enc->run = 0;
+}
+
+size_t tsdb_enc_end_run(tsdb_enc_t *enc, uint8_t *out) {
+  if (enc->run == 0) {
+    return 0;
+  }
+  size_t n = tsdb_put_varint(out, enc->run << 1 | TAG_RUN);
+  enc->run = 0;
+  return n;
+}
+
+size_t tsdb_enc_push(tsdb_enc_t *enc, const tsdb_sample_t *s, uint8_t *out) {
+  tsdb_cursor_t *cur = &enc->cur;
+  int32_t dt = (int32_t)(s->t_s - cur->last.t_s);
+  int32_t ddt = dt - cur->dt;
+  int32_t dh = s->humidity - cur->last.humidity;
+  int32_t dtemp = s->temperature - cur->last.temperature;
+
+  cur->last = *s;
+  cur->dt = dt;
+  // tags are 28 bits at most, so a run ends before the count overflows
+  if (ddt == 0 && dh == 0 && dtemp == 0 && enc->run < (1u << 27) - 1) {
+    enc->run++;
+    return 0;
+  }
+
+  size_t n = tsdb_enc_end_run(enc, out);
+  if (ddt == 0 && dh == 0 && dtemp == 0) {
+    n += tsdb_put_varint(out + n, 1 << 1 | TAG_RUN);
+    return n;
+  }
+  out[n++] =
+    (ddt ? TAG_DT : 0) | (dh ? TAG_HUM : 0) | (dtemp ? TAG_TEMP : 0);
+  if (ddt) {
+    n += tsdb_put_varint(out + n, zigzag(ddt));
+  }
+  if (dh) {
+    n += tsdb_put_varint(out + n, zigzag(dh));
+  }
+  if (dtemp) {
+    n += tsdb_put_varint(out + n, zigzag(dtemp));
+  }
+  return n;
+}
+
+void tsdb_dec_start(tsdb_dec_t *dec,
+  const tsdb_sample_t *first,
+  const uint8_t *body,
+  size_t len) {
+  dec->cur.last = *first;
+  dec->cur.dt = 0;
+  dec->run_left = 0;
+  dec->p = body;
+  dec->end = body + len;
+}
+
+static int next_field(tsdb_dec_t *dec, int32_t *out) {
+  uint32_t v;
+  size_t n = tsdb_get_varint(dec->p, dec->end - dec->p, &v);
+  if (n == 0) {
+    return -1;
+  }
+  dec->p += n;
+  *out = unzigzag(v);
+  return 0;
+}
+
+int tsdb_dec_next(tsdb_dec_t *dec, tsdb_sample_t *out) {
+  tsdb_cursor_t *cur = &dec->cur;
+  if (dec->run_left == 0) {
+    if (dec->p >= dec->end) {
+      return 0;
+    }
+    uint32_t tag;
+    size_t n = tsdb_get_varint(dec->p, dec->end - dec->p, &tag);
+    if (n == 0 || tag == TAG_RUN) {
+      return -1;
+    }
+    dec->p += n;
+
+    if (tag & TAG_RUN) {
+      dec->run_left = tag >> 1;
+    } else {
+      int32_t ddt = 0, dh = 0, dtemp = 0;
+      if ((tag & TAG_DT) && next_field(dec, &ddt) != 0) {
+        return -1;
+      }
+      if ((tag & TAG_HUM) && next_field(dec, &dh) != 0) {
+        return -1;
+      }
+      if ((tag & TAG_TEMP) && next_field(dec, &dtemp) != 0) {
+        return -1;
+      }
+      cur->dt += ddt;
+      cur->last.t_s += cur->dt;
+      cur->last.humidity += dh;
+      cur->last.temperature += dtemp;
+      *out = cur->last;
+      return 1;
+    }
+  }
+
+  dec->run_left--;
+  cur->last.t_s += cur->dt;
+  *out = cur->last;
+  return 1;
+}
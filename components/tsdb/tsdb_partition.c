@@ -0,0 +1,38 @@
+#include "tsdb_partition.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+
+static const char *TAG = "TSDB";
+
+static int part_read(void *ctx, uint32_t off, void *buf, size_t len) {
+  return esp_partition_read(ctx, off, buf, len) == ESP_OK ? 0 : -1;
+}
+
+static int part_write(void *ctx, uint32_t off, const void *buf, size_t len) {
+  return esp_partition_write(ctx, off, buf, len) == ESP_OK ? 0 : -1;
+}
+
+static int part_erase(void *ctx, uint32_t off, size_t len) {
+  return esp_partition_erase_range(ctx, off, len) == ESP_OK ? 0 : -1;
+}
+
+esp_err_t tsdb_partition_flash(const char *label, tsdb_flash_t *out) {
+  const esp_partition_t *part = esp_partition_find_first(
+    ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+  if (part == NULL) {
+    ESP_LOGE(TAG, "tsdb_partition_flash; no partition '%s' ", label);
+    return ESP_ERR_NOT_FOUND;
+  }
+  if (part->erase_size != TSDB_SECTOR_SIZE) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  *out = (tsdb_flash_t){
+    .read = part_read,
+    .write = part_write,
+    .erase = part_erase,
+    .ctx = (void *)part,
+    .size = part->size - part->size % TSDB_SECTOR_SIZE,
+  };
+  return ESP_OK;
+}
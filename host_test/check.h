@@ -0,0 +1,17 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+
+// failure counter shared by the checks of one test program, main returns
+// failures > 0 so ctest sees the result
+static int failures;
+
+static void check(int ok, const char *what) {
+  if (!ok) {
+    printf("FAIL %s\n", what);
+    failures++;
+  }
+}
+
+#endif
@@ -0,0 +1,268 @@
+/*
+  rgb_led color handling on the host: color_parse on its own, then
+  lib/http_server.c started on the fake httpd and driven with requests the
+  way the page and sync_test.py send them. the rest of rgb_led is stubbed
+  below as far as the handlers call it.
+
+  also times color_parse_json and a whole POST /api/color with the rgb_led
+  BENCH names. exits 1 when a check fails.
+*/
+#include "bench.h"
+#include "boot_init.h"
+#include "check.h"
+#include "color_parse.h"
+#include "events.h"
+#include "fake.h"
+#include "http_server.h"
+#include "led_fx.h"
+#include "ota.h"
+#include "prov.h"
+#include "report.h"
+#include "sync.h"
+#include "task_table.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "wifi.h"
+#include <string.h>
+
+static struct {
+  bool busy; // led_fx queue full
+  int ota_begins;
+  bool leader;
+  int submits;
+  uint8_t rgb[3];
+  int reports;
+  sync_effect_t effect;
+} stub;
+
+bool led_fx_submit(uint8_t r, uint8_t g, uint8_t b) {
+  if (stub.busy) {
+    return false;
+  }
+  stub.submits++;
+  stub.rgb[0] = r;
+  stub.rgb[1] = g;
+  stub.rgb[2] = b;
+  return true;
+}
+
+void led_fx_get_jitter(jitter_t *out) { jitter_init(out, 10000); }
+
+void report_color(uint8_t r, uint8_t g, uint8_t b) { stub.reports++; }
+
+esp_err_t sync_set_effect(const sync_effect_t *fx) {
+  if (!stub.leader) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  stub.effect = *fx;
+  return ESP_OK;
+}
+
+void sync_get_stats(sync_stats_t *out) { memset(out, 0, sizeof(*out)); }
+
+bool prov_is_active(void) { return false; }
+
+void prov_get_stats(prov_stats_t *out) { memset(out, 0, sizeof(*out)); }
+
+void wifi_get_metrics(wifi_conn_metrics_t *out) {
+  memset(out, 0, sizeof(*out));
+}
+
+esp_err_t ota_begin(size_t image_size) {
+  stub.ota_begins++;
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t ota_write(const void *data, size_t len) { return ESP_FAIL; }
+
+esp_err_t ota_end(const uint8_t expected[OTA_SHA256_LEN]) { return ESP_FAIL; }
+
+void ota_abort(void) {}
+
+void ota_get_stats(ota_stats_t *out) { memset(out, 0, sizeof(*out)); }
+
+void ota_reboot_later(void) {}
+
+void telemetry_get_stats(telemetry_stats_t *out) {
+  memset(out, 0, sizeof(*out));
+}
+
+const task_def_t *task_table_find(const char *name) { return NULL; }
+
+bool boot_init_get(boot_prof_t *out, bool previous) { return false; }
+
+void events_get_stats(events_stats_t *out) { memset(out, 0, sizeof(*out)); }
+
+esp_err_t events_subscribe(httpd_req_t *req) {
+  return httpd_resp_send(req, "", 0);
+}
+
+size_t trace_dump_size(void) { return 0; }
+
+size_t trace_dump(uint8_t *buf, size_t len) { return 0; }
+
+size_t trace_task_stats(char *buf, size_t len) { return 0; }
+
+static void check_parse(void) {
+  uint8_t r = 1;
+  uint8_t g = 2;
+  uint8_t b = 3;
+  check(color_parse_json("{\"r\":12,\"g\":200,\"b\":64}", &r, &g, &b) &&
+          r == 12 && g == 200 && b == 64,
+    "color");
+  check(color_parse_json("{\"b\":255,\"r\":0,\"g\":0,\"x\":1}", &r, &g, &b) &&
+          r == 0 && g == 0 && b == 255,
+    "color in any order");
+  const char *bad[] = {
+    "",
+    "{",
+    "[]",
+    "{\"r\":1,\"g\":2}",
+    "{\"r\":1,\"g\":2,\"b\":256}",
+    "{\"r\":-1,\"g\":2,\"b\":3}",
+    "{\"r\":\"1\",\"g\":2,\"b\":3}",
+    "{\"r\":null,\"g\":2,\"b\":3}",
+  };
+  for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+    check(!color_parse_json(bad[i], &r, &g, &b), bad[i]);
+  }
+
+  sync_effect_t fx;
+  check(color_parse_effect_json(
+          "{\"fx\":\"pulse\",\"a\":[255,0,0],\"b\":[0,0,255],"
+          "\"period_ms\":2000}",
+          &fx) &&
+          fx.type == SYNC_FX_PULSE && fx.a[0] == 255 && fx.b[2] == 255 &&
+          fx.period_ms == 2000,
+    "effect");
+  check(color_parse_effect_json("{\"fx\":\"pulse\",\"a\":[1,2,3]}", &fx) &&
+          fx.b[0] == 0 && fx.period_ms == 1000,
+    "effect defaults");
+  check(color_parse_effect_json(
+          "{\"fx\":\"pulse\",\"a\":[1,2,3],\"period_ms\":20}", &fx),
+    "shortest period");
+  check(!color_parse_effect_json(
+          "{\"fx\":\"pulse\",\"a\":[1,2,3],\"period_ms\":19}", &fx),
+    "period too short");
+  check(!color_parse_effect_json(
+          "{\"fx\":\"pulse\",\"a\":[1,2,3],\"period_ms\":3600001}", &fx),
+    "period too long");
+  check(!color_parse_effect_json("{\"fx\":\"strobe\",\"a\":[1,2,3]}", &fx),
+    "unknown effect");
+  check(!color_parse_effect_json("{\"fx\":\"pulse\",\"a\":[1,2]}", &fx),
+    "short color");
+}
+
+static int post(const char *uri, const char *body, fake_httpd_resp_t *resp) {
+  fake_httpd_req_t req = {.body = body};
+  if (fake_httpd_call(uri, HTTP_POST, &req, resp) != 0) {
+    return -1;
+  }
+  return resp->status;
+}
+
+static void check_handlers(void) {
+  fake_httpd_reset();
+  check(start_webserver() != NULL, "server start");
+  check(fake_httpd_failed_registrations() == 0, "handler not registered");
+  check(fake_httpd_handlers() == 9 &&
+          fake_httpd_config()->max_uri_handlers > fake_httpd_handlers(),
+    "no room for another handler");
+
+  fake_httpd_resp_t resp;
+  check(post("/api/color", "{\"r\":12,\"g\":200,\"b\":64}", &resp) == 200 &&
+          strcmp(resp.body, "OK") == 0 && resp.ret == ESP_OK,
+    "POST /api/color");
+  check(stub.submits == 1 && stub.rgb[0] == 12 && stub.rgb[1] == 200 &&
+          stub.rgb[2] == 64 && stub.reports == 1,
+    "color handed to the LED task");
+
+  check(post("/api/color", "{\"r\":12}", &resp) == 400 && resp.ret != ESP_OK,
+    "bad color");
+  check(post("/api/color", "", &resp) == 500, "empty body");
+  check(stub.submits == 1 && stub.reports == 1, "rejected color applied");
+
+  stub.busy = true;
+  check(post("/api/color", "{\"r\":1,\"g\":2,\"b\":3}", &resp) == 503 &&
+          strcmp(resp.body, "busy") == 0,
+    "full LED queue");
+  check(stub.reports == 1, "dropped color reported");
+  stub.busy = false;
+
+  const char *effect = "{\"fx\":\"pulse\",\"a\":[255,0,0]}";
+  stub.leader = false;
+  check(post("/api/sync", effect, &resp) == 409, "effect on a follower");
+  stub.leader = true;
+  check(post("/api/sync", effect, &resp) == 200 &&
+          stub.effect.type == SYNC_FX_PULSE && stub.effect.a[0] == 255,
+    "effect on the leader");
+  check(post("/api/sync", "{\"fx\":1}", &resp) == 400, "bad effect");
+
+  // registered last, the first to go missing when the table fills up
+  fake_httpd_req_t req = {0};
+  check(fake_httpd_call("/api/events", HTTP_GET, &req, &resp) == 0 &&
+          resp.ret == ESP_OK,
+    "GET /api/events");
+}
+
+static int post_ota(const char *auth, fake_httpd_resp_t *resp) {
+  fake_httpd_req_t req = {
+    .body = "image",
+    .hdr_name = auth ? "Authorization" : NULL,
+    .hdr_value = auth,
+  };
+  fake_httpd_call("/api/ota", HTTP_POST, &req, resp);
+  return resp->status;
+}
+
+// CONFIG_OTA_TOKEN is "host-token" in the fake sdkconfig
+static void check_ota_token(void) {
+  fake_httpd_resp_t resp;
+  check(post_ota(NULL, &resp) == 401, "upload without a token");
+  check(post_ota("Bearer nope", &resp) == 403, "wrong token");
+  check(post_ota("Bearer host-token2", &resp) == 403, "longer token");
+  check(post_ota("Bearer host-toke", &resp) == 403, "shorter token");
+  check(post_ota("Basic host-token", &resp) == 403, "other scheme");
+  check(post_ota("host-token", &resp) == 403, "no scheme");
+  check(stub.ota_begins == 0, "refused upload reached flash");
+  // the stub ota_begin refuses, the point is that it was asked
+  check(post_ota("Bearer host-token", &resp) == 500 && stub.ota_begins == 1,
+    "upload with the token");
+}
+
+static void bench_color_parse(void *ctx) {
+  uint8_t r, g, b;
+  color_parse_json(ctx, &r, &g, &b);
+}
+
+static void bench_color_handler(void *ctx) {
+  fake_httpd_resp_t resp;
+  post("/api/color", ctx, &resp);
+}
+
+static void run_benchmarks(void) {
+  bench_opts_t opts = {.warmup = 100, .iterations = 10000};
+  bench_result_t result;
+  char body[] = "{\"r\":12,\"g\":200,\"b\":64}";
+
+  bench_print_header();
+  if (bench_run("color_parse_json", bench_color_parse, body, &opts, &result) ==
+      0) {
+    bench_print(&result);
+  }
+  // the fake httpd costs next to nothing, this is parse plus the handler
+  if (bench_run("color_handler", bench_color_handler, body, &opts, &result) ==
+      0) {
+    bench_print(&result);
+  }
+}
+
+int main(void) {
+  check_parse();
+  check_handlers();
+  check_ota_token();
+  run_benchmarks();
+
+  printf("%s\n", failures ? "FAILED" : "ok");
+  return failures > 0;
+}
@@ -0,0 +1,85 @@
+/*
+  components/dht decode on its own: bit order and threshold, the checksum
+  including its wrap past 255, and what dht11_decode leaves alone on a bad
+  frame. the capture side is covered by dht_replay. exits 1 when a check
+  fails.
+*/
+#include "check.h"
+#include "dht11_decode.h"
+#include <string.h>
+
+static void pulses_for(const uint8_t data[DHT11_DATA_BYTES],
+  dht11_pulses_t *p) {
+  for (int i = 0; i < DHT11_DATA_BITS; i++) {
+    bool one = data[i / 8] & (0x80 >> (i % 8));
+    p->low[i] = 50;
+    p->high[i] = one ? 70 : 26;
+  }
+}
+
+static void check_bits(void) {
+  dht11_pulses_t p;
+  uint8_t data[DHT11_DATA_BYTES];
+  const uint8_t in[DHT11_DATA_BYTES] = {0x80, 0x01, 0xa5, 0x5a, 0xff};
+  pulses_for(in, &p);
+  memset(data, 0xee, sizeof(data));
+  dht11_decode_bits(&p, data);
+  check(memcmp(data, in, sizeof(in)) == 0, "bits are MSB first");
+
+  // a 1 needs its high phase longer than the low before it
+  for (int i = 0; i < DHT11_DATA_BITS; i++) {
+    p.low[i] = 48;
+    p.high[i] = i < 8 ? 48 : 49;
+  }
+  dht11_decode_bits(&p, data);
+  check(data[0] == 0x00 && data[1] == 0xff, "threshold");
+}
+
+static void check_checksum(void) {
+  const uint8_t ok[] = {45, 0, 23, 0, 68};
+  const uint8_t wrap[] = {200, 0, 100, 0, 44};
+  const uint8_t off[] = {45, 0, 23, 0, 69};
+  const uint8_t zero[] = {0, 0, 0, 0, 0};
+  check(dht11_checksum_ok(ok), "checksum");
+  check(dht11_checksum_ok(wrap), "checksum past 255");
+  check(!dht11_checksum_ok(off), "bad checksum accepted");
+  check(dht11_checksum_ok(zero), "all zero frame");
+}
+
+static void check_decode(void) {
+  dht11_pulses_t p;
+  int16_t hum = -1;
+  int16_t temp = -1;
+
+  // the DHT11 sends whole units, the decimal bytes are ignored
+  const uint8_t frame[] = {45, 7, 23, 9, 84};
+  pulses_for(frame, &p);
+  check(dht11_decode(&p, &hum, &temp) && hum == 450 && temp == 230,
+    "decode");
+
+  const uint8_t max[] = {255, 0, 255, 0, 254};
+  pulses_for(max, &p);
+  check(dht11_decode(&p, &hum, &temp) && hum == 2550 && temp == 2550,
+    "largest bytes");
+
+  hum = -1;
+  temp = -1;
+  const uint8_t bad[] = {45, 0, 23, 0, 0};
+  pulses_for(bad, &p);
+  check(!dht11_decode(&p, &hum, &temp), "bad frame decoded");
+  check(hum == -1 && temp == -1, "bad frame wrote the outputs");
+
+  pulses_for(frame, &p);
+  check(dht11_decode(&p, NULL, &temp) && temp == 230, "temperature only");
+  check(dht11_decode(&p, &hum, NULL) && hum == 450, "humidity only");
+  check(dht11_decode(&p, NULL, NULL), "checksum only");
+}
+
+int main(void) {
+  check_bits();
+  check_checksum();
+  check_decode();
+
+  printf("%s\n", failures ? "FAILED" : "ok");
+  return failures > 0;
+}
@@ -0,0 +1,296 @@
+/*
+  components/dht on the host: dht_read() bit-bangs a fake GPIO with a DHT11
+  model on the other end that plays a pulse trace once the start signal is
+  over. time is the fake clock, so a trace replays the same on every run.
+
+  frames built from the datasheet timings (nominal and with jitter on every
+  bit), a corrupted frame, a missing and a stalled sensor, then every trace
+  file given on the command line. a trace file holds one "<level> <us>"
+  segment per line from the moment the host releases the line, and a
+  "# expect <humidity> <temperature>" line in tenths, see traces/.
+
+    ./dht_replay                           # built frames only
+    ./dht_replay traces/dht11_45rh_23c.txt
+
+  also times dht11_decode and a whole replayed read, the BENCH names match
+  the temp_humid ones. exits 1 when a check fails, 2 on a bad trace file.
+*/
+#include "bench.h"
+#include "check.h"
+#include "dht.h"
+#include "dht11_decode.h"
+#include "fake.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define PIN 4
+#define TRACE_MAX 128
+// the host has to hold the line low for 18 ms before the sensor answers
+#define START_LOW_US 18000
+#define RANDOM_FRAMES 500
+#define JITTER_US 4
+
+typedef struct {
+  uint8_t level[TRACE_MAX];
+  uint32_t us[TRACE_MAX];
+  int len;
+} trace_t;
+
+typedef struct {
+  const trace_t *trace;
+  int64_t low_since; // -1 while the host leaves the line alone
+  int64_t start_us;  // -1 until a start signal
+} sensor_t;
+
+static void sensor_write(void *ctx, int level, int64_t now_us) {
+  sensor_t *s = ctx;
+  if (level == 0) {
+    if (s->low_since < 0) {
+      s->low_since = now_us;
+    }
+    return;
+  }
+  if (s->low_since >= 0 && now_us - s->low_since >= START_LOW_US) {
+    s->start_us = now_us;
+  }
+  s->low_since = -1;
+}
+
+static int sensor_read(void *ctx, int64_t now_us) {
+  sensor_t *s = ctx;
+  if (s->trace == NULL || s->start_us < 0) {
+    return 1;
+  }
+  int64_t t = now_us - s->start_us;
+  for (int i = 0; i < s->trace->len; i++) {
+    if (t < s->trace->us[i]) {
+      return s->trace->level[i];
+    }
+    t -= s->trace->us[i];
+  }
+  return 1; // pull-up after the frame
+}
+
+static sensor_t sensor;
+
+static void attach(const trace_t *trace) {
+  sensor = (sensor_t){.trace = trace, .low_since = -1, .start_us = -1};
+  fake_gpio_dev_t dev = {
+    .write = sensor_write,
+    .read = sensor_read,
+    .ctx = &sensor,
+  };
+  fake_gpio_attach(PIN, &dev);
+}
+
+static void push(trace_t *t, int level, int us) {
+  if (t->len < TRACE_MAX) {
+    t->level[t->len] = (uint8_t)level;
+    t->us[t->len] = (uint32_t)us;
+    t->len++;
+  }
+}
+
+static int jitter(int range) {
+  return range ? rand() % (2 * range + 1) - range : 0;
+}
+
+// datasheet timings: 20-40 us until the response, 80 us low, 80 us high,
+// then 50 us low before each bit and 26-28 us high for a 0, 70 us for a 1
+static void build(trace_t *t, const uint8_t data[DHT11_DATA_BYTES], int jit) {
+  t->len = 0;
+  push(t, 1, 30);
+  push(t, 0, 80);
+  push(t, 1, 80);
+  for (int i = 0; i < DHT11_DATA_BITS; i++) {
+    bool one = data[i / 8] & (0x80 >> (i % 8));
+    push(t, 0, 50 + jitter(jit));
+    push(t, 1, (one ? 70 : 27) + jitter(jit));
+  }
+  push(t, 0, 50);
+}
+
+static void frame(uint8_t hum, uint8_t temp, uint8_t data[DHT11_DATA_BYTES]) {
+  data[0] = hum;
+  data[1] = 0;
+  data[2] = temp;
+  data[3] = 0;
+  data[4] = (uint8_t)(hum + temp);
+}
+
+static esp_err_t replay(const trace_t *trace, int16_t *hum, int16_t *temp) {
+  attach(trace);
+  // the driver only leaves the line released between reads
+  fake_clock_advance(1000000);
+  return dht_read(PIN, hum, temp);
+}
+
+static void check_frames(void) {
+  static const uint8_t cases[][2] = {
+    {45, 23},
+    {0, 0},
+    {20, 0},
+    {95, 50},
+    {255, 255},
+  };
+  trace_t t;
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    uint8_t data[DHT11_DATA_BYTES];
+    frame(cases[i][0], cases[i][1], data);
+    build(&t, data, 0);
+    int16_t hum = -1;
+    int16_t temp = -1;
+    esp_err_t err = replay(&t, &hum, &temp);
+    check(err == ESP_OK && hum == cases[i][0] * 10 && temp == cases[i][1] * 10,
+      "nominal frame");
+    check(fake_gpio_mode(PIN) == GPIO_MODE_OUTPUT_OD &&
+            fake_gpio_driven(PIN) == 1,
+      "line released after a read");
+  }
+
+  srand(1);
+  int bad = 0;
+  for (int i = 0; i < RANDOM_FRAMES; i++) {
+    uint8_t data[DHT11_DATA_BYTES];
+    frame((uint8_t)(rand() % 101), (uint8_t)(rand() % 51), data);
+    build(&t, data, JITTER_US);
+    int16_t hum;
+    int16_t temp;
+    if (replay(&t, &hum, &temp) != ESP_OK || hum != data[0] * 10 ||
+        temp != data[2] * 10) {
+      bad++;
+    }
+  }
+  check(bad == 0, "jittered frames");
+  printf("replay      %d frames with +-%d us on every bit, %d bad\n",
+    RANDOM_FRAMES,
+    JITTER_US,
+    bad);
+
+  // only one of the arguments wanted
+  uint8_t data[DHT11_DATA_BYTES];
+  frame(60, 21, data);
+  build(&t, data, 0);
+  int16_t temp = 0;
+  check(replay(&t, NULL, &temp) == ESP_OK && temp == 210, "temperature only");
+  check(dht_read(PIN, NULL, NULL) == ESP_ERR_INVALID_ARG, "no outputs");
+}
+
+static void check_failures(void) {
+  uint8_t data[DHT11_DATA_BYTES];
+  frame(45, 23, data);
+  trace_t t;
+  int16_t hum;
+  int16_t temp;
+
+  // bit 20 is in the temperature byte, a 0 stretched into a 1
+  build(&t, data, 0);
+  t.us[3 + 2 * 20 + 1] = 70;
+  check(replay(&t, &hum, &temp) == ESP_ERR_INVALID_CRC, "corrupt frame");
+
+  check(replay(NULL, &hum, &temp) == ESP_ERR_TIMEOUT, "no sensor");
+
+  build(&t, data, 0);
+  t.len = 3 + 2 * 30;
+  check(replay(&t, &hum, &temp) == ESP_ERR_TIMEOUT, "frame cut short");
+
+  // a 1 held high past the driver's window
+  build(&t, data, 0);
+  t.us[3 + 2 * 2 + 1] = 120;
+  check(replay(&t, &hum, &temp) == ESP_ERR_TIMEOUT, "stuck high");
+}
+
+// returns 0 when the file replays to its expected values, -1 when it can't
+// be read
+static int replay_file(const char *path) {
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    printf("can't open %s\n", path);
+    return -1;
+  }
+  trace_t t = {.len = 0};
+  int want_hum = -1;
+  int want_temp = -1;
+  char line[128];
+  while (fgets(line, sizeof(line), f)) {
+    int level;
+    int us;
+    if (sscanf(line, "# expect %d %d", &want_hum, &want_temp) == 2 ||
+        line[0] == '#' || line[0] == '\n') {
+      continue;
+    }
+    if (sscanf(line, "%d %d", &level, &us) != 2 || t.len >= TRACE_MAX) {
+      printf("%s: bad line %s", path, line);
+      fclose(f);
+      return -1;
+    }
+    push(&t, level != 0, us);
+  }
+  fclose(f);
+
+  int16_t hum = 0;
+  int16_t temp = 0;
+  esp_err_t err = replay(&t, &hum, &temp);
+  printf("trace       %s: error %d, %d.%d %%, %d.%d C\n",
+    path,
+    err,
+    hum / 10,
+    hum % 10,
+    temp / 10,
+    temp % 10);
+  check(err == ESP_OK && hum == want_hum && temp == want_temp, path);
+  return 0;
+}
+
+static void bench_decode(void *ctx) {
+  int16_t hum;
+  int16_t temp;
+  dht11_decode(ctx, &hum, &temp);
+}
+
+static void bench_read(void *ctx) {
+  int16_t hum;
+  int16_t temp;
+  replay(ctx, &hum, &temp);
+}
+
+static void run_benchmarks(void) {
+  // same frame as the temp_humid case
+  static const uint8_t data[DHT11_DATA_BYTES] = {45, 0, 23, 0, 68};
+  static dht11_pulses_t pulses;
+  for (int i = 0; i < DHT11_DATA_BITS; i++) {
+    bool one = data[i / 8] & (0x80 >> (i % 8));
+    pulses.low[i] = 50;
+    pulses.high[i] = one ? 70 : 26;
+  }
+  static trace_t t;
+  build(&t, data, 0);
+
+  bench_opts_t opts = {.warmup = 100, .iterations = 10000};
+  bench_result_t result;
+  bench_print_header();
+  if (bench_run("dht11_decode", bench_decode, &pulses, &opts, &result) == 0) {
+    bench_print(&result);
+  }
+  // the polling loop on the fake GPIO, not the 20 ms the sensor takes
+  if (bench_run("dht11_read", bench_read, &t, &opts, &result) == 0) {
+    bench_print(&result);
+  }
+}
+
+int main(int argc, char **argv) {
+  fake_gpio_reset();
+  fake_clock_reset();
+
+  check_frames();
+  check_failures();
+  for (int i = 1; i < argc; i++) {
+    if (replay_file(argv[i]) != 0) {
+      return 2;
+    }
+  }
+  run_benchmarks();
+
+  printf("%s\n", failures ? "FAILED" : "ok");
+  return failures > 0;
+}
@@ -0,0 +1,28 @@
+#include "esp32/rom/ets_sys.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "fake.h"
+
+static int64_t now_us = 0;
+
+int64_t fake_clock_us(void) { return now_us; }
+
+void fake_clock_advance(uint32_t us) { now_us += us; }
+
+void fake_clock_reset(void) { now_us = 0; }
+
+int64_t esp_timer_get_time(void) { return now_us; }
+
+void ets_delay_us(uint32_t us) { now_us += us; }
+
+// bit by bit version of the ROM table one, same results
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+  crc = ~crc;
+  for (uint32_t i = 0; i < len; i++) {
+    crc ^= buf[i];
+    for (int b = 0; b < 8; b++) {
+      crc = crc & 1 ? (crc >> 1) ^ 0xedb88320u : crc >> 1;
+    }
+  }
+  return ~crc;
+}
@@ -0,0 +1,95 @@
+#include "driver/gpio.h"
+#include "fake.h"
+#include <string.h>
+
+typedef struct {
+  gpio_mode_t mode;
+  int driven;
+  fake_gpio_dev_t dev;
+  bool attached;
+} pin_t;
+
+static pin_t pins[GPIO_NUM_MAX];
+
+static pin_t *get_pin(gpio_num_t num) {
+  return num >= 0 && num < GPIO_NUM_MAX ? &pins[num] : NULL;
+}
+
+void fake_gpio_reset(void) {
+  memset(pins, 0, sizeof(pins));
+  for (int i = 0; i < GPIO_NUM_MAX; i++) {
+    pins[i].driven = -1;
+  }
+}
+
+void fake_gpio_attach(gpio_num_t num, const fake_gpio_dev_t *dev) {
+  pin_t *pin = get_pin(num);
+  if (pin != NULL) {
+    pin->dev = *dev;
+    pin->attached = true;
+  }
+}
+
+gpio_mode_t fake_gpio_mode(gpio_num_t num) {
+  pin_t *pin = get_pin(num);
+  return pin ? pin->mode : GPIO_MODE_DISABLE;
+}
+
+int fake_gpio_driven(gpio_num_t num) {
+  pin_t *pin = get_pin(num);
+  return pin ? pin->driven : -1;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t num) {
+  pin_t *pin = get_pin(num);
+  if (pin == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  pin->mode = GPIO_MODE_DISABLE;
+  return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t num, gpio_mode_t mode) {
+  pin_t *pin = get_pin(num);
+  if (pin == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  pin->mode = mode;
+  return ESP_OK;
+}
+
+esp_err_t gpio_set_pull_mode(gpio_num_t num, gpio_pull_mode_t pull) {
+  return get_pin(num) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_set_level(gpio_num_t num, uint32_t level) {
+  pin_t *pin = get_pin(num);
+  if (pin == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  pin->driven = level ? 1 : 0;
+  if (pin->attached && pin->dev.write) {
+    pin->dev.write(pin->dev.ctx, pin->driven, fake_clock_us());
+  }
+  return ESP_OK;
+}
+
+// an output drives the line, open drain only pulls it low. the input path
+// reads the line as the IDF driver does
+int gpio_get_level(gpio_num_t num) {
+  pin_t *pin = get_pin(num);
+  if (pin == NULL) {
+    return 0;
+  }
+  bool output = pin->mode == GPIO_MODE_OUTPUT ||
+                pin->mode == GPIO_MODE_INPUT_OUTPUT;
+  bool od = pin->mode == GPIO_MODE_OUTPUT_OD ||
+            pin->mode == GPIO_MODE_INPUT_OUTPUT_OD;
+  if (output || (od && pin->driven == 0)) {
+    return pin->driven == 1;
+  }
+  if (pin->attached && pin->dev.read) {
+    return pin->dev.read(pin->dev.ctx, fake_clock_us());
+  }
+  return 1; // pulled up
+}
@@ -0,0 +1,202 @@
+#include "esp_http_server.h"
+#include "fake.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define MAX_HANDLERS 32
+
+typedef struct {
+  const fake_httpd_req_t *in;
+  size_t pos;
+  fake_httpd_resp_t *out;
+} session_t;
+
+static httpd_config_t config;
+static bool running;
+static httpd_uri_t handlers[MAX_HANDLERS];
+static int handler_count;
+static int failed;
+
+void fake_httpd_reset(void) {
+  running = false;
+  handler_count = 0;
+  failed = 0;
+}
+
+int fake_httpd_handlers(void) { return handler_count; }
+
+int fake_httpd_failed_registrations(void) { return failed; }
+
+const httpd_config_t *fake_httpd_config(void) { return &config; }
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *cfg) {
+  if (running) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  config = *cfg;
+  running = true;
+  handler_count = 0;
+  failed = 0;
+  *handle = &config;
+  return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle) {
+  running = false;
+  return ESP_OK;
+}
+
+// same checks and errors as the real one, including the max_uri_handlers
+// limit that makes late registrations fail
+esp_err_t httpd_register_uri_handler(
+  httpd_handle_t handle, const httpd_uri_t *uri_handler) {
+  if (handle == NULL || uri_handler == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  for (int i = 0; i < handler_count; i++) {
+    if (handlers[i].method == uri_handler->method &&
+        strcmp(handlers[i].uri, uri_handler->uri) == 0) {
+      failed++;
+      return ESP_ERR_HTTPD_HANDLER_EXISTS;
+    }
+  }
+  if (handler_count >= config.max_uri_handlers ||
+      handler_count >= MAX_HANDLERS) {
+    failed++;
+    return ESP_ERR_HTTPD_HANDLERS_FULL;
+  }
+  handlers[handler_count++] = *uri_handler;
+  return ESP_OK;
+}
+
+int fake_httpd_call(const char *uri, httpd_method_t method,
+  const fake_httpd_req_t *in, fake_httpd_resp_t *out) {
+  const httpd_uri_t *h = NULL;
+  for (int i = 0; i < handler_count && h == NULL; i++) {
+    if (handlers[i].method == method && strcmp(handlers[i].uri, uri) == 0) {
+      h = &handlers[i];
+    }
+  }
+  if (h == NULL) {
+    return -1;
+  }
+
+  memset(out, 0, sizeof(*out));
+  out->status = 200;
+  session_t session = {.in = in, .out = out};
+  httpd_req_t req = {
+    .handle = &config,
+    .method = method,
+    .content_len = in->body ? strlen(in->body) : 0,
+    .aux = &session,
+    .user_ctx = h->user_ctx,
+  };
+  strncpy(req.uri, uri, sizeof(req.uri) - 1);
+  out->ret = h->handler(&req);
+  return 0;
+}
+
+static session_t *get_session(httpd_req_t *r) { return r->aux; }
+
+int httpd_req_recv(httpd_req_t *r, char *buf, size_t buf_len) {
+  session_t *s = get_session(r);
+  size_t left = r->content_len - s->pos;
+  if (left == 0) {
+    return 0;
+  }
+  size_t n = left < buf_len ? left : buf_len;
+  if (s->in->recv_max && n > s->in->recv_max) {
+    n = s->in->recv_max;
+  }
+  memcpy(buf, s->in->body + s->pos, n);
+  s->pos += n;
+  return (int)n;
+}
+
+size_t httpd_req_get_hdr_value_len(httpd_req_t *r, const char *field) {
+  session_t *s = get_session(r);
+  if (s->in->hdr_name == NULL || strcasecmp(s->in->hdr_name, field) != 0) {
+    return 0;
+  }
+  return strlen(s->in->hdr_value);
+}
+
+esp_err_t httpd_req_get_hdr_value_str(
+  httpd_req_t *r, const char *field, char *val, size_t val_size) {
+  session_t *s = get_session(r);
+  if (s->in->hdr_name == NULL || strcasecmp(s->in->hdr_name, field) != 0) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  size_t len = strlen(s->in->hdr_value);
+  if (val_size == 0) {
+    return ESP_ERR_HTTPD_RESULT_TRUNC;
+  }
+  strncpy(val, s->in->hdr_value, val_size - 1);
+  val[val_size - 1] = '\0';
+  return len < val_size ? ESP_OK : ESP_ERR_HTTPD_RESULT_TRUNC;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status) {
+  get_session(r)->out->status = atoi(status);
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type) {
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(
+  httpd_req_t *r, const char *field, const char *value) {
+  return ESP_OK;
+}
+
+static void append(fake_httpd_resp_t *out, const char *buf, ssize_t len) {
+  if (len == HTTPD_RESP_USE_STRLEN) {
+    len = (ssize_t)strlen(buf);
+  }
+  size_t room = sizeof(out->body) - 1 - out->len;
+  size_t n = (size_t)len < room ? (size_t)len : room;
+  memcpy(out->body + out->len, buf, n);
+  out->len += n;
+  out->body[out->len] = '\0';
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len) {
+  fake_httpd_resp_t *out = get_session(r)->out;
+  if (out->sent) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  append(out, buf, buf_len);
+  out->sent = true;
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_chunk(
+  httpd_req_t *r, const char *buf, ssize_t buf_len) {
+  fake_httpd_resp_t *out = get_session(r)->out;
+  if (buf == NULL) {
+    out->sent = true;
+  } else {
+    append(out, buf, buf_len);
+  }
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_err(
+  httpd_req_t *r, httpd_err_code_t error, const char *msg) {
+  static const int status[] = {
+    [HTTPD_500_INTERNAL_SERVER_ERROR] = 500,
+    [HTTPD_400_BAD_REQUEST] = 400,
+    [HTTPD_401_UNAUTHORIZED] = 401,
+    [HTTPD_403_FORBIDDEN] = 403,
+    [HTTPD_404_NOT_FOUND] = 404,
+    [HTTPD_408_REQ_TIMEOUT] = 408,
+  };
+  get_session(r)->out->status = status[error];
+  return httpd_resp_send(r, msg ? msg : "", HTTPD_RESP_USE_STRLEN);
+}
+
+esp_err_t httpd_resp_send_500(httpd_req_t *r) {
+  return httpd_resp_send_err(r, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+}
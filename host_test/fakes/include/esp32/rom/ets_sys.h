@@ -0,0 +1,9 @@
+#ifndef ETS_SYS_H
+#define ETS_SYS_H
+
+#include <stdint.h>
+
+// advances the fake clock instead of spinning
+void ets_delay_us(uint32_t us);
+
+#endif
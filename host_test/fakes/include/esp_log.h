@@ -0,0 +1,34 @@
+#ifndef ESP_LOG_H
+#define ESP_LOG_H
+
+#include <stdio.h>
+
+// errors and warnings go to stderr. info is dropped too, the hot paths log
+// at info and would swamp the timed runs
+typedef enum {
+  ESP_LOG_NONE,
+  ESP_LOG_ERROR,
+  ESP_LOG_WARN,
+  ESP_LOG_INFO,
+  ESP_LOG_DEBUG,
+  ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+#define ESP_LOG_HOST(letter, tag, fmt, ...)                                   \
+  fprintf(stderr, letter " (%s) " fmt "\n", (tag), ##__VA_ARGS__)
+
+// still type checks the arguments
+#define ESP_LOG_DROP(tag, fmt, ...)                                           \
+  do {                                                                        \
+    if (0) {                                                                  \
+      ESP_LOG_HOST("", tag, fmt, ##__VA_ARGS__);                              \
+    }                                                                         \
+  } while (0)
+
+#define ESP_LOGE(tag, fmt, ...) ESP_LOG_HOST("E", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) ESP_LOG_HOST("W", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) ESP_LOG_DROP(tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) ESP_LOG_DROP(tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...) ESP_LOG_DROP(tag, fmt, ##__VA_ARGS__)
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef FAKE_H
+#define FAKE_H
+
+#include "driver/gpio.h"
+#include "driver/ledc.h"
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  test side of the fake IDF layers in fakes/. time only moves when the code
+  under test calls ets_delay_us() or a test calls fake_clock_advance(), so a
+  pulse trace replays the same way on every run however fast the host is.
+*/
+
+// clock behind esp_timer_get_time() and ets_delay_us()
+int64_t fake_clock_us(void);
+void fake_clock_advance(uint32_t us);
+void fake_clock_reset(void);
+
+// something wired to a pin. write sees every level the code drives, read
+// returns the line level while the pin is not driven low
+typedef struct {
+  void (*write)(void *ctx, int level, int64_t now_us);
+  int (*read)(void *ctx, int64_t now_us);
+  void *ctx;
+} fake_gpio_dev_t;
+
+void fake_gpio_reset(void);
+void fake_gpio_attach(gpio_num_t pin, const fake_gpio_dev_t *dev);
+gpio_mode_t fake_gpio_mode(gpio_num_t pin);
+// last level the code drove, -1 if it never did
+int fake_gpio_driven(gpio_num_t pin);
+
+// duty as of the last ledc_update_duty, what the pin actually outputs
+uint32_t fake_ledc_output(ledc_channel_t channel);
+int fake_ledc_gpio(ledc_channel_t channel);
+uint32_t fake_ledc_updates(void);
+void fake_ledc_reset(void);
+
+// nvs_set_blob writes go to RAM and survive until fake_nvs_reset(), so a
+// test can "reboot" by loading again. fail makes the next writes return err
+void fake_nvs_reset(void);
+void fake_nvs_fail_writes(esp_err_t err);
+uint32_t fake_nvs_commits(void);
+
+// one request through a handler registered with httpd_register_uri_handler
+typedef struct {
+  const char *body;
+  const char *hdr_name; // one request header, optional
+  const char *hdr_value;
+  // recv returns at most this many bytes per call, 0 for no limit
+  size_t recv_max;
+} fake_httpd_req_t;
+
+typedef struct {
+  esp_err_t ret; // what the handler returned
+  int status;    // 200 unless set_status or send_err said otherwise
+  char body[512];
+  size_t len;
+  bool sent;
+} fake_httpd_resp_t;
+
+void fake_httpd_reset(void);
+// registered handlers, and the result of every registration attempt
+int fake_httpd_handlers(void);
+int fake_httpd_failed_registrations(void);
+const httpd_config_t *fake_httpd_config(void);
+// -1 when nothing is registered for uri and method
+int fake_httpd_call(const char *uri, httpd_method_t method,
+  const fake_httpd_req_t *req, fake_httpd_resp_t *resp);
+
+#endif
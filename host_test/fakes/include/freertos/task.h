@@ -0,0 +1,14 @@
+#ifndef FREERTOS_TASK_H
+#define FREERTOS_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+typedef struct {
+  int unused;
+} StaticTask_t;
+typedef StaticTask_t *TaskHandle_t;
+
+#define tskNO_AFFINITY 0x7fffffff
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef SDKCONFIG_H
+#define SDKCONFIG_H
+
+// the Kconfig defaults of the components built on the host. tracing and the
+// deferred log are off so their macros fall back to nothing and ESP_LOG
+
+#define CONFIG_TRACE_ENABLE 0
+#define CONFIG_DLOG_ENABLE 0
+#define CONFIG_TASK_PARTITION_CORES 1
+
+#define CONFIG_MOTOR_AIN1_GPIO 26
+#define CONFIG_MOTOR_AIN2_GPIO 25
+#define CONFIG_MOTOR_BIN1_GPIO 4
+#define CONFIG_MOTOR_BIN2_GPIO 16
+#define CONFIG_MOTOR_STBY_GPIO 14
+
+#define CONFIG_OTA_TOKEN "host-token"
+
+#define CONFIG_LED_SYNC_ENABLE 1
+#define CONFIG_LED_R_GPIO 23
+#define CONFIG_LED_G_GPIO 22
+#define CONFIG_LED_B_GPIO 21
+
+#endif
@@ -0,0 +1,73 @@
+#include "driver/ledc.h"
+#include "fake.h"
+#include <string.h>
+
+typedef struct {
+  int gpio;
+  uint32_t pending;
+  uint32_t output;
+} channel_t;
+
+static channel_t channels[LEDC_CHANNEL_MAX];
+static uint32_t updates;
+
+void fake_ledc_reset(void) {
+  memset(channels, 0, sizeof(channels));
+  for (int i = 0; i < LEDC_CHANNEL_MAX; i++) {
+    channels[i].gpio = -1;
+  }
+  updates = 0;
+}
+
+uint32_t fake_ledc_output(ledc_channel_t channel) {
+  return channel < LEDC_CHANNEL_MAX ? channels[channel].output : 0;
+}
+
+int fake_ledc_gpio(ledc_channel_t channel) {
+  return channel < LEDC_CHANNEL_MAX ? channels[channel].gpio : -1;
+}
+
+uint32_t fake_ledc_updates(void) { return updates; }
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t *timer_conf) {
+  if (timer_conf->timer_num >= LEDC_TIMER_MAX ||
+      timer_conf->duty_resolution >= LEDC_TIMER_BIT_MAX ||
+      timer_conf->freq_hz == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  return ESP_OK;
+}
+
+esp_err_t ledc_channel_config(const ledc_channel_config_t *ledc_conf) {
+  if (ledc_conf->channel >= LEDC_CHANNEL_MAX ||
+      ledc_conf->timer_sel >= LEDC_TIMER_MAX) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  channel_t *ch = &channels[ledc_conf->channel];
+  ch->gpio = ledc_conf->gpio_num;
+  ch->pending = ledc_conf->duty;
+  ch->output = ledc_conf->duty;
+  return ESP_OK;
+}
+
+esp_err_t ledc_set_duty(
+  ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t duty) {
+  if (speed_mode >= LEDC_SPEED_MODE_MAX || channel >= LEDC_CHANNEL_MAX) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  channels[channel].pending = duty;
+  return ESP_OK;
+}
+
+esp_err_t ledc_update_duty(ledc_mode_t speed_mode, ledc_channel_t channel) {
+  if (speed_mode >= LEDC_SPEED_MODE_MAX || channel >= LEDC_CHANNEL_MAX) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  channels[channel].output = channels[channel].pending;
+  updates++;
+  return ESP_OK;
+}
+
+uint32_t ledc_get_duty(ledc_mode_t speed_mode, ledc_channel_t channel) {
+  return channel < LEDC_CHANNEL_MAX ? channels[channel].output : 0;
+}
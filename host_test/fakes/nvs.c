@@ -0,0 +1,174 @@
+#include "fake.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_NAMESPACES 8
+#define MAX_ENTRIES 32
+#define NAME_MAX_LEN 15
+
+// the partition: namespaces and blobs, kept across nvs_open calls
+typedef struct {
+  char ns[NAME_MAX_LEN + 1];
+  char key[NAME_MAX_LEN + 1];
+  uint8_t *value;
+  size_t len;
+} entry_t;
+
+static char namespaces[MAX_NAMESPACES][NAME_MAX_LEN + 1];
+static entry_t entries[MAX_ENTRIES];
+static bool initialized;
+static esp_err_t write_err = ESP_OK;
+static uint32_t commits;
+
+// handle is the namespace index + 1, the top bit marks read write
+#define HANDLE_RW 0x80000000u
+
+void fake_nvs_reset(void) {
+  for (int i = 0; i < MAX_ENTRIES; i++) {
+    free(entries[i].value);
+  }
+  memset(entries, 0, sizeof(entries));
+  memset(namespaces, 0, sizeof(namespaces));
+  initialized = false;
+  write_err = ESP_OK;
+  commits = 0;
+}
+
+void fake_nvs_fail_writes(esp_err_t err) { write_err = err; }
+
+uint32_t fake_nvs_commits(void) { return commits; }
+
+esp_err_t nvs_flash_init(void) {
+  initialized = true;
+  return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void) {
+  fake_nvs_reset();
+  return ESP_OK;
+}
+
+static const char *handle_ns(nvs_handle_t handle) {
+  uint32_t i = (handle & ~HANDLE_RW) - 1;
+  return i < MAX_NAMESPACES && namespaces[i][0] ? namespaces[i] : NULL;
+}
+
+static entry_t *find(const char *ns, const char *key) {
+  for (int i = 0; i < MAX_ENTRIES; i++) {
+    if (entries[i].value && strcmp(entries[i].ns, ns) == 0 &&
+        strcmp(entries[i].key, key) == 0) {
+      return &entries[i];
+    }
+  }
+  return NULL;
+}
+
+esp_err_t nvs_open(
+  const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle) {
+  if (!initialized) {
+    return ESP_ERR_NVS_NOT_INITIALIZED;
+  }
+  if (strlen(name) > NAME_MAX_LEN) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  int free_slot = -1;
+  for (int i = 0; i < MAX_NAMESPACES; i++) {
+    if (strcmp(namespaces[i], name) == 0) {
+      *out_handle = (uint32_t)(i + 1) | (open_mode ? HANDLE_RW : 0);
+      return ESP_OK;
+    }
+    if (free_slot < 0 && namespaces[i][0] == '\0') {
+      free_slot = i;
+    }
+  }
+  // as on flash, a namespace only exists once opened for writing
+  if (open_mode == NVS_READONLY) {
+    return ESP_ERR_NVS_NOT_FOUND;
+  }
+  if (free_slot < 0) {
+    return ESP_ERR_NVS_NO_FREE_PAGES;
+  }
+  strcpy(namespaces[free_slot], name);
+  *out_handle = (uint32_t)(free_slot + 1) | HANDLE_RW;
+  return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) { (void)handle; }
+
+esp_err_t nvs_get_blob(
+  nvs_handle_t handle, const char *key, void *out_value, size_t *length) {
+  const char *ns = handle_ns(handle);
+  if (ns == NULL) {
+    return ESP_ERR_NVS_INVALID_HANDLE;
+  }
+  entry_t *e = find(ns, key);
+  if (e == NULL) {
+    return ESP_ERR_NVS_NOT_FOUND;
+  }
+  if (out_value == NULL) {
+    *length = e->len;
+    return ESP_OK;
+  }
+  if (*length < e->len) {
+    *length = e->len;
+    return ESP_ERR_INVALID_SIZE;
+  }
+  memcpy(out_value, e->value, e->len);
+  *length = e->len;
+  return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(
+  nvs_handle_t handle, const char *key, const void *value, size_t length) {
+  const char *ns = handle_ns(handle);
+  if (ns == NULL || !(handle & HANDLE_RW)) {
+    return ESP_ERR_NVS_INVALID_HANDLE;
+  }
+  if (write_err != ESP_OK) {
+    return write_err;
+  }
+  entry_t *e = find(ns, key);
+  for (int i = 0; e == NULL && i < MAX_ENTRIES; i++) {
+    if (entries[i].value == NULL) {
+      e = &entries[i];
+      strcpy(e->ns, ns);
+      strncpy(e->key, key, NAME_MAX_LEN);
+    }
+  }
+  if (e == NULL) {
+    return ESP_ERR_NVS_NO_FREE_PAGES;
+  }
+  uint8_t *copy = malloc(length ? length : 1);
+  if (copy == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  memcpy(copy, value, length);
+  free(e->value);
+  e->value = copy;
+  e->len = length;
+  return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key) {
+  const char *ns = handle_ns(handle);
+  if (ns == NULL || !(handle & HANDLE_RW)) {
+    return ESP_ERR_NVS_INVALID_HANDLE;
+  }
+  entry_t *e = find(ns, key);
+  if (e == NULL) {
+    return ESP_ERR_NVS_NOT_FOUND;
+  }
+  free(e->value);
+  memset(e, 0, sizeof(*e));
+  return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+  if (handle_ns(handle) == NULL || !(handle & HANDLE_RW)) {
+    return ESP_ERR_NVS_INVALID_HANDLE;
+  }
+  commits++;
+  return ESP_OK;
+}
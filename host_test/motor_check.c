@@ -0,0 +1,140 @@
+/*
+  components/motor hardware independent parts: motor_mix channel duties for
+  every speed, motor_curve_check limits field by field and a few exact
+  motor_curve_build points. the curve shape over a sweep of calibrations is
+  rc_car/tools/rc_curve, which ctest runs as well. exits 1 when a check
+  fails.
+*/
+#include "check.h"
+#include "motor_curve.h"
+#include "motor_mix.h"
+#include <stdlib.h>
+
+static void check_mix(void) {
+  int bad = 0;
+  for (int speed = -400; speed <= 400; speed++) {
+    uint32_t duty[MOTOR_CHANNELS];
+    motor_mix(speed, duty);
+    int s = speed > MOTOR_SPEED_MAX    ? MOTOR_SPEED_MAX
+            : speed < -MOTOR_SPEED_MAX ? -MOTOR_SPEED_MAX
+                                       : speed;
+    uint32_t fwd = s > 0 ? (uint32_t)s : 0;
+    uint32_t rev = s < 0 ? (uint32_t)-s : 0;
+    // IN1 forward, IN2 reverse, never both on one bridge
+    if (duty[0] != fwd || duty[1] != rev || duty[2] != fwd ||
+        duty[3] != rev) {
+      bad++;
+    }
+  }
+  check(bad == 0, "motor_mix duties");
+
+  uint32_t duty[MOTOR_CHANNELS] = {1, 1, 1, 1};
+  motor_mix(0, duty);
+  check(duty[0] == 0 && duty[1] == 0 && duty[2] == 0 && duty[3] == 0,
+    "stop leaves a channel on");
+
+  motor_mix_ab(100, -300, duty);
+  check(duty[0] == 100 && duty[1] == 0 && duty[2] == 0 && duty[3] == 255,
+    "separate motors");
+  motor_mix_ab(-1, 1, duty);
+  check(duty[0] == 0 && duty[1] == 1 && duty[2] == 1 && duty[3] == 0,
+    "smallest speeds");
+}
+
+static void check_limits(void) {
+  const motor_curve_t linear = MOTOR_CURVE_LINEAR;
+  check(motor_curve_check(&linear) == 0, "linear curve rejected");
+
+  motor_curve_t c = linear;
+  c.deadzone = 100;
+  c.expo = 100;
+  c.trim = 50;
+  c.reverse = 1;
+  check(motor_curve_check(&c) == 0, "upper limits rejected");
+  c.trim = -50;
+  c.min_duty = c.max_duty;
+  check(motor_curve_check(&c) == 0, "lower limits rejected");
+
+  struct {
+    motor_curve_t curve;
+    const char *what;
+  } bad[] = {
+    {linear, "deadzone 101"},
+    {linear, "expo 101"},
+    {linear, "min over max"},
+    {linear, "trim 51"},
+    {linear, "trim -51"},
+    {linear, "reverse 2"},
+  };
+  bad[0].curve.deadzone = 101;
+  bad[1].curve.expo = 101;
+  bad[2].curve.min_duty = 200;
+  bad[2].curve.max_duty = 199;
+  bad[3].curve.trim = 51;
+  bad[4].curve.trim = -51;
+  bad[5].curve.reverse = 2;
+  for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+    check(motor_curve_check(&bad[i].curve) != 0, bad[i].what);
+  }
+}
+
+static void check_points(void) {
+  int16_t lut[MOTOR_CURVE_LEN];
+  const motor_curve_t linear = MOTOR_CURVE_LINEAR;
+  motor_curve_build(&linear, lut);
+  int bad = 0;
+  for (int raw = 0; raw < MOTOR_CURVE_LEN; raw++) {
+    int old = (raw - MOTOR_CURVE_CENTER) * 2;
+    if (lut[raw] != (old > MOTOR_SPEED_MAX ? MOTOR_SPEED_MAX : old)) {
+      bad++;
+    }
+  }
+  check(bad == 0, "linear curve differs from the old mapping");
+
+  // half stick is 127 before shaping, full cubic is an eighth of that
+  motor_curve_t c = linear;
+  c.expo = 100;
+  motor_curve_build(&c, lut);
+  int half = MOTOR_CURVE_CENTER + 64;
+  check(lut[half] == 32 && lut[255] == 255, "cubic points");
+
+  c = linear;
+  c.min_duty = 60;
+  c.max_duty = 200;
+  c.deadzone = 10;
+  motor_curve_build(&c, lut);
+  // the old scale stops at -254 in reverse, one short of full
+  check(lut[MOTOR_CURVE_CENTER + 10] == 0 &&
+          lut[MOTOR_CURVE_CENTER + 11] >= 60 && lut[255] == 200 &&
+          lut[0] == -199,
+    "deadzone and duty range");
+
+  int16_t rev[MOTOR_CURVE_LEN];
+  c.reverse = 1;
+  motor_curve_build(&c, rev);
+  bad = 0;
+  for (int raw = 0; raw < MOTOR_CURVE_LEN; raw++) {
+    if (rev[raw] != -lut[raw]) {
+      bad++;
+    }
+  }
+  check(bad == 0, "reverse is not the mirror");
+
+  // trim scales the whole table, full command stays within the PWM range
+  c.reverse = 0;
+  c.trim = 10;
+  motor_curve_build(&c, lut);
+  check(lut[255] == 220, "trim at full command");
+  c.max_duty = 255;
+  motor_curve_build(&c, lut);
+  check(lut[255] == MOTOR_SPEED_MAX, "trim past the PWM range");
+}
+
+int main(void) {
+  check_mix();
+  check_limits();
+  check_points();
+
+  printf("%s\n", failures ? "FAILED" : "ok");
+  return failures > 0;
+}
@@ -0,0 +1,275 @@
+/*
+  the rc_car motor path on the host: a characteristic write through
+  rc_cmd_parse, the rc_cal tables and components/motor down to fake LEDC
+  channels, with the calibration stored in a fake NVS the way the car does.
+
+  checks the payload checks, every command byte against motor_mix_ab of the
+  table speeds as the channels output them, and that a calibration is
+  written once, survives a reboot, keeps driving when flash fails and reaches
+  the control loop after two changes in a row.
+  also times the path with the rc_car BENCH names. exits 1 when a check
+  fails.
+*/
+#include "bench.h"
+#include "check.h"
+#include "fake.h"
+#include "motor.h"
+#include "rc_cal.h"
+#include "rc_cmd.h"
+#include "rc_rec.h"
+#include "settings.h"
+#include "sdkconfig.h"
+#include <string.h>
+
+static const ledc_channel_t channels[MOTOR_CHANNELS] = {
+  LEDC_CHANNEL_0,
+  LEDC_CHANNEL_1,
+  LEDC_CHANNEL_2,
+  LEDC_CHANNEL_3,
+};
+
+static int cal_records;
+
+// the recorder only needs to know the tables changed
+void rc_rec_cal(const motor_curve_t curve[RC_REC_MOTORS]) { cal_records++; }
+
+// what rc_ctl does with a command, returns -1 for a rejected write
+static int write_cmd(const uint8_t *buf, uint16_t len) {
+  rc_cmd_t cmd;
+  if (rc_cmd_parse(buf, len, &cmd) != 0) {
+    return -1;
+  }
+  const rc_lut_t *lut = rc_cal_lut();
+  motor_set_ab(lut->speed[RC_CAL_MOTOR_A][cmd.raw],
+    lut->speed[RC_CAL_MOTOR_B][cmd.raw]);
+  return 0;
+}
+
+static bool outputs_match(const uint32_t want[MOTOR_CHANNELS]) {
+  for (int c = 0; c < MOTOR_CHANNELS; c++) {
+    if (fake_ledc_output(channels[c]) != want[c]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void check_parse(void) {
+  const uint8_t two[] = {127, 0};
+  rc_cmd_t cmd = {.raw = 42};
+  check(rc_cmd_parse(two, 0, &cmd) != 0, "empty write accepted");
+  check(rc_cmd_parse(two, sizeof(two), &cmd) != 0, "long write accepted");
+  check(rc_cmd_parse(NULL, 1, &cmd) != 0, "NULL write accepted");
+  check(cmd.raw == 42, "rejected write changed the command");
+  for (int raw = 0; raw < 256; raw++) {
+    uint8_t b = (uint8_t)raw;
+    check(rc_cmd_parse(&b, 1, &cmd) == 0 && cmd.raw == b, "command byte");
+  }
+}
+
+static void check_init(void) {
+  const int pins[MOTOR_CHANNELS] = {
+    CONFIG_MOTOR_AIN1_GPIO,
+    CONFIG_MOTOR_AIN2_GPIO,
+    CONFIG_MOTOR_BIN1_GPIO,
+    CONFIG_MOTOR_BIN2_GPIO,
+  };
+  motor_init();
+  for (int c = 0; c < MOTOR_CHANNELS; c++) {
+    check(fake_ledc_gpio(channels[c]) == pins[c], "channel pin");
+    check(fake_ledc_output(channels[c]) == 0, "channel off at start");
+  }
+  check(fake_gpio_driven(CONFIG_MOTOR_STBY_GPIO) == 1, "driver enabled");
+  motor_brake();
+  check(fake_gpio_driven(CONFIG_MOTOR_STBY_GPIO) == 0, "brake");
+  motor_resume();
+  check(fake_gpio_driven(CONFIG_MOTOR_STBY_GPIO) == 1, "resume");
+}
+
+// every byte through the current tables, what the pins output must be
+// motor_mix_ab of the table speeds
+static int sweep(void) {
+  const rc_lut_t *lut = rc_cal_lut();
+  int bad = 0;
+  for (int raw = 0; raw < 256; raw++) {
+    uint8_t b = (uint8_t)raw;
+    uint32_t want[MOTOR_CHANNELS];
+    motor_mix_ab(lut->speed[RC_CAL_MOTOR_A][raw],
+      lut->speed[RC_CAL_MOTOR_B][raw],
+      want);
+    uint32_t last[MOTOR_CHANNELS];
+    if (write_cmd(&b, 1) != 0 || !outputs_match(want)) {
+      bad++;
+    }
+    motor_get_duty(last);
+    if (memcmp(last, want, sizeof(want)) != 0) {
+      bad++;
+    }
+  }
+  return bad;
+}
+
+static void check_calibration(void) {
+  check(settings_nvs_init() == ESP_OK, "nvs init");
+  check(rc_cal_init() == ESP_OK, "first boot");
+  check(cal_records == 1, "tables recorded at init");
+  check(sweep() == 0, "default tables");
+
+  // the default tables are the old linear mapping
+  const rc_lut_t *lut = rc_cal_lut();
+  check(lut->speed[RC_CAL_MOTOR_A][MOTOR_CURVE_CENTER] == 0 &&
+          lut->speed[RC_CAL_MOTOR_A][0] == -254 &&
+          lut->speed[RC_CAL_MOTOR_B][255] == 255,
+    "linear tables");
+
+  rc_cal_t cal = {
+    .motor =
+      {
+        {.deadzone = 8,
+          .expo = 40,
+          .min_duty = 60,
+          .max_duty = 240,
+          .trim = -5,
+          .reverse = 0},
+        {.deadzone = 8,
+          .expo = 40,
+          .min_duty = 60,
+          .max_duty = 240,
+          .trim = 0,
+          .reverse = 1},
+      },
+  };
+  uint32_t commits = fake_nvs_commits();
+  check(rc_cal_set(&cal) == ESP_OK, "calibration set");
+  check(fake_nvs_commits() == commits + 1, "calibration written once");
+  check(rc_cal_set(&cal) == ESP_OK && fake_nvs_commits() == commits + 1,
+    "unchanged calibration written again");
+  check(sweep() == 0, "calibrated tables");
+  lut = rc_cal_lut();
+  check(lut->speed[RC_CAL_MOTOR_A][MOTOR_CURVE_CENTER + 8] == 0,
+    "deadzone");
+  check(lut->speed[RC_CAL_MOTOR_A][255] > 0 &&
+          lut->speed[RC_CAL_MOTOR_B][255] < 0,
+    "reversed motor");
+
+  rc_cal_t bad = cal;
+  bad.motor[RC_CAL_MOTOR_B].trim = 90;
+  check(rc_cal_set(&bad) == ESP_ERR_INVALID_ARG, "out of range accepted");
+  check(fake_nvs_commits() == commits + 1, "rejected calibration written");
+
+  // a reboot: the tables come back from flash
+  check(rc_cal_init() == ESP_OK, "second boot");
+  rc_cal_t got;
+  rc_cal_get(&got);
+  check(memcmp(&got, &cal, sizeof(cal)) == 0, "calibration after reboot");
+  check(sweep() == 0, "tables after reboot");
+
+  // the RAM copy still drives when flash fails
+  fake_nvs_fail_writes(ESP_ERR_NVS_NO_FREE_PAGES);
+  cal.motor[RC_CAL_MOTOR_A].deadzone = 20;
+  check(rc_cal_set(&cal) == ESP_ERR_NVS_NO_FREE_PAGES, "flash error hidden");
+  lut = rc_cal_lut();
+  check(lut->speed[RC_CAL_MOTOR_A][MOTOR_CURVE_CENTER + 15] == 0,
+    "tables after a flash error");
+  fake_nvs_fail_writes(ESP_OK);
+}
+
+// rc_ctl's tick with an unchanged command: the motor is only written when
+// the calibration moved
+static bool tick(rc_cal_view_t *view, uint8_t raw) {
+  if (!rc_cal_refresh(view)) {
+    return false;
+  }
+  motor_set_ab(view->lut.speed[RC_CAL_MOTOR_A][raw],
+    view->lut.speed[RC_CAL_MOTOR_B][raw]);
+  return true;
+}
+
+static void check_refresh(void) {
+  static rc_cal_view_t view;
+  const uint8_t raw = 200;
+  check(tick(&view, raw), "tables copied on the first tick");
+  check(!tick(&view, raw), "tables copied without a change");
+
+  // tuned twice while the car is held still, the loop sees neither set
+  rc_cal_t first;
+  rc_cal_get(&first);
+  first.motor[RC_CAL_MOTOR_A].max_duty = 200;
+  rc_cal_t second = first;
+  second.motor[RC_CAL_MOTOR_A].max_duty = 120;
+  second.motor[RC_CAL_MOTOR_B].expo = 0;
+  check(rc_cal_set(&first) == ESP_OK && rc_cal_set(&second) == ESP_OK,
+    "back to back calibrations");
+  check(tick(&view, raw), "two changes between ticks missed");
+
+  int16_t a[MOTOR_CURVE_LEN];
+  int16_t b[MOTOR_CURVE_LEN];
+  motor_curve_build(&second.motor[RC_CAL_MOTOR_A], a);
+  motor_curve_build(&second.motor[RC_CAL_MOTOR_B], b);
+  check(memcmp(view.lut.speed[RC_CAL_MOTOR_A], a, sizeof(a)) == 0 &&
+          memcmp(view.lut.speed[RC_CAL_MOTOR_B], b, sizeof(b)) == 0,
+    "copied tables are not the newest");
+  uint32_t want[MOTOR_CHANNELS];
+  motor_mix_ab(a[raw], b[raw], want);
+  check(outputs_match(want), "newest calibration not on the PWM");
+  check(!tick(&view, raw), "tables copied again");
+}
+
+static void bench_cmd_parse(void *ctx) {
+  rc_cmd_t cmd;
+  rc_cmd_parse(ctx, 1, &cmd);
+}
+
+static void bench_cal_lookup(void *ctx) {
+  uint8_t raw = *(uint8_t *)ctx;
+  const rc_lut_t *lut = rc_cal_lut();
+  volatile int a = lut->speed[RC_CAL_MOTOR_A][raw];
+  volatile int b = lut->speed[RC_CAL_MOTOR_B][raw];
+  (void)a;
+  (void)b;
+}
+
+static void bench_set_speed(void *ctx) {
+  static int speed = 0;
+  speed = speed >= 255 ? -255 : speed + 1;
+  motor_set_speed(speed);
+}
+
+static void bench_motor_write(void *ctx) { write_cmd(ctx, 1); }
+
+static void run_benchmarks(void) {
+  bench_opts_t opts = {.warmup = 100, .iterations = 10000};
+  bench_result_t result;
+  uint8_t raw = 200;
+
+  bench_print_header();
+  if (bench_run("rc_cmd_parse", bench_cmd_parse, &raw, &opts, &result) == 0) {
+    bench_print(&result);
+  }
+  if (bench_run("rc_cal_lookup", bench_cal_lookup, &raw, &opts, &result) ==
+      0) {
+    bench_print(&result);
+  }
+  if (bench_run("motor_set_speed", bench_set_speed, NULL, &opts, &result) ==
+      0) {
+    bench_print(&result);
+  }
+  if (bench_run("motor_write", bench_motor_write, &raw, &opts, &result) == 0) {
+    bench_print(&result);
+  }
+}
+
+int main(void) {
+  fake_gpio_reset();
+  fake_ledc_reset();
+  fake_nvs_reset();
+
+  check_parse();
+  check_init();
+  check_calibration();
+  check_refresh();
+  run_benchmarks();
+
+  printf("%s\n", failures ? "FAILED" : "ok");
+  return failures > 0;
+}
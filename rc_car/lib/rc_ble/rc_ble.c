@@ -1,15 +1,17 @@
 #include "rc_ble.h"
+#include "ble_core.h"
+#include "boot_init.h"
+#include "dlog.h"
 #include "esp_err.h"
 #include "freertos/FreeRTOS.h"
 #include "host/ble_hs.h"
-#include "nimble/nimble_port.h"
-#include "nimble/nimble_port_freertos.h"
-#include "nvs.h"
-#include "nvs_flash.h"
 #include "os/os_mbuf.h"
-#include "rc_motor.h"
-#include "services/gap/ble_svc_gap.h"
-#include "services/gatt/ble_svc_gatt.h"
+#include "rc_cal.h"
+#include "rc_cmd.h"
+#include "rc_ctl.h"
+#include "rc_rec.h"
+#include "sdkconfig.h"
+#include "trace.h"
 
 #define DEVICE_NAME "RC_CAR"
 
@@ -20,20 +22,96 @@ static uint8_t own_addr_type;
 static int motor_write(uint16_t conn_handle, uint16_t attr_handle,
                        struct ble_gatt_access_ctxt *ctxt, void *arg) {
   if (ctxt->op == BLE_GATT_ACCESS_OP_WRITE_CHR) {
-    uint8_t raw = ctxt->om->om_data[0];
-    int speed = ((int)raw - 127) * 2;
-    if (speed > 255) {
-      speed = 255;
+    TRACE_BEGIN(TRACE_BLE_MOTOR_WRITE);
+    rc_rec_cmd(ctxt->om->om_data, OS_MBUF_PKTLEN(ctxt->om));
+    rc_cmd_t cmd;
+    if (rc_cmd_parse(ctxt->om->om_data, OS_MBUF_PKTLEN(ctxt->om), &cmd) != 0) {
+      TRACE_END(TRACE_BLE_MOTOR_WRITE);
+      return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
     }
-    if (speed < -255) {
-      speed = -255;
+    DLOGI_EVERY(TAG, 100, "Motor control write: %d", cmd.raw);
+    // applied by rc_ctl_task, the host task goes straight back to the radio
+    rc_ctl_submit(&cmd);
+    TRACE_END(TRACE_BLE_MOTOR_WRITE);
+    return 0;
+  }
+  return BLE_ATT_ERR_UNLIKELY;
+}
+
+// reads return the current rc_cal_t, a write replaces all of it
+static int cal_access(uint16_t conn_handle, uint16_t attr_handle,
+                      struct ble_gatt_access_ctxt *ctxt, void *arg) {
+  rc_cal_t cal;
+  if (ctxt->op == BLE_GATT_ACCESS_OP_READ_CHR) {
+    rc_cal_get(&cal);
+    return os_mbuf_append(ctxt->om, &cal, sizeof(cal)) == 0
+               ? 0
+               : BLE_ATT_ERR_INSUFFICIENT_RES;
+  }
+  if (ctxt->op != BLE_GATT_ACCESS_OP_WRITE_CHR) {
+    return BLE_ATT_ERR_UNLIKELY;
+  }
+
+  if (OS_MBUF_PKTLEN(ctxt->om) != sizeof(cal)) {
+    return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+  }
+  os_mbuf_copydata(ctxt->om, 0, sizeof(cal), &cal);
+  esp_err_t esp_err = rc_cal_set(&cal);
+  if (esp_err == ESP_ERR_INVALID_ARG) {
+    return BLE_ATT_ERR_VALUE_NOT_ALLOWED;
+  }
+  // ESP_FAIL from flash still drives with the new tables until reboot
+  return 0;
+}
+
+#if CONFIG_RC_REC_ENABLE
+static uint32_t rec_offset;
+
+// write an RC_REC_OP_*, reads return the export from the last seek onwards
+static int rec_access(uint16_t conn_handle, uint16_t attr_handle,
+                      struct ble_gatt_access_ctxt *ctxt, void *arg) {
+  if (ctxt->op == BLE_GATT_ACCESS_OP_READ_CHR) {
+    // only touched from the host task
+    static uint8_t chunk[RC_REC_BLE_CHUNK];
+    size_t n = rc_rec_export(rec_offset, chunk, sizeof(chunk));
+    return os_mbuf_append(ctxt->om, chunk, n) == 0
+               ? 0
+               : BLE_ATT_ERR_INSUFFICIENT_RES;
+  }
+  if (ctxt->op != BLE_GATT_ACCESS_OP_WRITE_CHR) {
+    return BLE_ATT_ERR_UNLIKELY;
+  }
+
+  uint8_t req[5];
+  uint16_t len = OS_MBUF_PKTLEN(ctxt->om);
+  if (len == 0 || len > sizeof(req)) {
+    return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+  }
+  os_mbuf_copydata(ctxt->om, 0, len, req);
+
+  switch (req[0]) {
+  case RC_REC_OP_FREEZE:
+    rc_rec_freeze(true);
+    rec_offset = 0;
+    return 0;
+  case RC_REC_OP_RESUME:
+    rc_rec_freeze(false);
+    return 0;
+  case RC_REC_OP_CLEAR:
+    rc_rec_clear();
+    return 0;
+  case RC_REC_OP_DUMP_UART:
+    return rc_rec_dump_uart_async() == ESP_OK ? 0 : BLE_ATT_ERR_UNLIKELY;
+  case RC_REC_OP_SEEK:
+    if (len != 5) {
+      return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
     }
-    ESP_LOGI(TAG, "Motor control write: %d", speed);
-    motor_set_speed(speed);
+    rec_offset = req[1] | req[2] << 8 | req[3] << 16 | (uint32_t)req[4] << 24;
     return 0;
   }
   return BLE_ATT_ERR_UNLIKELY;
 }
+#endif
 
 static const struct ble_gatt_chr_def rc_var_chars[] = {
     {
@@ -41,6 +119,18 @@ static const struct ble_gatt_chr_def rc_var_chars[] = {
         .access_cb = motor_write,
         .flags = BLE_GATT_CHR_F_WRITE,
     },
+    {
+        .uuid = BLE_UUID16_DECLARE(RC_CAL_CHAR_UUID),
+        .access_cb = cal_access,
+        .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE,
+    },
+#if CONFIG_RC_REC_ENABLE
+    {
+        .uuid = BLE_UUID16_DECLARE(RC_REC_CHAR_UUID),
+        .access_cb = rec_access,
+        .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE,
+    },
+#endif
     {0}};
 
 static const struct ble_gatt_svc_def rc_car_svcs[] = {
@@ -114,6 +204,8 @@ static void advertise(void) {
                 nimble_err);
     return;
   }
+  // first control write can come in from here
+  boot_init_mark("ble_adv");
 }
 
 static void on_stack_sync(void) {
@@ -141,43 +233,11 @@ static void on_stack_sync(void) {
   advertise();
 }
 
-static void on_stack_reset(int reason) {
-  MODLOG_DFLT(ERROR, "Resetting state; reason=%d\n", reason);
-}
-
-void ble_host_task(void *param) {
-  ESP_LOGI(TAG, "BLE Host Task Started");
-  nimble_port_run();
-  nimble_port_freertos_deinit();
-}
-
 int ble_svr_init(void) {
-  esp_err_t esp_err = nimble_port_init();
-  if (esp_err != ESP_OK) {
-    ESP_LOGE(TAG, "Failed to init nimble %d ", esp_err);
-    return esp_err;
-  }
-
-  ble_hs_cfg.reset_cb = on_stack_reset;
-  ble_hs_cfg.sync_cb = on_stack_sync;
-  ble_hs_cfg.store_status_cb = ble_store_util_status_rr;
-
-  ble_svc_gap_init();
-  ble_svc_gatt_init();
-
-  int nimble_err = ble_gatts_count_cfg(rc_car_svcs);
-  if (nimble_err != 0) {
-    return nimble_err;
-  }
-
-  nimble_err = ble_gatts_add_svcs(rc_car_svcs);
-  if (nimble_err != 0) {
-    return nimble_err;
-  }
-  if (nimble_err != 0) {
-    ESP_LOGE(TAG, "Failed to init GATT server: %d", nimble_err);
-    return nimble_err;
-  }
-
-  return 0;
+  ble_core_cfg_t cfg = {
+      .name = DEVICE_NAME,
+      .svcs = rc_car_svcs,
+      .on_sync = on_stack_sync,
+  };
+  return ble_core_init(&cfg);
 }
\ No newline at end of file
@@ -7,6 +7,5 @@
 #define RC_MOTOR_CHAR_UUID 0x1101
 
 int ble_svr_init(void);
-void ble_host_task(void *param);
 
 #endif
\ No newline at end of file
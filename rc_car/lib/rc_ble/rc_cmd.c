@@ -0,0 +1,12 @@
+#include "rc_cmd.h"
+#include <stddef.h>
+
+int rc_cmd_parse(const uint8_t *buf, uint16_t len, rc_cmd_t *out) {
+  if (buf == NULL || len != 1) {
+    return -1;
+  }
+
+  // 0-255 with 127 as stop, rc_cal turns it into motor speeds
+  out->raw = buf[0];
+  return 0;
+}
@@ -0,0 +1,14 @@
+#ifndef RC_CMD_H
+#define RC_CMD_H
+
+#include <stdint.h>
+
+typedef struct {
+  uint8_t raw; // command byte, index into the rc_cal tables
+} rc_cmd_t;
+
+// hardware independent decode of a motor characteristic write.
+// returns 0 on success, -1 when the payload is malformed
+int rc_cmd_parse(const uint8_t *buf, uint16_t len, rc_cmd_t *out);
+
+#endif
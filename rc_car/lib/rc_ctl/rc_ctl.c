@@ -0,0 +1,130 @@
+#include "rc_ctl.h"
+#include "dlog.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mailbox.h"
+#include "motor.h"
+#include "rc_cal.h"
+#include "rc_rec.h"
+#include "task_table.h"
+#include "trace.h"
+
+// loop iterations between jitter and latency reports
+#define RC_CTL_REPORT_EVERY 1000
+
+static const char *TAG = "RC_CTL";
+
+typedef struct {
+  rc_cmd_t cmd;
+  int64_t written_us; // when the ble write reached the callback
+} ctl_msg_t;
+
+// producer: NimBLE host task, consumer: rc_ctl_task
+MAILBOX_DEFINE(cmd_box, ctl_msg_t);
+
+static jitter_t jitter;
+static rc_ctl_latency_t latency = {.min_us = UINT32_MAX};
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void rc_ctl_submit(const rc_cmd_t *cmd) {
+  ctl_msg_t msg = {.cmd = *cmd, .written_us = esp_timer_get_time()};
+  mailbox_post(&cmd_box, &msg);
+}
+
+void rc_ctl_get_jitter(jitter_t *out) {
+  portENTER_CRITICAL(&stats_lock);
+  *out = jitter;
+  portEXIT_CRITICAL(&stats_lock);
+}
+
+void rc_ctl_get_latency(rc_ctl_latency_t *out) {
+  portENTER_CRITICAL(&stats_lock);
+  *out = latency;
+  out->overwritten = cmd_box.overwritten;
+  portEXIT_CRITICAL(&stats_lock);
+}
+
+static void latency_sample(int64_t written_us) {
+  uint32_t us = (uint32_t)(esp_timer_get_time() - written_us);
+  TRACE_VALUE(TRACE_MOTOR_LATENCY, us);
+  portENTER_CRITICAL(&stats_lock);
+  latency.count++;
+  latency.sum_us += us;
+  if (us < latency.min_us) {
+    latency.min_us = us;
+  }
+  if (us > latency.max_us) {
+    latency.max_us = us;
+  }
+  portEXIT_CRITICAL(&stats_lock);
+}
+
+static void report(void) {
+  uint32_t p99 = jitter_percentile_us(&jitter, 99);
+  if (p99 == UINT32_MAX) {
+    DLOGI(TAG, "jitter (" TASK_PARTITION_NAME "): avg %d us, max %d us, "
+               "p99 over 1 ms",
+          (int)jitter_avg_us(&jitter), (int)jitter.max_us);
+  } else {
+    DLOGI(TAG, "jitter (" TASK_PARTITION_NAME "): avg %d us, max %d us, "
+               "p99 under %d us",
+          (int)jitter_avg_us(&jitter), (int)jitter.max_us, (int)p99);
+  }
+
+  rc_ctl_latency_t lat;
+  rc_ctl_get_latency(&lat);
+  if (lat.count) {
+    DLOGI(TAG, "write to pwm: min %d us, avg %d us, max %d us, %d replaced",
+          (int)lat.min_us, (int)(lat.sum_us / lat.count), (int)lat.max_us,
+          (int)lat.overwritten);
+  }
+}
+
+void rc_ctl_task(void *param) {
+  // static to keep the tables off the task stack
+  static rc_cal_view_t cal;
+  jitter_init(&jitter, RC_CTL_PERIOD_MS * 1000);
+  TickType_t wake = xTaskGetTickCount();
+  uint32_t seen = 0;
+  uint8_t raw = MOTOR_CURVE_CENTER;
+  // the calibration loaded at boot, nothing is driven until a command
+  rc_cal_refresh(&cal);
+
+  for (;;) {
+    vTaskDelayUntil(&wake, pdMS_TO_TICKS(RC_CTL_PERIOD_MS));
+
+    portENTER_CRITICAL(&stats_lock);
+    jitter_sample(&jitter, esp_timer_get_time());
+    portEXIT_CRITICAL(&stats_lock);
+
+    // a new calibration maps the current byte elsewhere, applied right away
+    // rather than with the next command
+    bool update = rc_cal_refresh(&cal);
+
+    // only the newest command matters for the motor
+    ctl_msg_t msg;
+    bool taken = mailbox_take(&cmd_box, &msg, &seen);
+    if (taken && msg.cmd.raw != raw) {
+      raw = msg.cmd.raw;
+      update = true;
+    }
+    if (update) {
+      motor_set_ab(cal.lut.speed[RC_CAL_MOTOR_A][raw],
+                   cal.lut.speed[RC_CAL_MOTOR_B][raw]);
+    }
+
+    if (taken) {
+      // a repeat of the current speed is applied as soon as it is taken
+      latency_sample(msg.written_us);
+
+      uint32_t duty[MOTOR_CHANNELS];
+      motor_get_duty(duty);
+      rc_rec_out(cal.lut.speed[RC_CAL_MOTOR_A][raw], duty, msg.written_us);
+    }
+
+    if (jitter.samples && jitter.samples % RC_CTL_REPORT_EVERY == 0) {
+      report();
+    }
+  }
+}
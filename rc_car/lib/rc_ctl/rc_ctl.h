@@ -0,0 +1,27 @@
+#ifndef RC_CTL_H
+#define RC_CTL_H
+
+#include "jitter.h"
+#include "rc_cmd.h"
+#include <stdint.h>
+
+#define RC_CTL_PERIOD_MS 10
+
+// ble write callback to pwm update, in us
+typedef struct {
+  uint32_t count;
+  uint32_t min_us;
+  uint32_t max_us;
+  uint64_t sum_us;
+  uint32_t overwritten; // commands replaced before the loop applied them
+} rc_ctl_latency_t;
+
+// called from the NimBLE host task, never blocks. a newer command replaces one
+// the loop has not applied yet
+void rc_ctl_submit(const rc_cmd_t *cmd);
+// fixed rate motor loop, listed in the app task table
+void rc_ctl_task(void *param);
+void rc_ctl_get_jitter(jitter_t *out);
+void rc_ctl_get_latency(rc_ctl_latency_t *out);
+
+#endif
@@ -0,0 +1,94 @@
+#include "rc_cal.h"
+#include "esp_log.h"
+#include "rc_rec.h"
+#include "settings.h"
+#include <string.h>
+
+#define RC_CAL_VERSION 1
+
+_Static_assert(sizeof(rc_cal_t) == 12, "calibration layout changed");
+
+static const char *TAG = "RC_CAL";
+
+static const rc_cal_t cal_defaults = {
+    .motor = {MOTOR_CURVE_LINEAR, MOTOR_CURVE_LINEAR},
+};
+SETTINGS_BLOB_DEFINE(cal_settings, rc_cal_t, "rc_car", "cal", RC_CAL_VERSION,
+                     &cal_defaults);
+
+// tables of generation g are in luts[g & 1]. writers are init and the NimBLE
+// host task, readers that can race with them copy through rc_cal_refresh
+static rc_lut_t luts[2];
+static uint32_t generation = 0;
+
+static void rebuild(const rc_cal_t *cal) {
+  uint32_t gen = __atomic_load_n(&generation, __ATOMIC_RELAXED) + 1;
+  rc_lut_t *next = &luts[gen & 1];
+  for (int m = 0; m < RC_CAL_MOTORS; m++) {
+    motor_curve_build(&cal->motor[m], next->speed[m]);
+  }
+  __atomic_store_n(&generation, gen, __ATOMIC_RELEASE);
+  // outputs recorded from here on come from the new tables
+  rc_rec_cal(cal->motor);
+}
+
+esp_err_t rc_cal_init(void) {
+  esp_err_t esp_err = settings_load(&cal_settings);
+  rc_cal_t cal;
+  settings_read(&cal_settings, &cal);
+  for (int m = 0; m < RC_CAL_MOTORS; m++) {
+    if (motor_curve_check(&cal.motor[m]) != 0) {
+      ESP_LOGE(TAG, "stored calibration out of range, using linear");
+      cal = cal_defaults;
+      break;
+    }
+  }
+  rebuild(&cal);
+  return esp_err;
+}
+
+const rc_lut_t *rc_cal_lut(void) {
+  return &luts[__atomic_load_n(&generation, __ATOMIC_ACQUIRE) & 1];
+}
+
+bool rc_cal_refresh(rc_cal_view_t *view) {
+  uint32_t gen = __atomic_load_n(&generation, __ATOMIC_ACQUIRE);
+  if (gen == view->generation) {
+    return false;
+  }
+  for (;;) {
+    memcpy(&view->lut, &luts[gen & 1], sizeof(view->lut));
+    // the table copied from is only rebuilt after gen + 1 is out, an
+    // unchanged generation means the copy is whole
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    uint32_t now = __atomic_load_n(&generation, __ATOMIC_RELAXED);
+    if (now == gen) {
+      break;
+    }
+    gen = now;
+  }
+  view->generation = gen;
+  return true;
+}
+
+void rc_cal_get(rc_cal_t *out) { settings_read(&cal_settings, out); }
+
+esp_err_t rc_cal_set(const rc_cal_t *cal) {
+  for (int m = 0; m < RC_CAL_MOTORS; m++) {
+    if (motor_curve_check(&cal->motor[m]) != 0) {
+      return ESP_ERR_INVALID_ARG;
+    }
+  }
+
+  rc_cal_t *cur = settings_edit(&cal_settings);
+  if (memcmp(cur, cal, sizeof(*cal)) == 0) {
+    settings_revert(&cal_settings);
+    return ESP_OK;
+  }
+  *cur = *cal;
+  // the RAM copy holds the change even when flash fails, drive with it
+  esp_err_t esp_err = settings_commit(&cal_settings);
+  rebuild(cal);
+  ESP_LOGI(TAG, "calibration updated");
+  return esp_err;
+}
@@ -0,0 +1,47 @@
+#ifndef RC_CAL_H
+#define RC_CAL_H
+
+#include "esp_err.h"
+#include "motor_curve.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// calibration characteristic, reads and writes an rc_cal_t as is
+#define RC_CAL_CHAR_UUID 0x1103
+
+enum {
+  RC_CAL_MOTOR_A = 0,
+  RC_CAL_MOTOR_B = 1,
+  RC_CAL_MOTORS = 2,
+};
+
+typedef struct {
+  motor_curve_t motor[RC_CAL_MOTORS];
+} rc_cal_t;
+
+// speed of each motor for every command byte
+typedef struct {
+  int16_t speed[RC_CAL_MOTORS][MOTOR_CURVE_LEN];
+} rc_lut_t;
+
+// the control loop's own copy of the tables, a rebuild never writes it. a
+// zeroed view matches the tables before rc_cal_init
+typedef struct {
+  rc_lut_t lut;
+  uint32_t generation; // rebuilds so far when copied
+} rc_cal_view_t;
+
+// loads the calibration from NVS and builds the tables
+esp_err_t rc_cal_init(void);
+// tables for the current calibration. the second change after this call
+// rewrites them, only for callers that can't race with rc_cal_set
+const rc_lut_t *rc_cal_lut(void);
+// copies the tables when the calibration changed since the last call,
+// returns true when it did. cheap otherwise, meant for every control tick
+bool rc_cal_refresh(rc_cal_view_t *view);
+void rc_cal_get(rc_cal_t *out);
+// checks, stores and rebuilds the tables. a calibration equal to the current
+// one is neither written nor rebuilt
+esp_err_t rc_cal_set(const rc_cal_t *cal);
+
+#endif
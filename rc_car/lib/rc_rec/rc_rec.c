@@ -0,0 +1,214 @@
+#include "rc_rec.h"
+#include "sdkconfig.h"
+
+#if CONFIG_RC_REC_ENABLE
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "task_table.h"
+#include <stdio.h>
+#include <string.h>
+
+#define RC_REC_RECORDS CONFIG_RC_REC_RECORDS
+#define RC_REC_MASK (RC_REC_RECORDS - 1)
+#define RC_REC_UART_BYTES 64
+
+_Static_assert((RC_REC_RECORDS & RC_REC_MASK) == 0,
+               "RC_REC_RECORDS must be a power of two");
+_Static_assert(sizeof(rc_rec_t) == 16, "record layout changed");
+
+static const char *TAG = "RC_REC";
+
+static rc_rec_t *ring;
+static uint32_t head; // records written since the last clear
+static bool frozen;
+static motor_curve_t curve[RC_REC_MOTORS];
+// writers: NimBLE host task (commands) and rc_ctl (outputs)
+static portMUX_TYPE ring_lock = portMUX_INITIALIZER_UNLOCKED;
+
+esp_err_t rc_rec_init(void) {
+  size_t size = RC_REC_RECORDS * sizeof(rc_rec_t);
+  ring = heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+  if (ring == NULL) {
+    ring = heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  }
+  if (ring == NULL) {
+    ESP_LOGE(TAG, "rc_rec_init; no memory for %d records ", RC_REC_RECORDS);
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
+
+static void put(const rc_rec_t *rec) {
+  if (ring == NULL) {
+    return;
+  }
+  portENTER_CRITICAL(&ring_lock);
+  if (!frozen) {
+    ring[head & RC_REC_MASK] = *rec;
+    head++;
+  }
+  portEXIT_CRITICAL(&ring_lock);
+}
+
+void rc_rec_cmd(const uint8_t *buf, uint16_t len) {
+  rc_rec_t rec = {
+      .ts_us = (uint32_t)esp_timer_get_time(),
+      .type = RC_REC_CMD,
+      .len = len > 255 ? 255 : len,
+  };
+  memcpy(rec.data, buf, len < sizeof(rec.data) ? len : sizeof(rec.data));
+  put(&rec);
+}
+
+void rc_rec_out(int speed, const uint32_t *duty, int64_t cmd_us) {
+  rc_rec_t rec = {
+      .ts_us = (uint32_t)esp_timer_get_time(),
+      .type = RC_REC_OUT,
+      .speed = (int16_t)speed,
+      .ref_us = (uint32_t)cmd_us,
+  };
+  for (size_t i = 0; i < sizeof(rec.data); i++) {
+    rec.data[i] = (uint8_t)duty[i];
+  }
+  put(&rec);
+}
+
+void rc_rec_cal(const motor_curve_t cal[RC_REC_MOTORS]) {
+  portENTER_CRITICAL(&ring_lock);
+  if (memcmp(curve, cal, sizeof(curve)) != 0) {
+    memcpy(curve, cal, sizeof(curve));
+    head = 0;
+  }
+  portEXIT_CRITICAL(&ring_lock);
+}
+
+void rc_rec_freeze(bool freeze) {
+  portENTER_CRITICAL(&ring_lock);
+  frozen = freeze;
+  portEXIT_CRITICAL(&ring_lock);
+}
+
+void rc_rec_clear(void) {
+  portENTER_CRITICAL(&ring_lock);
+  head = 0;
+  portEXIT_CRITICAL(&ring_lock);
+}
+
+static uint32_t stored(void) {
+  return head < RC_REC_RECORDS ? head : RC_REC_RECORDS;
+}
+
+size_t rc_rec_export_size(void) {
+  return sizeof(rc_rec_hdr_t) + stored() * sizeof(rc_rec_t);
+}
+
+// only stable while frozen, a live ring can move under the copy
+size_t rc_rec_export(uint32_t offset, uint8_t *buf, size_t len) {
+  if (ring == NULL) {
+    return 0;
+  }
+  uint32_t count = stored();
+  rc_rec_hdr_t hdr = {
+      .magic = RC_REC_MAGIC,
+      .version = RC_REC_VERSION,
+      .rec_size = sizeof(rc_rec_t),
+      .count = count,
+      .overwritten = head - count,
+  };
+  memcpy(hdr.curve, curve, sizeof(hdr.curve));
+  uint32_t first = head - count;
+
+  size_t n = 0;
+  while (n < len) {
+    uint32_t pos = offset + n;
+    const uint8_t *src;
+    size_t avail;
+    if (pos < sizeof(hdr)) {
+      src = (const uint8_t *)&hdr + pos;
+      avail = sizeof(hdr) - pos;
+    } else {
+      uint32_t rec = (pos - sizeof(hdr)) / sizeof(rc_rec_t);
+      uint32_t skip = (pos - sizeof(hdr)) % sizeof(rc_rec_t);
+      if (rec >= count) {
+        break;
+      }
+      src = (const uint8_t *)&ring[(first + rec) & RC_REC_MASK] + skip;
+      avail = sizeof(rc_rec_t) - skip;
+    }
+    if (avail > len - n) {
+      avail = len - n;
+    }
+    memcpy(buf + n, src, avail);
+    n += avail;
+  }
+  return n;
+}
+
+void rc_rec_dump_uart(void) {
+  bool was_frozen = frozen;
+  rc_rec_freeze(true);
+
+  size_t size = rc_rec_export_size();
+  printf("REC,begin,%lu\n", (unsigned long)size);
+  uint8_t chunk[RC_REC_UART_BYTES];
+  for (uint32_t off = 0; off < size; off += sizeof(chunk)) {
+    size_t n = rc_rec_export(off, chunk, sizeof(chunk));
+    printf("REC,");
+    for (size_t i = 0; i < n; i++) {
+      printf("%02x", chunk[i]);
+    }
+    printf("\n");
+  }
+  printf("REC,end\n");
+
+  rc_rec_freeze(was_frozen);
+}
+
+static bool dumping;
+
+static void dump_task(void *param) {
+  rc_rec_dump_uart();
+  __atomic_store_n(&dumping, false, __ATOMIC_RELEASE);
+  vTaskDelete(NULL);
+}
+
+esp_err_t rc_rec_dump_uart_async(void) {
+  if (__atomic_exchange_n(&dumping, true, __ATOMIC_ACQ_REL)) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  // a full ring is several seconds of uart, keep it off the caller
+  if (xTaskCreatePinnedToCore(dump_task, "rc_rec_dump", 3072, NULL, 1, NULL,
+                              TASK_CORE_RADIO) != pdPASS) {
+    __atomic_store_n(&dumping, false, __ATOMIC_RELEASE);
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
+
+#else
+
+esp_err_t rc_rec_init(void) { return ESP_OK; }
+
+void rc_rec_cmd(const uint8_t *buf, uint16_t len) {}
+
+void rc_rec_out(int speed, const uint32_t *duty, int64_t cmd_us) {}
+
+void rc_rec_cal(const motor_curve_t cal[RC_REC_MOTORS]) {}
+
+void rc_rec_freeze(bool freeze) {}
+
+void rc_rec_clear(void) {}
+
+size_t rc_rec_export_size(void) { return 0; }
+
+size_t rc_rec_export(uint32_t offset, uint8_t *buf, size_t len) { return 0; }
+
+void rc_rec_dump_uart(void) {}
+
+esp_err_t rc_rec_dump_uart_async(void) { return ESP_ERR_NOT_SUPPORTED; }
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef RC_REC_H
+#define RC_REC_H
+
+#include "esp_err.h"
+#include "rc_rec_fmt.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// session recorder control characteristic, write one of these then read the
+// export back in chunks
+#define RC_REC_CHAR_UUID 0x1102
+#define RC_REC_BLE_CHUNK 480
+
+enum {
+  RC_REC_OP_FREEZE = 1, // stop recording so the export holds still
+  RC_REC_OP_RESUME = 2,
+  RC_REC_OP_CLEAR = 3,
+  RC_REC_OP_DUMP_UART = 4,
+  RC_REC_OP_SEEK = 5, // followed by a u32 export offset for the next read
+};
+
+// ring in PSRAM when there is some, internal RAM otherwise
+esp_err_t rc_rec_init(void);
+void rc_rec_cmd(const uint8_t *buf, uint16_t len);
+void rc_rec_out(int speed, const uint32_t *duty, int64_t cmd_us);
+// calibration the following outputs are made with. a change clears the ring,
+// a session replays against a single calibration
+void rc_rec_cal(const motor_curve_t curve[RC_REC_MOTORS]);
+
+void rc_rec_freeze(bool freeze);
+void rc_rec_clear(void);
+// export image is an rc_rec_hdr_t then the records, copy any window of it
+size_t rc_rec_export_size(void);
+size_t rc_rec_export(uint32_t offset, uint8_t *buf, size_t len);
+// REC lines holding the export as hex, tools/rc_replay.c reads them
+void rc_rec_dump_uart(void);
+// same from a short lived task, for callers that must not block
+esp_err_t rc_rec_dump_uart_async(void);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef RC_REC_FMT_H
+#define RC_REC_FMT_H
+
+#include "motor_curve.h"
+#include <stdint.h>
+
+// session recording layout, shared with tools/rc_replay.c. hardware
+// independent, all fields little endian
+
+#define RC_REC_MAGIC 0x43455252 // "RREC"
+#define RC_REC_VERSION 2
+#define RC_REC_MOTORS 2
+
+enum {
+  RC_REC_CMD = 1, // motor characteristic write, before it is parsed
+  RC_REC_OUT = 2, // command taken by the control loop and written to the pwm
+};
+
+typedef struct {
+  uint32_t ts_us;
+  uint8_t type;
+  uint8_t len;     // CMD: payload length as received, clamped to 255
+  int16_t speed;   // OUT: motor A speed applied
+  uint8_t data[4]; // CMD: first payload bytes, OUT: channel duties
+  uint32_t ref_us; // OUT: ts_us of the command that was applied
+} rc_rec_t;
+
+// an export is this header followed by count records, oldest first
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t rec_size;
+  uint32_t count;
+  uint32_t overwritten; // records lost to the ring wrapping
+  // motor A and B calibration every recorded output was made with
+  motor_curve_t curve[RC_REC_MOTORS];
+} rc_rec_hdr_t;
+
+#endif
@@ -0,0 +1,36 @@
+#include "app_tasks.h"
+#include "dlog.h"
+#include "esp_task.h"
+#include "rc_ctl.h"
+#include "sdkconfig.h"
+#include "trace.h"
+
+#if CONFIG_DLOG_ENABLE
+TASK_STORAGE(dlog, DLOG_TASK_STACK);
+#endif
+#if TRACE_HAS_TASK
+TASK_STORAGE(trace, TRACE_TASK_STACK);
+#endif
+TASK_STORAGE(rc_ctl, 2560);
+TASK_STORAGE(task_mon, 2560);
+
+// BLE writes only queue commands, the motor loop has APP_CPU to itself when
+// the cores are partitioned
+task_def_t app_tasks[] = {
+    TASK_STATIC(rc_ctl, "rc_ctl", rc_ctl_task, 10, TASK_CORE_RT),
+    TASK_EXTERNAL("nimble_host", CONFIG_BT_NIMBLE_HOST_TASK_STACK_SIZE,
+                  configMAX_PRIORITIES - 4, CONFIG_BT_NIMBLE_PINNED_TO_CORE),
+#if CONFIG_DLOG_ENABLE
+    TASK_STATIC(dlog, "dlog", dlog_task, CONFIG_DLOG_TASK_PRIORITY,
+                TASK_CORE_RADIO),
+#endif
+#if TRACE_HAS_TASK
+    TASK_STATIC(trace, "trace", trace_task, 1, TASK_CORE_RADIO),
+#endif
+    TASK_STATIC(task_mon, "task_mon", task_monitor_task, 1,
+                TASK_CORE_RADIO),
+    TASK_EXTERNAL("esp_timer", CONFIG_ESP_TIMER_TASK_STACK_SIZE,
+                  ESP_TASK_TIMER_PRIO, 0),
+};
+
+const size_t app_task_count = sizeof(app_tasks) / sizeof(app_tasks[0]);
@@ -1,31 +1,185 @@
-#include "nimble/nimble_port.h"
-#include "nimble/nimble_port_freertos.h"
-#include "nvs_flash.h"
+#include "app_tasks.h"
+#include "boot_init.h"
+#include "ble_core.h"
+#include "dlog.h"
+#include "motor.h"
 #include "rc_ble.h"
-#include "rc_motor.h"
+#include "rc_cal.h"
+#include "rc_rec.h"
+#include "sdkconfig.h"
+#include "settings.h"
+#include "trace.h"
 #include <stdio.h>
 
+#if CONFIG_BENCH_ENABLE
+#include "bench.h"
+#include "rc_cmd.h"
+#endif
+
 static const char *TAG = "RC_CAR";
 
-void app_main(void) {
-  esp_err_t esp_err = nvs_flash_init();
-  if (esp_err == ESP_ERR_NVS_NO_FREE_PAGES ||
-      esp_err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-    ESP_ERROR_CHECK(nvs_flash_erase());
-    esp_err = nvs_flash_init();
+#if CONFIG_BENCH_ENABLE
+static void bench_cmd_parse(void *ctx) {
+  rc_cmd_t cmd;
+  rc_cmd_parse(ctx, 1, &cmd);
+}
+
+static void bench_cal_lookup(void *ctx) {
+  const rc_lut_t *lut = rc_cal_lut();
+  uint8_t raw = *(const uint8_t *)ctx;
+  volatile int a = lut->speed[RC_CAL_MOTOR_A][raw];
+  volatile int b = lut->speed[RC_CAL_MOTOR_B][raw];
+  (void)a;
+  (void)b;
+}
+
+static void bench_set_speed(void *ctx) {
+  static int speed = 0;
+  speed = speed >= 255 ? -255 : speed + 1;
+  motor_set_speed(speed);
+}
+
+// command parse, table lookup and motor update, the rc_ctl path
+static void bench_motor_write(void *ctx) {
+  rc_cmd_t cmd;
+  if (rc_cmd_parse(ctx, 1, &cmd) == 0) {
+    const rc_lut_t *lut = rc_cal_lut();
+    motor_set_ab(lut->speed[RC_CAL_MOTOR_A][cmd.raw],
+                 lut->speed[RC_CAL_MOTOR_B][cmd.raw]);
   }
-  if (esp_err != ESP_OK) {
-    ESP_LOGE(TAG, "failed to initialize nvs flash, error code: %d ", esp_err);
-    return;
+}
+
+#if CONFIG_DLOG_ENABLE
+static void bench_dlog(void *ctx) { DLOGI(TAG, "Motor speed: %d", 200); }
+
+static void bench_esp_log(void *ctx) { ESP_LOGI(TAG, "Motor speed: %d", 200); }
+#endif
+
+static esp_err_t run_benchmarks(void) {
+  bench_opts_t opts = {
+    .warmup = CONFIG_BENCH_WARMUP,
+    .iterations = CONFIG_BENCH_ITERATIONS,
+  };
+  bench_result_t result;
+  uint8_t raw = 200;
+
+  // PWM still updates but the driver outputs stay off
+  motor_brake();
+
+  bench_print_header();
+  if (bench_run("rc_cmd_parse", bench_cmd_parse, &raw, &opts, &result) == 0) {
+    bench_print(&result);
+  }
+  if (bench_run("rc_cal_lookup", bench_cal_lookup, &raw, &opts, &result) ==
+      0) {
+    bench_print(&result);
+  }
+  if (bench_run("motor_set_speed", bench_set_speed, NULL, &opts, &result) ==
+      0) {
+    bench_print(&result);
+  }
+  if (bench_run("motor_write", bench_motor_write, &raw, &opts, &result) == 0) {
+    bench_print(&result);
+  }
+
+#if CONFIG_DLOG_ENABLE
+  // stay under the ring size so every push is queued rather than dropped
+  bench_opts_t log_opts = {
+    .warmup = 0,
+    .iterations = CONFIG_DLOG_RING_SIZE / 2,
+  };
+  dlog_flush();
+  if (bench_run("dlog_push", bench_dlog, NULL, &log_opts, &result) == 0) {
+    dlog_flush();
+    bench_print(&result);
+  }
+  if (bench_run("esp_logi", bench_esp_log, NULL, &log_opts, &result) == 0) {
+    bench_print(&result);
   }
+#endif
 
+  motor_stop();
+  motor_resume();
+  return ESP_OK;
+}
+#endif
+
+static esp_err_t init_motor(void) {
   motor_init();
+  return ESP_OK;
+}
 
-  esp_err = ble_svr_init();
+static esp_err_t init_rec(void) {
+  // a car without a recorder still drives
+  rc_rec_init();
+  return ESP_OK;
+}
+
+static esp_err_t init_cal(void) {
+  // linear tables when nothing is stored
+  rc_cal_init();
+  return ESP_OK;
+}
+
+static esp_err_t start_tasks(void) {
+  esp_err_t esp_err = task_table_start(app_tasks, app_task_count);
+  if (esp_err == ESP_OK) {
+    // the motor loop takes commands
+    boot_init_mark("ctl");
+  }
+  return esp_err;
+}
+
+static esp_err_t start_ble(void) {
+  esp_err_t esp_err = ble_svr_init();
   if (esp_err != ESP_OK) {
     ESP_LOGE(TAG, "Failed to init nimble %d ", esp_err);
-    return;
+    return esp_err;
   }
+  ble_core_start();
+  return ESP_OK;
+}
+
+enum {
+  STEP_NVS,
+  STEP_MOTOR,
+  STEP_REC,
+  STEP_CAL,
+  STEP_TASKS,
+#if CONFIG_BENCH_ENABLE
+  STEP_BENCH,
+#endif
+  STEP_BLE,
+};
+
+#if CONFIG_BENCH_ENABLE
+// numbers taken before the radio is up, like they always were
+#define BLE_DEPS (BOOT_DEP(STEP_NVS) | BOOT_DEP(STEP_BENCH))
+#else
+#define BLE_DEPS BOOT_DEP(STEP_NVS)
+#endif
 
-  nimble_port_freertos_init(ble_host_task);
+// the BLE controller only waits for NVS, the motor outputs and the recorder
+// come up meanwhile
+static const boot_step_t boot_steps[] = {
+    [STEP_NVS] = {"nvs", settings_nvs_init, 0, true},
+    [STEP_MOTOR] = {"motor", init_motor, 0, true},
+    [STEP_REC] = {"rec", init_rec, 0, true},
+    [STEP_CAL] = {"cal", init_cal, BOOT_DEP(STEP_NVS) | BOOT_DEP(STEP_REC),
+                  true},
+    [STEP_TASKS] = {"tasks", start_tasks,
+                    BOOT_DEP(STEP_MOTOR) | BOOT_DEP(STEP_CAL), true},
+#if CONFIG_BENCH_ENABLE
+    [STEP_BENCH] = {"bench", run_benchmarks, BOOT_DEP(STEP_TASKS), false},
+#endif
+    [STEP_BLE] = {"ble", start_ble, BLE_DEPS, false},
+};
+
+void app_main(void) {
+  esp_err_t esp_err =
+      boot_init_run(boot_steps, sizeof(boot_steps) / sizeof(boot_steps[0]));
+  boot_init_report();
+  if (esp_err != ESP_OK) {
+    ESP_LOGE(TAG, "boot_init_run; error code: %d ", esp_err);
+  }
 }
@@ -0,0 +1,172 @@
+/*
+  builds a motor response table with the same code the car runs and checks
+  it: stop inside the deadzone, monotonic in the command, min_duty right past
+  the deadzone, max_duty (with trim) at full command, and the default curve
+  equal to the old linear ((raw - 127) * 2) mapping.
+
+    gcc -O2 -I../../components/motor/include rc_curve.c \
+      ../../components/motor/motor_curve.c -o rc_curve
+    ./rc_curve                             # checks a sweep of calibrations
+    ./rc_curve -d 6 -e 40 -m 60 -t -5 -p   # one curve as raw,speed csv
+
+  exits 1 when a check fails, 2 on bad arguments.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include "motor_curve.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define FAIL_PRINT 10
+
+static int fails;
+
+static void fail(const motor_curve_t *c, const char *what, int raw, int got) {
+  if (fails++ < FAIL_PRINT) {
+    printf("dz %d expo %d min %d max %d trim %d rev %d: %s at raw %d (%d)\n",
+           c->deadzone, c->expo, c->min_duty, c->max_duty, c->trim,
+           c->reverse, what, raw, got);
+  }
+}
+
+static int scaled(int duty, int trim) {
+  int v = (duty * (100 + trim) + 50) / 100;
+  return v > 255 ? 255 : v;
+}
+
+static void check(const motor_curve_t *c) {
+  int16_t lut[MOTOR_CURVE_LEN];
+  motor_curve_build(c, lut);
+  int sign = c->reverse ? -1 : 1;
+
+  for (int raw = 0; raw < MOTOR_CURVE_LEN; raw++) {
+    int in = (raw - MOTOR_CURVE_CENTER) * 2;
+    int v = lut[raw] * sign;
+    if (v < -255 || v > 255) {
+      fail(c, "out of range", raw, v);
+    }
+    if ((in > 0 && v < 0) || (in < 0 && v > 0)) {
+      fail(c, "wrong direction", raw, v);
+    }
+    if (abs(in) <= c->deadzone * 2 && v != 0) {
+      fail(c, "moves inside the deadzone", raw, v);
+    }
+    if (raw > 0 && v < lut[raw - 1] * sign) {
+      fail(c, "not monotonic", raw, v);
+    }
+  }
+
+  // first step past the deadzone on either side
+  int up = MOTOR_CURVE_CENTER + c->deadzone + 1;
+  int down = MOTOR_CURVE_CENTER - c->deadzone - 1;
+  int floor_duty = scaled(c->min_duty, c->trim);
+  if (abs(lut[up]) < floor_duty || abs(lut[down]) < floor_duty) {
+    fail(c, "under min_duty", up, lut[up]);
+  }
+  if (abs(lut[MOTOR_CURVE_LEN - 1]) != scaled(c->max_duty, c->trim)) {
+    fail(c, "full command is not max_duty", 255, lut[255]);
+  }
+}
+
+int main(int argc, char **argv) {
+  motor_curve_t one = MOTOR_CURVE_LINEAR;
+  int print = 0, opt;
+  while ((opt = getopt(argc, argv, "d:e:m:M:t:rp")) != -1) {
+    switch (opt) {
+    case 'd':
+      one.deadzone = atoi(optarg);
+      break;
+    case 'e':
+      one.expo = atoi(optarg);
+      break;
+    case 'm':
+      one.min_duty = atoi(optarg);
+      break;
+    case 'M':
+      one.max_duty = atoi(optarg);
+      break;
+    case 't':
+      one.trim = atoi(optarg);
+      break;
+    case 'r':
+      one.reverse = 1;
+      break;
+    case 'p':
+      print = 1;
+      break;
+    default:
+      fprintf(stderr,
+              "usage: %s [-d deadzone] [-e expo] [-m min_duty] "
+              "[-M max_duty] [-t trim] [-r] [-p]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+
+  if (print) {
+    if (motor_curve_check(&one) != 0) {
+      fprintf(stderr, "calibration out of range\n");
+      return 2;
+    }
+    int16_t lut[MOTOR_CURVE_LEN];
+    motor_curve_build(&one, lut);
+    printf("raw,speed\n");
+    for (int raw = 0; raw < MOTOR_CURVE_LEN; raw++) {
+      printf("%d,%d\n", raw, lut[raw]);
+    }
+    check(&one);
+    return fails ? 1 : 0;
+  }
+
+  // the default has to drive exactly like the car did before calibration
+  motor_curve_t linear = MOTOR_CURVE_LINEAR;
+  int16_t lut[MOTOR_CURVE_LEN];
+  motor_curve_build(&linear, lut);
+  for (int raw = 0; raw < MOTOR_CURVE_LEN; raw++) {
+    int old = (raw - 127) * 2;
+    old = old > 255 ? 255 : old;
+    if (lut[raw] != old) {
+      fail(&linear, "differs from the linear mapping", raw, lut[raw]);
+    }
+  }
+
+  uint32_t curves = 0;
+  static const int deadzones[] = {0, 1, 5, 20, 100};
+  static const int expos[] = {0, 30, 70, 100};
+  static const int mins[] = {0, 40, 120};
+  static const int maxes[] = {120, 200, 255};
+  static const int trims[] = {-50, -7, 0, 12, 50};
+  for (size_t d = 0; d < sizeof(deadzones) / sizeof(*deadzones); d++) {
+    for (size_t e = 0; e < sizeof(expos) / sizeof(*expos); e++) {
+      for (size_t m = 0; m < sizeof(mins) / sizeof(*mins); m++) {
+        for (size_t x = 0; x < sizeof(maxes) / sizeof(*maxes); x++) {
+          for (size_t t = 0; t < sizeof(trims) / sizeof(*trims); t++) {
+            for (int r = 0; r <= 1; r++) {
+              motor_curve_t c = {
+                  .deadzone = deadzones[d],
+                  .expo = expos[e],
+                  .min_duty = mins[m],
+                  .max_duty = maxes[x],
+                  .trim = trims[t],
+                  .reverse = r,
+              };
+              if (motor_curve_check(&c) != 0) {
+                continue;
+              }
+              check(&c);
+              curves++;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  motor_curve_t bad = {.min_duty = 200, .max_duty = 100};
+  if (motor_curve_check(&bad) == 0) {
+    fail(&bad, "accepted min_duty over max_duty", 0, 0);
+  }
+
+  printf("%lu curves checked, %d failures\n", (unsigned long)curves, fails);
+  return fails ? 1 : 0;
+}
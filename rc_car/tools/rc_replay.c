@@ -0,0 +1,272 @@
+/*
+  replays a drive session recorded by rc_rec through the same command parse,
+  response curves and motor mix code the car runs, and checks every recorded
+  pwm output against what the code produces now. the curves are rebuilt from
+  the calibration in the export header.
+
+  input is the export read over BLE (RC_REC_OP_SEEK + reads, concatenated) or
+  a serial log holding the REC lines from rc_rec_dump_uart().
+
+    gcc -O2 -I../lib/rc_ble -I../lib/rc_rec -I../../components/motor/include \
+      rc_replay.c ../lib/rc_ble/rc_cmd.c ../../components/motor/motor_mix.c \
+      ../../components/motor/motor_curve.c -o rc_replay
+    ./rc_replay session.bin          # as fast as possible
+    ./rc_replay -x 10 monitor.log    # recorded timing, 10x compressed
+    ./rc_replay -v session.bin       # print every output
+
+  host_test replays traces/rc_drive.log under ctest.
+
+  exits 1 when an output differs, 2 when the input can't be read.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include "motor_curve.h"
+#include "motor_mix.h"
+#include "rc_cmd.h"
+#include "rc_rec_fmt.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// commands that can arrive between the loop taking one and recording it
+#define PENDING_CMDS 32
+#define MISMATCH_PRINT 10
+
+typedef struct {
+  uint32_t ts_us;
+  uint8_t raw;
+} cmd_t;
+
+static uint8_t *read_file(const char *path, size_t *len) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) {
+    return NULL;
+  }
+  size_t cap = 1 << 16, n = 0;
+  uint8_t *buf = malloc(cap);
+  size_t got;
+  while (buf && (got = fread(buf + n, 1, cap - n, f)) > 0) {
+    n += got;
+    if (n == cap) {
+      cap *= 2;
+      buf = realloc(buf, cap);
+    }
+  }
+  fclose(f);
+  *len = n;
+  return buf;
+}
+
+static int hex_nibble(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  return -1;
+}
+
+// pulls the hex payload of "REC,<hex>" lines back into the export image.
+// the last begin marker wins when the log holds several dumps
+static size_t from_log(const char *text, size_t len, uint8_t *out) {
+  size_t n = 0;
+  const char *end = text + len;
+  for (const char *p = text; p < end; p++) {
+    if (end - p < 4 || memcmp(p, "REC,", 4) != 0) {
+      continue;
+    }
+    p += 4;
+    if (end - p >= 6 && memcmp(p, "begin,", 6) == 0) {
+      n = 0;
+      continue;
+    }
+    while (p + 1 < end) {
+      int hi = hex_nibble(p[0]), lo = hex_nibble(p[1]);
+      if (hi < 0 || lo < 0) {
+        break;
+      }
+      out[n++] = (uint8_t)(hi << 4 | lo);
+      p += 2;
+    }
+  }
+  return n;
+}
+
+static void sleep_us(uint64_t us) {
+  struct timespec ts = {.tv_sec = us / 1000000,
+                        .tv_nsec = (us % 1000000) * 1000};
+  nanosleep(&ts, NULL);
+}
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+  double compress = 0;
+  int verbose = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "x:v")) != -1) {
+    switch (opt) {
+    case 'x':
+      compress = atof(optarg);
+      break;
+    case 'v':
+      verbose = 1;
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-x factor] [-v] session.bin|monitor.log\n",
+              argv[0]);
+      return 2;
+    }
+  }
+  if (optind >= argc) {
+    fprintf(stderr, "usage: %s [-x factor] [-v] session.bin|monitor.log\n",
+            argv[0]);
+    return 2;
+  }
+
+  size_t len;
+  uint8_t *data = read_file(argv[optind], &len);
+  if (data == NULL) {
+    perror(argv[optind]);
+    return 2;
+  }
+
+  rc_rec_hdr_t hdr;
+  if (len < sizeof(hdr) || memcmp(data, &(uint32_t){RC_REC_MAGIC}, 4) != 0) {
+    len = from_log((const char *)data, len, data);
+  }
+  if (len < sizeof(hdr)) {
+    fprintf(stderr, "%s: no recording found\n", argv[optind]);
+    return 2;
+  }
+  memcpy(&hdr, data, sizeof(hdr));
+  if (hdr.magic != RC_REC_MAGIC || hdr.version != RC_REC_VERSION ||
+      hdr.rec_size != sizeof(rc_rec_t)) {
+    fprintf(stderr, "%s: not an rc_rec v%d export\n", argv[optind],
+            RC_REC_VERSION);
+    return 2;
+  }
+  if (len < sizeof(hdr) + (size_t)hdr.count * sizeof(rc_rec_t)) {
+    fprintf(stderr, "%s: export truncated\n", argv[optind]);
+    return 2;
+  }
+  const rc_rec_t *recs = (const rc_rec_t *)(data + sizeof(hdr));
+
+  static int16_t lut[RC_REC_MOTORS][MOTOR_CURVE_LEN];
+  for (int m = 0; m < RC_REC_MOTORS; m++) {
+    if (motor_curve_check(&hdr.curve[m]) != 0) {
+      fprintf(stderr, "%s: calibration of motor %c out of range\n",
+              argv[optind], 'A' + m);
+      return 2;
+    }
+    motor_curve_build(&hdr.curve[m], lut[m]);
+  }
+
+  cmd_t pending[PENDING_CMDS];
+  uint32_t n_pending = 0;
+  uint32_t cmds = 0, bad_cmds = 0, outs = 0, orphans = 0, mismatches = 0;
+  uint32_t lat_min = UINT32_MAX, lat_max = 0;
+  uint64_t lat_sum = 0, work_ns = 0;
+  uint64_t start_ns = now_ns();
+
+  for (uint32_t i = 0; i < hdr.count; i++) {
+    const rc_rec_t *rec = &recs[i];
+    if (compress > 0 && i > 0) {
+      sleep_us((uint64_t)((rec->ts_us - recs[i - 1].ts_us) / compress));
+    }
+
+    if (rec->type == RC_REC_CMD) {
+      cmds++;
+      uint64_t t0 = now_ns();
+      rc_cmd_t cmd;
+      int err = rc_cmd_parse(rec->data, rec->len, &cmd);
+      work_ns += now_ns() - t0;
+      if (err != 0) {
+        bad_cmds++;
+        continue;
+      }
+      pending[n_pending++ % PENDING_CMDS] =
+          (cmd_t){.ts_us = rec->ts_us, .raw = cmd.raw};
+      continue;
+    }
+    if (rec->type != RC_REC_OUT) {
+      continue;
+    }
+    outs++;
+
+    // newest command recorded before the one the loop applied was stamped
+    const cmd_t *cmd = NULL;
+    uint32_t back = n_pending < PENDING_CMDS ? n_pending : PENDING_CMDS;
+    for (uint32_t k = 1; k <= back; k++) {
+      const cmd_t *c = &pending[(n_pending - k) % PENDING_CMDS];
+      if ((int32_t)(c->ts_us - rec->ref_us) <= 0) {
+        cmd = c;
+        break;
+      }
+    }
+    if (cmd == NULL) {
+      // its command went out with the ring wrapping
+      orphans++;
+      continue;
+    }
+
+    uint32_t lat = rec->ts_us - rec->ref_us;
+    lat_sum += lat;
+    lat_min = lat < lat_min ? lat : lat_min;
+    lat_max = lat > lat_max ? lat : lat_max;
+
+    uint64_t t0 = now_ns();
+    int a = lut[0][cmd->raw], b = lut[1][cmd->raw];
+    uint32_t duty[MOTOR_CHANNELS];
+    motor_mix_ab(a, b, duty);
+    work_ns += now_ns() - t0;
+
+    int same = a == rec->speed;
+    for (int ch = 0; ch < MOTOR_CHANNELS; ch++) {
+      same = same && duty[ch] == rec->data[ch];
+    }
+    if (verbose || (!same && mismatches < MISMATCH_PRINT)) {
+      printf("%10lu speed %4d duty %3lu %3lu %3lu %3lu",
+             (unsigned long)rec->ts_us, a, (unsigned long)duty[0],
+             (unsigned long)duty[1], (unsigned long)duty[2],
+             (unsigned long)duty[3]);
+      if (!same) {
+        printf("  recorded %4d duty %3u %3u %3u %3u", rec->speed, rec->data[0],
+               rec->data[1], rec->data[2], rec->data[3]);
+      }
+      printf("\n");
+    }
+    mismatches += !same;
+  }
+
+  uint64_t wall_ns = now_ns() - start_ns;
+  uint32_t span_us = hdr.count ? recs[hdr.count - 1].ts_us - recs[0].ts_us : 0;
+  printf("records %lu (%lu overwritten on the car), session %.2f s, replay "
+         "%.2f s\n",
+         (unsigned long)hdr.count, (unsigned long)hdr.overwritten,
+         span_us / 1e6, wall_ns / 1e9);
+  printf("commands %lu (%lu malformed), outputs %lu, without command %lu\n",
+         (unsigned long)cmds, (unsigned long)bad_cmds, (unsigned long)outs,
+         (unsigned long)orphans);
+  if (outs > orphans) {
+    printf("write to pwm on the car: min %lu us, avg %lu us, max %lu us\n",
+           (unsigned long)lat_min,
+           (unsigned long)(lat_sum / (outs - orphans)), (unsigned long)lat_max);
+  }
+  uint32_t events = cmds + outs - orphans;
+  if (events) {
+    printf("parse + curve + mix: %.1f ns per event\n",
+           (double)work_ns / events);
+  }
+  printf("%lu output mismatches\n", (unsigned long)mismatches);
+
+  free(data);
+  return mismatches ? 1 : 0;
+}
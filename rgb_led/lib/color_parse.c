@@ -0,0 +1,66 @@
+#include "color_parse.h"
+#include "cJSON.h"
+#include <string.h>
+
+static bool get_channel(const cJSON *json, const char *name, uint8_t *out) {
+  const cJSON *item = cJSON_GetObjectItem(json, name);
+  if (!cJSON_IsNumber(item) || item->valueint < 0 || item->valueint > 255) {
+    return false;
+  }
+  *out = (uint8_t)item->valueint;
+  return true;
+}
+
+bool color_parse_json(const char *body, uint8_t *r, uint8_t *g, uint8_t *b) {
+  cJSON *json = cJSON_Parse(body);
+  if (json == NULL) {
+    return false;
+  }
+
+  bool ok = get_channel(json, "r", r) && get_channel(json, "g", g) &&
+            get_channel(json, "b", b);
+
+  cJSON_Delete(json);
+  return ok;
+}
+
+static bool get_rgb(const cJSON *json, const char *name, uint8_t rgb[3]) {
+  const cJSON *arr = cJSON_GetObjectItem(json, name);
+  if (!cJSON_IsArray(arr) || cJSON_GetArraySize(arr) != 3) {
+    return false;
+  }
+  for (int i = 0; i < 3; i++) {
+    const cJSON *item = cJSON_GetArrayItem(arr, i);
+    if (!cJSON_IsNumber(item) || item->valueint < 0 || item->valueint > 255) {
+      return false;
+    }
+    rgb[i] = (uint8_t)item->valueint;
+  }
+  return true;
+}
+
+bool color_parse_effect_json(const char *body, sync_effect_t *out) {
+  cJSON *json = cJSON_Parse(body);
+  if (json == NULL) {
+    return false;
+  }
+
+  memset(out, 0, sizeof(*out));
+  out->period_ms = 1000;
+  const cJSON *fx = cJSON_GetObjectItem(json, "fx");
+  const cJSON *period = cJSON_GetObjectItem(json, "period_ms");
+  int type = cJSON_IsString(fx) ? sync_fx_from_name(fx->valuestring) : -1;
+  bool ok = type >= 0 && get_rgb(json, "a", out->a);
+  if (ok && cJSON_GetObjectItem(json, "b") != NULL) {
+    ok = get_rgb(json, "b", out->b);
+  }
+  if (ok && period != NULL) {
+    ok = cJSON_IsNumber(period) && period->valueint >= 20 &&
+         period->valueint <= 3600000;
+    out->period_ms = ok ? (uint32_t)period->valueint : 0;
+  }
+  out->type = (uint8_t)type;
+
+  cJSON_Delete(json);
+  return ok;
+}
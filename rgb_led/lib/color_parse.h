@@ -0,0 +1,16 @@
+#ifndef COLOR_PARSE_H
+#define COLOR_PARSE_H
+
+#include "sync_proto.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// hardware independent parse of the /api/color body {"r":0,"g":0,"b":0}.
+// false when a channel is missing, not a number or outside 0-255
+bool color_parse_json(const char *body, uint8_t *r, uint8_t *g, uint8_t *b);
+// same for the /api/sync body
+// {"fx":"pulse","a":[255,0,0],"b":[0,0,255],"period_ms":2000}, b and
+// period_ms are optional. start_us is left to the leader
+bool color_parse_effect_json(const char *body, sync_effect_t *out);
+
+#endif
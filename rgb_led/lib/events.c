@@ -0,0 +1,306 @@
+#include "events.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "led_fx.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+
+// one formatted event, a subscriber holds at most one per topic
+#define EVENT_MAX 128
+
+static const char *TAG = "EVENTS";
+
+typedef enum {
+  TOPIC_COLOR,
+  TOPIC_LED,
+  TOPIC_STATS,
+  TOPIC_COUNT,
+} topic_t;
+
+typedef union {
+  struct {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    bool fading;
+  } led;
+  struct {
+    int rssi;
+    uint32_t heap_free;
+    uint32_t jitter_max_us;
+  } stats;
+} state_t;
+
+typedef struct {
+  state_t state;
+  uint32_t version; // 0: never published
+} slot_t;
+
+typedef struct {
+  bool used;
+  bool dead; // a send failed, httpd frees the slot once it closes the session
+  int fd;
+  uint32_t seen[TOPIC_COUNT];
+  char out[EVENT_MAX * TOPIC_COUNT];
+  size_t out_len;
+  size_t out_off;
+} subscriber_t;
+
+// latest state per topic, written by any producer
+static slot_t slots[TOPIC_COUNT];
+static portMUX_TYPE slots_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t task = NULL;
+
+// subscribers and stats, httpd adds and frees slots, the events task sends
+static SemaphoreHandle_t subs_lock = NULL;
+static StaticSemaphore_t subs_lock_buf;
+static subscriber_t subs[EVENTS_MAX_SUBSCRIBERS];
+static httpd_handle_t server = NULL;
+static events_stats_t stats;
+static uint64_t fanout_sum_us = 0;
+
+static void publish(topic_t topic, const state_t *state) {
+  portENTER_CRITICAL(&slots_lock);
+  slots[topic].state = *state;
+  slots[topic].version++;
+  portEXIT_CRITICAL(&slots_lock);
+  TaskHandle_t t = __atomic_load_n(&task, __ATOMIC_ACQUIRE);
+  if (t != NULL) {
+    xTaskNotifyGive(t);
+  }
+}
+
+void events_publish_color(uint8_t r, uint8_t g, uint8_t b) {
+  state_t state = {.led = {r, g, b, false}};
+  publish(TOPIC_COLOR, &state);
+}
+
+void events_publish_led(uint8_t r, uint8_t g, uint8_t b, bool fading) {
+  state_t state = {.led = {r, g, b, fading}};
+  publish(TOPIC_LED, &state);
+}
+
+static void publish_stats(void) {
+  state_t state = {0};
+  int rssi = 0;
+  if (esp_wifi_sta_get_rssi(&rssi) == ESP_OK) {
+    state.stats.rssi = rssi;
+  }
+  state.stats.heap_free = esp_get_free_heap_size();
+  jitter_t jitter;
+  led_fx_get_jitter(&jitter);
+  state.stats.jitter_max_us = jitter.max_us;
+  publish(TOPIC_STATS, &state);
+}
+
+static size_t format(topic_t topic, const slot_t *slot, char *buf, size_t len) {
+  const state_t *s = &slot->state;
+  int n = 0;
+  switch (topic) {
+  case TOPIC_COLOR:
+  case TOPIC_LED:
+    n = snprintf(buf,
+      len,
+      "id: %" PRIu32 "\nevent: %s\ndata: {\"r\":%u,\"g\":%u,\"b\":%u,"
+      "\"fading\":%s}\n\n",
+      slot->version,
+      topic == TOPIC_COLOR ? "color" : "led",
+      s->led.r,
+      s->led.g,
+      s->led.b,
+      s->led.fading ? "true" : "false");
+    break;
+  case TOPIC_STATS:
+    n = snprintf(buf,
+      len,
+      "id: %" PRIu32 "\nevent: stats\ndata: {\"rssi\":%d,\"heap_free\":%" PRIu32
+      ",\"jitter_max_us\":%" PRIu32 "}\n\n",
+      slot->version,
+      s->stats.rssi,
+      s->stats.heap_free,
+      s->stats.jitter_max_us);
+    break;
+  default:
+    break;
+  }
+  return n > 0 && (size_t)n < len ? (size_t)n : 0;
+}
+
+// writes what the socket takes without waiting, true once out is empty
+static bool flush(subscriber_t *sub) {
+  while (sub->out_off < sub->out_len) {
+    int n = httpd_socket_send(server,
+      sub->fd,
+      sub->out + sub->out_off,
+      sub->out_len - sub->out_off,
+      MSG_DONTWAIT);
+    if (n == HTTPD_SOCK_ERR_TIMEOUT || n == 0) {
+      stats.blocked++;
+      return false;
+    }
+    if (n < 0) {
+      // httpd sees the broken connection as well and closes it, closing it
+      // from here could hit a reused fd
+      sub->dead = true;
+      return false;
+    }
+    sub->out_off += n;
+  }
+  sub->out_len = 0;
+  sub->out_off = 0;
+  return true;
+}
+
+static void fan_out(const slot_t *snap, bool ping) {
+  int64_t start = esp_timer_get_time();
+  uint32_t active = 0;
+
+  xSemaphoreTake(subs_lock, portMAX_DELAY);
+  for (int i = 0; i < EVENTS_MAX_SUBSCRIBERS; i++) {
+    subscriber_t *sub = &subs[i];
+    if (!sub->used || sub->dead) {
+      continue;
+    }
+    active++;
+    // a blocked subscriber gets the newest states once it drained
+    if (!flush(sub)) {
+      continue;
+    }
+
+    for (int t = 0; t < TOPIC_COUNT; t++) {
+      if (snap[t].version == sub->seen[t]) {
+        continue;
+      }
+      stats.superseded += snap[t].version - sub->seen[t] - 1;
+      sub->seen[t] = snap[t].version;
+      sub->out_len += format(t,
+        &snap[t],
+        sub->out + sub->out_len,
+        sizeof(sub->out) - sub->out_len);
+      stats.sent++;
+    }
+    if (ping && sub->out_len == 0) {
+      static const char comment[] = ": ping\n\n";
+      memcpy(sub->out, comment, sizeof(comment) - 1);
+      sub->out_len = sizeof(comment) - 1;
+    }
+    flush(sub);
+  }
+
+  stats.subscribers = active;
+  if (active > 0) {
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+    stats.passes++;
+    fanout_sum_us += elapsed;
+    stats.fanout_avg_us = (uint32_t)(fanout_sum_us / stats.passes);
+    if (elapsed > stats.fanout_max_us) {
+      stats.fanout_max_us = elapsed;
+    }
+  }
+  xSemaphoreGive(subs_lock);
+}
+
+esp_err_t events_init(void) {
+  subs_lock = xSemaphoreCreateMutexStatic(&subs_lock_buf);
+  return ESP_OK;
+}
+
+void events_task(void *param) {
+  __atomic_store_n(&task, xTaskGetCurrentTaskHandle(), __ATOMIC_RELEASE);
+
+  int64_t last_stats = 0;
+  int64_t last_ping = esp_timer_get_time();
+  for (;;) {
+    // woken by every publish, the timeout retries blocked subscribers
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(EVENTS_RETRY_MS));
+
+    int64_t now = esp_timer_get_time();
+    if (stats.subscribers > 0 && now - last_stats >= EVENTS_STATS_MS * 1000) {
+      publish_stats();
+      last_stats = now;
+    }
+    bool ping = now - last_ping >= EVENTS_PING_MS * 1000;
+    if (ping) {
+      last_ping = now;
+    }
+
+    slot_t snap[TOPIC_COUNT];
+    portENTER_CRITICAL(&slots_lock);
+    memcpy(snap, slots, sizeof(snap));
+    portEXIT_CRITICAL(&slots_lock);
+    fan_out(snap, ping);
+  }
+}
+
+static void on_session_free(void *ctx) {
+  subscriber_t *sub = ctx;
+  xSemaphoreTake(subs_lock, portMAX_DELAY);
+  sub->used = false;
+  xSemaphoreGive(subs_lock);
+}
+
+esp_err_t events_subscribe(httpd_req_t *req) {
+  xSemaphoreTake(subs_lock, portMAX_DELAY);
+  subscriber_t *sub = NULL;
+  for (int i = 0; i < EVENTS_MAX_SUBSCRIBERS && sub == NULL; i++) {
+    if (!subs[i].used) {
+      sub = &subs[i];
+    }
+  }
+  xSemaphoreGive(subs_lock);
+  if (sub == NULL) {
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_send(req, "too many subscribers", HTTPD_RESP_USE_STRLEN);
+    return ESP_OK;
+  }
+
+  // written by hand, the response never ends. retry sets the client's
+  // reconnect delay
+  static const char head[] = "HTTP/1.1 200 OK\r\n"
+                             "Content-Type: text/event-stream\r\n"
+                             "Cache-Control: no-cache\r\n"
+                             "Access-Control-Allow-Origin: *\r\n"
+                             "\r\n"
+                             "retry: 2000\n\n";
+  if (httpd_send(req, head, sizeof(head) - 1) != sizeof(head) - 1) {
+    return ESP_FAIL;
+  }
+
+  xSemaphoreTake(subs_lock, portMAX_DELAY);
+  memset(sub, 0, sizeof(*sub));
+  sub->fd = httpd_req_to_sockfd(req);
+  // the current state goes out right away, nothing counts as missed
+  portENTER_CRITICAL(&slots_lock);
+  for (int t = 0; t < TOPIC_COUNT; t++) {
+    sub->seen[t] = slots[t].version > 0 ? slots[t].version - 1 : 0;
+  }
+  portEXIT_CRITICAL(&slots_lock);
+  sub->used = true;
+  server = req->handle;
+  stats.connects++;
+  xSemaphoreGive(subs_lock);
+
+  // the slot lives as long as the connection
+  req->sess_ctx = sub;
+  req->free_ctx = on_session_free;
+  // the events task may not run yet, its first pass picks the subscriber up
+  TaskHandle_t t = __atomic_load_n(&task, __ATOMIC_ACQUIRE);
+  if (t != NULL) {
+    xTaskNotifyGive(t);
+  }
+  ESP_LOGI(TAG, "subscriber on fd %d", sub->fd);
+  return ESP_OK;
+}
+
+void events_get_stats(events_stats_t *out) {
+  xSemaphoreTake(subs_lock, portMAX_DELAY);
+  *out = stats;
+  xSemaphoreGive(subs_lock);
+}
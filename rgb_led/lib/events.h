@@ -0,0 +1,55 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+  live state pushed to dashboards as Server-Sent Events on GET /api/events.
+  every topic keeps only its latest state and a version, producers overwrite
+  it and never block. each subscriber remembers the version it last got per
+  topic, so a slow one skips straight to the newest state and the states in
+  between are dropped rather than queued.
+
+    event: color  the target the LED fades to
+    event: led    LED output, every fade step (one per LED_FX_PERIOD_MS)
+    event: stats  rssi, free heap and LED jitter, once a second
+
+  the id is the topic version, a gap means the subscriber missed states.
+*/
+
+#define EVENTS_MAX_SUBSCRIBERS 4
+// blocked sockets are retried this often when nothing new is published
+#define EVENTS_RETRY_MS 50
+#define EVENTS_STATS_MS 1000
+// comment line that lets a dead client show up as a send error
+#define EVENTS_PING_MS 15000
+
+typedef struct {
+  uint32_t subscribers;
+  uint32_t connects;
+  uint32_t sent;       // events written to sockets
+  uint32_t superseded; // states a subscriber never saw, replaced by newer ones
+  uint32_t blocked;    // sends put off because a socket buffer was full
+  // one fan-out pass over all subscribers, passes without any are ignored
+  uint32_t passes;
+  uint32_t fanout_avg_us;
+  uint32_t fanout_max_us;
+} events_stats_t;
+
+// creates the subscriber lock, call it before the events task and httpd start
+esp_err_t events_init(void);
+
+void events_publish_color(uint8_t r, uint8_t g, uint8_t b);
+// from the LED task on every output frame
+void events_publish_led(uint8_t r, uint8_t g, uint8_t b, bool fading);
+
+// GET handler, keeps the connection as a subscriber
+esp_err_t events_subscribe(httpd_req_t *req);
+// listed in the app task table, formats and sends the events
+void events_task(void *param);
+void events_get_stats(events_stats_t *out);
+
+#endif
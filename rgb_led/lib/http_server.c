@@ -1,11 +1,39 @@
+#include "boot_init.h"
 #include "cJSON.h"
+#include "color_parse.h"
+#include "dlog.h"
 #include "esp_err.h"
 #include "esp_http_server.h"
 #include "esp_log.h"
-#include "rgb_led.h"
+#include "esp_timer.h"
+#include "events.h"
+#include "led_fx.h"
+#include "ota.h"
+#include "prov.h"
+#include "report.h"
+#include "sdkconfig.h"
+#include "sync.h"
+#include "task_table.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "wifi.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+// size of the download served by /api/throughput
+#define THROUGHPUT_BYTES (256 * 1024)
+#define THROUGHPUT_CHUNK 1436
+// one flash sector per esp_ota_write
+#define OTA_RECV_CHUNK 4096
+#define OTA_RECV_RETRIES 5
 
 static const char *TAG = "HTTP_SERVER";
 
+// last measured download rate, split by whether BLE shared the radio
+static uint32_t kbps_ble_on = 0;
+static uint32_t kbps_ble_off = 0;
+
 static esp_err_t root_handler(httpd_req_t *req) {
   const char *html =
     "<!DOCTYPE html>"
@@ -22,6 +50,8 @@ static esp_err_t root_handler(httpd_req_t *req) {
     "<body>"
     "<h1>RGB LED Control</h1>"
     "<div class='color-preview' id='preview'></div>"
+    "<label>LED now</label>"
+    "<div class='color-preview' id='led'></div>"
     "<label>Red: <span id='r-val'>0</span></label><br>"
     "<input type='range' id='r' min='0' max='255' value='0'><br>"
     "<label>Green: <span id='g-val'>0</span></label><br>"
@@ -57,6 +87,12 @@ static esp_err_t root_handler(httpd_req_t *req) {
     "document.getElementById('g').oninput = update;"
     "document.getElementById('b').oninput = update;"
     "document.getElementById('btn').addEventListener('click', setColor);"
+    "const events = new EventSource('/api/events');"
+    "events.addEventListener('led', e => {"
+    "  const s = JSON.parse(e.data);"
+    "  document.getElementById('led').style.backgroundColor = "
+    "`rgb(${s.r},${s.g},${s.b})`;"
+    "});"
     "</script>"
     "</body>"
     "</html>";
@@ -74,53 +110,445 @@ static esp_err_t color_handler(httpd_req_t *req) {
   }
   buf[ret] = '\0';
 
-  cJSON *json = cJSON_Parse(buf);
+  uint8_t r, g, b;
+  if (!color_parse_json(buf, &r, &g, &b)) {
+    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "expected {r,g,b} 0-255");
+    return ESP_FAIL;
+  }
+
+  // the LED task fades to it on its own core
+  if (!led_fx_submit(r, g, b)) {
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_send(req, "busy", HTTPD_RESP_USE_STRLEN);
+    return ESP_OK;
+  }
+  DLOGI_EVERY(TAG, 100, "Set RGB: %d, %d, %d", r, g, b);
+  report_color(r, g, b);
+
+  httpd_resp_set_status(req, "200 OK");
+  httpd_resp_send(req, "OK", HTTPD_RESP_USE_STRLEN);
+  return ESP_OK;
+}
+
+#if CONFIG_LED_SYNC_ENABLE
+static esp_err_t sync_handler(httpd_req_t *req) {
+  char buf[160];
+  int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
+  if (ret <= 0) {
+    httpd_resp_send_500(req);
+    return ESP_FAIL;
+  }
+  buf[ret] = '\0';
+
+  sync_effect_t fx;
+  if (!color_parse_effect_json(buf, &fx)) {
+    httpd_resp_send_err(
+      req, HTTPD_400_BAD_REQUEST, "expected {fx,a:[r,g,b],b,period_ms}");
+    return ESP_FAIL;
+  }
+
+  esp_err_t esp_err = sync_set_effect(&fx);
+  if (esp_err != ESP_OK) {
+    httpd_resp_set_status(req, "409 Conflict");
+    httpd_resp_send(req, "not the sync leader", HTTPD_RESP_USE_STRLEN);
+    return ESP_OK;
+  }
+  DLOGI(TAG, "Sync effect: %d", fx.type);
+
+  httpd_resp_set_status(req, "200 OK");
+  httpd_resp_send(req, "OK", HTTPD_RESP_USE_STRLEN);
+  return ESP_OK;
+}
+#endif
+
+static esp_err_t throughput_handler(httpd_req_t *req) {
+  static char chunk[THROUGHPUT_CHUNK];
+  memset(chunk, 'x', sizeof(chunk));
+
+  bool ble_on = prov_is_active();
+  int64_t start = esp_timer_get_time();
+
+  httpd_resp_set_type(req, "application/octet-stream");
+  for (size_t sent = 0; sent < THROUGHPUT_BYTES; sent += sizeof(chunk)) {
+    size_t len = THROUGHPUT_BYTES - sent;
+    if (len > sizeof(chunk)) {
+      len = sizeof(chunk);
+    }
+    if (httpd_resp_send_chunk(req, chunk, len) != ESP_OK) {
+      return ESP_FAIL;
+    }
+  }
+  httpd_resp_send_chunk(req, NULL, 0);
+
+  int64_t elapsed_us = esp_timer_get_time() - start;
+  uint32_t kbps =
+    elapsed_us > 0 ? (uint32_t)(THROUGHPUT_BYTES * 8000LL / elapsed_us) : 0;
+  if (ble_on) {
+    kbps_ble_on = kbps;
+  } else {
+    kbps_ble_off = kbps;
+  }
+  ESP_LOGI(TAG, "Throughput %" PRIu32 " kbit/s, BLE %s", kbps,
+    ble_on ? "on" : "off");
+  return ESP_OK;
+}
+
+static bool parse_sha256(const char *hex, uint8_t out[OTA_SHA256_LEN]) {
+  if (strlen(hex) != OTA_SHA256_LEN * 2) {
+    return false;
+  }
+  for (int i = 0; i < OTA_SHA256_LEN; i++) {
+    char byte[3] = {hex[2 * i], hex[2 * i + 1], '\0'};
+    char *end;
+    out[i] = (uint8_t)strtoul(byte, &end, 16);
+    if (*end != '\0') {
+      return false;
+    }
+  }
+  return true;
+}
+
+// compares every byte so the time taken doesn't tell how much matched
+static bool token_equal(const char *a, const char *b, size_t len) {
+  uint8_t diff = 0;
+  for (size_t i = 0; i < len; i++) {
+    diff |= (uint8_t)(a[i] ^ b[i]);
+  }
+  return diff == 0;
+}
+
+// "Authorization: Bearer <CONFIG_OTA_TOKEN>", no token configured means no
+// network updates at all. sends the error response itself
+static bool ota_authorized(httpd_req_t *req) {
+  static const char prefix[] = "Bearer ";
+  const char *token = CONFIG_OTA_TOKEN;
+  size_t token_len = strlen(token);
+  if (token_len == 0) {
+    httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, "OTA disabled");
+    return false;
+  }
+
+  size_t want = sizeof(prefix) - 1 + token_len;
+  size_t len = httpd_req_get_hdr_value_len(req, "Authorization");
+  if (len == 0) {
+    httpd_resp_set_hdr(req, "WWW-Authenticate", "Bearer");
+    httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "token required");
+    return false;
+  }
+  char *value = malloc(len + 1);
+  if (value == NULL) {
+    httpd_resp_send_500(req);
+    return false;
+  }
+  bool ok =
+    httpd_req_get_hdr_value_str(req, "Authorization", value, len + 1) ==
+      ESP_OK &&
+    len == want && strncmp(value, prefix, sizeof(prefix) - 1) == 0 &&
+    token_equal(value + sizeof(prefix) - 1, token, token_len);
+  free(value);
+  if (!ok) {
+    ESP_LOGW(TAG, "OTA upload with a wrong token refused");
+    httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, "bad token");
+  }
+  return ok;
+}
+
+// raw image in the body, optional X-Image-SHA256 hex digest. the body goes to
+// flash a sector at a time as it comes off the socket
+static esp_err_t ota_handler(httpd_req_t *req) {
+  if (!ota_authorized(req)) {
+    return ESP_FAIL;
+  }
+
+  char hex[OTA_SHA256_LEN * 2 + 1];
+  uint8_t expected[OTA_SHA256_LEN];
+  bool check = false;
+  if (httpd_req_get_hdr_value_str(req, "X-Image-SHA256", hex, sizeof(hex)) ==
+      ESP_OK) {
+    if (!parse_sha256(hex, expected)) {
+      httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "bad X-Image-SHA256");
+      return ESP_FAIL;
+    }
+    check = true;
+  }
+
+  esp_err_t err = ota_begin(req->content_len);
+  if (err == ESP_ERR_INVALID_SIZE) {
+    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "image too large");
+    return ESP_FAIL;
+  }
+  if (err != ESP_OK) {
+    httpd_resp_send_500(req);
+    return ESP_FAIL;
+  }
+
+  static char chunk[OTA_RECV_CHUNK];
+  size_t left = req->content_len;
+  int retries = 0;
+  while (left > 0) {
+    int ret = httpd_req_recv(
+      req, chunk, left < sizeof(chunk) ? left : sizeof(chunk));
+    if (ret == HTTPD_SOCK_ERR_TIMEOUT && retries++ < OTA_RECV_RETRIES) {
+      continue;
+    }
+    if (ret <= 0) {
+      ota_abort();
+      ESP_LOGE(TAG, "ota_handler; receive failed with %u bytes left ",
+        (unsigned)left);
+      return ESP_FAIL;
+    }
+    retries = 0;
+    if (ota_write(chunk, ret) != ESP_OK) {
+      httpd_resp_send_500(req);
+      return ESP_FAIL;
+    }
+    left -= ret;
+  }
+
+  err = ota_end(check ? expected : NULL);
+  if (err == ESP_ERR_INVALID_CRC) {
+    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "sha256 mismatch");
+    return ESP_FAIL;
+  }
+  if (err != ESP_OK) {
+    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "invalid image");
+    return ESP_FAIL;
+  }
+
+  ota_stats_t ota;
+  ota_get_stats(&ota);
+  char body[64];
+  snprintf(body, sizeof(body), "{\"bytes\":%u,\"ms\":%u,\"kbps\":%u}",
+    (unsigned)ota.bytes, (unsigned)ota.ms, (unsigned)ota.kbps);
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_send(req, body, HTTPD_RESP_USE_STRLEN);
+
+  ota_reboot_later();
+  return ESP_OK;
+}
+
+static esp_err_t stats_handler(httpd_req_t *req) {
+  prov_stats_t prov;
+  prov_get_stats(&prov);
+  wifi_conn_metrics_t wifi;
+  wifi_get_metrics(&wifi);
+
+  cJSON *json = cJSON_CreateObject();
   if (json == NULL) {
     httpd_resp_send_500(req);
     return ESP_FAIL;
   }
 
-  int r = cJSON_GetObjectItem(json, "r")->valueint;
-  int g = cJSON_GetObjectItem(json, "g")->valueint;
-  int b = cJSON_GetObjectItem(json, "b")->valueint;
+  cJSON *ble = cJSON_AddObjectToObject(json, "ble");
+  cJSON_AddBoolToObject(ble, "active", prov.active);
+  cJSON_AddNumberToObject(ble, "sessions", prov.sessions);
+  cJSON_AddNumberToObject(ble, "active_ms", (double)prov.active_ms);
+  cJSON_AddNumberToObject(ble, "heap_free_on", prov.heap_free_ble_on);
+  cJSON_AddNumberToObject(ble, "heap_free_off", prov.heap_free_ble_off);
+  cJSON_AddNumberToObject(ble, "heap_reclaimed", prov.heap_reclaimed);
+  cJSON_AddNumberToObject(ble, "largest_block_on", prov.largest_block_ble_on);
+  cJSON_AddNumberToObject(
+    ble, "largest_block_off", prov.largest_block_ble_off);
+  cJSON_AddNumberToObject(ble, "kbps_ble_on", kbps_ble_on);
+  cJSON_AddNumberToObject(ble, "kbps_ble_off", kbps_ble_off);
 
-  set_rgb(r, g, b);
-  ESP_LOGI(TAG, "Set RGB: %d, %d, %d", r, g, b);
+  cJSON *conn = cJSON_AddObjectToObject(json, "wifi");
+  cJSON_AddNumberToObject(conn, "attempts", wifi.attempts);
+  cJSON_AddNumberToObject(conn, "fast_connects", wifi.fast_connects);
+  cJSON_AddNumberToObject(conn, "scan_ms", (double)(wifi.scan_us / 1000));
+  cJSON_AddNumberToObject(conn, "auth_ms", (double)(wifi.auth_us / 1000));
+  cJSON_AddNumberToObject(conn, "dhcp_ms", (double)(wifi.dhcp_us / 1000));
+  cJSON_AddNumberToObject(conn, "total_ms", (double)(wifi.total_us / 1000));
 
+  jitter_t jitter;
+  led_fx_get_jitter(&jitter);
+  cJSON *led = cJSON_AddObjectToObject(json, "led");
+  cJSON_AddStringToObject(led, "cores", TASK_PARTITION_NAME);
+  cJSON_AddNumberToObject(led, "ticks", jitter.samples);
+  cJSON_AddNumberToObject(led, "jitter_avg_us", jitter_avg_us(&jitter));
+  cJSON_AddNumberToObject(led, "jitter_max_us", jitter.max_us);
+  uint32_t p99 = jitter_percentile_us(&jitter, 99);
+  // -1: over the last histogram bound
+  cJSON_AddNumberToObject(
+    led, "jitter_p99_us", p99 == UINT32_MAX ? -1.0 : (double)p99);
+
+  ota_stats_t ota;
+  ota_get_stats(&ota);
+  cJSON *update = cJSON_AddObjectToObject(json, "ota");
+  cJSON_AddNumberToObject(update, "updates", ota.updates);
+  cJSON_AddNumberToObject(update, "failures", ota.failures);
+  cJSON_AddNumberToObject(update, "last_err", ota.last_err);
+  cJSON_AddNumberToObject(update, "bytes", ota.bytes);
+  cJSON_AddNumberToObject(update, "ms", ota.ms);
+  cJSON_AddNumberToObject(update, "kbps", ota.kbps);
+
+  boot_prof_t boot;
+  if (boot_init_get(&boot, false)) {
+    cJSON *bt = cJSON_AddObjectToObject(json, "boot");
+    cJSON_AddBoolToObject(bt, "parallel", boot.parallel);
+    cJSON_AddNumberToObject(bt, "init_us", boot.total_us);
+    cJSON_AddNumberToObject(bt, "poweron_us", boot.poweron_us);
+    // ready marks, us after app start
+    for (int i = 0; i < boot.marks; i++) {
+      const boot_event_t *mark = &boot.ev[boot.steps + i];
+      cJSON_AddNumberToObject(bt, mark->name, mark->start_us);
+    }
+  }
+
+  sync_stats_t sy;
+  sync_get_stats(&sy);
+  if (sy.enabled) {
+    cJSON *ls = cJSON_AddObjectToObject(json, "sync");
+    cJSON_AddStringToObject(ls, "role", sy.leader ? "leader" : "follower");
+    cJSON_AddBoolToObject(ls, "synced", sy.synced);
+    cJSON_AddStringToObject(ls, "effect", sync_fx_name(sy.effect.type));
+    cJSON_AddNumberToObject(ls, "sent", sy.sent);
+    cJSON_AddNumberToObject(ls, "received", sy.received);
+    cJSON_AddNumberToObject(ls, "effects", sy.node.effects);
+    cJSON_AddNumberToObject(ls, "exchanges", sy.node.exchanges);
+    cJSON_AddNumberToObject(ls, "outliers", sy.node.outliers);
+    cJSON_AddNumberToObject(ls, "leader_changes", sy.node.leader_changes);
+    cJSON_AddNumberToObject(ls, "offset_us", (double)sy.node.last_offset_us);
+    cJSON_AddNumberToObject(ls, "delay_us", (double)sy.node.last_delay_us);
+    cJSON_AddNumberToObject(ls, "drift_ppb", sy.node.drift_ppb);
+  }
+
+  events_stats_t ev;
+  events_get_stats(&ev);
+  cJSON *sse = cJSON_AddObjectToObject(json, "events");
+  cJSON_AddNumberToObject(sse, "subscribers", ev.subscribers);
+  cJSON_AddNumberToObject(sse, "connects", ev.connects);
+  cJSON_AddNumberToObject(sse, "sent", ev.sent);
+  cJSON_AddNumberToObject(sse, "superseded", ev.superseded);
+  cJSON_AddNumberToObject(sse, "blocked", ev.blocked);
+  cJSON_AddNumberToObject(sse, "passes", ev.passes);
+  cJSON_AddNumberToObject(sse, "fanout_avg_us", ev.fanout_avg_us);
+  cJSON_AddNumberToObject(sse, "fanout_max_us", ev.fanout_max_us);
+
+  telemetry_stats_t tlm;
+  telemetry_get_stats(&tlm);
+  cJSON *mqtt = cJSON_AddObjectToObject(json, "telemetry");
+  cJSON_AddBoolToObject(mqtt, "connected", tlm.connected);
+  cJSON_AddNumberToObject(mqtt, "connects", tlm.connects);
+  cJSON_AddNumberToObject(mqtt, "records", tlm.records);
+  cJSON_AddNumberToObject(mqtt, "dropped_records", tlm.dropped_records);
+  cJSON_AddNumberToObject(mqtt, "batches", tlm.batches);
+  cJSON_AddNumberToObject(mqtt, "bytes", tlm.bytes);
+  cJSON_AddNumberToObject(mqtt, "published", tlm.published);
+  cJSON_AddNumberToObject(mqtt, "queued", tlm.queued);
+  cJSON_AddNumberToObject(mqtt, "drained", tlm.drained);
+  cJSON_AddNumberToObject(mqtt, "dropped_batches", tlm.dropped_batches);
+  cJSON_AddNumberToObject(mqtt, "queue_depth", tlm.queue_depth);
+  cJSON_AddNumberToObject(mqtt, "last_drain_batches", tlm.last_drain_batches);
+  cJSON_AddNumberToObject(mqtt, "last_drain_ms", tlm.last_drain_ms);
+
+  char *body = cJSON_PrintUnformatted(json);
   cJSON_Delete(json);
+  if (body == NULL) {
+    httpd_resp_send_500(req);
+    return ESP_FAIL;
+  }
 
-  httpd_resp_set_status(req, "200 OK");
-  httpd_resp_send(req, "OK", HTTPD_RESP_USE_STRLEN);
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_send(req, body, HTTPD_RESP_USE_STRLEN);
+  cJSON_free(body);
   return ESP_OK;
 }
 
+static esp_err_t trace_handler(httpd_req_t *req) {
+  size_t size = trace_dump_size();
+  uint8_t *buf = malloc(size);
+  if (buf == NULL) {
+    httpd_resp_send_500(req);
+    return ESP_FAIL;
+  }
+  size_t len = trace_dump(buf, size);
+  httpd_resp_set_type(req, "application/octet-stream");
+  esp_err_t err = httpd_resp_send(req, (const char *)buf, len);
+  free(buf);
+  return err;
+}
+
+static esp_err_t trace_tasks_handler(httpd_req_t *req) {
+  static char buf[1024];
+  size_t len = trace_task_stats(buf, sizeof(buf));
+  httpd_resp_set_type(req, "text/csv");
+  return httpd_resp_send(req, buf, len);
+}
+
+// wraps a handler in a trace span named after the endpoint
+#define TRACED_HANDLER(fn, id)                                                \
+  static esp_err_t fn##_traced(httpd_req_t *req) {                            \
+    TRACE_BEGIN(id);                                                          \
+    esp_err_t err = fn(req);                                                  \
+    TRACE_END(id);                                                            \
+    return err;                                                               \
+  }
+
+TRACED_HANDLER(root_handler, TRACE_HTTP_ROOT)
+TRACED_HANDLER(color_handler, TRACE_HTTP_COLOR)
+TRACED_HANDLER(stats_handler, TRACE_HTTP_STATS)
+TRACED_HANDLER(throughput_handler, TRACE_HTTP_THROUGHPUT)
+TRACED_HANDLER(trace_handler, TRACE_HTTP_TRACE)
+TRACED_HANDLER(ota_handler, TRACE_HTTP_OTA)
+#if CONFIG_LED_SYNC_ENABLE
+TRACED_HANDLER(sync_handler, TRACE_HTTP_SYNC)
+#endif
+
+// registered in this order, /api/sync only with LED sync built in
+static const httpd_uri_t uris[] = {
+  {.uri = "/", .method = HTTP_GET, .handler = root_handler_traced},
+  {.uri = "/api/color", .method = HTTP_POST, .handler = color_handler_traced},
+#if CONFIG_LED_SYNC_ENABLE
+  {.uri = "/api/sync", .method = HTTP_POST, .handler = sync_handler_traced},
+#endif
+  {.uri = "/api/stats", .method = HTTP_GET, .handler = stats_handler_traced},
+  {
+    .uri = "/api/throughput",
+    .method = HTTP_GET,
+    .handler = throughput_handler_traced,
+  },
+  {.uri = "/api/trace", .method = HTTP_GET, .handler = trace_handler_traced},
+  {
+    .uri = "/api/trace/tasks",
+    .method = HTTP_GET,
+    .handler = trace_tasks_handler,
+  },
+  {.uri = "/api/ota", .method = HTTP_POST, .handler = ota_handler_traced},
+  {.uri = "/api/events", .method = HTTP_GET, .handler = events_subscribe},
+};
+
+#define URI_COUNT (sizeof(uris) / sizeof(uris[0]))
+// the default of 8 silently dropped the last endpoint once there were 9
+#define URI_HEADROOM 2
+
 httpd_handle_t start_webserver(void) {
   httpd_config_t config = HTTPD_DEFAULT_CONFIG();
   httpd_handle_t server = NULL;
 
-  if (httpd_start(&server, &config) == ESP_OK) {
-    httpd_uri_t root = {
-      .uri = "/",
-      .method = HTTP_GET,
-      .handler = root_handler,
-    };
-    httpd_register_uri_handler(server, &root);
+  // stack, priority and core come from the app task table
+  const task_def_t *task = task_table_find("httpd");
+  if (task != NULL) {
+    config.stack_size = task->stack_size;
+    config.task_priority = task->priority;
+    config.core_id = task->core;
+  }
+  config.max_uri_handlers = URI_COUNT + URI_HEADROOM;
 
-    httpd_uri_t color = {
-      .uri = "/api/color",
-      .method = HTTP_POST,
-      .handler = color_handler,
-    };
-    httpd_register_uri_handler(server, &color);
+  esp_err_t esp_err = httpd_start(&server, &config);
+  if (esp_err != ESP_OK) {
+    ESP_LOGE(TAG, "httpd_start; error code: %d ", esp_err);
+    return NULL;
+  }
 
-    ESP_LOGI(TAG, "Web server started");
+  for (size_t i = 0; i < URI_COUNT; i++) {
+    esp_err = httpd_register_uri_handler(server, &uris[i]);
+    if (esp_err != ESP_OK) {
+      ESP_LOGE(TAG, "httpd_register_uri_handler %s; error code: %d ",
+        uris[i].uri, esp_err);
+    }
   }
 
+  ESP_LOGI(TAG, "Web server started");
   return server;
 }
-
-// void stop_webserver(httpd_handle_t server) {
-//   if (server) {
-//     httpd_stop(server);
-//   }
-// }
\ No newline at end of file
@@ -0,0 +1,172 @@
+#include "led_fx.h"
+#include "boot_init.h"
+#include "esp_timer.h"
+#include "events.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "led.h"
+#include "spsc.h"
+
+typedef struct {
+  uint8_t r;
+  uint8_t g;
+  uint8_t b;
+} led_color_t;
+
+// producer: httpd, consumer: led_fx_task
+SPSC_DEFINE(color_queue, led_color_t, 8);
+
+// shown as soon as the task runs, ahead of WiFi and BLE
+static const led_color_t boot_color = {255, 0, 0};
+
+static TaskHandle_t task = NULL;
+static led_fx_frame_fn frame_fn = NULL;
+// wakes the task on a frame's due time, ticks are too coarse for that
+static esp_timer_handle_t frame_timer = NULL;
+static jitter_t jitter;
+static portMUX_TYPE jitter_lock = portMUX_INITIALIZER_UNLOCKED;
+
+bool led_fx_submit(uint8_t r, uint8_t g, uint8_t b) {
+  led_color_t color = {r, g, b};
+  if (!spsc_push(&color_queue, &color)) {
+    return false;
+  }
+  if (task != NULL) {
+    xTaskNotifyGive(task);
+  }
+  return true;
+}
+
+void led_fx_follow(led_fx_frame_fn fn) {
+  __atomic_store_n(&frame_fn, fn, __ATOMIC_RELEASE);
+  if (task != NULL) {
+    xTaskNotifyGive(task);
+  }
+}
+
+void led_fx_get_jitter(jitter_t *out) {
+  portENTER_CRITICAL(&jitter_lock);
+  *out = jitter;
+  portEXIT_CRITICAL(&jitter_lock);
+}
+
+// newest queued color, older ones are skipped
+static bool take_latest(led_color_t *out) {
+  bool found = false;
+  while (spsc_pop(&color_queue, out)) {
+    found = true;
+  }
+  return found;
+}
+
+static uint8_t lerp(uint8_t from, uint8_t to, int step, int steps) {
+  return (uint8_t)(from + ((int)to - (int)from) * step / steps);
+}
+
+static void frame_timer_cb(void *arg) { xTaskNotifyGive(task); }
+
+// shows frames on their due time until a color is submitted (returned in
+// target) or following stops
+static bool follow_frames(led_color_t *cur, led_color_t *target) {
+  portENTER_CRITICAL(&jitter_lock);
+  jitter_restart(&jitter);
+  portEXIT_CRITICAL(&jitter_lock);
+
+  for (;;) {
+    led_fx_frame_fn fn = __atomic_load_n(&frame_fn, __ATOMIC_ACQUIRE);
+    if (fn == NULL) {
+      return false;
+    }
+
+    int64_t due;
+    uint8_t rgb[3];
+    if (!fn(esp_timer_get_time(), &due, rgb)) {
+      // no clock or effect yet, look again shortly
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LED_FX_PERIOD_MS * 10));
+    } else {
+      int64_t wait = due - esp_timer_get_time();
+      if (wait > 0) {
+        esp_timer_start_once(frame_timer, wait);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        esp_timer_stop(frame_timer);
+      }
+      if (esp_timer_get_time() >= due) {
+        portENTER_CRITICAL(&jitter_lock);
+        jitter_sample(&jitter, esp_timer_get_time());
+        portEXIT_CRITICAL(&jitter_lock);
+
+        cur->r = rgb[0];
+        cur->g = rgb[1];
+        cur->b = rgb[2];
+        led_set_rgb(cur->r, cur->g, cur->b);
+        events_publish_led(cur->r, cur->g, cur->b, true);
+      }
+    }
+
+    // a local color leaves the sync until the next effect
+    if (take_latest(target)) {
+      __atomic_store_n(&frame_fn, NULL, __ATOMIC_RELEASE);
+      return true;
+    }
+  }
+}
+
+void led_fx_task(void *param) {
+  const int steps = LED_FX_FADE_MS / LED_FX_PERIOD_MS;
+  led_color_t cur = boot_color;
+  led_color_t target;
+  bool have_target = false;
+
+  jitter_init(&jitter, LED_FX_PERIOD_MS * 1000);
+  esp_timer_create_args_t timer_args = {
+    .callback = frame_timer_cb,
+    .name = "led_frame",
+  };
+  esp_timer_create(&timer_args, &frame_timer);
+  task = xTaskGetCurrentTaskHandle();
+
+  // lit here rather than through the queue, httpd stays its only producer
+  led_set_rgb(cur.r, cur.g, cur.b);
+  boot_init_mark("led");
+
+  for (;;) {
+    if (!have_target && !take_latest(&target)) {
+      if (__atomic_load_n(&frame_fn, __ATOMIC_ACQUIRE) != NULL) {
+        have_target = follow_frames(&cur, &target);
+      } else {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      }
+      continue;
+    }
+    have_target = false;
+    events_publish_color(target.r, target.g, target.b);
+
+    // idle time between fades is not jitter
+    portENTER_CRITICAL(&jitter_lock);
+    jitter_restart(&jitter);
+    portEXIT_CRITICAL(&jitter_lock);
+
+    led_color_t from = cur;
+    TickType_t wake = xTaskGetTickCount();
+    for (int step = 1; step <= steps; step++) {
+      vTaskDelayUntil(&wake, pdMS_TO_TICKS(LED_FX_PERIOD_MS));
+
+      portENTER_CRITICAL(&jitter_lock);
+      jitter_sample(&jitter, esp_timer_get_time());
+      portEXIT_CRITICAL(&jitter_lock);
+
+      cur.r = lerp(from.r, target.r, step, steps);
+      cur.g = lerp(from.g, target.g, step, steps);
+      cur.b = lerp(from.b, target.b, step, steps);
+      led_set_rgb(cur.r, cur.g, cur.b);
+      events_publish_led(cur.r, cur.g, cur.b, step < steps);
+
+      // a newer color restarts the fade from where the LED is now
+      if (take_latest(&target)) {
+        events_publish_color(target.r, target.g, target.b);
+        from = cur;
+        step = 0;
+      }
+    }
+  }
+}
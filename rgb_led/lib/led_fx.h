@@ -0,0 +1,25 @@
+#ifndef LED_FX_H
+#define LED_FX_H
+
+#include "jitter.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define LED_FX_PERIOD_MS 10
+#define LED_FX_FADE_MS 150
+
+// queues a new target color, the LED task fades to it. called from httpd,
+// returns false when the queue is full
+bool led_fx_submit(uint8_t r, uint8_t g, uint8_t b);
+// source of synchronized frames. fills the color of the next frame and the
+// local esp_timer time it is due, false while there is nothing to show
+typedef bool (*led_fx_frame_fn)(
+  int64_t now_us, int64_t *due_us, uint8_t rgb[3]);
+// the LED task shows frames from fn on time until a color is submitted, NULL
+// stops following
+void led_fx_follow(led_fx_frame_fn fn);
+// listed in the app task table
+void led_fx_task(void *param);
+void led_fx_get_jitter(jitter_t *out);
+
+#endif
@@ -0,0 +1,414 @@
+#include "prov.h"
+#include "ble_core.h"
+#include "boot_init.h"
+#include "driver/gpio.h"
+#include "esp_event.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "host/ble_hs.h"
+#include "prov_frame.h"
+#include "trace.h"
+#include "wifi.h"
+#include <inttypes.h>
+#include <string.h>
+
+#define DEVICE_NAME "ESP32-RGB"
+
+#define WIFI_SERVICE_UUID 0x1800
+#define FRAME_CHAR_UUID 0x2A00
+#define STATUS_CHAR_UUID 0x2A03
+
+#define PROV_BUTTON GPIO_NUM_0 // BOOT button
+// advertising window opened by the button on a provisioned device
+#define PROV_WINDOW_MS (120 * 1000)
+// BLE stays up this long after WiFi connects so the client can read status
+#define PROV_LINGER_MS (5 * 1000)
+
+static const char *TAG = "PROV";
+
+ESP_EVENT_DEFINE_BASE(PROV_EVENT);
+
+enum {
+  PROV_EVENT_OPEN,
+  PROV_EVENT_CLOSE,
+};
+
+_Static_assert(PROV_SSID_MAX < WIFI_SSID_MAX_LEN, "SSID does not fit");
+_Static_assert(PROV_PASS_MAX < WIFI_PASS_MAX_LEN, "passphrase does not fit");
+
+static uint8_t own_addr_type;
+static prov_frame_t frame;
+static uint8_t last_status = PROV_ST_IDLE;
+static uint8_t prov_options = 0;
+static uint16_t status_val_handle;
+
+// start/stop only ever run on the default event loop task (or app_main
+// before it has any events), so these need no locking
+static bool ble_running = false;
+static int64_t window_end_us = 0; // 0: open until provisioned
+static int64_t t_started = 0;
+static esp_timer_handle_t close_timer = NULL;
+static prov_stats_t stats = {0};
+
+// GAP events on the host task and the close timer on the esp_timer task
+// both use these, always under conn_lock
+static portMUX_TYPE conn_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool close_pending = false;
+static uint16_t conn_handle = BLE_HS_CONN_HANDLE_NONE;
+
+static void advertise(void);
+
+static void post_close(void) {
+  esp_event_post(PROV_EVENT, PROV_EVENT_CLOSE, NULL, 0, 0);
+}
+
+static void set_status(uint8_t status) {
+  last_status = status;
+  if (ble_running) {
+    // notifies subscribed clients with the value from status_read()
+    ble_gatts_chr_updated(status_val_handle);
+  }
+}
+
+static int handle_chunk(struct ble_gatt_access_ctxt *ctxt) {
+  if (ctxt->op != BLE_GATT_ACCESS_OP_WRITE_CHR) {
+    return BLE_ATT_ERR_UNLIKELY;
+  }
+
+  uint8_t chunk[1 + PROV_FRAME_MAX];
+  uint16_t len = OS_MBUF_PKTLEN(ctxt->om);
+  if (len > sizeof(chunk)) {
+    prov_frame_reset(&frame);
+    set_status(PROV_ST_TOO_LONG);
+    return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+  }
+  os_mbuf_copydata(ctxt->om, 0, len, chunk);
+
+  prov_creds_t creds;
+  prov_status_t status = prov_frame_feed(&frame, chunk, len, &creds);
+  memset(chunk, 0, sizeof(chunk));
+  if (status == PROV_ST_MORE) {
+    return 0;
+  }
+
+  if (status == PROV_ST_OK) {
+    ESP_LOGI(TAG, "Credentials received for '%s'", creds.ssid);
+    prov_options = creds.options;
+    if (wifi_set_credentials(creds.ssid, creds.pass) != ESP_OK) {
+      status = PROV_ST_STORE_FAILED;
+    }
+    memset(&creds, 0, sizeof(creds));
+  } else {
+    ESP_LOGE(TAG, "Rejected provisioning frame; status: %d", status);
+  }
+
+  set_status(status);
+  if (status == PROV_ST_TOO_LONG) {
+    return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+  }
+  // ATT application error range carries the status back on the write
+  return status == PROV_ST_OK ? 0 : 0x80 + status;
+}
+
+static int frame_write(uint16_t conn_handle,
+  uint16_t attr_handle,
+  struct ble_gatt_access_ctxt *ctxt,
+  void *arg) {
+  TRACE_BEGIN(TRACE_BLE_PROV_FRAME);
+  int rc = handle_chunk(ctxt);
+  TRACE_END(TRACE_BLE_PROV_FRAME);
+  return rc;
+}
+
+static int status_read(uint16_t conn_handle,
+  uint16_t attr_handle,
+  struct ble_gatt_access_ctxt *ctxt,
+  void *arg) {
+  TRACE_BEGIN(TRACE_BLE_PROV_STATUS);
+  if (ctxt->op == BLE_GATT_ACCESS_OP_READ_CHR) {
+    uint8_t status[2] = {last_status, wifi_is_connected() ? 1 : 0};
+    os_mbuf_append(ctxt->om, status, sizeof(status));
+  }
+  TRACE_END(TRACE_BLE_PROV_STATUS);
+  return 0;
+};
+
+static const struct ble_gatt_svc_def provision_services[] = {
+  {
+    .type = BLE_GATT_SVC_TYPE_PRIMARY,
+    .uuid = BLE_UUID16_DECLARE(WIFI_SERVICE_UUID),
+    .characteristics =
+      (struct ble_gatt_chr_def[]){
+        {
+          .uuid = BLE_UUID16_DECLARE(FRAME_CHAR_UUID),
+          .access_cb = frame_write,
+          // credentials only travel over an encrypted link
+          .flags = BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_ENC,
+        },
+        {
+          .uuid = BLE_UUID16_DECLARE(STATUS_CHAR_UUID),
+          .access_cb = status_read,
+          .val_handle = &status_val_handle,
+          .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY,
+        },
+        {0}},
+  },
+  {0}};
+
+static int on_gap_event(struct ble_gap_event *event, void *arg) {
+  switch (event->type) {
+  case BLE_GAP_EVENT_CONNECT:
+    if (event->connect.status == 0) {
+      portENTER_CRITICAL(&conn_lock);
+      conn_handle = event->connect.conn_handle;
+      portEXIT_CRITICAL(&conn_lock);
+    } else {
+      advertise();
+    }
+    return 0;
+
+  case BLE_GAP_EVENT_DISCONNECT: {
+    portENTER_CRITICAL(&conn_lock);
+    conn_handle = BLE_HS_CONN_HANDLE_NONE;
+    bool closing = close_pending;
+    portEXIT_CRITICAL(&conn_lock);
+    prov_frame_reset(&frame);
+    if (closing) {
+      post_close();
+    } else {
+      advertise();
+    }
+    return 0;
+  }
+
+  case BLE_GAP_EVENT_ADV_COMPLETE: {
+    portENTER_CRITICAL(&conn_lock);
+    bool idle = conn_handle == BLE_HS_CONN_HANDLE_NONE;
+    portEXIT_CRITICAL(&conn_lock);
+    // advertising duration ran out, the provisioning window is over
+    if (idle) {
+      post_close();
+    }
+    return 0;
+  }
+  }
+  return 0;
+}
+
+static void advertise(void) {
+  int32_t duration_ms = BLE_HS_FOREVER;
+  if (window_end_us != 0) {
+    int64_t left_ms = (window_end_us - esp_timer_get_time()) / 1000;
+    if (left_ms <= 0) {
+      post_close();
+      return;
+    }
+    duration_ms = (int32_t)left_ms;
+  }
+
+  struct ble_hs_adv_fields fields = {0};
+  fields.flags = BLE_HS_ADV_F_DISC_GEN | BLE_HS_ADV_F_BREDR_UNSUP;
+  fields.name = (uint8_t *)DEVICE_NAME;
+  fields.name_len = strlen(DEVICE_NAME);
+  fields.name_is_complete = 1;
+
+  ble_gap_adv_set_fields(&fields);
+
+  struct ble_gap_adv_params adv_params = {0};
+  adv_params.conn_mode = BLE_GAP_CONN_MODE_UND;
+  adv_params.disc_mode = BLE_GAP_DISC_MODE_GEN;
+
+  int nimble_err = ble_gap_adv_start(
+    own_addr_type, NULL, duration_ms, &adv_params, on_gap_event, NULL);
+  if (nimble_err != 0) {
+    ESP_LOGE(TAG, "ble_gap_adv_start; error code: %d ", nimble_err);
+    return;
+  }
+  boot_init_mark("ble_adv");
+}
+
+static void on_stack_sync(void) {
+  own_addr_type = BLE_OWN_ADDR_RANDOM;
+
+  ble_hs_id_infer_auto(0, &own_addr_type);
+
+  stats.heap_free_ble_on = esp_get_free_heap_size();
+  stats.largest_block_ble_on =
+    heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT);
+
+  advertise();
+}
+
+static esp_err_t prov_start(uint32_t window_ms) {
+  if (ble_running) {
+    return ESP_OK;
+  }
+
+  ble_core_cfg_t cfg = {
+    .name = DEVICE_NAME,
+    .svcs = provision_services,
+    .on_sync = on_stack_sync,
+  };
+  esp_err_t esp_err = ble_core_init(&cfg);
+  if (esp_err != ESP_OK) {
+    return esp_err;
+  }
+
+  // just works pairing with LE secure connections, nothing is bonded
+  ble_hs_cfg.sm_io_cap = BLE_SM_IO_CAP_NO_IO;
+  ble_hs_cfg.sm_bonding = 0;
+  ble_hs_cfg.sm_mitm = 0;
+  ble_hs_cfg.sm_sc = 1;
+  ble_hs_cfg.sm_our_key_dist = 0;
+  ble_hs_cfg.sm_their_key_dist = 0;
+
+  ble_running = true;
+  portENTER_CRITICAL(&conn_lock);
+  close_pending = false;
+  portEXIT_CRITICAL(&conn_lock);
+  last_status = PROV_ST_IDLE;
+  prov_options = 0;
+  prov_frame_reset(&frame);
+  t_started = esp_timer_get_time();
+  window_end_us = window_ms ? t_started + (int64_t)window_ms * 1000 : 0;
+  stats.sessions++;
+  stats.active = true;
+  if (window_ms) {
+    esp_timer_start_once(close_timer, (uint64_t)window_ms * 1000);
+  }
+
+  ble_core_start();
+
+  ESP_LOGI(TAG,
+    "Provisioning open%s",
+    window_ms ? " for the button window" : " until provisioned");
+  return ESP_OK;
+}
+
+static void prov_stop(void) {
+  if (!ble_running) {
+    return;
+  }
+  esp_timer_stop(close_timer);
+
+  // waits for the host task, then disables the controller and frees its
+  // memory
+  if (ble_core_stop() != ESP_OK) {
+    return;
+  }
+
+  ble_running = false;
+  portENTER_CRITICAL(&conn_lock);
+  close_pending = false;
+  conn_handle = BLE_HS_CONN_HANDLE_NONE;
+  portEXIT_CRITICAL(&conn_lock);
+
+  stats.active = false;
+  stats.active_ms += (esp_timer_get_time() - t_started) / 1000;
+  stats.heap_free_ble_off = esp_get_free_heap_size();
+  stats.largest_block_ble_off =
+    heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT);
+  stats.heap_reclaimed =
+    (int32_t)stats.heap_free_ble_off - (int32_t)stats.heap_free_ble_on;
+
+  ESP_LOGI(TAG,
+    "BLE stopped, %" PRId32 " bytes of heap reclaimed",
+    stats.heap_reclaimed);
+}
+
+static void prov_event_handler(
+  void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data) {
+  if (event_id == PROV_EVENT_OPEN) {
+    prov_start(PROV_WINDOW_MS);
+  } else if (event_id == PROV_EVENT_CLOSE) {
+    prov_stop();
+  }
+}
+
+// esp_timer task. a client that disconnects in between finds close_pending
+// set and closes the window itself, the terminate then just fails
+static void close_timer_cb(void *arg) {
+  portENTER_CRITICAL(&conn_lock);
+  uint16_t conn = conn_handle;
+  close_pending = conn != BLE_HS_CONN_HANDLE_NONE;
+  portEXIT_CRITICAL(&conn_lock);
+
+  if (conn != BLE_HS_CONN_HANDLE_NONE) {
+    // let the client finish, the disconnect event closes the window
+    ble_gap_terminate(conn, BLE_ERR_REM_USER_CONN_TERM);
+    return;
+  }
+  post_close();
+}
+
+static void IRAM_ATTR button_isr(void *arg) {
+  esp_event_isr_post(PROV_EVENT, PROV_EVENT_OPEN, NULL, 0, NULL);
+}
+
+void prov_on_wifi_connected(void) {
+  if (!ble_running) {
+    return;
+  }
+  set_status(PROV_ST_CONNECTED);
+  if (prov_options & PROV_OPT_KEEP_BLE) {
+    return;
+  }
+  esp_timer_stop(close_timer);
+  esp_timer_start_once(close_timer, (uint64_t)PROV_LINGER_MS * 1000);
+}
+
+void prov_on_wifi_failed(void) {
+  if (ble_running && last_status == PROV_ST_OK) {
+    set_status(PROV_ST_CONN_FAILED);
+  }
+}
+
+bool prov_is_active(void) { return ble_running; }
+
+void prov_get_stats(prov_stats_t *out) { *out = stats; }
+
+esp_err_t prov_init(bool provisioned) {
+  esp_err_t esp_err;
+
+  esp_timer_create_args_t timer_args = {
+    .callback = close_timer_cb,
+    .name = "prov_close",
+  };
+  esp_err = esp_timer_create(&timer_args, &close_timer);
+  if (esp_err != ESP_OK) {
+    ESP_LOGE(TAG, "esp_timer_create; error code: %d ", esp_err);
+    return esp_err;
+  }
+
+  esp_err = esp_event_handler_register(
+    PROV_EVENT, ESP_EVENT_ANY_ID, &prov_event_handler, NULL);
+  if (esp_err != ESP_OK) {
+    ESP_LOGE(TAG, "esp_event_handler_register; error code: %d ", esp_err);
+    return esp_err;
+  }
+
+  gpio_config_t button_cfg = {
+    .pin_bit_mask = 1ULL << PROV_BUTTON,
+    .mode = GPIO_MODE_INPUT,
+    .pull_up_en = GPIO_PULLUP_ENABLE,
+    .intr_type = GPIO_INTR_NEGEDGE,
+  };
+  gpio_config(&button_cfg);
+  esp_err = gpio_install_isr_service(0);
+  if (esp_err != ESP_OK && esp_err != ESP_ERR_INVALID_STATE) {
+    ESP_LOGE(TAG, "gpio_install_isr_service; error code: %d ", esp_err);
+    return esp_err;
+  }
+  gpio_isr_handler_add(PROV_BUTTON, button_isr, NULL);
+
+  if (provisioned) {
+    stats.heap_free_ble_off = esp_get_free_heap_size();
+    stats.largest_block_ble_off =
+      heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT);
+    return ESP_OK;
+  }
+  return prov_start(0);
+}
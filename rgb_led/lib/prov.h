@@ -0,0 +1,29 @@
+#ifndef PROV_H
+#define PROV_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+  uint32_t sessions;          // times the BLE stack was brought up
+  uint32_t heap_free_ble_on;  // free heap with the BLE stack running
+  uint32_t heap_free_ble_off; // free heap after the last shutdown
+  int32_t heap_reclaimed;     // off - on, bytes returned by the shutdown
+  uint32_t largest_block_ble_on;
+  uint32_t largest_block_ble_off;
+  uint64_t active_ms; // total time the radio was shared with BLE
+  bool active;
+} prov_stats_t;
+
+// starts BLE provisioning right away when unprovisioned, otherwise only
+// arms the BOOT button to open a provisioning window
+esp_err_t prov_init(bool provisioned);
+// schedules the BLE shutdown once WiFi has an IP
+void prov_on_wifi_connected(void);
+// reports a failed attempt with freshly provisioned credentials
+void prov_on_wifi_failed(void);
+bool prov_is_active(void);
+void prov_get_stats(prov_stats_t *out);
+
+#endif
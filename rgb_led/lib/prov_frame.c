@@ -0,0 +1,126 @@
+#include "prov_frame.h"
+#include <string.h>
+
+// plain memset can be dropped by the compiler when the buffer is dead
+static void wipe(void *buf, size_t len) {
+  volatile uint8_t *p = buf;
+  while (len--) {
+    *p++ = 0;
+  }
+}
+
+void prov_frame_reset(prov_frame_t *frame) {
+  wipe(frame->buf, sizeof(frame->buf));
+  frame->len = 0;
+  frame->next_seq = 0;
+  frame->open = false;
+}
+
+prov_status_t prov_frame_decode(
+  const uint8_t *buf, uint16_t len, prov_creds_t *out) {
+  bool have_ssid = false;
+  bool have_pass = false;
+  bool have_opts = false;
+
+  memset(out, 0, sizeof(*out));
+
+  uint16_t pos = 0;
+  while (pos < len) {
+    if (len - pos < 2) {
+      return PROV_ST_BAD_TLV;
+    }
+    uint8_t type = buf[pos];
+    uint8_t vlen = buf[pos + 1];
+    const uint8_t *value = &buf[pos + 2];
+    pos += 2;
+    if (vlen > len - pos) {
+      return PROV_ST_BAD_TLV;
+    }
+    pos += vlen;
+
+    switch (type) {
+    case PROV_TLV_SSID:
+      if (have_ssid || vlen == 0 || vlen > PROV_SSID_MAX) {
+        return PROV_ST_BAD_SSID;
+      }
+      memcpy(out->ssid, value, vlen);
+      out->ssid[vlen] = '\0';
+      if (strlen(out->ssid) != vlen) {
+        return PROV_ST_BAD_SSID; // embedded NUL
+      }
+      have_ssid = true;
+      break;
+
+    case PROV_TLV_PASS:
+      if (have_pass || (vlen != 0 && vlen < PROV_PASS_MIN) ||
+          vlen > PROV_PASS_MAX) {
+        return PROV_ST_BAD_PASS;
+      }
+      for (uint8_t i = 0; i < vlen; i++) {
+        if (value[i] < 0x20 || value[i] > 0x7E) {
+          return PROV_ST_BAD_PASS;
+        }
+      }
+      memcpy(out->pass, value, vlen);
+      out->pass[vlen] = '\0';
+      have_pass = true;
+      break;
+
+    case PROV_TLV_OPTIONS:
+      if (have_opts || vlen != 1 || (value[0] & ~PROV_OPT_KEEP_BLE)) {
+        return PROV_ST_BAD_OPTIONS;
+      }
+      out->options = value[0];
+      have_opts = true;
+      break;
+
+    default:
+      return PROV_ST_BAD_TLV;
+    }
+  }
+
+  return have_ssid ? PROV_ST_OK : PROV_ST_BAD_SSID;
+}
+
+prov_status_t prov_frame_feed(prov_frame_t *frame,
+  const uint8_t *data,
+  uint16_t len,
+  prov_creds_t *out) {
+  if (len == 0) {
+    prov_frame_reset(frame);
+    return PROV_ST_BAD_SEQUENCE;
+  }
+
+  uint8_t hdr = data[0];
+  uint8_t seq = hdr & PROV_HDR_SEQ_MASK;
+  data++;
+  len--;
+
+  if (hdr & PROV_HDR_FIRST) {
+    prov_frame_reset(frame);
+    frame->open = true;
+  }
+  if (!frame->open || seq != frame->next_seq) {
+    prov_frame_reset(frame);
+    return PROV_ST_BAD_SEQUENCE;
+  }
+  if (len > sizeof(frame->buf) - frame->len) {
+    prov_frame_reset(frame);
+    return PROV_ST_TOO_LONG;
+  }
+
+  memcpy(&frame->buf[frame->len], data, len);
+  frame->len += len;
+  frame->next_seq = (seq + 1) & PROV_HDR_SEQ_MASK;
+
+  if (!(hdr & PROV_HDR_LAST)) {
+    return PROV_ST_MORE;
+  }
+
+  prov_status_t status = prov_frame_decode(frame->buf, frame->len, out);
+  prov_frame_reset(frame);
+  if (status != PROV_ST_OK) {
+    wipe(out, sizeof(*out));
+  }
+  return status;
+}
@@ -0,0 +1,86 @@
+#ifndef PROV_FRAME_H
+#define PROV_FRAME_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+  provisioning frame, sent as one or more writes to the frame characteristic
+
+  every write starts with a header byte followed by up to MTU-4 bytes of the
+  frame:
+    bit 7    FIRST, starts a new frame and drops anything buffered
+    bit 6    LAST, frame is complete, validate and apply it
+    bit 0-5  sequence number, 0 on FIRST and +1 (mod 64) per write
+
+  the reassembled frame is a list of TLVs (type u8, len u8, value):
+    0x01 SSID        1-31 bytes, no NUL. 802.11 allows 32 but the stored
+                     settings keep it NUL terminated in 32
+    0x02 PASSPHRASE  0 (open network) or 8-63 printable ASCII
+    0x03 OPTIONS     1 byte, PROV_OPT_* bits
+  SSID is required, each type may appear once.
+*/
+
+#define PROV_HDR_FIRST 0x80
+#define PROV_HDR_LAST 0x40
+#define PROV_HDR_SEQ_MASK 0x3F
+
+#define PROV_TLV_SSID 0x01
+#define PROV_TLV_PASS 0x02
+#define PROV_TLV_OPTIONS 0x03
+
+#define PROV_OPT_KEEP_BLE 0x01 // don't shut BLE down after WiFi connects
+
+// one short of the 802.11 limit, see the SSID TLV above
+#define PROV_SSID_MAX 31
+#define PROV_PASS_MIN 8
+#define PROV_PASS_MAX 63
+#define PROV_FRAME_MAX 128
+
+// result codes, also the first byte of the status characteristic
+typedef enum {
+  PROV_ST_OK = 0x00,
+  PROV_ST_BAD_SEQUENCE = 0x01,
+  PROV_ST_TOO_LONG = 0x02,
+  PROV_ST_BAD_TLV = 0x03,
+  // missing, repeated, with a NUL, or longer than PROV_SSID_MAX (31, a
+  // 32 byte SSID can't be provisioned)
+  PROV_ST_BAD_SSID = 0x04,
+  PROV_ST_BAD_PASS = 0x05,
+  PROV_ST_BAD_OPTIONS = 0x06,
+  PROV_ST_STORE_FAILED = 0x07,
+  PROV_ST_IDLE = 0x0F,
+  PROV_ST_CONNECTED = 0x10,
+  PROV_ST_CONN_FAILED = 0x11,
+  // not a result, more writes are expected
+  PROV_ST_MORE = 0xFF,
+} prov_status_t;
+
+typedef struct {
+  char ssid[PROV_SSID_MAX + 1];
+  char pass[PROV_PASS_MAX + 1];
+  uint8_t options;
+} prov_creds_t;
+
+typedef struct {
+  uint8_t buf[PROV_FRAME_MAX];
+  uint16_t len;
+  uint8_t next_seq;
+  bool open;
+} prov_frame_t;
+
+// drops (and wipes) a partially received frame
+void prov_frame_reset(prov_frame_t *frame);
+
+// feeds one write. returns PROV_ST_MORE while the frame is incomplete,
+// PROV_ST_OK once it is complete and decoded into out, otherwise the error.
+// the frame is reset on anything but PROV_ST_MORE
+prov_status_t prov_frame_feed(prov_frame_t *frame,
+  const uint8_t *data,
+  uint16_t len,
+  prov_creds_t *out);
+
+prov_status_t prov_frame_decode(
+  const uint8_t *buf, uint16_t len, prov_creds_t *out);
+
+#endif
@@ -0,0 +1,40 @@
+#include "report.h"
+#include "esp_system.h"
+#include "esp_wifi.h"
+#include "led_fx.h"
+#include "prov.h"
+#include "telemetry.h"
+
+static void put_u32(uint8_t *p, uint32_t v) {
+  for (int i = 0; i < 4; i++) {
+    p[i] = (uint8_t)(v >> (8 * i));
+  }
+}
+
+// once per batch, from the telemetry task
+static void report_status(void) {
+  int rssi = 0;
+  esp_wifi_sta_get_rssi(&rssi);
+  jitter_t jitter;
+  led_fx_get_jitter(&jitter);
+
+  uint8_t rec[10];
+  rec[0] = (uint8_t)(int8_t)rssi;
+  rec[1] = prov_is_active();
+  put_u32(rec + 2, esp_get_free_heap_size());
+  put_u32(rec + 6, jitter.max_us);
+  telemetry_add(REPORT_STATUS, rec, sizeof(rec));
+}
+
+esp_err_t report_init(void) {
+  telemetry_cfg_t cfg = {
+    .node = NULL,
+    .on_publish = report_status,
+  };
+  return telemetry_init(&cfg);
+}
+
+void report_color(uint8_t r, uint8_t g, uint8_t b) {
+  uint8_t rec[3] = {r, g, b};
+  telemetry_add(REPORT_COLOR, rec, sizeof(rec));
+}
@@ -0,0 +1,16 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include "esp_err.h"
+#include <stdint.h>
+
+// telemetry record types of this app, decoded by
+// components/telemetry/telemetry_sub.py
+#define REPORT_COLOR 1  // r u8, g u8, b u8: a color set over HTTP
+#define REPORT_STATUS 2 // rssi i8, ble u8, heap_free u32, jitter_max_us u32
+
+// starts MQTT telemetry, status records go out with every batch
+esp_err_t report_init(void);
+void report_color(uint8_t r, uint8_t g, uint8_t b);
+
+#endif
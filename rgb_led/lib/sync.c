@@ -0,0 +1,280 @@
+#include "sync.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+#include <string.h>
+
+#if CONFIG_LED_SYNC_ENABLE
+
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "led_fx.h"
+#include "lwip/sockets.h"
+#include "wifi.h"
+
+#define SYNC_POLL_MAX_MS 50
+
+#if CONFIG_LED_SYNC_LEADER
+#define SYNC_LEADER true
+#else
+#define SYNC_LEADER false
+#endif
+
+static const char *TAG = "SYNC";
+
+// only the sync task touches node, decode, clock fit and encode run without
+// a lock. the LED task and httpd read the copy published after each change
+static sync_node_t node;
+static uint32_t sent;
+static uint32_t received;
+
+// guards shown and the effect handed over by httpd, held for copies only
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+static struct {
+  sync_node_t node;
+  uint32_t sent;
+  uint32_t received;
+} shown;
+static sync_effect_t pending_fx;
+static int64_t pending_us;
+static bool have_pending = false;
+
+static int sock = -1;
+static struct sockaddr_in group_addr;
+static struct sockaddr_in leader_addr;
+static bool have_leader_addr = false;
+
+static void publish(void) {
+  portENTER_CRITICAL(&lock);
+  shown.node = node;
+  shown.sent = sent;
+  shown.received = received;
+  portEXIT_CRITICAL(&lock);
+}
+
+// LED task only, static to keep the node off its stack
+static bool frame(int64_t now_us, int64_t *due_us, uint8_t rgb[3]) {
+  static sync_node_t copy;
+  portENTER_CRITICAL(&lock);
+  copy = shown.node;
+  portEXIT_CRITICAL(&lock);
+  // promotes a started effect in the copy only, sync_task advances node
+  return sync_node_frame(&copy, now_us, due_us, rgb);
+}
+
+// stamped here, the effect starts lead_us after the request and not after
+// the sync task gets to it
+esp_err_t sync_set_effect(const sync_effect_t *fx) {
+  if (!SYNC_LEADER) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  portENTER_CRITICAL(&lock);
+  pending_fx = *fx;
+  pending_us = esp_timer_get_time();
+  have_pending = true;
+  portEXIT_CRITICAL(&lock);
+  return ESP_OK;
+}
+
+void sync_get_stats(sync_stats_t *out) {
+  portENTER_CRITICAL(&lock);
+  out->enabled = true;
+  out->leader = SYNC_LEADER;
+  out->synced = SYNC_LEADER || shown.node.clock.synced;
+  out->sent = shown.sent;
+  out->received = shown.received;
+  out->node = shown.node.stats;
+  out->effect = shown.node.cur;
+  if (!shown.node.have_cur) {
+    out->effect.type = SYNC_FX_COUNT;
+  }
+  portEXIT_CRITICAL(&lock);
+}
+
+// the effect httpd handed over, returns true when there was one
+static bool take_pending(void) {
+  sync_effect_t fx;
+  int64_t at;
+  portENTER_CRITICAL(&lock);
+  bool have = have_pending;
+  fx = pending_fx;
+  at = pending_us;
+  have_pending = false;
+  portEXIT_CRITICAL(&lock);
+  if (have) {
+    sync_node_set_effect(&node, &fx, at);
+  }
+  return have;
+}
+
+static int open_socket(void) {
+  int s = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+  if (s < 0) {
+    ESP_LOGE(TAG, "socket; error code: %d ", errno);
+    return -1;
+  }
+
+  struct sockaddr_in bind_addr = {
+    .sin_family = AF_INET,
+    .sin_port = htons(CONFIG_LED_SYNC_PORT),
+    .sin_addr.s_addr = htonl(INADDR_ANY),
+  };
+  struct ip_mreq mreq = {
+    .imr_multiaddr.s_addr = inet_addr(CONFIG_LED_SYNC_GROUP),
+    .imr_interface.s_addr = htonl(INADDR_ANY),
+  };
+  uint8_t ttl = 1;
+  if (bind(s, (struct sockaddr *)&bind_addr, sizeof(bind_addr)) < 0 ||
+      setsockopt(s, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0 ||
+      setsockopt(s, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) < 0) {
+    ESP_LOGE(TAG, "multicast setup; error code: %d ", errno);
+    close(s);
+    return -1;
+  }
+  ESP_LOGI(TAG,
+    "%s on " CONFIG_LED_SYNC_GROUP ":%d",
+    node.cfg.leader ? "leading" : "following",
+    CONFIG_LED_SYNC_PORT);
+  return s;
+}
+
+static void send_to(sync_dest_t dest,
+  const uint8_t *buf,
+  size_t len,
+  const struct sockaddr_in *sender) {
+  const struct sockaddr_in *to = NULL;
+  switch (dest) {
+  case SYNC_TO_GROUP:
+    to = &group_addr;
+    break;
+  case SYNC_TO_LEADER:
+    to = have_leader_addr ? &leader_addr : NULL;
+    break;
+  case SYNC_TO_SENDER:
+    to = sender;
+    break;
+  default:
+    break;
+  }
+  if (to == NULL || len == 0) {
+    return;
+  }
+  if (sendto(sock, buf, len, 0, (const struct sockaddr *)to, sizeof(*to)) ==
+      (ssize_t)len) {
+    sent++;
+  }
+}
+
+static void receive(void) {
+  uint8_t buf[SYNC_MSG_MAX];
+  uint8_t out[SYNC_MSG_MAX];
+  struct sockaddr_in from;
+  socklen_t from_len = sizeof(from);
+  ssize_t n = recvfrom(
+    sock, buf, sizeof(buf), 0, (struct sockaddr *)&from, &from_len);
+  // stamped as close to the socket as the task gets
+  int64_t now = esp_timer_get_time();
+  if (n <= 0) {
+    return;
+  }
+
+  sync_dest_t dest;
+  received++;
+  uint32_t effects = node.stats.effects;
+  uint32_t leader = node.leader_id;
+  // the current effect has to be in node before a new one replaces next
+  sync_node_advance(&node, now);
+  size_t len =
+    sync_node_rx(&node, buf, (size_t)n, now, out, sizeof(out), &dest);
+  bool new_effect = node.stats.effects != effects;
+  bool new_leader = node.leader_id != leader;
+  publish();
+
+  if (!node.cfg.leader && (new_effect || new_leader)) {
+    // clock requests go where the effects come from
+    leader_addr = from;
+    leader_addr.sin_port = htons(CONFIG_LED_SYNC_PORT);
+    have_leader_addr = true;
+  }
+  if (new_effect) {
+    led_fx_follow(frame);
+  }
+  send_to(dest, out, len, &from);
+}
+
+void sync_task(void *param) {
+  sync_node_cfg_t cfg = {
+    .leader = SYNC_LEADER,
+    // a new id every boot, followers notice a restarted leader by it
+    .id = esp_random(),
+    .lead_us = (int64_t)CONFIG_LED_SYNC_LEAD_MS * 1000,
+    .repeat_us = (int64_t)CONFIG_LED_SYNC_REPEAT_MS * 1000,
+    .clock_period_us = (int64_t)CONFIG_LED_SYNC_CLOCK_MS * 1000,
+  };
+  sync_node_init(&node, &cfg);
+  group_addr = (struct sockaddr_in){
+    .sin_family = AF_INET,
+    .sin_port = htons(CONFIG_LED_SYNC_PORT),
+    .sin_addr.s_addr = inet_addr(CONFIG_LED_SYNC_GROUP),
+  };
+
+  for (;;) {
+    sync_node_advance(&node, esp_timer_get_time());
+    if (take_pending()) {
+      publish();
+      led_fx_follow(frame);
+    }
+    if (!wifi_is_connected()) {
+      if (sock >= 0) {
+        close(sock);
+        sock = -1;
+      }
+      vTaskDelay(pdMS_TO_TICKS(500));
+      continue;
+    }
+    if (sock < 0 && (sock = open_socket()) < 0) {
+      vTaskDelay(pdMS_TO_TICKS(2000));
+      continue;
+    }
+
+    uint8_t out[SYNC_MSG_MAX];
+    sync_dest_t dest;
+    int64_t next;
+    int64_t now = esp_timer_get_time();
+    size_t len = sync_node_poll(&node, now, out, sizeof(out), &dest, &next);
+    publish();
+    send_to(dest, out, len, NULL);
+
+    // short enough that a new leader effect goes out well within its lead
+    int64_t wait_us = next - esp_timer_get_time();
+    if (wait_us > SYNC_POLL_MAX_MS * 1000) {
+      wait_us = SYNC_POLL_MAX_MS * 1000;
+    }
+    if (wait_us < 0) {
+      wait_us = 0;
+    }
+    struct timeval tv = {
+      .tv_sec = 0,
+      .tv_usec = (suseconds_t)wait_us,
+    };
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(sock, &fds);
+    if (select(sock + 1, &fds, NULL, NULL, &tv) > 0) {
+      receive();
+    }
+  }
+}
+
+#else
+
+esp_err_t sync_set_effect(const sync_effect_t *fx) {
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+void sync_get_stats(sync_stats_t *out) { memset(out, 0, sizeof(*out)); }
+
+void sync_task(void *param) { vTaskDelete(NULL); }
+
+#endif
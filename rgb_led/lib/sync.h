@@ -0,0 +1,25 @@
+#ifndef SYNC_H
+#define SYNC_H
+
+#include "esp_err.h"
+#include "sync_node.h"
+#include <stdbool.h>
+
+typedef struct {
+  bool enabled;
+  bool leader;
+  bool synced; // follower has a leader clock estimate
+  uint32_t sent;
+  uint32_t received;
+  sync_node_stats_t node;
+  sync_effect_t effect; // showing, type SYNC_FX_COUNT when none
+} sync_stats_t;
+
+// leader only, announces the effect to the group and follows it locally.
+// ESP_ERR_INVALID_STATE on followers
+esp_err_t sync_set_effect(const sync_effect_t *fx);
+void sync_get_stats(sync_stats_t *out);
+// listed in the app task table, idles until WiFi is up
+void sync_task(void *param);
+
+#endif
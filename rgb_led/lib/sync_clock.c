@@ -0,0 +1,104 @@
+#include "sync_clock.h"
+#include <string.h>
+
+// samples up to this much slower than the best recent one are kept
+#define DELAY_SLACK_US 500
+// a line needs this much time between the first and last sample
+#define MIN_FIT_SPAN_US 2000000
+
+void sync_clock_init(sync_clock_t *clock) { memset(clock, 0, sizeof(*clock)); }
+
+void sync_clock_hint(sync_clock_t *clock, int64_t leader_us, int64_t local_us) {
+  if (clock->count > 0) {
+    return;
+  }
+  clock->ref_local_us = local_us;
+  clock->ref_offset_us = leader_us - local_us;
+  clock->drift_ppb = 0;
+  clock->synced = true;
+}
+
+static int64_t min_delay(const sync_clock_t *clock) {
+  uint32_t n = clock->count < SYNC_CLOCK_SAMPLES ? clock->count
+                                                 : SYNC_CLOCK_SAMPLES;
+  int64_t best = INT64_MAX;
+  for (uint32_t i = 0; i < n; i++) {
+    if (clock->samples[i].delay_us < best) {
+      best = clock->samples[i].delay_us;
+    }
+  }
+  return best;
+}
+
+// least squares offset = a + b * (local - newest), over the kept samples
+static void fit(sync_clock_t *clock, const sync_clock_sample_t *newest) {
+  uint32_t n = clock->count < SYNC_CLOCK_SAMPLES ? clock->count
+                                                 : SYNC_CLOCK_SAMPLES;
+  int64_t oldest = newest->local_us;
+  double sx = 0, sy = 0, sxx = 0, sxy = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    const sync_clock_sample_t *s = &clock->samples[i];
+    double x = (double)(s->local_us - newest->local_us);
+    double y = (double)(s->offset_us - newest->offset_us);
+    sx += x;
+    sy += y;
+    sxx += x * x;
+    sxy += x * y;
+    if (s->local_us < oldest) {
+      oldest = s->local_us;
+    }
+  }
+
+  double slope = 0;
+  double den = n * sxx - sx * sx;
+  if (n >= 3 && newest->local_us - oldest >= MIN_FIT_SPAN_US && den > 0) {
+    slope = (n * sxy - sx * sy) / den;
+  }
+  if (slope > SYNC_CLOCK_MAX_PPM * 1e-6 || slope < -SYNC_CLOCK_MAX_PPM * 1e-6) {
+    slope = 0;
+  }
+  // line through the mean, evaluated at the newest sample
+  double at_newest = (sy - slope * sx) / n;
+
+  clock->ref_local_us = newest->local_us;
+  clock->ref_offset_us = newest->offset_us + (int64_t)at_newest;
+  clock->drift_ppb = (int32_t)(slope * 1e9);
+}
+
+bool sync_clock_sample(
+  sync_clock_t *clock, int64_t t1, int64_t t2, int64_t t3, int64_t t4) {
+  sync_clock_sample_t s = {
+    .local_us = t1 + (t4 - t1) / 2,
+    .offset_us = ((t2 - t1) + (t3 - t4)) / 2,
+    .delay_us = (t4 - t1) - (t3 - t2),
+  };
+  if (s.delay_us < 0) {
+    s.delay_us = 0;
+  }
+
+  if (clock->count >= SYNC_CLOCK_SAMPLES / 2 &&
+      clock->rejected_run < SYNC_CLOCK_SAMPLES &&
+      s.delay_us > min_delay(clock) * 3 / 2 + DELAY_SLACK_US) {
+    clock->rejected++;
+    clock->rejected_run++;
+    return false;
+  }
+  clock->rejected_run = 0;
+
+  clock->samples[clock->count % SYNC_CLOCK_SAMPLES] = s;
+  clock->count++;
+  fit(clock, &s);
+  clock->synced = true;
+  return true;
+}
+
+int64_t sync_clock_to_leader(const sync_clock_t *clock, int64_t local_us) {
+  int64_t dt = local_us - clock->ref_local_us;
+  return local_us + clock->ref_offset_us + dt * clock->drift_ppb / 1000000000;
+}
+
+int64_t sync_clock_to_local(const sync_clock_t *clock, int64_t leader_us) {
+  // one fixed point step is enough, drift is at most a few hundred ppm
+  int64_t local = leader_us - clock->ref_offset_us;
+  return local - (sync_clock_to_leader(clock, local) - leader_us);
+}
@@ -0,0 +1,53 @@
+#ifndef SYNC_CLOCK_H
+#define SYNC_CLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+  follower estimate of the leader clock from NTP style exchanges. every
+  exchange gives
+
+    offset = ((t2 - t1) + (t3 - t4)) / 2   leader minus local
+    delay  = (t4 - t1) - (t3 - t2)          round trip on the wire
+
+  with t1/t4 on the local clock and t2/t3 on the leader's. samples whose
+  delay is well above the best recent one sat in a queue somewhere and are
+  dropped. a line through the remaining offsets gives the offset now and the
+  drift between the two crystals, so the estimate holds between exchanges.
+
+  hardware independent.
+*/
+
+#define SYNC_CLOCK_SAMPLES 8
+// a drift this large is a wrong fit, crystals are within +-100 ppm
+#define SYNC_CLOCK_MAX_PPM 500
+
+typedef struct {
+  int64_t local_us; // middle of the exchange
+  int64_t offset_us;
+  int64_t delay_us;
+} sync_clock_sample_t;
+
+typedef struct {
+  sync_clock_sample_t samples[SYNC_CLOCK_SAMPLES];
+  uint32_t count; // samples taken, the ring holds the newest ones
+  int64_t ref_local_us;
+  int64_t ref_offset_us; // leader minus local at ref_local_us
+  int32_t drift_ppb;     // leader ticks faster by this much
+  bool synced;
+  uint32_t rejected;
+  uint32_t rejected_run; // in a row, a long run means the path got slower
+} sync_clock_t;
+
+void sync_clock_init(sync_clock_t *clock);
+// coarse offset from a one way leader timestamp, only used until the first
+// exchange completes
+void sync_clock_hint(sync_clock_t *clock, int64_t leader_us, int64_t local_us);
+// returns true when the exchange was used, false for a queued outlier
+bool sync_clock_sample(
+  sync_clock_t *clock, int64_t t1, int64_t t2, int64_t t3, int64_t t4);
+int64_t sync_clock_to_leader(const sync_clock_t *clock, int64_t local_us);
+int64_t sync_clock_to_local(const sync_clock_t *clock, int64_t leader_us);
+
+#endif
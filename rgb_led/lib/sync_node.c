@@ -0,0 +1,201 @@
+#include "sync_node.h"
+#include <string.h>
+
+// a follower without samples asks this often
+#define FAST_PERIOD_US 250000
+#define FAST_SAMPLES 4
+// sends of a new effect within the lead time
+#define PENDING_REPEATS 4
+
+void sync_node_init(sync_node_t *node, const sync_node_cfg_t *cfg) {
+  memset(node, 0, sizeof(*node));
+  node->cfg = *cfg;
+  sync_clock_init(&node->clock);
+}
+
+int64_t sync_node_leader_us(const sync_node_t *node, int64_t now_us) {
+  return node->cfg.leader ? now_us
+                          : sync_clock_to_leader(&node->clock, now_us);
+}
+
+static int64_t to_local(const sync_node_t *node, int64_t leader_us) {
+  return node->cfg.leader ? leader_us
+                          : sync_clock_to_local(&node->clock, leader_us);
+}
+
+static void take_effect(sync_node_t *node, const sync_effect_t *fx) {
+  node->next = *fx;
+  node->have_next = true;
+  node->stats.effects++;
+}
+
+void sync_node_set_effect(
+  sync_node_t *node, const sync_effect_t *fx, int64_t now_us) {
+  sync_effect_t e = *fx;
+  // on a frame boundary, so every node's first frame of it is phase 0
+  int64_t start = now_us + node->cfg.lead_us;
+  e.start_us = (start / SYNC_FRAME_US + 1) * SYNC_FRAME_US;
+  node->seq++;
+  take_effect(node, &e);
+  node->announce = true;
+}
+
+// the effect the group should know about, the pending one first
+static const sync_effect_t *newest(const sync_node_t *node) {
+  if (node->have_next) {
+    return &node->next;
+  }
+  return node->have_cur ? &node->cur : NULL;
+}
+
+size_t sync_node_rx(sync_node_t *node,
+  const uint8_t *buf,
+  size_t len,
+  int64_t now_us,
+  uint8_t *out,
+  size_t out_len,
+  sync_dest_t *dest) {
+  *dest = SYNC_TO_NONE;
+  sync_msg_t msg;
+  if (sync_proto_decode(buf, len, &msg) != 0 || msg.node == node->cfg.id) {
+    return 0;
+  }
+
+  if (node->cfg.leader) {
+    if (msg.type != SYNC_MSG_CLOCK_REQ) {
+      return 0;
+    }
+    sync_msg_t resp = {
+      .type = SYNC_MSG_CLOCK_RESP,
+      .node = node->cfg.id,
+      .clock = {.t1 = msg.clock.t1, .t2 = now_us},
+    };
+    // t3 as late as possible, the caller sends right away
+    resp.clock.t3 = now_us;
+    *dest = SYNC_TO_SENDER;
+    return sync_proto_encode(&resp, out, out_len);
+  }
+
+  switch (msg.type) {
+  case SYNC_MSG_EFFECT:
+    if (!node->have_leader || msg.node != node->leader_id) {
+      // another leader, or the same one rebooted: its clock starts over
+      if (node->have_leader) {
+        node->stats.leader_changes++;
+      }
+      node->leader_id = msg.node;
+      node->have_leader = true;
+      node->seq = msg.effect.seq - 1;
+      sync_clock_init(&node->clock);
+      node->next_send_us = now_us;
+    }
+    sync_clock_hint(&node->clock, msg.effect.leader_us, now_us);
+    if (msg.effect.seq != node->seq || (!node->have_cur && !node->have_next)) {
+      node->seq = msg.effect.seq;
+      take_effect(node, &msg.effect.fx);
+    }
+    return 0;
+
+  case SYNC_MSG_CLOCK_RESP:
+    if (!node->have_leader || msg.node != node->leader_id) {
+      return 0;
+    }
+    if (sync_clock_sample(
+          &node->clock, msg.clock.t1, msg.clock.t2, msg.clock.t3, now_us)) {
+      node->stats.exchanges++;
+    } else {
+      node->stats.outliers++;
+    }
+    node->stats.last_offset_us = node->clock.ref_offset_us;
+    node->stats.last_delay_us = (now_us - msg.clock.t1) -
+                                (msg.clock.t3 - msg.clock.t2);
+    node->stats.drift_ppb = node->clock.drift_ppb;
+    return 0;
+  }
+  return 0;
+}
+
+size_t sync_node_poll(sync_node_t *node,
+  int64_t now_us,
+  uint8_t *out,
+  size_t out_len,
+  sync_dest_t *dest,
+  int64_t *next_us) {
+  *dest = SYNC_TO_NONE;
+  if (now_us < node->next_send_us && !node->announce) {
+    *next_us = node->next_send_us;
+    return 0;
+  }
+
+  sync_msg_t msg = {.node = node->cfg.id};
+  if (node->cfg.leader) {
+    const sync_effect_t *fx = newest(node);
+    node->announce = false;
+    node->next_send_us = now_us + node->cfg.repeat_us;
+    if (node->have_next && node->next.start_us > now_us) {
+      // a pending effect goes out a few times before it starts, one lost
+      // datagram shouldn't leave a follower on the old one
+      int64_t again = now_us + node->cfg.lead_us / PENDING_REPEATS;
+      if (again < node->next_send_us) {
+        node->next_send_us = again;
+      }
+    }
+    *next_us = node->next_send_us;
+    if (fx == NULL) {
+      return 0;
+    }
+    msg.type = SYNC_MSG_EFFECT;
+    msg.effect.seq = node->seq;
+    msg.effect.leader_us = now_us;
+    msg.effect.fx = *fx;
+    *dest = SYNC_TO_GROUP;
+    return sync_proto_encode(&msg, out, out_len);
+  }
+
+  int64_t period = node->clock.count < FAST_SAMPLES ? FAST_PERIOD_US
+                                                    : node->cfg.clock_period_us;
+  node->next_send_us = now_us + period;
+  *next_us = node->next_send_us;
+  if (!node->have_leader) {
+    return 0;
+  }
+  msg.type = SYNC_MSG_CLOCK_REQ;
+  msg.clock.t1 = now_us;
+  *dest = SYNC_TO_LEADER;
+  return sync_proto_encode(&msg, out, out_len);
+}
+
+static void promote(sync_node_t *node, int64_t leader_us) {
+  if (node->have_next && leader_us >= node->next.start_us) {
+    node->cur = node->next;
+    node->have_cur = true;
+    node->have_next = false;
+  }
+}
+
+void sync_node_advance(sync_node_t *node, int64_t now_us) {
+  if (!node->cfg.leader && !node->clock.synced) {
+    return;
+  }
+  promote(node, sync_node_leader_us(node, now_us));
+}
+
+bool sync_node_frame(
+  sync_node_t *node, int64_t now_us, int64_t *due_us, uint8_t rgb[3]) {
+  if (!node->cfg.leader && !node->clock.synced) {
+    return false;
+  }
+  // at least half a frame ahead: called at a frame's due time this is the
+  // one after it, even when the clock conversions round down a microsecond
+  int64_t leader_us = sync_node_leader_us(node, now_us) + SYNC_FRAME_US / 2;
+  int64_t frame_us = (sync_node_frame_index(leader_us) + 1) * SYNC_FRAME_US;
+
+  promote(node, frame_us);
+  if (!node->have_cur) {
+    return false;
+  }
+
+  *due_us = to_local(node, frame_us);
+  sync_fx_render(&node->cur, frame_us, rgb);
+  return true;
+}
@@ -0,0 +1,96 @@
+#ifndef SYNC_NODE_H
+#define SYNC_NODE_H
+
+#include "sync_clock.h"
+#include "sync_proto.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  one node of the LED sync, without sockets or tasks so the device and the
+  host test in tools/ run the same logic. times are the node's own clock in
+  us, the caller owns the transport and the locking.
+
+  the leader repeats its newest effect to the group. new effects start lead_us
+  later and are sent right away and a few more times until then, so
+  followers have them in time. the follower asks the leader for the time,
+  quickly until it has a few samples, then every clock_period_us.
+*/
+
+typedef enum {
+  SYNC_TO_NONE = 0,
+  SYNC_TO_GROUP,
+  SYNC_TO_LEADER, // the address the last effect came from
+  SYNC_TO_SENDER, // answer to the datagram just received
+} sync_dest_t;
+
+typedef struct {
+  bool leader;
+  uint32_t id;
+  int64_t lead_us;
+  int64_t repeat_us;
+  int64_t clock_period_us;
+} sync_node_cfg_t;
+
+typedef struct {
+  uint32_t effects;    // new effects taken
+  uint32_t exchanges;  // clock answers used
+  uint32_t outliers;   // clock answers dropped as queued
+  uint32_t leader_changes;
+  int64_t last_offset_us;
+  int64_t last_delay_us;
+  int32_t drift_ppb;
+} sync_node_stats_t;
+
+typedef struct {
+  sync_node_cfg_t cfg;
+  sync_clock_t clock;
+  uint32_t leader_id;
+  bool have_leader;
+  sync_effect_t cur; // showing
+  sync_effect_t next; // waits for its start
+  bool have_cur;
+  bool have_next;
+  uint32_t seq;
+  int64_t next_send_us;
+  bool announce; // leader: new effect not sent yet
+  sync_node_stats_t stats;
+} sync_node_t;
+
+void sync_node_init(sync_node_t *node, const sync_node_cfg_t *cfg);
+// leader only, the effect starts lead_us from now. fx->start_us is ignored
+void sync_node_set_effect(
+  sync_node_t *node, const sync_effect_t *fx, int64_t now_us);
+// handles a received datagram, any answer goes into out. returns its length,
+// 0 when there is nothing to send
+size_t sync_node_rx(sync_node_t *node,
+  const uint8_t *buf,
+  size_t len,
+  int64_t now_us,
+  uint8_t *out,
+  size_t out_len,
+  sync_dest_t *dest);
+// periodic work (effect repeats, clock requests). returns a datagram to send
+// now or 0, *next_us is when to call again
+size_t sync_node_poll(sync_node_t *node,
+  int64_t now_us,
+  uint8_t *out,
+  size_t out_len,
+  sync_dest_t *dest,
+  int64_t *next_us);
+// makes a pending effect current once it started. sync_node_frame does the
+// same, a caller rendering from a copy of the node calls this on the original
+void sync_node_advance(sync_node_t *node, int64_t now_us);
+// next frame at least half a frame after now: its local due time and color.
+// false while there is no effect or no clock yet
+bool sync_node_frame(
+  sync_node_t *node, int64_t now_us, int64_t *due_us, uint8_t rgb[3]);
+// the clock frames are scheduled on, the leader's own clock for the leader
+int64_t sync_node_leader_us(const sync_node_t *node, int64_t now_us);
+// frame index the leader time falls in
+static inline int64_t sync_node_frame_index(int64_t leader_us) {
+  return leader_us / SYNC_FRAME_US;
+}
+
+#endif
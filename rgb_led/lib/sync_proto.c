@@ -0,0 +1,211 @@
+#include "sync_proto.h"
+#include <string.h>
+
+#define HDR_LEN 8
+#define EFFECT_LEN (HDR_LEN + 4 + 8 + 1 + 3 + 3 + 4 + 8)
+#define CLOCK_REQ_LEN (HDR_LEN + 8)
+#define CLOCK_RESP_LEN (HDR_LEN + 24)
+
+static const char *const fx_names[SYNC_FX_COUNT] = {
+  [SYNC_FX_SOLID] = "solid",
+  [SYNC_FX_PULSE] = "pulse",
+  [SYNC_FX_BLINK] = "blink",
+  [SYNC_FX_RAINBOW] = "rainbow",
+};
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v) {
+  for (int i = 0; i < 4; i++) {
+    *p++ = (uint8_t)(v >> (8 * i));
+  }
+  return p;
+}
+
+static uint8_t *put_i64(uint8_t *p, int64_t v) {
+  uint64_t u = (uint64_t)v;
+  for (int i = 0; i < 8; i++) {
+    *p++ = (uint8_t)(u >> (8 * i));
+  }
+  return p;
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+  return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static int64_t get_i64(const uint8_t *p) {
+  uint64_t u = 0;
+  for (int i = 7; i >= 0; i--) {
+    u = u << 8 | p[i];
+  }
+  return (int64_t)u;
+}
+
+size_t sync_proto_encode(const sync_msg_t *msg, uint8_t *buf, size_t len) {
+  size_t need;
+  switch (msg->type) {
+  case SYNC_MSG_EFFECT:
+    need = EFFECT_LEN;
+    break;
+  case SYNC_MSG_CLOCK_REQ:
+    need = CLOCK_REQ_LEN;
+    break;
+  case SYNC_MSG_CLOCK_RESP:
+    need = CLOCK_RESP_LEN;
+    break;
+  default:
+    return 0;
+  }
+  if (len < need) {
+    return 0;
+  }
+
+  uint8_t *p = buf;
+  *p++ = SYNC_MAGIC & 0xff;
+  *p++ = SYNC_MAGIC >> 8;
+  *p++ = SYNC_VERSION;
+  *p++ = msg->type;
+  p = put_u32(p, msg->node);
+
+  switch (msg->type) {
+  case SYNC_MSG_EFFECT:
+    p = put_u32(p, msg->effect.seq);
+    p = put_i64(p, msg->effect.leader_us);
+    *p++ = msg->effect.fx.type;
+    memcpy(p, msg->effect.fx.a, 3);
+    p += 3;
+    memcpy(p, msg->effect.fx.b, 3);
+    p += 3;
+    p = put_u32(p, msg->effect.fx.period_ms);
+    p = put_i64(p, msg->effect.fx.start_us);
+    break;
+  case SYNC_MSG_CLOCK_RESP:
+    p = put_i64(p, msg->clock.t1);
+    p = put_i64(p, msg->clock.t2);
+    p = put_i64(p, msg->clock.t3);
+    break;
+  default:
+    p = put_i64(p, msg->clock.t1);
+    break;
+  }
+  return (size_t)(p - buf);
+}
+
+int sync_proto_decode(const uint8_t *buf, size_t len, sync_msg_t *out) {
+  if (len < HDR_LEN || (buf[0] | buf[1] << 8) != SYNC_MAGIC ||
+      buf[2] != SYNC_VERSION) {
+    return -1;
+  }
+  memset(out, 0, sizeof(*out));
+  out->type = buf[3];
+  out->node = get_u32(&buf[4]);
+  const uint8_t *p = &buf[HDR_LEN];
+
+  switch (out->type) {
+  case SYNC_MSG_EFFECT:
+    if (len != EFFECT_LEN) {
+      return -1;
+    }
+    out->effect.seq = get_u32(p);
+    out->effect.leader_us = get_i64(p + 4);
+    out->effect.fx.type = p[12];
+    memcpy(out->effect.fx.a, p + 13, 3);
+    memcpy(out->effect.fx.b, p + 16, 3);
+    out->effect.fx.period_ms = get_u32(p + 19);
+    out->effect.fx.start_us = get_i64(p + 23);
+    if (out->effect.fx.type >= SYNC_FX_COUNT ||
+        out->effect.fx.period_ms == 0) {
+      return -1;
+    }
+    return 0;
+  case SYNC_MSG_CLOCK_REQ:
+    if (len != CLOCK_REQ_LEN) {
+      return -1;
+    }
+    out->clock.t1 = get_i64(p);
+    return 0;
+  case SYNC_MSG_CLOCK_RESP:
+    if (len != CLOCK_RESP_LEN) {
+      return -1;
+    }
+    out->clock.t1 = get_i64(p);
+    out->clock.t2 = get_i64(p + 8);
+    out->clock.t3 = get_i64(p + 16);
+    return 0;
+  }
+  return -1;
+}
+
+static uint8_t lerp(uint8_t from, uint8_t to, uint64_t x, uint64_t one) {
+  return (uint8_t)(from + ((int64_t)to - from) * (int64_t)x / (int64_t)one);
+}
+
+// hue 0-1535 on the six edges of the RGB cube
+static void hue_rgb(uint32_t hue, uint8_t rgb[3]) {
+  uint8_t up = hue & 0xff;
+  uint8_t down = 255 - up;
+  switch (hue >> 8) {
+  case 0:
+    rgb[0] = 255, rgb[1] = up, rgb[2] = 0;
+    break;
+  case 1:
+    rgb[0] = down, rgb[1] = 255, rgb[2] = 0;
+    break;
+  case 2:
+    rgb[0] = 0, rgb[1] = 255, rgb[2] = up;
+    break;
+  case 3:
+    rgb[0] = 0, rgb[1] = down, rgb[2] = 255;
+    break;
+  case 4:
+    rgb[0] = up, rgb[1] = 0, rgb[2] = 255;
+    break;
+  default:
+    rgb[0] = 255, rgb[1] = 0, rgb[2] = down;
+    break;
+  }
+}
+
+void sync_fx_render(
+  const sync_effect_t *fx, int64_t leader_us, uint8_t rgb[3]) {
+  uint64_t period = (uint64_t)fx->period_ms * 1000;
+  int64_t since = leader_us - fx->start_us;
+  uint64_t phase = since > 0 ? (uint64_t)since % period : 0;
+
+  switch (fx->type) {
+  case SYNC_FX_PULSE: {
+    uint64_t half = period / 2;
+    uint64_t x = phase < half ? phase : period - phase;
+    for (int i = 0; i < 3; i++) {
+      rgb[i] = lerp(fx->a[i], fx->b[i], x, half);
+    }
+    break;
+  }
+  case SYNC_FX_BLINK:
+    memcpy(rgb, phase < period / 2 ? fx->a : fx->b, 3);
+    break;
+  case SYNC_FX_RAINBOW: {
+    uint8_t hue[3];
+    hue_rgb((uint32_t)(phase * 1536 / period), hue);
+    for (int i = 0; i < 3; i++) {
+      rgb[i] = (uint8_t)(hue[i] * fx->a[i] / 255);
+    }
+    break;
+  }
+  default:
+    memcpy(rgb, fx->a, 3);
+    break;
+  }
+}
+
+int sync_fx_from_name(const char *name) {
+  for (int i = 0; i < SYNC_FX_COUNT; i++) {
+    if (strcmp(name, fx_names[i]) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+const char *sync_fx_name(uint8_t type) {
+  return type < SYNC_FX_COUNT ? fx_names[type] : "unknown";
+}
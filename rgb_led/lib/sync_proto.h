@@ -0,0 +1,82 @@
+#ifndef SYNC_PROTO_H
+#define SYNC_PROTO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  LED sync datagrams over UDP multicast, all fields little endian
+
+    magic u16 "LS", version u8, type u8, node u32
+
+  EFFECT      leader -> group    seq u32, leader_us i64, effect
+  CLOCK_REQ   follower -> leader t1 i64
+  CLOCK_RESP  leader -> follower t1 i64, t2 i64, t3 i64
+
+  an effect is type u8, a rgb, b rgb, period_ms u32, start_us i64. nodes
+  never send pixels, every node renders frame k (leader time k * 10 ms) from
+  the effect on its own, so the same parameters give the same frame.
+
+  t1 is the follower clock when the request left, t2 and t3 the leader clock
+  when it arrived and when the answer left, see sync_clock.h.
+*/
+
+#define SYNC_MAGIC 0x534c // "LS"
+#define SYNC_VERSION 1
+#define SYNC_MSG_MAX 48
+// frames fall on multiples of this in leader time, same as LED_FX_PERIOD_MS
+#define SYNC_FRAME_US 10000
+
+typedef enum {
+  SYNC_MSG_EFFECT = 1,
+  SYNC_MSG_CLOCK_REQ = 2,
+  SYNC_MSG_CLOCK_RESP = 3,
+} sync_msg_type_t;
+
+typedef enum {
+  SYNC_FX_SOLID = 0,   // a
+  SYNC_FX_PULSE = 1,   // a to b and back once per period
+  SYNC_FX_BLINK = 2,   // a for the first half of the period, b after
+  SYNC_FX_RAINBOW = 3, // hue wheel once per period, scaled by a
+  SYNC_FX_COUNT,
+} sync_fx_type_t;
+
+typedef struct {
+  uint8_t type;
+  uint8_t a[3];
+  uint8_t b[3];
+  uint32_t period_ms;
+  int64_t start_us; // leader time of phase 0, the effect applies from here
+} sync_effect_t;
+
+typedef struct {
+  uint8_t type;
+  uint32_t node;
+  union {
+    struct {
+      uint32_t seq; // bumped by the leader for every new effect
+      int64_t leader_us;
+      sync_effect_t fx;
+    } effect;
+    struct {
+      int64_t t1;
+      int64_t t2;
+      int64_t t3;
+    } clock;
+  };
+} sync_msg_t;
+
+// hardware independent. returns the datagram length, 0 when buf is too small
+size_t sync_proto_encode(const sync_msg_t *msg, uint8_t *buf, size_t len);
+// returns 0 on success, -1 for foreign or malformed datagrams
+int sync_proto_decode(const uint8_t *buf, size_t len, sync_msg_t *out);
+
+// color of the effect at a leader time, times before start_us show phase 0
+void sync_fx_render(
+  const sync_effect_t *fx, int64_t leader_us, uint8_t rgb[3]);
+// "solid", "pulse", ... to SYNC_FX_*, -1 when unknown
+int sync_fx_from_name(const char *name);
+const char *sync_fx_name(uint8_t type);
+
+#endif
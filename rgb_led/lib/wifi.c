@@ -1,212 +1,419 @@
 #include "esp_err.h"
+#include "esp_event.h"
 #include "esp_http_server.h"
 #include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
-#include "host/ble_gap.h"
-#include "host/ble_store.h"
-#include "host/ble_uuid.h"
 #include "http_server.h"
-#include "nimble/nimble_port.h"
 #include "nvs.h"
-#include "services/gap/ble_svc_gap.h"
-#include "services/gatt/ble_svc_gatt.h"
+#include "ota.h"
+#include "prov.h"
+#include "settings.h"
+#include "wifi.h"
+#include "freertos/FreeRTOS.h"
+#include <inttypes.h>
+
+// reconnect backoff: 500ms, 1s, 2s ... capped at 30s
+#define RECONNECT_BASE_MS 500
+#define RECONNECT_MAX_MS 30000
+// failed attempts against the cached AP before falling back to a full scan
+#define CACHED_AP_MAX_FAILS 2
+#define SCAN_MAX_RECORDS 8
 
-#define WIFI_SSID_MAX_LEN 32
-#define WIFI_PASS_MAX_LEN 64
+static const char *TAG = "WIFI_GATT";
 
-#define WIFI_SERVICE_UUID 0x1800
-#define SSID_CHAR_UUID 0x2A00
-#define PASS_CHAR_UUID 0x2A01
-#define CONNECT_CHAR_UUID 0x2A02
+// requests from other tasks, so the connection state below is only ever
+// touched by the default event loop task
+ESP_EVENT_DEFINE_BASE(WIFI_CONN_EVENT);
 
-static const char *TAG = "WIFI_GATT";
+enum {
+  WIFI_CONN_EVENT_CONNECT, // new credentials
+  WIFI_CONN_EVENT_RETRY,   // backoff timer ran out
+};
+
+typedef enum {
+  CONN_IDLE,
+  CONN_SCAN,
+  CONN_AUTH,
+  CONN_DHCP,
+  CONN_ONLINE,
+} conn_phase_t;
 
 static httpd_handle_t server = NULL;
 
-static uint8_t own_addr_type;
-static char wifi_ssid[WIFI_SSID_MAX_LEN] = {0};
-static char wifi_pass[WIFI_PASS_MAX_LEN] = {0};
+typedef struct {
+  char ssid[WIFI_SSID_MAX_LEN];
+  char pass[WIFI_PASS_MAX_LEN];
+  // last AP we got an IP from so a power cycle skips the scan,
+  // channel 0 means nothing is cached
+  uint8_t bssid[6];
+  uint8_t channel;
+} wifi_settings_t;
+
+#define WIFI_SETTINGS_VERSION 1
+
+static const wifi_settings_t wifi_defaults = {0};
+SETTINGS_BLOB_DEFINE(wifi_settings,
+  wifi_settings_t,
+  "wifi",
+  "cfg",
+  WIFI_SETTINGS_VERSION,
+  &wifi_defaults);
+
 static bool wifi_connected = false;
+static bool wifi_started = false;
+
+static conn_phase_t phase = CONN_IDLE;
+static uint32_t fail_count = 0;
+static bool using_cache = false;
+static int64_t t_attempt = 0;
+static int64_t t_phase = 0;
+static esp_timer_handle_t reconnect_timer = NULL;
+static wifi_conn_metrics_t metrics = {0};
+
+static bool ap_cached(void) {
+  wifi_settings_t ws;
+  settings_read(&wifi_settings, &ws);
+  return ws.channel != 0;
+}
+
+static void save_ap_cache(const uint8_t *bssid, uint8_t channel) {
+  wifi_settings_t *ws = settings_edit(&wifi_settings);
+  memcpy(ws->bssid, bssid, sizeof(ws->bssid));
+  ws->channel = channel;
+  // no flash write when we reconnected to the same AP
+  settings_commit(&wifi_settings);
+}
+
+static void invalidate_ap_cache(void) {
+  wifi_settings_t *ws = settings_edit(&wifi_settings);
+  memset(ws->bssid, 0, sizeof(ws->bssid));
+  ws->channel = 0;
+  settings_commit(&wifi_settings);
+}
+
+static void fill_sta_config(wifi_config_t *wifi_config,
+  const uint8_t *bssid,
+  uint8_t channel) {
+  wifi_settings_t ws;
+  settings_read(&wifi_settings, &ws);
+
+  memset(wifi_config, 0, sizeof(*wifi_config));
+  wifi_config->sta.threshold.authmode =
+    ws.pass[0] ? WIFI_AUTH_WPA2_WPA3_PSK : WIFI_AUTH_OPEN;
+  wifi_config->sta.sort_method = WIFI_CONNECT_AP_BY_SIGNAL;
+  strncpy((char *)wifi_config->sta.ssid, ws.ssid, WIFI_SSID_MAX_LEN);
+  strncpy((char *)wifi_config->sta.password, ws.pass, WIFI_PASS_MAX_LEN);
+
+  if (bssid) {
+    // AP is already known, connect straight to it on its channel
+    wifi_config->sta.scan_method = WIFI_FAST_SCAN;
+    wifi_config->sta.bssid_set = true;
+    memcpy(wifi_config->sta.bssid, bssid, 6);
+    wifi_config->sta.channel = channel;
+  } else {
+    wifi_config->sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+  }
+}
+
+static void connect_to(const uint8_t *bssid, uint8_t channel) {
+  wifi_config_t wifi_config;
+  fill_sta_config(&wifi_config, bssid, channel);
+  esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+
+  phase = CONN_AUTH;
+  t_phase = esp_timer_get_time();
+  esp_err_t err = esp_wifi_connect();
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "esp_wifi_connect; error code: %d ", err);
+  }
+}
+
+// starts one connection attempt: straight to the cached AP when we have one,
+// otherwise a scan for our SSID only (see WIFI_EVENT_SCAN_DONE)
+static void begin_attempt(void) {
+  metrics.attempts++;
+  t_attempt = esp_timer_get_time();
+  t_phase = t_attempt;
+
+  wifi_settings_t ws;
+  settings_read(&wifi_settings, &ws);
+
+  if (ws.channel != 0 && fail_count < CACHED_AP_MAX_FAILS) {
+    using_cache = true;
+    metrics.scan_us = 0;
+    connect_to(ws.bssid, ws.channel);
+    return;
+  }
+
+  using_cache = false;
+  static char scan_ssid[WIFI_SSID_MAX_LEN + 1];
+  strlcpy(scan_ssid, ws.ssid, sizeof(scan_ssid));
+  wifi_scan_config_t scan_cfg = {
+    .ssid = (uint8_t *)scan_ssid,
+    .show_hidden = true,
+  };
+  phase = CONN_SCAN;
+  esp_err_t err = esp_wifi_scan_start(&scan_cfg, false);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "esp_wifi_scan_start; error code: %d ", err);
+    // let the driver do its own full channel scan instead
+    connect_to(NULL, 0);
+  }
+}
+
+static void schedule_reconnect(void) {
+  uint32_t shift = fail_count > 0 ? fail_count - 1 : 0;
+  uint32_t delay_ms = RECONNECT_MAX_MS;
+  if (shift < 16) {
+    delay_ms = RECONNECT_BASE_MS << shift;
+    if (delay_ms > RECONNECT_MAX_MS) {
+      delay_ms = RECONNECT_MAX_MS;
+    }
+  }
+
+  ESP_LOGI(TAG, "Reconnecting in %" PRIu32 " ms", delay_ms);
+  esp_timer_stop(reconnect_timer);
+  esp_timer_start_once(reconnect_timer, (uint64_t)delay_ms * 1000);
+}
+
+// runs on the esp_timer task, the attempt itself goes to the event loop
+static void reconnect_timer_cb(void *arg) {
+  esp_err_t err =
+    esp_event_post(WIFI_CONN_EVENT, WIFI_CONN_EVENT_RETRY, NULL, 0, 0);
+  if (err != ESP_OK) {
+    // loop queue full, try again after the shortest backoff
+    esp_timer_start_once(reconnect_timer, (uint64_t)RECONNECT_BASE_MS * 1000);
+  }
+}
+
+static void on_scan_done(void) {
+  metrics.scan_us = esp_timer_get_time() - t_phase;
+
+  uint16_t count = SCAN_MAX_RECORDS;
+  wifi_ap_record_t records[SCAN_MAX_RECORDS];
+  if (esp_wifi_scan_get_ap_records(&count, records) != ESP_OK || count == 0) {
+    ESP_LOGE(TAG, "AP not found");
+    phase = CONN_IDLE;
+    fail_count++;
+    schedule_reconnect();
+    return;
+  }
+
+  wifi_ap_record_t *best = &records[0];
+  for (uint16_t i = 1; i < count; i++) {
+    if (records[i].rssi > best->rssi) {
+      best = &records[i];
+    }
+  }
+
+  connect_to(best->bssid, best->primary);
+}
+
+static void on_got_ip(void) {
+  int64_t now = esp_timer_get_time();
+  metrics.dhcp_us = now - t_phase;
+  metrics.total_us = now - t_attempt;
+  if (using_cache) {
+    metrics.fast_connects++;
+  }
+  phase = CONN_ONLINE;
+  fail_count = 0;
+
+  ESP_LOGI(TAG,
+    "Online in %" PRId64 " ms (scan %" PRId64 ", auth %" PRId64
+    ", dhcp %" PRId64 ")%s",
+    metrics.total_us / 1000,
+    metrics.scan_us / 1000,
+    metrics.auth_us / 1000,
+    metrics.dhcp_us / 1000,
+    using_cache ? " via cached AP" : "");
+
+  wifi_ap_record_t ap;
+  if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+    save_ap_cache(ap.bssid, ap.primary);
+  }
+}
+
+static void wifi_connect(void);
 
 static void wifi_event_handler(
   void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data) {
-  if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
+  if (event_base == WIFI_CONN_EVENT && event_id == WIFI_CONN_EVENT_CONNECT) {
+    wifi_connect();
+  } else if (event_base == WIFI_CONN_EVENT &&
+             event_id == WIFI_CONN_EVENT_RETRY) {
+    // wifi_connect() may have started an attempt since the timer fired
+    if (phase == CONN_IDLE) {
+      begin_attempt();
+    }
+  } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
     ESP_LOGI(TAG, "WiFi started, connecting...");
-    esp_wifi_connect();
+    begin_attempt();
+  } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_SCAN_DONE) {
+    if (phase == CONN_SCAN) {
+      on_scan_done();
+    }
+  } else if (event_base == WIFI_EVENT &&
+             event_id == WIFI_EVENT_STA_CONNECTED) {
+    int64_t now = esp_timer_get_time();
+    metrics.auth_us = now - t_phase;
+    t_phase = now;
+    phase = CONN_DHCP;
   } else if (event_base == WIFI_EVENT &&
              event_id == WIFI_EVENT_STA_DISCONNECTED) {
     wifi_connected = false;
     wifi_event_sta_disconnected_t *disconn =
       (wifi_event_sta_disconnected_t *)event_data;
     ESP_LOGE(TAG, "WiFi disconnected, reason: %d", disconn->reason);
-    vTaskDelay(5000 / portTICK_PERIOD_MS);
-    esp_wifi_connect();
+    metrics.last_disconnect_reason = disconn->reason;
+    phase = CONN_IDLE;
+    fail_count++;
+    if (using_cache && fail_count >= CACHED_AP_MAX_FAILS && ap_cached()) {
+      // AP moved or was replaced, go back to scanning
+      invalidate_ap_cache();
+    }
+    prov_on_wifi_failed();
+    schedule_reconnect();
   } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
     wifi_connected = true;
     ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
     printf("Got IP: " IPSTR "\n", IP2STR(&event->ip_info.ip));
-    server = start_webserver();
+    on_got_ip();
+    if (server == NULL) {
+      server = start_webserver();
+    }
+    // reachable for the next update, an image that gets here is kept
+    if (server != NULL) {
+      ota_mark_healthy();
+    }
+    prov_on_wifi_connected();
   }
 };
 
+// event loop task only
 static void wifi_connect(void) {
-  wifi_config_t wifi_config = {
-    .sta =
-      {
-        .threshold.authmode = WIFI_AUTH_WPA2_WPA3_PSK,
-        .scan_method = WIFI_ALL_CHANNEL_SCAN,
-        .sort_method = WIFI_CONNECT_AP_BY_SIGNAL,
-      },
-  };
+  wifi_settings_t ws;
+  settings_read(&wifi_settings, &ws);
+  ESP_LOGI(TAG, "Connecting - SSID:'%s'", ws.ssid);
+
+  fail_count = 0;
+  if (!wifi_started) {
+    // first attempt is made from WIFI_EVENT_STA_START
+    wifi_started = true;
+    esp_wifi_set_mode(WIFI_MODE_STA);
+    esp_wifi_start();
+    return;
+  }
 
-  strncpy((char *)wifi_config.sta.ssid, wifi_ssid, WIFI_SSID_MAX_LEN);
-  strncpy((char *)wifi_config.sta.password, wifi_pass, WIFI_PASS_MAX_LEN);
+  esp_timer_stop(reconnect_timer);
+  if (phase == CONN_IDLE) {
+    begin_attempt();
+  } else if (phase != CONN_SCAN) {
+    // the disconnect event schedules the next attempt
+    esp_wifi_disconnect();
+  }
+};
 
-  ESP_LOGI(TAG,
-    "Connecting - SSID:'%s' Pass:'%s'",
-    wifi_config.sta.ssid,
-    wifi_config.sta.password);
+void wifi_get_metrics(wifi_conn_metrics_t *out) { *out = metrics; }
 
-  esp_wifi_set_mode(WIFI_MODE_STA);
-  esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
-  esp_wifi_start();
-};
+bool wifi_is_connected(void) { return wifi_connected; }
 
-static void save_wifi_creds(void) {
-  nvs_handle_t handle;
-  nvs_open("wifi", NVS_READWRITE, &handle);
-  nvs_set_str(handle, "ssid", wifi_ssid);
-  nvs_set_str(handle, "pass", wifi_pass);
-  nvs_commit(handle);
-  nvs_close(handle);
-  ESP_LOGI(TAG, "WiFi credentials saved to NVS");
+bool wifi_is_provisioned(void) {
+  wifi_settings_t ws;
+  settings_read(&wifi_settings, &ws);
+  return ws.ssid[0] != '\0';
 }
 
-static bool load_wifi_creds(void) {
-  nvs_handle_t handle;
-  if (nvs_open("wifi", NVS_READONLY, &handle) != ESP_OK) {
-    return false;
+// new credentials and the cleared AP cache go to flash as one write
+static esp_err_t save_wifi_creds(const char *ssid, const char *pass) {
+  wifi_settings_t *ws = settings_edit(&wifi_settings);
+  bool changed = strncmp(ws->ssid, ssid, sizeof(ws->ssid)) != 0 ||
+                 strncmp(ws->pass, pass, sizeof(ws->pass)) != 0;
+  if (changed) {
+    memset(ws, 0, sizeof(*ws));
+    strlcpy(ws->ssid, ssid, sizeof(ws->ssid));
+    strlcpy(ws->pass, pass, sizeof(ws->pass));
+  }
+  esp_err_t esp_err = settings_commit(&wifi_settings);
+  if (esp_err == ESP_OK) {
+    ESP_LOGI(TAG, "WiFi credentials saved to NVS");
   }
+  return esp_err;
+}
 
-  size_t ssid_len = WIFI_SSID_MAX_LEN;
-  size_t pass_len = WIFI_PASS_MAX_LEN;
+static esp_err_t post_connect(void) {
+  // bounded, the caller may be the NimBLE host task that the loop task
+  // waits for when provisioning shuts down
+  esp_err_t esp_err = esp_event_post(
+    WIFI_CONN_EVENT, WIFI_CONN_EVENT_CONNECT, NULL, 0, pdMS_TO_TICKS(100));
+  if (esp_err != ESP_OK) {
+    ESP_LOGE(TAG, "esp_event_post; error code: %d ", esp_err);
+  }
+  return esp_err;
+}
 
-  esp_err_t err1 = nvs_get_str(handle, "ssid", wifi_ssid, &ssid_len);
-  esp_err_t err2 = nvs_get_str(handle, "pass", wifi_pass, &pass_len);
+esp_err_t wifi_set_credentials(const char *ssid, const char *pass) {
+  esp_err_t esp_err = save_wifi_creds(ssid, pass);
+  if (esp_err != ESP_OK) {
+    return esp_err;
+  }
+  return post_connect();
+}
 
-  nvs_close(handle);
+// pre-blob firmware stored ssid/pass as separate strings
+static void migrate_legacy_creds(void) {
+  nvs_handle_t handle;
+  if (nvs_open("wifi", NVS_READWRITE, &handle) != ESP_OK) {
+    return;
+  }
+
+  char ssid[WIFI_SSID_MAX_LEN] = {0};
+  char pass[WIFI_PASS_MAX_LEN] = {0};
+  size_t ssid_len = sizeof(ssid);
+  size_t pass_len = sizeof(pass);
+  esp_err_t err1 = nvs_get_str(handle, "ssid", ssid, &ssid_len);
+  esp_err_t err2 = nvs_get_str(handle, "pass", pass, &pass_len);
 
   if (err1 == ESP_OK && err2 == ESP_OK) {
-    ESP_LOGI(TAG, "Loaded WiFi credentials from NVS");
-    return true;
+    save_wifi_creds(ssid, pass);
+    nvs_erase_key(handle, "ssid");
+    nvs_erase_key(handle, "pass");
+    nvs_erase_key(handle, "bssid");
+    nvs_erase_key(handle, "chan");
+    nvs_commit(handle);
+    ESP_LOGI(TAG, "Migrated WiFi credentials to settings blob");
   }
-  return false;
+  nvs_close(handle);
 }
 
-static int ssid_write(uint16_t conn_handle,
-  uint16_t attr_handle,
-  struct ble_gatt_access_ctxt *ctxt,
-  void *arg) {
-  if (ctxt->op == BLE_GATT_ACCESS_OP_WRITE_CHR) {
-    uint16_t len = OS_MBUF_PKTLEN(ctxt->om);
-    if (len < WIFI_SSID_MAX_LEN) {
-      os_mbuf_copydata(ctxt->om, 0, len, wifi_ssid);
-      wifi_ssid[len] = '\0';
-      printf("SSID received: %s\n", wifi_ssid);
-    }
+static bool load_wifi_creds(void) {
+  if (settings_load(&wifi_settings) != ESP_OK) {
+    return false;
   }
-  return 0;
-};
 
-static int pass_write(uint16_t conn_handle,
-  uint16_t attr_handle,
-  struct ble_gatt_access_ctxt *ctxt,
-  void *arg) {
-  if (ctxt->op == BLE_GATT_ACCESS_OP_WRITE_CHR) {
-    uint16_t len = OS_MBUF_PKTLEN(ctxt->om);
-    if (len < WIFI_PASS_MAX_LEN) {
-      os_mbuf_copydata(ctxt->om, 0, len, wifi_pass);
-      wifi_pass[len] = '\0';
-      printf("Password received\n");
-    }
+  wifi_settings_t ws;
+  settings_read(&wifi_settings, &ws);
+  if (ws.ssid[0] == '\0') {
+    migrate_legacy_creds();
+    settings_read(&wifi_settings, &ws);
   }
-  return 0;
-};
-
-static int connect_write(uint16_t conn_handle,
-  uint16_t attr_handle,
-  struct ble_gatt_access_ctxt *ctxt,
-  void *arg) {
-  if (ctxt->op == BLE_GATT_ACCESS_OP_WRITE_CHR) {
-    printf("Connecting to WiFi...\n");
-    save_wifi_creds();
-    wifi_connect();
+  if (ws.ssid[0] == '\0') {
+    return false;
   }
-  return 0;
-};
 
-static int status_read(uint16_t conn_handle,
-  uint16_t attr_handle,
-  struct ble_gatt_access_ctxt *ctxt,
-  void *arg) {
-  if (ctxt->op == BLE_GATT_ACCESS_OP_READ_CHR) {
-    uint8_t status = wifi_connected ? 1 : 0;
-    os_mbuf_append(ctxt->om, &status, sizeof(status));
+  ESP_LOGI(TAG, "Loaded WiFi credentials from NVS");
+  if (ws.channel != 0) {
+    ESP_LOGI(TAG,
+      "Cached AP " MACSTR " on channel %d",
+      MAC2STR(ws.bssid),
+      ws.channel);
   }
-  return 0;
-};
-
-static const struct ble_gatt_svc_def provision_services[] = {
-  {
-    .type = BLE_GATT_SVC_TYPE_PRIMARY,
-    .uuid = BLE_UUID16_DECLARE(WIFI_SERVICE_UUID),
-    .characteristics =
-      (struct ble_gatt_chr_def[]){{
-                                    .uuid = BLE_UUID16_DECLARE(SSID_CHAR_UUID),
-                                    .access_cb = ssid_write,
-                                    .flags = BLE_GATT_CHR_F_WRITE,
-                                  },
-        {
-          .uuid = BLE_UUID16_DECLARE(PASS_CHAR_UUID),
-          .access_cb = pass_write,
-          .flags = BLE_GATT_CHR_F_WRITE,
-        },
-        {
-          .uuid = BLE_UUID16_DECLARE(CONNECT_CHAR_UUID),
-          .access_cb = connect_write,
-          .flags = BLE_GATT_CHR_F_WRITE,
-        },
-        {
-          .uuid = BLE_UUID16_DECLARE(0x2A03),
-          .access_cb = status_read,
-          .flags = BLE_GATT_CHR_F_READ,
-        },
-        {0}},
-  },
-  {0}};
-
-static void on_stack_sync(void) {
-  own_addr_type = BLE_OWN_ADDR_RANDOM;
-
-  ble_hs_id_infer_auto(0, &own_addr_type);
-
-  struct ble_hs_adv_fields fields = {0};
-  fields.flags = BLE_HS_ADV_F_DISC_GEN | BLE_HS_ADV_F_BREDR_UNSUP;
-  fields.name = (uint8_t *)"ESP32-RGB";
-  fields.name_len = strlen("ESP32-RGB");
-  fields.name_is_complete = 1;
-
-  ble_gap_adv_set_fields(&fields);
-
-  struct ble_gap_adv_params adv_params = {0};
-  adv_params.conn_mode = BLE_GAP_CONN_MODE_UND;
-  adv_params.disc_mode = BLE_GAP_DISC_MODE_GEN;
-
-  ble_gap_adv_start(
-    own_addr_type, NULL, BLE_HS_FOREVER, &adv_params, NULL, NULL);
+  return true;
 }
 
-int init_wifi_prov(void) {
+esp_err_t wifi_netif_init(void) {
   esp_err_t esp_err;
 
   esp_err = esp_netif_init();
@@ -222,6 +429,11 @@ int init_wifi_prov(void) {
   }
 
   esp_netif_create_default_wifi_sta();
+  return ESP_OK;
+}
+
+int init_wifi_prov(void) {
+  esp_err_t esp_err;
 
   wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
   esp_err = esp_wifi_init(&cfg);
@@ -244,33 +456,29 @@ int init_wifi_prov(void) {
     return esp_err;
   }
 
-  if (load_wifi_creds()) {
-    wifi_connect();
-    // idf.py erase-flash to erase stored credentials
-  }
-
-  esp_err = nimble_port_init();
+  esp_err = esp_event_handler_register(
+    WIFI_CONN_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL);
   if (esp_err != ESP_OK) {
-    ESP_LOGE(TAG, "nimble_port_init; error code: %d ", esp_err);
+    ESP_LOGE(TAG, "esp_event_handler_register; error code: %d ", esp_err);
     return esp_err;
   }
 
-  ble_hs_cfg.sync_cb = on_stack_sync;
-
-  ble_svc_gap_init();
-  ble_svc_gatt_init();
-
-  esp_err = ble_gatts_count_cfg(provision_services);
-  if (esp_err != 0) {
-    ESP_LOGE(TAG, "ble_gatts_count_cfg; error code: %d ", esp_err);
+  esp_timer_create_args_t timer_args = {
+    .callback = reconnect_timer_cb,
+    .name = "wifi_reconnect",
+  };
+  esp_err = esp_timer_create(&timer_args, &reconnect_timer);
+  if (esp_err != ESP_OK) {
+    ESP_LOGE(TAG, "esp_timer_create; error code: %d ", esp_err);
     return esp_err;
   }
 
-  esp_err = ble_gatts_add_svcs(provision_services);
-  if (esp_err != 0) {
-    ESP_LOGE(TAG, "ble_gatts_add_svcs; error code: %d ", esp_err);
-    return esp_err;
+  bool provisioned = load_wifi_creds();
+  if (provisioned) {
+    post_connect();
+    // idf.py erase-flash to erase stored credentials
   }
 
-  return 0;
-}
\ No newline at end of file
+  // BLE only comes up when there is nothing to connect to, or on request
+  return prov_init(provisioned);
+}
@@ -1,6 +1,32 @@
 #ifndef GATT_SVR_H
 #define GATT_SVR_H
 
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define WIFI_SSID_MAX_LEN 32
+#define WIFI_PASS_MAX_LEN 64
+
+// durations are in microseconds and describe the last successful connect
+typedef struct {
+  uint32_t attempts;
+  uint32_t fast_connects; // connects made straight to the cached AP
+  int64_t scan_us;        // 0 when the cached AP was used
+  int64_t auth_us;
+  int64_t dhcp_us;
+  int64_t total_us;
+  uint8_t last_disconnect_reason;
+} wifi_conn_metrics_t;
+
+// lwIP, the default event loop and the station netif, no NVS needed
+esp_err_t wifi_netif_init(void);
+// after settings_nvs_init() and wifi_netif_init()
 int init_wifi_prov(void);
+bool wifi_is_connected(void);
+bool wifi_is_provisioned(void);
+// stores the credentials and (re)connects with them
+esp_err_t wifi_set_credentials(const char *ssid, const char *pass);
+void wifi_get_metrics(wifi_conn_metrics_t *out);
 
-#endif
\ No newline at end of file
+#endif
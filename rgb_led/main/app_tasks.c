@@ -0,0 +1,60 @@
+#include "app_tasks.h"
+#include "dlog.h"
+#include "esp_task.h"
+#include "events.h"
+#include "led_fx.h"
+#include "sdkconfig.h"
+#include "sync.h"
+#include "telemetry.h"
+#include "trace.h"
+
+#if CONFIG_DLOG_ENABLE
+TASK_STORAGE(dlog, DLOG_TASK_STACK);
+#endif
+#if TRACE_HAS_TASK
+TASK_STORAGE(trace, TRACE_TASK_STACK);
+#endif
+TASK_STORAGE(led_fx, 2048);
+TASK_STORAGE(events, 3072);
+TASK_STORAGE(telemetry, 3584);
+#if CONFIG_LED_SYNC_ENABLE
+TASK_STORAGE(sync, 3072);
+#endif
+TASK_STORAGE(task_mon, 2560);
+
+// WiFi, lwIP, NimBLE and httpd on PRO_CPU, the LED task gets APP_CPU when
+// the cores are partitioned
+task_def_t app_tasks[] = {
+  TASK_STATIC(led_fx, "led_fx", led_fx_task, 10, TASK_CORE_RT),
+  TASK_EXTERNAL("tiT",
+    CONFIG_LWIP_TCPIP_TASK_STACK_SIZE,
+    ESP_TASK_TCPIP_PRIO,
+    tskNO_AFFINITY),
+  TASK_EXTERNAL("nimble_host",
+    CONFIG_BT_NIMBLE_HOST_TASK_STACK_SIZE,
+    configMAX_PRIORITIES - 4,
+    CONFIG_BT_NIMBLE_PINNED_TO_CORE),
+  // created by start_webserver() with these values
+  TASK_EXTERNAL("httpd", 4096, tskIDLE_PRIORITY + 5, TASK_CORE_RADIO),
+  // below httpd, the LED task only ever overwrites its latest state
+  TASK_STATIC(events, "events", events_task, 4, TASK_CORE_RADIO),
+#if CONFIG_LED_SYNC_ENABLE
+  // above httpd, receive stamps feed the clock estimate
+  TASK_STATIC(sync, "sync", sync_task, 6, TASK_CORE_RADIO),
+#endif
+  TASK_STATIC(telemetry, "telemetry", telemetry_task, 3, TASK_CORE_RADIO),
+  // created by esp-mqtt with these values, its core is a menuconfig option
+  TASK_EXTERNAL("mqtt_task", 6144, 5, tskNO_AFFINITY),
+#if CONFIG_DLOG_ENABLE
+  TASK_STATIC(
+    dlog, "dlog", dlog_task, CONFIG_DLOG_TASK_PRIORITY, TASK_CORE_RADIO),
+#endif
+#if TRACE_HAS_TASK
+  TASK_STATIC(trace, "trace", trace_task, 1, TASK_CORE_RADIO),
+#endif
+  TASK_STATIC(task_mon, "task_mon", task_monitor_task, 1, TASK_CORE_RADIO),
+  TASK_EXTERNAL(
+    "esp_timer", CONFIG_ESP_TIMER_TASK_STACK_SIZE, ESP_TASK_TIMER_PRIO, 0),
+};
+
+const size_t app_task_count = sizeof(app_tasks) / sizeof(app_tasks[0]);
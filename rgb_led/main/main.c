@@ -1,47 +1,133 @@
+#include "app_tasks.h"
+#include "boot_init.h"
+#include "dlog.h"
 #include "driver/gpio.h"
 #include "driver/ledc.h"
 #include "esp_err.h"
 #include "esp_log.h"
+#include "events.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "nimble/nimble_port.h"
-#include "nimble/nimble_port_freertos.h"
+#include "led.h"
 #include "nvs.h"
-#include "nvs_flash.h"
-#include "rgb_led.h"
+#include "ota.h"
+#include "report.h"
+#include "sdkconfig.h"
+#include "settings.h"
+#include "trace.h"
 #include "wifi.h"
 
+#if CONFIG_BENCH_ENABLE
+#include "bench.h"
+#include "color_parse.h"
+#endif
+
 static const char *TAG = "RGB_LED";
 
-#define DEVICE_NAME "RGB_LED"
+#if CONFIG_BENCH_ENABLE
+static void bench_set_rgb(void *ctx) {
+  static uint8_t v = 0;
+  v++;
+  led_set_rgb(v, 255 - v, v / 2);
+}
 
-static void ble_host_task(void *param) {
-  ESP_LOGI(TAG, "BLE Host Task Started");
-  nimble_port_run();
-  nimble_port_freertos_deinit();
+static void bench_color_parse(void *ctx) {
+  uint8_t r, g, b;
+  color_parse_json(ctx, &r, &g, &b);
 }
 
-void app_main(void) {
-  esp_err_t esp_err = nvs_flash_init();
-  if (esp_err == ESP_ERR_NVS_NO_FREE_PAGES ||
-      esp_err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-    ESP_ERROR_CHECK(nvs_flash_erase());
-    esp_err = nvs_flash_init();
-  }
-  if (esp_err != ESP_OK) {
-    ESP_LOGE(TAG, "nvs_flash_init error; code: %d ", esp_err);
-    return;
+// the work color_handler() does once the body is received
+static void bench_color_handler(void *ctx) {
+  uint8_t r, g, b;
+  if (color_parse_json(ctx, &r, &g, &b)) {
+    led_set_rgb(r, g, b);
   }
+}
 
-  ledc_init();
+static esp_err_t run_benchmarks(void) {
+  bench_opts_t opts = {
+    .warmup = CONFIG_BENCH_WARMUP,
+    .iterations = CONFIG_BENCH_ITERATIONS,
+  };
+  bench_result_t result;
+  char body[] = "{\"r\":12,\"g\":200,\"b\":64}";
 
-  esp_err = init_wifi_prov();
-  if (esp_err != ESP_OK) {
-    ESP_LOGE(TAG, "init_wifi_prov; error code: %d ", esp_err);
-    return;
+  bench_print_header();
+  if (bench_run("set_rgb", bench_set_rgb, NULL, &opts, &result) == 0) {
+    bench_print(&result);
+  }
+  if (bench_run("color_parse_json", bench_color_parse, body, &opts, &result) ==
+      0) {
+    bench_print(&result);
   }
+  if (bench_run("color_handler", bench_color_handler, body, &opts, &result) ==
+      0) {
+    bench_print(&result);
+  }
+  return ESP_OK;
+}
+#endif
 
-  set_rgb(255, 0, 0);
+static esp_err_t start_tasks(void) {
+  return task_table_start(app_tasks, app_task_count);
+}
+
+static esp_err_t init_led(void) {
+  led_init();
+  return ESP_OK;
+}
+
+enum {
+  STEP_NVS,
+  STEP_LED,
+  STEP_EVENTS,
+  STEP_TASKS,
+#if CONFIG_BENCH_ENABLE
+  STEP_BENCH,
+#endif
+  STEP_NETIF,
+  STEP_WIFI,
+  STEP_REPORT,
+};
+
+#if CONFIG_BENCH_ENABLE
+// numbers taken before the radio is up, like they always were
+#define WIFI_DEPS                                                             \
+  (BOOT_DEP(STEP_NVS) | BOOT_DEP(STEP_EVENTS) | BOOT_DEP(STEP_NETIF) |        \
+    BOOT_DEP(STEP_BENCH))
+#else
+#define WIFI_DEPS                                                             \
+  (BOOT_DEP(STEP_NVS) | BOOT_DEP(STEP_EVENTS) | BOOT_DEP(STEP_NETIF))
+#endif
 
-  nimble_port_freertos_init(ble_host_task);
+// WiFi and the BLE controller read their calibration from NVS, the LED needs
+// neither. netif and the event loop come up while NVS mounts. the web server
+// starts from the WiFi step, /api/events needs its lock by then
+static const boot_step_t boot_steps[] = {
+  [STEP_NVS] = {"nvs", settings_nvs_init, 0, true},
+  [STEP_LED] = {"led", init_led, 0, true},
+  [STEP_EVENTS] = {"events", events_init, 0, true},
+  [STEP_TASKS] = {"tasks",
+    start_tasks,
+    BOOT_DEP(STEP_LED) | BOOT_DEP(STEP_EVENTS),
+    true},
+#if CONFIG_BENCH_ENABLE
+  [STEP_BENCH] = {"bench", run_benchmarks, BOOT_DEP(STEP_TASKS), false},
+#endif
+  [STEP_NETIF] = {"netif", wifi_netif_init, 0, true},
+  [STEP_WIFI] = {"wifi", init_wifi_prov, WIFI_DEPS, false},
+  // batches queue on flash until the broker is reachable
+  [STEP_REPORT] = {"report", report_init, BOOT_DEP(STEP_WIFI), false},
+};
+
+void app_main(void) {
+  // a new image that never reaches WiFi and the web server rolls back
+  ota_health_start();
+
+  esp_err_t esp_err = boot_init_run(
+    boot_steps, sizeof(boot_steps) / sizeof(boot_steps[0]));
+  boot_init_report();
+  if (esp_err != ESP_OK) {
+    ESP_LOGE(TAG, "boot_init_run; error code: %d ", esp_err);
+  }
 }
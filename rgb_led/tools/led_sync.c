@@ -0,0 +1,366 @@
+/*
+  one LED sync node on the host, with the node logic the device runs and a
+  POSIX socket in place of lwIP. prints a line for every frame it would show
+
+    FRAME <node> <index> <due us> <shown us> <r> <g> <b>
+
+  with the monotonic time the frame was scheduled for and the time the
+  process got to it, so several processes on loopback can be compared frame
+  by frame, see sync_test.py. each process gets its own simulated crystal:
+  its clock is the monotonic clock plus an offset, running fast or slow by
+  some ppm.
+
+    gcc -O2 -I../lib led_sync.c ../lib/sync_node.c ../lib/sync_clock.c \
+      ../lib/sync_proto.c -o led_sync
+    ./led_sync -L -t 20                # leader, new effect every 5 s
+    ./led_sync -o 1500 -d 80 -t 20     # follower 1.5 s ahead, 80 ppm fast
+    ./led_sync -o -300 -d -40 -l 10 -j 2000 -t 20  # lossy, jittery follower
+
+  exits 2 on bad arguments or when the sockets can't be set up.
+*/
+#define _GNU_SOURCE
+#include "sync_node.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SEND_QUEUE 16
+
+typedef struct {
+  int64_t at_us; // true time to send
+  struct sockaddr_in to;
+  uint8_t buf[SYNC_MSG_MAX];
+  size_t len;
+} pending_t;
+
+static int64_t start_us;
+static double offset_us;
+static double drift;
+static pending_t queue[SEND_QUEUE];
+static int queued;
+static int ucast = -1;
+static struct sockaddr_in group_addr;
+static struct sockaddr_in leader_addr;
+static int have_leader_addr;
+
+static int64_t mono_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// simulated crystal: local = true + offset + (true - start) * drift
+static int64_t to_local(int64_t true_us) {
+  return true_us + (int64_t)(offset_us + (true_us - start_us) * drift);
+}
+
+static int64_t to_true(int64_t local_us) {
+  return start_us +
+         (int64_t)((local_us - offset_us - start_us) / (1.0 + drift));
+}
+
+static void queue_send(
+  const uint8_t *buf, size_t len, const struct sockaddr_in *to, int jitter) {
+  if (len == 0 || to == NULL || queued == SEND_QUEUE) {
+    return;
+  }
+  pending_t *p = &queue[queued++];
+  p->at_us = mono_us() + (jitter > 0 ? rand() % jitter : 0);
+  p->to = *to;
+  memcpy(p->buf, buf, len);
+  p->len = len;
+}
+
+static void flush_sends(int64_t now_true) {
+  for (int i = 0; i < queued;) {
+    if (queue[i].at_us > now_true) {
+      i++;
+      continue;
+    }
+    sendto(ucast,
+      queue[i].buf,
+      queue[i].len,
+      0,
+      (struct sockaddr *)&queue[i].to,
+      sizeof(queue[i].to));
+    queue[i] = queue[--queued];
+  }
+}
+
+static const struct sockaddr_in *dest_addr(
+  sync_dest_t dest, const struct sockaddr_in *sender) {
+  switch (dest) {
+  case SYNC_TO_GROUP:
+    return &group_addr;
+  case SYNC_TO_LEADER:
+    return have_leader_addr ? &leader_addr : NULL;
+  case SYNC_TO_SENDER:
+    return sender;
+  default:
+    return NULL;
+  }
+}
+
+// group traffic arrives on mcast, requests and answers on the node's own
+// unicast socket, so every process can share the port on one host
+static int open_sockets(const char *group, int port, int *mcast) {
+  int one = 1;
+  struct in_addr lo = {.s_addr = htonl(INADDR_LOOPBACK)};
+  struct sockaddr_in any = {
+    .sin_family = AF_INET,
+    .sin_port = htons(port),
+    .sin_addr.s_addr = htonl(INADDR_ANY),
+  };
+  struct ip_mreq mreq = {
+    .imr_multiaddr.s_addr = inet_addr(group),
+    .imr_interface = lo,
+  };
+  *mcast = socket(AF_INET, SOCK_DGRAM, 0);
+  if (*mcast < 0 ||
+      setsockopt(*mcast, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0 ||
+      setsockopt(*mcast, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0 ||
+      bind(*mcast, (struct sockaddr *)&any, sizeof(any)) < 0 ||
+      setsockopt(
+        *mcast, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+    perror("multicast socket");
+    return -1;
+  }
+
+  struct sockaddr_in own = {
+    .sin_family = AF_INET,
+    .sin_addr = lo,
+  };
+  unsigned char loop = 1;
+  ucast = socket(AF_INET, SOCK_DGRAM, 0);
+  if (ucast < 0 || bind(ucast, (struct sockaddr *)&own, sizeof(own)) < 0 ||
+      setsockopt(ucast, IPPROTO_IP, IP_MULTICAST_IF, &lo, sizeof(lo)) < 0 ||
+      setsockopt(
+        ucast, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) < 0) {
+    perror("unicast socket");
+    return -1;
+  }
+  group_addr = (struct sockaddr_in){
+    .sin_family = AF_INET,
+    .sin_port = htons(port),
+    .sin_addr.s_addr = inet_addr(group),
+  };
+  return 0;
+}
+
+// what the leader cycles through
+static const sync_effect_t effects[] = {
+  {.type = SYNC_FX_PULSE,
+    .a = {255, 0, 0},
+    .b = {0, 0, 255},
+    .period_ms = 800},
+  {.type = SYNC_FX_RAINBOW, .a = {255, 255, 255}, .period_ms = 1500},
+  {.type = SYNC_FX_BLINK, .a = {0, 255, 0}, .b = {0, 0, 0}, .period_ms = 400},
+};
+#define EFFECT_COUNT (sizeof(effects) / sizeof(effects[0]))
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+    "usage: %s [-L] [-c change_s] [-o offset_ms] [-d drift_ppm] "
+    "[-l loss_pct] [-j jitter_us] [-t seconds] [-i id] [-g group] "
+    "[-p port]\n",
+    prog);
+}
+
+int main(int argc, char **argv) {
+  int leader = 0;
+  double change_s = 5;
+  double seconds = 10;
+  int loss = 0;
+  int jitter = 0;
+  uint32_t id = 0;
+  const char *group = "239.255.76.83";
+  int port = 47800;
+  int opt;
+  while ((opt = getopt(argc, argv, "Lc:o:d:l:j:t:i:g:p:")) != -1) {
+    switch (opt) {
+    case 'L':
+      leader = 1;
+      break;
+    case 'c':
+      change_s = atof(optarg);
+      break;
+    case 'o':
+      offset_us = atof(optarg) * 1000;
+      break;
+    case 'd':
+      drift = atof(optarg) / 1e6;
+      break;
+    case 'l':
+      loss = atoi(optarg);
+      break;
+    case 'j':
+      jitter = atoi(optarg);
+      break;
+    case 't':
+      seconds = atof(optarg);
+      break;
+    case 'i':
+      id = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    case 'g':
+      group = optarg;
+      break;
+    case 'p':
+      port = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (change_s <= 0 || loss < 0 || loss > 100 || jitter < 0) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  start_us = mono_us();
+  srand((unsigned)(start_us ^ getpid()));
+  if (id == 0) {
+    id = ((uint32_t)rand() << 1) | 1;
+  }
+  int mcast;
+  if (open_sockets(group, port, &mcast) != 0) {
+    return 2;
+  }
+  setvbuf(stdout, NULL, _IOLBF, 0);
+
+  sync_node_t node;
+  sync_node_cfg_t cfg = {
+    .leader = leader,
+    .id = id,
+    .lead_us = 300000,
+    .repeat_us = 1000000,
+    .clock_period_us = 2000000,
+  };
+  sync_node_init(&node, &cfg);
+
+  int64_t end_us = start_us + (int64_t)(seconds * 1e6);
+  int64_t change_us = (int64_t)(change_s * 1e6);
+  int64_t next_change = start_us;
+  size_t effect = 0;
+  int have_frame = 0;
+  int64_t due = 0; // local
+  uint8_t rgb[3];
+
+  for (;;) {
+    int64_t now = mono_us();
+    if (now >= end_us) {
+      break;
+    }
+    if (leader && now >= next_change) {
+      sync_node_set_effect(&node, &effects[effect], to_local(now));
+      effect = (effect + 1) % EFFECT_COUNT;
+      next_change += change_us;
+    }
+
+    uint8_t out[SYNC_MSG_MAX];
+    sync_dest_t dest;
+    int64_t next_poll;
+    size_t len = sync_node_poll(
+      &node, to_local(now), out, sizeof(out), &dest, &next_poll);
+    queue_send(out, len, dest_addr(dest, NULL), jitter);
+    flush_sends(now);
+
+    if (have_frame && to_local(now) >= due) {
+      int64_t index = sync_node_frame_index(
+        sync_node_leader_us(&node, due) + SYNC_FRAME_US / 2);
+      printf("FRAME %08x %lld %lld %lld %u %u %u\n",
+        id,
+        (long long)index,
+        (long long)to_true(due),
+        (long long)now,
+        rgb[0],
+        rgb[1],
+        rgb[2]);
+      // strictly after the one just shown
+      have_frame = sync_node_frame(&node, due, &due, rgb);
+    }
+    if (!have_frame) {
+      have_frame = sync_node_frame(&node, to_local(now), &due, rgb);
+    }
+
+    int64_t wake = end_us;
+    if (to_true(next_poll) < wake) {
+      wake = to_true(next_poll);
+    }
+    if (have_frame && to_true(due) < wake) {
+      wake = to_true(due);
+    }
+    if (!have_frame && now + SYNC_FRAME_US < wake) {
+      wake = now + SYNC_FRAME_US;
+    }
+    for (int i = 0; i < queued; i++) {
+      if (queue[i].at_us < wake) {
+        wake = queue[i].at_us;
+      }
+    }
+    if (leader && next_change < wake) {
+      wake = next_change;
+    }
+
+    int64_t wait = wake - mono_us();
+    if (wait < 0) {
+      wait = 0;
+    }
+    struct timespec ts = {
+      .tv_sec = wait / 1000000,
+      .tv_nsec = (wait % 1000000) * 1000,
+    };
+    struct pollfd fds[2] = {
+      {.fd = mcast, .events = POLLIN},
+      {.fd = ucast, .events = POLLIN},
+    };
+    if (ppoll(fds, 2, &ts, NULL) <= 0) {
+      continue;
+    }
+
+    for (int i = 0; i < 2; i++) {
+      if (!(fds[i].revents & POLLIN)) {
+        continue;
+      }
+      uint8_t buf[SYNC_MSG_MAX];
+      struct sockaddr_in from;
+      socklen_t from_len = sizeof(from);
+      ssize_t n = recvfrom(
+        fds[i].fd, buf, sizeof(buf), 0, (struct sockaddr *)&from, &from_len);
+      int64_t rx_local = to_local(mono_us());
+      if (n <= 0 || rand() % 100 < loss) {
+        continue;
+      }
+      uint32_t leader_id = node.leader_id;
+      len = sync_node_rx(
+        &node, buf, (size_t)n, rx_local, out, sizeof(out), &dest);
+      if (!leader && node.leader_id != leader_id) {
+        // the leader sends effects from its unicast socket
+        leader_addr = from;
+        have_leader_addr = 1;
+        have_frame = 0;
+      }
+      queue_send(out, len, dest_addr(dest, &from), jitter);
+    }
+  }
+
+  fprintf(stderr,
+    "node %08x: %u effects, %u exchanges, %u outliers, offset %lld us, "
+    "drift %.1f ppm (simulated %.1f)\n",
+    id,
+    node.stats.effects,
+    node.stats.exchanges,
+    node.stats.outliers,
+    (long long)node.stats.last_offset_us,
+    node.stats.drift_ppb / 1000.0,
+    -drift * 1e6);
+  return 0;
+}
@@ -0,0 +1,187 @@
+#!/usr/bin/env python3
+"""Measure /api/events with several subscribers at once.
+
+Opens N subscribers, posts a run of distinct colors to /api/color and times
+how long each color takes to show up as a color event on every subscriber.
+Gaps in the event ids are states a subscriber skipped. The device side cost
+of one fan-out pass comes from the events section of /api/stats.
+
+    python sse_clients.py 192.168.1.50                  # 1, 2 and 4 clients
+    python sse_clients.py 192.168.1.50 -n 4 -c 500 -r 100
+"""
+import argparse
+import json
+import socket
+import statistics
+import threading
+import time
+import urllib.error
+import urllib.request
+
+
+class Subscriber(threading.Thread):
+    def __init__(self, host, port):
+        super().__init__(daemon=True)
+        self.sock = socket.create_connection((host, port), timeout=5)
+        self.sock.sendall(
+            f"GET /api/events HTTP/1.1\r\nHost: {host}\r\n"
+            "Accept: text/event-stream\r\n\r\n".encode()
+        )
+        self.colors = {}  # (r, g, b) -> first time seen
+        self.events = 0
+        self.skipped = 0
+        self.last_id = {}
+        self.ok = False
+        self.stop = False
+
+    def handle(self, event, data, ev_id, now):
+        self.events += 1
+        if ev_id is not None:
+            last = self.last_id.get(event)
+            if last is not None and ev_id > last + 1:
+                self.skipped += ev_id - last - 1
+            self.last_id[event] = ev_id
+        if event == "color":
+            s = json.loads(data)
+            self.colors.setdefault((s["r"], s["g"], s["b"]), now)
+
+    def run(self):
+        buf = b""
+        head_done = False
+        event, data, ev_id = "message", "", None
+        while not self.stop:
+            try:
+                chunk = self.sock.recv(4096)
+            except socket.timeout:
+                continue
+            except OSError:
+                break
+            if not chunk:
+                break
+            now = time.monotonic()
+            buf += chunk
+            if not head_done:
+                if b"\r\n\r\n" not in buf:
+                    continue
+                head, buf = buf.split(b"\r\n\r\n", 1)
+                self.ok = b" 200 " in head.split(b"\r\n")[0]
+                head_done = True
+                if not self.ok:
+                    break
+            while b"\n" in buf:
+                line, buf = buf.split(b"\n", 1)
+                line = line.decode()
+                if line == "":
+                    if data:
+                        self.handle(event, data, ev_id, now)
+                    event, data, ev_id = "message", "", None
+                elif line.startswith("event: "):
+                    event = line[7:]
+                elif line.startswith("data: "):
+                    data = line[6:]
+                elif line.startswith("id: "):
+                    ev_id = int(line[4:])
+
+    def close(self):
+        self.stop = True
+        try:
+            self.sock.shutdown(socket.SHUT_RDWR)
+        except OSError:
+            pass
+        self.sock.close()
+
+
+def post_color(base, rgb):
+    body = json.dumps(dict(zip("rgb", rgb))).encode()
+    req = urllib.request.Request(
+        base + "/api/color", body, {"Content-Type": "application/json"}
+    )
+    try:
+        with urllib.request.urlopen(req, timeout=5) as resp:
+            return resp.status == 200
+    except urllib.error.HTTPError:
+        return False
+
+
+def get_events_stats(base):
+    with urllib.request.urlopen(base + "/api/stats", timeout=5) as resp:
+        return json.load(resp)["events"]
+
+
+def pct(values, p):
+    if not values:
+        return float("nan")
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def run(args, base, n, salt):
+    subs = [Subscriber(args.host, args.port) for _ in range(n)]
+    for s in subs:
+        s.start()
+    time.sleep(0.5)
+    if not all(s.ok for s in subs):
+        print(f"{n} clients: device refused a subscriber")
+        for s in subs:
+            s.close()
+        return
+
+    before = get_events_stats(base)
+    posted = {}
+    busy = 0
+    period = 1 / args.rate
+    for i in range(args.colors):
+        # distinct per run, so late events of an earlier run don't match
+        rgb = ((i * 7 + salt) % 256, (i // 256 + salt) % 256, i % 251)
+        start = time.monotonic()
+        if post_color(base, rgb):
+            posted[rgb] = start
+        else:
+            busy += 1
+        time.sleep(max(0, period - (time.monotonic() - start)))
+    time.sleep(1)
+    after = get_events_stats(base)
+    for s in subs:
+        s.close()
+
+    lat = []
+    missed = 0
+    for s in subs:
+        for rgb, t in posted.items():
+            if rgb in s.colors:
+                lat.append((s.colors[rgb] - t) * 1000)
+            else:
+                missed += 1
+    passes = after["passes"] - before["passes"]
+    fanout = (
+        (after["fanout_avg_us"] * after["passes"]
+         - before["fanout_avg_us"] * before["passes"]) / passes
+        if passes > 0
+        else float("nan")
+    )
+    print(
+        f"{n} clients: {len(posted)} colors ({busy} busy), latency p50 "
+        f"{pct(lat, 50):.1f} ms p99 {pct(lat, 99):.1f} ms, "
+        f"{missed / n:.1f} colors not seen per client, "
+        f"{sum(s.skipped for s in subs) / n:.1f} states skipped per client, "
+        f"fan-out {fanout:.0f} us/pass (max {after['fanout_max_us']} us), "
+        f"{after['blocked'] - before['blocked']} blocked sends"
+    )
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("host")
+    ap.add_argument("--port", type=int, default=80)
+    ap.add_argument("-n", "--clients", default="1,2,4", help="e.g. 1,2,4")
+    ap.add_argument("-c", "--colors", type=int, default=200)
+    ap.add_argument("-r", "--rate", type=float, default=20, help="colors/s")
+    args = ap.parse_args()
+    base = f"http://{args.host}:{args.port}"
+
+    for salt, n in enumerate(int(x) for x in args.clients.split(",")):
+        run(args, base, n, salt * 31)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+"""Run a leader and several followers of led_sync on loopback and compare.
+
+Every follower gets its own clock offset, drift, packet loss and send
+jitter. Frames are matched by index across the nodes. The spread of the
+times they were scheduled for is the phase error of the clock alignment; the
+spread of the times the processes got to them adds the host's scheduling
+latency. A frame whose color differs between nodes is a mismatch. Frames
+from the first seconds, while the followers find the leader and fit their
+clocks, are skipped.
+
+    gcc -O2 -I../lib led_sync.c ../lib/sync_node.c ../lib/sync_clock.c \\
+      ../lib/sync_proto.c -o led_sync
+    python sync_test.py                      # 4 followers, 20 s
+    python sync_test.py -n 8 -t 60 --loss 20 --jitter 3000
+
+Exits 1 when the p99 scheduled phase error or the mismatch share is over
+the limit.
+"""
+import argparse
+import collections
+import os
+import random
+import statistics
+import subprocess
+import sys
+import tempfile
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("-n", "--followers", type=int, default=4)
+    parser.add_argument("-t", "--seconds", type=float, default=20)
+    parser.add_argument("-w", "--warmup", type=float, default=5)
+    parser.add_argument("-b", "--binary", default="./led_sync")
+    parser.add_argument("-p", "--port", type=int, default=47800)
+    parser.add_argument("--loss", type=int, default=5, help="percent")
+    parser.add_argument("--jitter", type=int, default=1000, help="us")
+    parser.add_argument("--max-p99", type=float, default=2000, help="us")
+    parser.add_argument("--max-mismatch", type=float, default=2, help="percent")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    if not os.access(args.binary, os.X_OK):
+        sys.exit(f"{args.binary} not found, build it first (see the docstring)")
+
+    rng = random.Random(args.seed)
+    common = ["-t", str(args.seconds), "-p", str(args.port)]
+    cmds = [[args.binary, "-L", "-c", "4"] + common]
+    for _ in range(args.followers):
+        cmds.append([
+            args.binary,
+            "-o", str(rng.randint(-5000, 5000)),
+            "-d", str(rng.randint(-100, 100)),
+            "-l", str(args.loss),
+            "-j", str(args.jitter),
+        ] + common)
+
+    # files rather than pipes, a node blocked on a full pipe misses frames
+    outs = [tempfile.TemporaryFile("w+") for _ in cmds]
+    procs = [subprocess.Popen(c, stdout=o) for c, o in zip(cmds, outs)]
+    # frame index -> node -> (due, shown, color)
+    frames = collections.defaultdict(dict)
+    start = None
+    for proc, out in zip(procs, outs):
+        proc.wait()
+        out.seek(0)
+        for line in out:
+            f = line.split()
+            if f[0] != "FRAME":
+                continue
+            due, shown = int(f[3]), int(f[4])
+            start = due if start is None else min(start, due)
+            frames[int(f[2])][f[1]] = (due, shown, tuple(f[5:8]))
+
+    nodes = len(procs)
+    errors = []  # scheduled
+    shown_errors = []
+    mismatches = 0
+    partial = 0
+    for index, seen in frames.items():
+        due = [d for d, _, _ in seen.values()]
+        if min(due) - start < args.warmup * 1e6:
+            continue
+        if len(seen) < nodes:
+            partial += 1
+            continue
+        shown = [s for _, s, _ in seen.values()]
+        errors.append(max(due) - min(due))
+        shown_errors.append(max(shown) - min(shown))
+        if len({c for _, _, c in seen.values()}) > 1:
+            mismatches += 1
+
+    if not errors:
+        sys.exit("no frame was shown by every node")
+    p99 = percentile(errors, 99)
+    mismatch = 100 * mismatches / len(errors)
+    print(f"{nodes} nodes, {len(errors)} frames on all, {partial} on some")
+    print("phase error (max - min per frame)")
+    for name, e in (("scheduled", errors), ("shown", shown_errors)):
+        print(f"  {name:9} p50 {statistics.median(e):.0f} us, "
+              f"p99 {percentile(e, 99)} us, max {max(e)} us")
+    print(f"color mismatches {mismatches} ({mismatch:.2f} %)")
+    if p99 > args.max_p99 or mismatch > args.max_mismatch:
+        print("FAIL")
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,98 @@
+#include "battery.h"
+#include "sdkconfig.h"
+
+#if CONFIG_TH_BATTERY_ADC_CHANNEL >= 0
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_log.h"
+#include <stdbool.h>
+
+#define BATTERY_CHANNEL ((adc_channel_t)CONFIG_TH_BATTERY_ADC_CHANNEL)
+// a few conversions smooth out the divider noise
+#define BATTERY_READS 4
+
+static const char *TAG = "BATTERY";
+
+static adc_oneshot_unit_handle_t adc = NULL;
+static adc_cali_handle_t cali = NULL;
+
+esp_err_t battery_init(void) {
+  adc_oneshot_unit_init_cfg_t unit_cfg = {.unit_id = ADC_UNIT_1};
+  esp_err_t err = adc_oneshot_new_unit(&unit_cfg, &adc);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "adc_oneshot_new_unit; error code: %d ", err);
+    return err;
+  }
+  adc_oneshot_chan_cfg_t chan_cfg = {
+    .atten = ADC_ATTEN_DB_12,
+    .bitwidth = ADC_BITWIDTH_DEFAULT,
+  };
+  err = adc_oneshot_config_channel(adc, BATTERY_CHANNEL, &chan_cfg);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "adc_oneshot_config_channel; error code: %d ", err);
+    return err;
+  }
+
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+  adc_cali_curve_fitting_config_t cali_cfg = {
+    .unit_id = ADC_UNIT_1,
+    .chan = BATTERY_CHANNEL,
+    .atten = ADC_ATTEN_DB_12,
+    .bitwidth = ADC_BITWIDTH_DEFAULT,
+  };
+  err = adc_cali_create_scheme_curve_fitting(&cali_cfg, &cali);
+#elif ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED
+  adc_cali_line_fitting_config_t cali_cfg = {
+    .unit_id = ADC_UNIT_1,
+    .atten = ADC_ATTEN_DB_12,
+    .bitwidth = ADC_BITWIDTH_DEFAULT,
+  };
+  err = adc_cali_create_scheme_line_fitting(&cali_cfg, &cali);
+#else
+  err = ESP_ERR_NOT_SUPPORTED;
+#endif
+  if (err != ESP_OK) {
+    // chips without eFuse calibration still get a rough level
+    ESP_LOGW(TAG, "no ADC calibration; error code: %d ", err);
+    cali = NULL;
+  }
+  return ESP_OK;
+}
+
+static bool read_mv(int *mv) {
+  int sum = 0;
+  for (int i = 0; i < BATTERY_READS; i++) {
+    int raw;
+    if (adc_oneshot_read(adc, BATTERY_CHANNEL, &raw) != ESP_OK) {
+      return false;
+    }
+    sum += raw;
+  }
+  int raw = sum / BATTERY_READS;
+  if (cali == NULL || adc_cali_raw_to_voltage(cali, raw, mv) != ESP_OK) {
+    // 12 dB attenuation is roughly 0-3.1 V over the 12 bit range
+    *mv = raw * 3100 / 4095;
+  }
+  return true;
+}
+
+uint8_t battery_level(void) {
+  int mv;
+  if (adc == NULL || !read_mv(&mv)) {
+    return BATTERY_UNKNOWN;
+  }
+  int battery_mv = mv * CONFIG_TH_BATTERY_DIVIDER / 1000;
+  int span = CONFIG_TH_BATTERY_FULL_MV - CONFIG_TH_BATTERY_EMPTY_MV;
+  int pct =
+    span > 0 ? (battery_mv - CONFIG_TH_BATTERY_EMPTY_MV) * 100 / span : 0;
+  return pct < 0 ? 0 : pct > 100 ? 100 : (uint8_t)pct;
+}
+
+#else
+
+esp_err_t battery_init(void) { return ESP_OK; }
+
+uint8_t battery_level(void) { return BATTERY_UNKNOWN; }
+
+#endif
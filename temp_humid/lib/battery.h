@@ -0,0 +1,15 @@
+#ifndef BATTERY_H
+#define BATTERY_H
+
+#include "esp_err.h"
+#include <stdint.h>
+
+// battery level through a divider on an ADC1 pin, see Kconfig.projbuild.
+// level is BEACON_BATTERY_UNKNOWN (0xff) without one
+#define BATTERY_UNKNOWN 0xff
+
+esp_err_t battery_init(void);
+// percent between the empty and full voltages, linear
+uint8_t battery_level(void);
+
+#endif
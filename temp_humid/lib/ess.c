@@ -0,0 +1,543 @@
+#include "ess.h"
+#include "sdkconfig.h"
+
+#if CONFIG_TH_ESS_ENABLE
+#include "beacon.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "ess_codec.h"
+#include "ess_hist.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "host/ble_hs.h"
+#include "os/os_mbuf.h"
+#include <string.h>
+
+#define DEVICE_NAME "TEMP_HUMID"
+#define CHAN_TEMP 0
+#define CHAN_HUM 1
+#define CHANNELS 2
+// one notification at the largest ATT MTU NimBLE goes to
+#define CHUNK_MAX 244
+#define HIST_INFO_LEN 10
+// ES application errors
+#define ATT_ERR_WRITE_REJECTED 0x80
+#define ATT_ERR_CONDITION_NOT_SUPPORTED 0x81
+
+static const char *TAG = "ESS";
+
+typedef struct {
+  uint16_t val_handle;
+  ess_triggers_t triggers;
+  ess_sent_t last;
+  int32_t value; // hundredths
+  bool subscribed;
+} channel_t;
+
+typedef struct {
+  uint8_t chan;
+  uint8_t index;
+} trigger_ref_t;
+
+// guards the state below, GATT and GAP calls come from the host task,
+// readings from the sensor task
+static SemaphoreHandle_t lock;
+static StaticSemaphore_t lock_buf;
+
+static channel_t channels[CHANNELS];
+static ess_record_t records[CONFIG_TH_ESS_HISTORY_LEN];
+static ess_hist_t hist;
+static uint32_t hist_t_s;
+static uint16_t hist_handle;
+static bool hist_subscribed;
+static ess_stream_t stream;
+static uint16_t conn_handle = BLE_HS_CONN_HANDLE_NONE;
+static uint32_t update_s;
+static ess_stats_t stats;
+
+static trigger_ref_t trigger_refs[CHANNELS][ESS_TRIGGERS] = {
+  {{CHAN_TEMP, 0}, {CHAN_TEMP, 1}},
+  {{CHAN_HUM, 0}, {CHAN_HUM, 1}},
+};
+
+static void put_u32(uint8_t *p, uint32_t v) {
+  for (int i = 0; i < 4; i++) {
+    p[i] = (uint8_t)(v >> (8 * i));
+  }
+}
+
+// with the lock held
+static void reset_channels(void) {
+  static const int32_t deadband[CHANNELS] = {
+    [CHAN_TEMP] = CONFIG_TH_ESS_TEMP_DEADBAND * 10,
+    [CHAN_HUM] = CONFIG_TH_ESS_HUM_DEADBAND * 10,
+  };
+  for (int i = 0; i < CHANNELS; i++) {
+    channel_t *ch = &channels[i];
+    ch->triggers = (ess_triggers_t){
+      .trigger =
+        {
+          {.condition = ESS_TRIG_CHANGED},
+          {
+            .condition = ESS_TRIG_MIN_TIME,
+            .operand = CONFIG_TH_ESS_MIN_INTERVAL_S,
+          },
+        },
+      .logic = ESS_LOGIC_AND,
+      .value_signed = i == CHAN_TEMP,
+      .deadband = deadband[i],
+    };
+    ch->last.sent = false;
+    ch->subscribed = false;
+  }
+}
+
+static int append(struct os_mbuf *om, const void *buf, size_t len) {
+  return os_mbuf_append(om, buf, len) == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+}
+
+static int value_access(uint16_t conn_handle,
+  uint16_t attr_handle,
+  struct ble_gatt_access_ctxt *ctxt,
+  void *arg) {
+  if (ctxt->op != BLE_GATT_ACCESS_OP_READ_CHR) {
+    return BLE_ATT_ERR_UNLIKELY;
+  }
+  const channel_t *ch = arg;
+  xSemaphoreTake(lock, portMAX_DELAY);
+  uint8_t buf[2] = {(uint8_t)ch->value, (uint8_t)(ch->value >> 8)};
+  xSemaphoreGive(lock);
+  return append(ctxt->om, buf, sizeof(buf));
+}
+
+static int trigger_access(uint16_t conn_handle,
+  uint16_t attr_handle,
+  struct ble_gatt_access_ctxt *ctxt,
+  void *arg) {
+  const trigger_ref_t *ref = arg;
+  channel_t *ch = &channels[ref->chan];
+  ess_trigger_t *trigger = &ch->triggers.trigger[ref->index];
+  uint8_t buf[ESS_TRIGGER_MAX_LEN];
+
+  if (ctxt->op == BLE_GATT_ACCESS_OP_READ_DSC) {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    size_t len = ess_trigger_encode(
+      trigger, ch->triggers.value_signed, buf, sizeof(buf));
+    xSemaphoreGive(lock);
+    return append(ctxt->om, buf, len);
+  }
+  if (ctxt->op != BLE_GATT_ACCESS_OP_WRITE_DSC) {
+    return BLE_ATT_ERR_UNLIKELY;
+  }
+
+  uint16_t len = OS_MBUF_PKTLEN(ctxt->om);
+  if (len == 0 || len > sizeof(buf)) {
+    return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+  }
+  os_mbuf_copydata(ctxt->om, 0, len, buf);
+  ess_trigger_t decoded;
+  if (ess_trigger_decode(buf, len, ch->triggers.value_signed, &decoded) !=
+      0) {
+    return ATT_ERR_CONDITION_NOT_SUPPORTED;
+  }
+  xSemaphoreTake(lock, portMAX_DELAY);
+  *trigger = decoded;
+  xSemaphoreGive(lock);
+  return 0;
+}
+
+static int config_access(uint16_t conn_handle,
+  uint16_t attr_handle,
+  struct ble_gatt_access_ctxt *ctxt,
+  void *arg) {
+  channel_t *ch = arg;
+  if (ctxt->op == BLE_GATT_ACCESS_OP_READ_DSC) {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    uint8_t logic = ch->triggers.logic;
+    xSemaphoreGive(lock);
+    return append(ctxt->om, &logic, 1);
+  }
+  if (ctxt->op != BLE_GATT_ACCESS_OP_WRITE_DSC) {
+    return BLE_ATT_ERR_UNLIKELY;
+  }
+
+  if (OS_MBUF_PKTLEN(ctxt->om) != 1) {
+    return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+  }
+  uint8_t logic;
+  os_mbuf_copydata(ctxt->om, 0, 1, &logic);
+  if (logic != ESS_LOGIC_AND && logic != ESS_LOGIC_OR) {
+    return ATT_ERR_WRITE_REJECTED;
+  }
+  xSemaphoreTake(lock, portMAX_DELAY);
+  ch->triggers.logic = logic;
+  xSemaphoreGive(lock);
+  return 0;
+}
+
+static int measurement_access(uint16_t conn_handle,
+  uint16_t attr_handle,
+  struct ble_gatt_access_ctxt *ctxt,
+  void *arg) {
+  if (ctxt->op != BLE_GATT_ACCESS_OP_READ_DSC) {
+    return BLE_ATT_ERR_UNLIKELY;
+  }
+  uint8_t buf[ESS_MEAS_LEN];
+  size_t len = ess_measurement_encode(update_s, buf, sizeof(buf));
+  return append(ctxt->om, buf, len);
+}
+
+// one chunk per call, the next goes once NimBLE reports this one sent, so
+// a fetch never holds more than one history notification in the mbuf pool
+static void send_chunk(void) {
+  // only touched from the host task
+  static uint8_t chunk[CHUNK_MAX];
+
+  xSemaphoreTake(lock, portMAX_DELAY);
+  if (!hist_subscribed || conn_handle == BLE_HS_CONN_HANDLE_NONE) {
+    xSemaphoreGive(lock);
+    return;
+  }
+  uint16_t conn = conn_handle;
+  uint16_t mtu = ble_att_mtu(conn);
+  size_t room = mtu > 3 ? mtu - 3 : 0;
+  if (room > sizeof(chunk)) {
+    room = sizeof(chunk);
+  }
+  // nothing while the previous chunk is in flight, its NOTIFY_TX sends on
+  size_t len = ess_stream_chunk(&stream, &hist, chunk, room);
+  if (len == 0) {
+    xSemaphoreGive(lock);
+    return;
+  }
+  stats.chunks++;
+  xSemaphoreGive(lock);
+
+  struct os_mbuf *om = ble_hs_mbuf_from_flat(chunk, len);
+  int nimble_err =
+    om != NULL ? ble_gatts_notify_custom(conn, hist_handle, om) : BLE_HS_ENOMEM;
+  if (nimble_err != 0) {
+    // the client fetches again from the last record it got
+    ESP_LOGE(TAG, "send_chunk; error code: %d ", nimble_err);
+    xSemaphoreTake(lock, portMAX_DELAY);
+    ess_stream_sent(&stream, false);
+    xSemaphoreGive(lock);
+  }
+}
+
+static int hist_access(uint16_t conn_handle,
+  uint16_t attr_handle,
+  struct ble_gatt_access_ctxt *ctxt,
+  void *arg) {
+  if (ctxt->op == BLE_GATT_ACCESS_OP_READ_CHR) {
+    uint8_t buf[HIST_INFO_LEN];
+    xSemaphoreTake(lock, portMAX_DELAY);
+    put_u32(buf, ess_hist_oldest(&hist));
+    put_u32(buf + 4, hist.next_seq);
+    xSemaphoreGive(lock);
+    buf[8] = (uint8_t)CONFIG_TH_ESS_HISTORY_PERIOD_S;
+    buf[9] = (uint8_t)(CONFIG_TH_ESS_HISTORY_PERIOD_S >> 8);
+    return append(ctxt->om, buf, sizeof(buf));
+  }
+  if (ctxt->op != BLE_GATT_ACCESS_OP_WRITE_CHR) {
+    return BLE_ATT_ERR_UNLIKELY;
+  }
+
+  uint8_t req[5];
+  uint16_t len = OS_MBUF_PKTLEN(ctxt->om);
+  if (len == 0 || len > sizeof(req)) {
+    return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+  }
+  os_mbuf_copydata(ctxt->om, 0, len, req);
+
+  switch (req[0]) {
+  case ESS_HIST_OP_FETCH:
+    if (len != 5) {
+      return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    }
+    // during a stream this only moves the running chain to the new seq
+    xSemaphoreTake(lock, portMAX_DELAY);
+    ess_stream_fetch(&stream,
+      req[1] | req[2] << 8 | req[3] << 16 | (uint32_t)req[4] << 24);
+    xSemaphoreGive(lock);
+    send_chunk();
+    return 0;
+  case ESS_HIST_OP_STOP:
+    xSemaphoreTake(lock, portMAX_DELAY);
+    ess_stream_stop(&stream);
+    xSemaphoreGive(lock);
+    return 0;
+  }
+  return BLE_ATT_ERR_UNLIKELY;
+}
+
+static struct ble_gatt_dsc_def temp_dscs[] = {
+  {
+    .uuid = BLE_UUID16_DECLARE(ESS_TRIGGER_DSC_UUID),
+    .att_flags = BLE_ATT_F_READ | BLE_ATT_F_WRITE,
+    .access_cb = trigger_access,
+    .arg = &trigger_refs[CHAN_TEMP][0],
+  },
+  {
+    .uuid = BLE_UUID16_DECLARE(ESS_TRIGGER_DSC_UUID),
+    .att_flags = BLE_ATT_F_READ | BLE_ATT_F_WRITE,
+    .access_cb = trigger_access,
+    .arg = &trigger_refs[CHAN_TEMP][1],
+  },
+  {
+    .uuid = BLE_UUID16_DECLARE(ESS_CONFIG_DSC_UUID),
+    .att_flags = BLE_ATT_F_READ | BLE_ATT_F_WRITE,
+    .access_cb = config_access,
+    .arg = &channels[CHAN_TEMP],
+  },
+  {
+    .uuid = BLE_UUID16_DECLARE(ESS_MEAS_DSC_UUID),
+    .att_flags = BLE_ATT_F_READ,
+    .access_cb = measurement_access,
+  },
+  {0}};
+
+static struct ble_gatt_dsc_def hum_dscs[] = {
+  {
+    .uuid = BLE_UUID16_DECLARE(ESS_TRIGGER_DSC_UUID),
+    .att_flags = BLE_ATT_F_READ | BLE_ATT_F_WRITE,
+    .access_cb = trigger_access,
+    .arg = &trigger_refs[CHAN_HUM][0],
+  },
+  {
+    .uuid = BLE_UUID16_DECLARE(ESS_TRIGGER_DSC_UUID),
+    .att_flags = BLE_ATT_F_READ | BLE_ATT_F_WRITE,
+    .access_cb = trigger_access,
+    .arg = &trigger_refs[CHAN_HUM][1],
+  },
+  {
+    .uuid = BLE_UUID16_DECLARE(ESS_CONFIG_DSC_UUID),
+    .att_flags = BLE_ATT_F_READ | BLE_ATT_F_WRITE,
+    .access_cb = config_access,
+    .arg = &channels[CHAN_HUM],
+  },
+  {
+    .uuid = BLE_UUID16_DECLARE(ESS_MEAS_DSC_UUID),
+    .att_flags = BLE_ATT_F_READ,
+    .access_cb = measurement_access,
+  },
+  {0}};
+
+static const struct ble_gatt_chr_def ess_chars[] = {
+  {
+    .uuid = BLE_UUID16_DECLARE(ESS_TEMP_CHAR_UUID),
+    .access_cb = value_access,
+    .arg = &channels[CHAN_TEMP],
+    .descriptors = temp_dscs,
+    .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY,
+    .val_handle = &channels[CHAN_TEMP].val_handle,
+  },
+  {
+    .uuid = BLE_UUID16_DECLARE(ESS_HUM_CHAR_UUID),
+    .access_cb = value_access,
+    .arg = &channels[CHAN_HUM],
+    .descriptors = hum_dscs,
+    .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY,
+    .val_handle = &channels[CHAN_HUM].val_handle,
+  },
+  {0}};
+
+// ESS_HIST_SVC_UUID and ESS_HIST_CHAR_UUID, little endian
+#define HIST_UUID(id)                                                        \
+  {                                                                          \
+    .u.type = BLE_UUID_TYPE_128,                                             \
+    .value = {0xb6, 0xa5, 0xd4, 0xf0, 0xe2, 0x81, 0x2b, 0x9a, 0x6d, 0x4f,   \
+      0x5e, 0x3b, id, 0x00, 0xa1, 0xc7},                                     \
+  }
+
+static const ble_uuid128_t hist_svc_uuid = HIST_UUID(0x01);
+static const ble_uuid128_t hist_char_uuid = HIST_UUID(0x02);
+
+static const struct ble_gatt_chr_def hist_chars[] = {
+  {
+    .uuid = &hist_char_uuid.u,
+    .access_cb = hist_access,
+    .flags =
+      BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_NOTIFY,
+    .val_handle = &hist_handle,
+  },
+  {0}};
+
+static const struct ble_gatt_svc_def ess_svcs[] = {
+  {
+    .type = BLE_GATT_SVC_TYPE_PRIMARY,
+    .uuid = BLE_UUID16_DECLARE(ESS_SVC_UUID),
+    .characteristics = ess_chars,
+  },
+  {
+    .type = BLE_GATT_SVC_TYPE_PRIMARY,
+    .uuid = &hist_svc_uuid.u,
+    .characteristics = hist_chars,
+  },
+  {0}};
+
+static void on_subscribe(const struct ble_gap_event *event) {
+  uint16_t handle = event->subscribe.attr_handle;
+  bool on = event->subscribe.cur_notify;
+
+  xSemaphoreTake(lock, portMAX_DELAY);
+  for (int i = 0; i < CHANNELS; i++) {
+    if (channels[i].val_handle == handle) {
+      channels[i].subscribed = on;
+      // the next reading goes out whatever the triggers say
+      channels[i].last.sent = false;
+    }
+  }
+  bool resume = false;
+  if (handle == hist_handle) {
+    hist_subscribed = on;
+    resume = on && stream.active;
+  }
+  xSemaphoreGive(lock);
+
+  // a fetch written before the subscription starts now
+  if (resume) {
+    send_chunk();
+  }
+}
+
+// the beacon passes on every event of the connection
+static int on_gap_event(struct ble_gap_event *event, void *arg) {
+  switch (event->type) {
+  case BLE_GAP_EVENT_CONNECT:
+    if (event->connect.status == 0) {
+      xSemaphoreTake(lock, portMAX_DELAY);
+      conn_handle = event->connect.conn_handle;
+      xSemaphoreGive(lock);
+      ESP_LOGI(TAG, "client connected");
+    }
+    break;
+  case BLE_GAP_EVENT_DISCONNECT:
+    xSemaphoreTake(lock, portMAX_DELAY);
+    conn_handle = BLE_HS_CONN_HANDLE_NONE;
+    hist_subscribed = false;
+    stream = (ess_stream_t){0};
+    reset_channels();
+    xSemaphoreGive(lock);
+    ESP_LOGI(TAG, "client gone; reason=%d", event->disconnect.reason);
+    break;
+  case BLE_GAP_EVENT_SUBSCRIBE:
+    on_subscribe(event);
+    break;
+  case BLE_GAP_EVENT_NOTIFY_TX:
+    if (event->notify_tx.attr_handle != hist_handle ||
+        event->notify_tx.indication) {
+      break;
+    }
+    if (event->notify_tx.status != 0) {
+      // the chunk never left, the client fetches again from the last record
+      // it got instead of getting the rest with a gap
+      ESP_LOGE(TAG, "history notify; error code: %d ", event->notify_tx.status);
+    }
+    xSemaphoreTake(lock, portMAX_DELAY);
+    bool more = ess_stream_sent(&stream, event->notify_tx.status == 0);
+    xSemaphoreGive(lock);
+    if (more) {
+      send_chunk();
+    }
+    break;
+  }
+  return 0;
+}
+
+static void notify(uint16_t conn, const channel_t *ch, int32_t value) {
+  uint8_t buf[2] = {(uint8_t)value, (uint8_t)(value >> 8)};
+  struct os_mbuf *om = ble_hs_mbuf_from_flat(buf, sizeof(buf));
+  int nimble_err = om != NULL
+                     ? ble_gatts_notify_custom(conn, ch->val_handle, om)
+                     : BLE_HS_ENOMEM;
+  if (nimble_err != 0) {
+    ESP_LOGE(TAG, "ble_gatts_notify_custom; error code: %d ", nimble_err);
+  }
+}
+
+esp_err_t ess_init(uint32_t interval_s) {
+  lock = xSemaphoreCreateMutexStatic(&lock_buf);
+  update_s = interval_s;
+  ess_hist_init(&hist, records, CONFIG_TH_ESS_HISTORY_LEN);
+  reset_channels();
+
+  beacon_cfg_t cfg = {
+    .name = DEVICE_NAME,
+    .svcs = ess_svcs,
+    .svc_uuid = ESS_SVC_UUID,
+    .on_gap = on_gap_event,
+  };
+  return beacon_init(&cfg);
+}
+
+void ess_update(const power_sample_t *sample) {
+  if (lock == NULL) {
+    return;
+  }
+  int64_t now = esp_timer_get_time();
+  // tenths to the hundredths of the characteristics
+  int32_t values[CHANNELS] = {
+    [CHAN_TEMP] = sample->temperature * 10,
+    [CHAN_HUM] = sample->humidity * 10,
+  };
+  bool due[CHANNELS] = {false};
+
+  xSemaphoreTake(lock, portMAX_DELAY);
+  if (hist.count == 0 ||
+      sample->t_s - hist_t_s >= CONFIG_TH_ESS_HISTORY_PERIOD_S) {
+    ess_record_t record = {
+      .t_s = sample->t_s,
+      .temperature = (int16_t)values[CHAN_TEMP],
+      .humidity = (uint16_t)values[CHAN_HUM],
+    };
+    ess_hist_push(&hist, &record);
+    hist_t_s = sample->t_s;
+  }
+
+  for (int i = 0; i < CHANNELS; i++) {
+    channel_t *ch = &channels[i];
+    ch->value = values[i];
+    if (!ch->subscribed) {
+      continue;
+    }
+    if (!ess_trigger_due(&ch->triggers, &ch->last, values[i], now)) {
+      stats.suppressed++;
+      continue;
+    }
+    ch->last = (ess_sent_t){.sent = true, .value = values[i], .at_us = now};
+    due[i] = true;
+    stats.notified++;
+  }
+  uint16_t conn = conn_handle;
+  xSemaphoreGive(lock);
+
+  for (int i = 0; i < CHANNELS; i++) {
+    if (due[i]) {
+      notify(conn, &channels[i], values[i]);
+    }
+  }
+}
+
+void ess_get_stats(ess_stats_t *out) {
+  if (lock == NULL) {
+    memset(out, 0, sizeof(*out));
+    return;
+  }
+  xSemaphoreTake(lock, portMAX_DELAY);
+  *out = stats;
+  out->records = (uint32_t)hist.count;
+  xSemaphoreGive(lock);
+}
+
+#else
+
+#include <string.h>
+
+esp_err_t ess_init(uint32_t update_s) { return ESP_ERR_NOT_SUPPORTED; }
+
+void ess_update(const power_sample_t *sample) {}
+
+void ess_get_stats(ess_stats_t *out) { memset(out, 0, sizeof(*out)); }
+
+#endif
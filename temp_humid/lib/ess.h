@@ -0,0 +1,45 @@
+#ifndef ESS_H
+#define ESS_H
+
+#include "esp_err.h"
+#include "power.h"
+#include <stdint.h>
+
+/*
+  GATT Environmental Sensing Service for one client at a time, served on
+  the beacon's connection (components/beacon) so broadcasting goes on while
+  a client is connected. ess_codec.h has the characteristics and their
+  triggers: a subscribed client is notified only when the triggers say so,
+  instead of polling reads every interval.
+
+  the history characteristic sits in a vendor service of its own,
+  ESS_HIST_SVC_UUID / ESS_HIST_CHAR_UUID, with the chunks of ess_hist.h:
+
+    write 0x01 | since seq u32  notifies chunks from since on, up to the
+                                empty one. needs the notification enabled
+    write 0x02                  stops
+    read                        oldest seq u32 | next seq u32 | period u16 s
+
+  trigger settings go back to the Kconfig defaults when the client leaves,
+  there is no bonding to tell clients apart.
+*/
+
+#define ESS_HIST_SVC_UUID "c7a10001-3b5e-4f6d-9a2b-81e2f0d4a5b6"
+#define ESS_HIST_CHAR_UUID "c7a10002-3b5e-4f6d-9a2b-81e2f0d4a5b6"
+#define ESS_HIST_OP_FETCH 0x01
+#define ESS_HIST_OP_STOP 0x02
+
+typedef struct {
+  uint32_t notified;   // temperature and humidity notifications
+  uint32_t suppressed; // readings a subscribed client wasn't sent
+  uint32_t chunks;     // history notifications
+  uint32_t records;    // in the history ring
+} ess_stats_t;
+
+// brings the beacon up with the services. readings come every update_s
+esp_err_t ess_init(uint32_t update_s);
+// call with every stored sample
+void ess_update(const power_sample_t *sample);
+void ess_get_stats(ess_stats_t *out);
+
+#endif
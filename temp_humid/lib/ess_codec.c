@@ -0,0 +1,142 @@
+#include "ess_codec.h"
+#include <stdlib.h>
+
+#define SAMPLING_UNSPECIFIED 0x00
+#define APPLICATION_AIR 0x01
+#define UNCERTAINTY_UNKNOWN 0xff
+
+static void put_u16(uint8_t *p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u24(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+}
+
+static int32_t get_value(const uint8_t *p, bool value_signed) {
+  uint16_t v = (uint16_t)(p[0] | p[1] << 8);
+  return value_signed ? (int16_t)v : v;
+}
+
+static bool met(const ess_trigger_t *t,
+  int32_t deadband,
+  const ess_sent_t *last,
+  int32_t value,
+  int64_t now_us) {
+  switch (t->condition) {
+  case ESS_TRIG_INTERVAL:
+  case ESS_TRIG_MIN_TIME:
+    return now_us - last->at_us >= (int64_t)t->operand * 1000000;
+  case ESS_TRIG_CHANGED:
+    return abs(value - last->value) >= (deadband > 0 ? deadband : 1);
+  case ESS_TRIG_LT:
+    return value < t->operand;
+  case ESS_TRIG_LE:
+    return value <= t->operand;
+  case ESS_TRIG_GT:
+    return value > t->operand;
+  case ESS_TRIG_GE:
+    return value >= t->operand;
+  case ESS_TRIG_EQ:
+    return value == t->operand;
+  case ESS_TRIG_NE:
+    return value != t->operand;
+  }
+  return false;
+}
+
+bool ess_trigger_due(const ess_triggers_t *triggers,
+  const ess_sent_t *last,
+  int32_t value,
+  int64_t now_us) {
+  bool and = triggers->logic == ESS_LOGIC_AND;
+  bool any_active = false;
+  bool result = and;
+  for (int i = 0; i < ESS_TRIGGERS; i++) {
+    const ess_trigger_t *t = &triggers->trigger[i];
+    if (t->condition == ESS_TRIG_INACTIVE) {
+      continue;
+    }
+    any_active = true;
+    // the first value after a subscription always goes out
+    bool ok = !last->sent || met(t, triggers->deadband, last, value, now_us);
+    result = and ? result && ok : result || ok;
+  }
+  return any_active && result;
+}
+
+size_t ess_trigger_encode(
+  const ess_trigger_t *trigger, bool value_signed, uint8_t *buf, size_t len) {
+  (void)value_signed;
+  size_t need = 1;
+  if (trigger->condition == ESS_TRIG_INTERVAL ||
+      trigger->condition == ESS_TRIG_MIN_TIME) {
+    need = 4;
+  } else if (trigger->condition >= ESS_TRIG_LT) {
+    need = 3;
+  }
+  if (len < need) {
+    return 0;
+  }
+  buf[0] = trigger->condition;
+  if (need == 4) {
+    put_u24(buf + 1, (uint32_t)trigger->operand);
+  } else if (need == 3) {
+    put_u16(buf + 1, (uint16_t)trigger->operand);
+  }
+  return need;
+}
+
+int ess_trigger_decode(
+  const uint8_t *buf, size_t len, bool value_signed, ess_trigger_t *out) {
+  if (len == 0) {
+    return -1;
+  }
+  ess_trigger_t t = {.condition = buf[0]};
+  switch (buf[0]) {
+  case ESS_TRIG_INACTIVE:
+  case ESS_TRIG_CHANGED:
+    if (len != 1) {
+      return -1;
+    }
+    break;
+  case ESS_TRIG_INTERVAL:
+  case ESS_TRIG_MIN_TIME:
+    if (len != 4) {
+      return -1;
+    }
+    t.operand = buf[1] | buf[2] << 8 | buf[3] << 16;
+    break;
+  case ESS_TRIG_LT:
+  case ESS_TRIG_LE:
+  case ESS_TRIG_GT:
+  case ESS_TRIG_GE:
+  case ESS_TRIG_EQ:
+  case ESS_TRIG_NE:
+    if (len != 3) {
+      return -1;
+    }
+    t.operand = get_value(buf + 1, value_signed);
+    break;
+  default:
+    return -1;
+  }
+  *out = t;
+  return 0;
+}
+
+size_t ess_measurement_encode(uint32_t update_s, uint8_t *buf, size_t len) {
+  if (len < ESS_MEAS_LEN) {
+    return 0;
+  }
+  put_u16(buf, 0); // flags, reserved
+  buf[2] = SAMPLING_UNSPECIFIED;
+  put_u24(buf + 3, 0); // measurement period, not in use
+  put_u24(buf + 6, update_s);
+  buf[9] = APPLICATION_AIR;
+  buf[10] = UNCERTAINTY_UNKNOWN;
+  return ESS_MEAS_LEN;
+}
@@ -0,0 +1,93 @@
+#ifndef ESS_CODEC_H
+#define ESS_CODEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  Environmental Sensing Service (0x181A) values and descriptors, hardware
+  independent. temperature (0x2A6E) is sint16 and humidity (0x2A6F) uint16,
+  both in hundredths, little endian.
+
+  each characteristic has two ES Trigger Setting descriptors (0x290D),
+  combined by its ES Configuration descriptor (0x290B). a trigger is a
+  condition byte plus an operand:
+
+    0x00 inactive
+    0x01 fixed interval          u24 seconds
+    0x02 no less than between    u24 seconds
+    0x03 value changed           -
+    0x04..0x09 <, <=, >, >=, ==, != the operand, in the value's format
+
+  "changed" means moved by at least the characteristic's deadband since the
+  last notification, so DHT11 noise doesn't count. the defaults, changed
+  AND at least n seconds apart, notify only on real moves and at a bounded
+  rate.
+*/
+
+#define ESS_SVC_UUID 0x181a
+#define ESS_TEMP_CHAR_UUID 0x2a6e
+#define ESS_HUM_CHAR_UUID 0x2a6f
+#define ESS_CONFIG_DSC_UUID 0x290b
+#define ESS_MEAS_DSC_UUID 0x290c
+#define ESS_TRIGGER_DSC_UUID 0x290d
+
+#define ESS_TRIGGERS 2
+#define ESS_TRIGGER_MAX_LEN 4
+#define ESS_MEAS_LEN 11
+// ES Configuration values
+#define ESS_LOGIC_AND 0x00
+#define ESS_LOGIC_OR 0x01
+
+typedef enum {
+  ESS_TRIG_INACTIVE = 0x00,
+  ESS_TRIG_INTERVAL = 0x01,
+  ESS_TRIG_MIN_TIME = 0x02,
+  ESS_TRIG_CHANGED = 0x03,
+  ESS_TRIG_LT = 0x04,
+  ESS_TRIG_LE = 0x05,
+  ESS_TRIG_GT = 0x06,
+  ESS_TRIG_GE = 0x07,
+  ESS_TRIG_EQ = 0x08,
+  ESS_TRIG_NE = 0x09,
+} ess_condition_t;
+
+typedef struct {
+  uint8_t condition;
+  int32_t operand; // seconds for the time conditions, else hundredths
+} ess_trigger_t;
+
+typedef struct {
+  ess_trigger_t trigger[ESS_TRIGGERS];
+  uint8_t logic;
+  bool value_signed; // operand format: sint16 or uint16
+  int32_t deadband;  // hundredths, what ESS_TRIG_CHANGED counts as a change
+} ess_triggers_t;
+
+// last notification of a characteristic
+typedef struct {
+  bool sent;
+  int32_t value;
+  int64_t at_us;
+} ess_sent_t;
+
+// whether a new value goes out now. with no active trigger nothing does
+bool ess_trigger_due(const ess_triggers_t *triggers,
+  const ess_sent_t *last,
+  int32_t value,
+  int64_t now_us);
+
+// Trigger Setting descriptor value, returns its length or 0 when buf is too
+// small
+size_t ess_trigger_encode(
+  const ess_trigger_t *trigger, bool value_signed, uint8_t *buf, size_t len);
+// returns 0 on success, -1 for an unknown condition or a wrong length
+int ess_trigger_decode(
+  const uint8_t *buf, size_t len, bool value_signed, ess_trigger_t *out);
+
+// ES Measurement descriptor: unspecified sampling, readings every
+// update_s seconds, measured in air
+size_t ess_measurement_encode(uint32_t update_s, uint8_t *buf, size_t len);
+
+#endif
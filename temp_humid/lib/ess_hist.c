@@ -0,0 +1,122 @@
+#include "ess_hist.h"
+
+static void put_u32(uint8_t *p, uint32_t v) {
+  for (int i = 0; i < 4; i++) {
+    p[i] = (uint8_t)(v >> (8 * i));
+  }
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+  return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+void ess_hist_init(ess_hist_t *h, ess_record_t *records, size_t cap) {
+  h->records = records;
+  h->cap = cap;
+  h->next_seq = 0;
+  h->count = 0;
+}
+
+void ess_hist_push(ess_hist_t *h, const ess_record_t *record) {
+  h->records[h->next_seq % h->cap] = *record;
+  h->next_seq++;
+  if (h->count < h->cap) {
+    h->count++;
+  }
+}
+
+uint32_t ess_hist_oldest(const ess_hist_t *h) {
+  return h->next_seq - (uint32_t)h->count;
+}
+
+size_t ess_hist_chunk(
+  const ess_hist_t *h, uint32_t *seq, uint8_t *buf, size_t len) {
+  if (len < ESS_HIST_HEADER_LEN + ESS_HIST_RECORD_LEN) {
+    return 0;
+  }
+  uint32_t oldest = ess_hist_oldest(h);
+  // the ones before oldest were overwritten, a seq past the end (say from
+  // before a reboot) starts over too
+  if (*seq - oldest > h->count) {
+    *seq = oldest;
+  }
+  uint32_t n = h->next_seq - *seq;
+  uint32_t fit = (len - ESS_HIST_HEADER_LEN) / ESS_HIST_RECORD_LEN;
+  if (n > fit) {
+    n = fit;
+  }
+  if (n > UINT8_MAX) {
+    n = UINT8_MAX;
+  }
+
+  put_u32(buf, *seq);
+  buf[4] = (uint8_t)n;
+  uint8_t *p = buf + ESS_HIST_HEADER_LEN;
+  for (uint32_t i = 0; i < n; i++) {
+    const ess_record_t *r = &h->records[(*seq + i) % h->cap];
+    put_u32(p, r->t_s);
+    p[4] = (uint8_t)r->temperature;
+    p[5] = (uint8_t)((uint16_t)r->temperature >> 8);
+    p[6] = (uint8_t)r->humidity;
+    p[7] = (uint8_t)(r->humidity >> 8);
+    p += ESS_HIST_RECORD_LEN;
+  }
+  *seq += n;
+  return ESS_HIST_HEADER_LEN + n * ESS_HIST_RECORD_LEN;
+}
+
+void ess_stream_fetch(ess_stream_t *s, uint32_t since) {
+  s->seq = since;
+  s->active = true;
+}
+
+void ess_stream_stop(ess_stream_t *s) { s->active = false; }
+
+size_t ess_stream_chunk(
+  ess_stream_t *s, const ess_hist_t *h, uint8_t *buf, size_t len) {
+  if (!s->active || s->in_flight) {
+    return 0;
+  }
+  size_t n = ess_hist_chunk(h, &s->seq, buf, len);
+  if (n == 0) {
+    s->active = false;
+    return 0;
+  }
+  // the empty chunk tells the client it has everything
+  if (n == ESS_HIST_HEADER_LEN) {
+    s->active = false;
+  }
+  s->in_flight = true;
+  return n;
+}
+
+bool ess_stream_sent(ess_stream_t *s, bool ok) {
+  s->in_flight = false;
+  if (!ok) {
+    s->active = false;
+  }
+  return s->active;
+}
+
+int ess_hist_decode(const uint8_t *buf,
+  size_t len,
+  uint32_t *first_seq,
+  ess_record_t *out,
+  size_t max) {
+  if (len < ESS_HIST_HEADER_LEN) {
+    return -1;
+  }
+  size_t n = buf[4];
+  if (len != ESS_HIST_HEADER_LEN + n * ESS_HIST_RECORD_LEN || n > max) {
+    return -1;
+  }
+  *first_seq = get_u32(buf);
+  const uint8_t *p = buf + ESS_HIST_HEADER_LEN;
+  for (size_t i = 0; i < n; i++) {
+    out[i].t_s = get_u32(p);
+    out[i].temperature = (int16_t)(p[4] | p[5] << 8);
+    out[i].humidity = (uint16_t)(p[6] | p[7] << 8);
+    p += ESS_HIST_RECORD_LEN;
+  }
+  return (int)n;
+}
@@ -0,0 +1,73 @@
+#ifndef ESS_HIST_H
+#define ESS_HIST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  RAM ring of readings for the history characteristic, hardware
+  independent. every record gets a sequence number, so a client that
+  reconnects asks for everything after the last one it has and gets it in
+  chunks of one notification each:
+
+    | first seq u32 | count u8 | count * (t_s u32 | temp i16 | hum u16) |
+
+  little endian, t_s wall clock seconds, temperature and humidity in
+  hundredths like the ESS characteristics. a chunk with count 0 says the
+  client is up to date. when the ring wrapped past what the client asked
+  for, first seq is the oldest one still held.
+*/
+
+#define ESS_HIST_HEADER_LEN 5
+#define ESS_HIST_RECORD_LEN 8
+
+typedef struct {
+  uint32_t t_s;
+  int16_t temperature; // hundredths of C
+  uint16_t humidity;   // hundredths of %
+} ess_record_t;
+
+typedef struct {
+  ess_record_t *records;
+  size_t cap;
+  uint32_t next_seq; // of the next push, records held are next - count..
+  size_t count;
+} ess_hist_t;
+
+// one fetch streamed as a chain of notifications, each sent when the one
+// before it went out. at most one is in flight, a fetch during a stream
+// moves the chain rather than starting a second one
+typedef struct {
+  uint32_t seq; // of the next chunk
+  bool active;
+  bool in_flight;
+} ess_stream_t;
+
+void ess_hist_init(ess_hist_t *h, ess_record_t *records, size_t cap);
+// overwrites the oldest record when full
+void ess_hist_push(ess_hist_t *h, const ess_record_t *record);
+uint32_t ess_hist_oldest(const ess_hist_t *h);
+
+// the chunk starting at *seq that fits len, moves *seq past it. returns the
+// length, or 0 when len can't hold a header and one record
+size_t ess_hist_chunk(
+  const ess_hist_t *h, uint32_t *seq, uint8_t *buf, size_t len);
+// (re)starts the stream at since
+void ess_stream_fetch(ess_stream_t *s, uint32_t since);
+void ess_stream_stop(ess_stream_t *s);
+// the next chunk when one is due and none is in flight, else 0. ends the
+// stream with the empty chunk
+size_t ess_stream_chunk(
+  ess_stream_t *s, const ess_hist_t *h, uint8_t *buf, size_t len);
+// the chunk in flight went out, or failed and ends the stream. returns true
+// when the next one is due
+bool ess_stream_sent(ess_stream_t *s, bool ok);
+// returns the number of records, -1 for a malformed chunk or more than max
+int ess_hist_decode(const uint8_t *buf,
+  size_t len,
+  uint32_t *first_seq,
+  ess_record_t *out,
+  size_t max);
+
+#endif
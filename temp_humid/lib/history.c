@@ -0,0 +1,93 @@
+#include "history.h"
+#include "esp_log.h"
+#include "power.h"
+#include "tsdb_partition.h"
+#include <stdbool.h>
+
+// one partition sector per block, 704 KB with the shipped partitions.csv
+#define HISTORY_MAX_BLOCKS 256
+
+static const char *TAG = "HISTORY";
+
+static tsdb_t db;
+static tsdb_block_t blocks[HISTORY_MAX_BLOCKS];
+static bool mounted = false;
+static uint32_t unflushed = 0;
+
+esp_err_t history_init(void) {
+  if (mounted) {
+    return ESP_OK;
+  }
+
+  tsdb_flash_t flash;
+  esp_err_t err = tsdb_partition_flash(HISTORY_PARTITION, &flash);
+  if (err != ESP_OK) {
+    return err;
+  }
+  int rc = tsdb_mount(&db, &flash, blocks, HISTORY_MAX_BLOCKS);
+  if (rc != TSDB_OK) {
+    ESP_LOGE(TAG, "tsdb_mount; error code: %d ", rc);
+    return ESP_FAIL;
+  }
+  mounted = true;
+
+  tsdb_stats_t stats;
+  tsdb_get_stats(&db, &stats);
+  ESP_LOGI(TAG,
+    "%u samples in %u/%u blocks, %u bytes",
+    (unsigned)stats.samples,
+    (unsigned)stats.blocks,
+    (unsigned)stats.sectors,
+    (unsigned)stats.bytes);
+  return ESP_OK;
+}
+
+void history_store(void) {
+#if POWER_MODE == POWER_MODE_DEEP_SLEEP
+  // RAM is gone every wakeup, so mount and flush once per half RTC ring
+  power_stats_t ps;
+  power_get_stats(&ps);
+  if (ps.unsent < POWER_RING_LEN / 2 || history_init() != ESP_OK) {
+    return;
+  }
+#endif
+  if (!mounted) {
+    return;
+  }
+
+  power_sample_t samples[8];
+  size_t n;
+  while ((n = power_take_unsent(samples, 8)) > 0) {
+    for (size_t i = 0; i < n; i++) {
+      tsdb_sample_t s = {
+        .t_s = samples[i].t_s,
+        .humidity = samples[i].humidity,
+        .temperature = samples[i].temperature,
+      };
+      int rc = tsdb_append(&db, &s);
+      if (rc != TSDB_OK) {
+        ESP_LOGE(TAG, "tsdb_append; error code: %d ", rc);
+        return;
+      }
+      unflushed++;
+    }
+  }
+
+  if (POWER_MODE == POWER_MODE_DEEP_SLEEP ||
+      unflushed >= HISTORY_FLUSH_EVERY) {
+    int rc = tsdb_flush(&db);
+    if (rc != TSDB_OK) {
+      ESP_LOGE(TAG, "tsdb_flush; error code: %d ", rc);
+    }
+    unflushed = 0;
+  }
+}
+
+esp_err_t history_query(uint32_t from_s, uint32_t to_s, tsdb_agg_t *out) {
+  if (!mounted) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  return tsdb_query(&db, from_s, to_s, out) == TSDB_OK ? ESP_OK : ESP_FAIL;
+}
+
+void history_get_stats(tsdb_stats_t *out) { tsdb_get_stats(&db, out); }
@@ -0,0 +1,19 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "esp_err.h"
+#include "tsdb.h"
+#include <stdint.h>
+
+// sample history in the "tsdb" flash partition, see components/tsdb
+#define HISTORY_PARTITION "tsdb"
+// samples between flushes, a power cut loses at most this many
+#define HISTORY_FLUSH_EVERY 30
+
+esp_err_t history_init(void);
+// moves the samples power.c holds in RTC memory into the store
+void history_store(void);
+esp_err_t history_query(uint32_t from_s, uint32_t to_s, tsdb_agg_t *out);
+void history_get_stats(tsdb_stats_t *out);
+
+#endif
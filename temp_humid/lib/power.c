@@ -0,0 +1,210 @@
+#include "power.h"
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
+#include <sys/time.h>
+
+// rough ESP32 figures for a board without radio use, only used for the
+// average current estimate
+#define CURRENT_ACTIVE_UA 30000
+#define CURRENT_LIGHT_SLEEP_UA 800
+#define CURRENT_DEEP_SLEEP_UA 10
+// ROM bootloader time before esp_timer starts counting, deep sleep only
+#define DEEP_SLEEP_ROM_BOOT_US 30000
+
+#define RTC_STATE_MAGIC 0x54485057
+
+static const char *TAG = "POWER";
+
+typedef struct {
+  uint32_t magic;
+  power_sample_t last;
+  bool have_last;
+  power_sample_t ring[POWER_RING_LEN];
+  uint16_t head;
+  uint16_t count;
+  power_stats_t stats;
+} rtc_state_t;
+
+// survives deep sleep, reset on power on
+static RTC_DATA_ATTR rtc_state_t rtc_state;
+
+static gpio_num_t sensor_pin = GPIO_NUM_NC;
+static int64_t t_awake = 0;
+
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t cpu_lock = NULL;
+static esp_pm_lock_handle_t sleep_lock = NULL;
+#endif
+
+static uint32_t now_s(void) {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (uint32_t)tv.tv_sec;
+}
+
+static void update_current_estimate(void) {
+  power_stats_t *st = &rtc_state.stats;
+  uint64_t total = st->active_us + st->sleep_us;
+  if (total == 0) {
+    return;
+  }
+  uint32_t sleep_ua = POWER_MODE == POWER_MODE_DEEP_SLEEP
+                        ? CURRENT_DEEP_SLEEP_UA
+                        : CURRENT_LIGHT_SLEEP_UA;
+  if (POWER_MODE == POWER_MODE_AWAKE) {
+    sleep_ua = CURRENT_ACTIVE_UA;
+  }
+  st->avg_current_ua = (uint32_t)((st->active_us * CURRENT_ACTIVE_UA +
+                                    st->sleep_us * sleep_ua) /
+                                   total);
+}
+
+static void record_wake_latency(uint32_t latency_us) {
+  power_stats_t *st = &rtc_state.stats;
+  st->wakeups++;
+  st->last_wake_latency_us = latency_us;
+  if (latency_us > st->max_wake_latency_us) {
+    st->max_wake_latency_us = latency_us;
+  }
+}
+
+bool power_woke_from_sleep(void) {
+  return esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER;
+}
+
+esp_err_t power_init(gpio_num_t pin) {
+  t_awake = esp_timer_get_time();
+  sensor_pin = pin;
+  // released from the hold that kept the bus idle during deep sleep
+  gpio_hold_dis(sensor_pin);
+
+  if (rtc_state.magic != RTC_STATE_MAGIC || !power_woke_from_sleep()) {
+    memset(&rtc_state, 0, sizeof(rtc_state));
+    rtc_state.magic = RTC_STATE_MAGIC;
+  } else {
+    // esp_timer starts at 0 on every boot, so this is boot to app_main
+    record_wake_latency((uint32_t)t_awake + DEEP_SLEEP_ROM_BOOT_US);
+  }
+
+#if CONFIG_PM_ENABLE
+  esp_err_t esp_err;
+
+  esp_err = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "sensor", &cpu_lock);
+  if (esp_err != ESP_OK) {
+    ESP_LOGE(TAG, "esp_pm_lock_create; error code: %d ", esp_err);
+    return esp_err;
+  }
+  esp_err = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "sensor", &sleep_lock);
+  if (esp_err != ESP_OK) {
+    ESP_LOGE(TAG, "esp_pm_lock_create; error code: %d ", esp_err);
+    return esp_err;
+  }
+
+  if (POWER_MODE == POWER_MODE_LIGHT_SLEEP) {
+    esp_pm_config_t pm_config = {
+      .max_freq_mhz = 80,
+      .min_freq_mhz = 40, // XTAL
+      .light_sleep_enable = true,
+    };
+    esp_err = esp_pm_configure(&pm_config);
+    if (esp_err != ESP_OK) {
+      ESP_LOGE(TAG, "esp_pm_configure; error code: %d ", esp_err);
+      return esp_err;
+    }
+  }
+#else
+  if (POWER_MODE == POWER_MODE_LIGHT_SLEEP) {
+    ESP_LOGW(TAG, "CONFIG_PM_ENABLE is off, staying awake between reads");
+  }
+#endif
+
+  return ESP_OK;
+}
+
+void power_sensor_begin(void) {
+#if CONFIG_PM_ENABLE
+  // ets_delay_us based bit timing needs a fixed CPU clock
+  esp_pm_lock_acquire(cpu_lock);
+  esp_pm_lock_acquire(sleep_lock);
+#endif
+}
+
+void power_sensor_end(void) {
+#if CONFIG_PM_ENABLE
+  esp_pm_lock_release(sleep_lock);
+  esp_pm_lock_release(cpu_lock);
+#endif
+}
+
+void power_store_sample(int16_t humidity, int16_t temperature) {
+  power_sample_t sample = {
+    .t_s = now_s(),
+    .humidity = humidity,
+    .temperature = temperature,
+  };
+  rtc_state.last = sample;
+  rtc_state.have_last = true;
+
+  uint16_t tail = (rtc_state.head + rtc_state.count) % POWER_RING_LEN;
+  rtc_state.ring[tail] = sample;
+  if (rtc_state.count < POWER_RING_LEN) {
+    rtc_state.count++;
+  } else {
+    rtc_state.head = (rtc_state.head + 1) % POWER_RING_LEN;
+    rtc_state.stats.dropped++;
+  }
+}
+
+bool power_last_sample(power_sample_t *out) {
+  if (!rtc_state.have_last) {
+    return false;
+  }
+  *out = rtc_state.last;
+  return true;
+}
+
+size_t power_take_unsent(power_sample_t *out, size_t max) {
+  size_t n = 0;
+  while (n < max && rtc_state.count > 0) {
+    out[n++] = rtc_state.ring[rtc_state.head];
+    rtc_state.head = (rtc_state.head + 1) % POWER_RING_LEN;
+    rtc_state.count--;
+  }
+  return n;
+}
+
+void power_sleep(uint32_t ms) {
+  int64_t now = esp_timer_get_time();
+  rtc_state.stats.active_us += now - t_awake;
+
+  if (POWER_MODE == POWER_MODE_DEEP_SLEEP) {
+    rtc_state.stats.sleep_us += (uint64_t)ms * 1000;
+    update_current_estimate();
+    // keep the data line pulled high so the DHT does not see a start signal
+    gpio_set_direction(sensor_pin, GPIO_MODE_OUTPUT_OD);
+    gpio_set_level(sensor_pin, 1);
+    gpio_hold_en(sensor_pin);
+    gpio_deep_sleep_hold_en();
+    esp_deep_sleep((uint64_t)ms * 1000);
+  }
+
+  vTaskDelay(pdMS_TO_TICKS(ms));
+
+  t_awake = esp_timer_get_time();
+  int64_t slept = t_awake - now;
+  rtc_state.stats.sleep_us += slept;
+  int64_t late = slept - (int64_t)ms * 1000;
+  record_wake_latency(late > 0 ? (uint32_t)late : 0);
+  update_current_estimate();
+}
+
+void power_get_stats(power_stats_t *out) {
+  *out = rtc_state.stats;
+  out->unsent = rtc_state.count;
+}
@@ -0,0 +1,62 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include "driver/gpio.h"
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define POWER_MODE_AWAKE 0       // old behaviour, CPU idles at full clock
+#define POWER_MODE_LIGHT_SLEEP 1 // esp_pm + tickless idle between reads
+#define POWER_MODE_DEEP_SLEEP 2  // one read per boot, RTC memory keeps samples
+
+// picked in menuconfig, "Temp humid" > "Power mode between readings"
+#if CONFIG_TH_POWER_DEEP_SLEEP
+#define POWER_MODE POWER_MODE_DEEP_SLEEP
+#elif CONFIG_TH_POWER_AWAKE
+#define POWER_MODE POWER_MODE_AWAKE
+#else
+#define POWER_MODE POWER_MODE_LIGHT_SLEEP
+#endif
+
+// unsent samples kept in RTC memory, oldest are dropped when full
+#define POWER_RING_LEN 64
+
+typedef struct {
+  uint32_t t_s;        // wall clock seconds, kept by the RTC across deep sleep
+  int16_t humidity;    // tenths of %
+  int16_t temperature; // tenths of C
+} power_sample_t;
+
+typedef struct {
+  uint32_t wakeups;
+  uint32_t last_wake_latency_us; // oversleep (light) or boot to app (deep)
+  uint32_t max_wake_latency_us;
+  uint64_t active_us;
+  uint64_t sleep_us;
+  uint32_t avg_current_ua; // estimate from the active/sleep split
+  uint32_t unsent;
+  uint32_t dropped;
+} power_stats_t;
+
+esp_err_t power_init(gpio_num_t sensor_pin);
+// true when this boot is a deep sleep wakeup, i.e. the sensor is powered up
+bool power_woke_from_sleep(void);
+
+// hold the CPU clock and keep the chip awake around a sensor transfer
+void power_sensor_begin(void);
+void power_sensor_end(void);
+
+void power_store_sample(int16_t humidity, int16_t temperature);
+bool power_last_sample(power_sample_t *out);
+// moves up to max unsent samples, oldest first, into out
+size_t power_take_unsent(power_sample_t *out, size_t max);
+
+// light sleep / awake: blocks for ms. deep sleep: does not return
+void power_sleep(uint32_t ms);
+
+void power_get_stats(power_stats_t *out);
+
+#endif
@@ -0,0 +1,37 @@
+#include "app_tasks.h"
+#include "dlog.h"
+#include "esp_task.h"
+#include "power.h"
+#include "sdkconfig.h"
+#include "trace.h"
+
+#if POWER_MODE != POWER_MODE_DEEP_SLEEP
+// NimBLE bring up for the beacon runs on the sensor task
+TASK_STORAGE(dht11, 4096);
+#endif
+#if CONFIG_DLOG_ENABLE
+TASK_STORAGE(dlog, DLOG_TASK_STACK);
+#endif
+#if TRACE_HAS_TASK
+TASK_STORAGE(trace, TRACE_TASK_STACK);
+#endif
+TASK_STORAGE(task_mon, 2560);
+
+// sensor capture gets APP_CPU when the cores are partitioned
+task_def_t app_tasks[] = {
+#if POWER_MODE != POWER_MODE_DEEP_SLEEP
+  TASK_STATIC(dht11, "dht11_task", dht11_task, 5, TASK_CORE_RT),
+#endif
+#if CONFIG_DLOG_ENABLE
+  TASK_STATIC(
+    dlog, "dlog", dlog_task, CONFIG_DLOG_TASK_PRIORITY, TASK_CORE_RADIO),
+#endif
+#if TRACE_HAS_TASK
+  TASK_STATIC(trace, "trace", trace_task, 1, TASK_CORE_RADIO),
+#endif
+  TASK_STATIC(task_mon, "task_mon", task_monitor_task, 1, TASK_CORE_RADIO),
+  TASK_EXTERNAL(
+    "esp_timer", CONFIG_ESP_TIMER_TASK_STACK_SIZE, ESP_TASK_TIMER_PRIO, 0),
+};
+
+const size_t app_task_count = sizeof(app_tasks) / sizeof(app_tasks[0]);
@@ -0,0 +1,11 @@
+#ifndef APP_TASKS_H
+#define APP_TASKS_H
+
+#include "task_table.h"
+
+extern task_def_t app_tasks[];
+extern const size_t app_task_count;
+
+void dht11_task(void *param);
+
+#endif
@@ -1,229 +1,327 @@
+#include "app_tasks.h"
+#include "battery.h"
+#include "beacon.h"
+#include "dht.h"
+#include "dht11_decode.h"
+#include "dlog.h"
+#include "env_fix.h"
+#include "esp_attr.h"
 #include "esp_err.h"
+#include "esp_timer.h"
+#include "ess.h"
+#include "history.h"
+#include "power.h"
+#include "sdkconfig.h"
 #include "soc/gpio_num.h"
+#include "trace.h"
 #include <driver/gpio.h>
-#include <esp32/rom/ets_sys.h>
 #include <esp_log.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
-#define DATA_PIN GPIO_NUM_25
-#define TIMER_INTERVAL 2
-#define DATA_BITS 40
-#define DATA_BYTES (DATA_BITS / 8)
+#if CONFIG_BENCH_ENABLE
+#include "bench.h"
+#include "env_float.h"
+#endif
 
-static portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
-#define PORT_ENTER_CRITICAL() portENTER_CRITICAL(&mux)
-#define PORT_EXIT_CRITICAL() portEXIT_CRITICAL(&mux)
+#define DATA_PIN GPIO_NUM_25
+#define READ_INTERVAL_MS 2000
+// DHT11 needs a second after power up before it answers
+#define SENSOR_WARMUP_MS 2000
+#define STATS_EVERY_N_READS 30
 
 static const char *TAG = "TEMP_HUMID";
 
-/*
-  code is mostly me copying/tweaking the dht.c from
-  https://github.com/esp-idf-lib/dht/blob/main/dht.c to get a better
-  understanding of what is happening
-
-  from ./datasheets/DHT11-Temperature_Humidity.pdf
-
-  Stage 1. set Data Single-bus voltage level from high to low for at least 18ms
-  Stage 2. pull up voltage and wait 20-40us (microseconds) for DHT’s response
-  Stage 3. DHT sends low for 80us as reponse signal
-  Stage 4. DHT sends high for 80us to prep sending data
-
-  begin sending data
-
-  every bit starts with 50us low then length of following high determines 1 or 0
-  duration < 50us = 0
-  duration > 50us = 1
-
-  total of 40 bits sequentially
-  byte array length 5
-  bytes 1 and 3 are humidity %
-  bytes 2 and 4 are temperature C
-  bytes 2 and 4 zero fill
-  byte 5 is checksum
-
-  byte_5 == (byte_1 + byte_2 + byte_3 + byte_4) & 0xFF
-*/
-
-static esp_err_t await_pin_state(
-  gpio_num_t pin, uint32_t timeout, int expected_state, uint32_t *duration) {
-  gpio_set_direction(pin, GPIO_MODE_INPUT);
-
-  for (uint32_t i = 0; i < timeout; i += TIMER_INTERVAL) {
-    ets_delay_us(TIMER_INTERVAL);
-    if (gpio_get_level(pin) == expected_state) {
-      if (duration) {
-        *duration = i;
-        return ESP_OK;
-      }
-    }
+// kept over deep sleep so the median and average see the earlier readings
+static RTC_DATA_ATTR env_filter_t hum_filter;
+static RTC_DATA_ATTR env_filter_t temp_filter;
+
+static void log_last_hour(void) {
+  power_sample_t last;
+  if (!power_last_sample(&last)) {
+    return;
   }
+  tsdb_agg_t agg;
+  int64_t start = esp_timer_get_time();
+  if (history_query(last.t_s - 3600, last.t_s + 1, &agg) != ESP_OK ||
+      agg.count == 0) {
+    return;
+  }
+  int64_t query_us = esp_timer_get_time() - start;
+
+  tsdb_stats_t stats;
+  history_get_stats(&stats);
+  ESP_LOGI(TAG,
+    "last hour: %" PRIu32 " samples, humidity %d..%d avg %d, temperature "
+    "%d..%d avg %d (tenths), query %" PRId64 " us, %" PRIu32 " bytes stored",
+    agg.count,
+    agg.hum_min,
+    agg.hum_max,
+    (int)(agg.hum_sum / agg.count),
+    agg.temp_min,
+    agg.temp_max,
+    (int)(agg.temp_sum / agg.count),
+    query_us,
+    stats.bytes);
+}
 
-  return ESP_ERR_TIMEOUT;
-};
+#if CONFIG_TH_BEACON_ENABLE
+static void update_beacon(int16_t humidity, int16_t temperature) {
+  beacon_reading_t reading = {
+    .valid = true,
+    .temperature = temperature,
+    .humidity = humidity,
+    .battery = battery_level(),
+  };
+  beacon_update(&reading);
+}
 
-static inline esp_err_t transmit_data(
-  gpio_num_t pin, uint8_t data[DATA_BYTES]) {
-  esp_err_t err;
-
-  uint32_t low_duration;
-  uint32_t high_duration;
-
-  // 1. set voltage from high to low for 20ms
-  gpio_set_direction(pin, GPIO_MODE_OUTPUT_OD);
-  gpio_set_level(pin, 0);
-  ets_delay_us(20000);
-
-  // 2. pull up voltage and wait 40us
-  gpio_set_level(pin, 1);
-  ets_delay_us(40);
-  err = await_pin_state(pin, 40, 0, NULL);
-  if (err != ESP_OK) {
-    PORT_EXIT_CRITICAL();
-    ESP_LOGE(TAG, "transmit_data: Stage 2 error: %d", err);
-    return err;
-  }
+static void log_beacon(void) {
+  beacon_stats_t stats;
+  beacon_get_stats(&stats);
+  ESP_LOGI(TAG,
+    "beacon seq %u, %" PRIu32 " payload updates, %" PRIu32
+    " readings inside the deadband",
+    stats.seq,
+    stats.updates,
+    stats.suppressed);
+}
+#endif
 
-  // 3. DHT sends low for 80us as reponse signal
-  err = await_pin_state(pin, 80, 1, NULL);
-  if (err != ESP_OK) {
-    PORT_EXIT_CRITICAL();
-    ESP_LOGE(TAG, "transmit_data: Stage 3 error: %d", err);
-    return err;
+#if CONFIG_TH_ESS_ENABLE
+static void update_ess(void) {
+  power_sample_t last;
+  if (power_last_sample(&last)) {
+    ess_update(&last);
   }
+}
+
+static void log_ess(void) {
+  beacon_stats_t beacon;
+  ess_stats_t stats;
+  beacon_get_stats(&beacon);
+  ess_get_stats(&stats);
+  ESP_LOGI(TAG,
+    "ess %s, %" PRIu32 " notified, %" PRIu32 " held back by triggers, %" PRIu32
+    " history chunks, %" PRIu32 " records",
+    beacon.connected ? "connected" : "idle",
+    stats.notified,
+    stats.suppressed,
+    stats.chunks,
+    stats.records);
+}
+#endif
 
-  // 4. DHT sends high for 80us to prep sending data
-  err = await_pin_state(pin, 80, 0, NULL);
-  if (err != ESP_OK) {
-    PORT_EXIT_CRITICAL();
-    ESP_LOGE(TAG, "transmit_data: Stage 4 error: %d", err);
-    return err;
+static void sample_once(void) {
+  int16_t humidity, temperature;
+
+  TRACE_BEGIN(TRACE_DHT_READ);
+  power_sensor_begin();
+  esp_err_t res = dht_read(DATA_PIN, &humidity, &temperature);
+  power_sensor_end();
+  TRACE_END(TRACE_DHT_READ);
+
+  if (res != ESP_OK) {
+    DLOGE(TAG, "Could not read data from sensor");
+    return;
   }
 
-  // read in bits
-  for (int i = 0; i < DATA_BITS; i++) {
-    err = await_pin_state(pin, 65, 1, &low_duration);
-    if (err != ESP_OK) {
-      PORT_EXIT_CRITICAL();
-      ESP_LOGE(TAG, "transmit_data: low bit timeout");
-      return err;
-    }
-
-    err = await_pin_state(pin, 75, 0, &high_duration);
-    if (err != ESP_OK) {
-      PORT_EXIT_CRITICAL();
-      ESP_LOGE(TAG, "transmit_data: high bit timeout");
-      return err;
-    }
-
-    uint8_t b = i / 8;
-    uint8_t m = i % 8;
-    // if m == 0, initialize element in byte array because it's the start of the
-    // next byte otherwise, b will be the index of the byte array we want to use
-
-    // 8 / 8 = 1 (b == 1)
-    // 8 % 8 = 0 (m == 0)
-
-    // 10 / 8 = 1 (b == 1)
-    // 10 % 8 = 0 (m == 2)
-    if (!m) {
-      data[b] = 0;
-    }
-
-    data[b] |= (high_duration > low_duration) << (7 - m);
+  int16_t dew_point, heat_index;
+  env_filter_run(
+    &hum_filter, &humidity, &humidity, 1, CONFIG_TH_SMOOTHING_SHIFT);
+  env_filter_run(
+    &temp_filter, &temperature, &temperature, 1, CONFIG_TH_SMOOTHING_SHIFT);
+  env_dew_point(&temperature, &humidity, &dew_point, 1);
+  env_heat_index(&temperature, &humidity, &heat_index, 1);
+
+  power_store_sample(humidity, temperature);
+  history_store();
+#if CONFIG_TH_BEACON_ENABLE
+  update_beacon(humidity, temperature);
+#endif
+#if CONFIG_TH_ESS_ENABLE
+  update_ess();
+#endif
+  // tenths, the DHT11 range (0-50C, 20-90%) is never negative
+  DLOGI(TAG,
+    "Humidity: %d.%d%% Temperature: %d.%dC",
+    humidity / 10,
+    humidity % 10,
+    temperature / 10,
+    temperature % 10);
+  DLOGI(TAG,
+    "Dew point %d, heat index %d (tenths of C)",
+    dew_point,
+    heat_index);
+
+  power_stats_t stats;
+  power_get_stats(&stats);
+  if (stats.wakeups % STATS_EVERY_N_READS == 0) {
+    ESP_LOGI(TAG,
+      "wakeups %" PRIu32 ", wake latency %" PRIu32 "/%" PRIu32
+      " us, ~%" PRIu32 " uA, %" PRIu32 " unsent, %" PRIu32 " dropped",
+      stats.wakeups,
+      stats.last_wake_latency_us,
+      stats.max_wake_latency_us,
+      stats.avg_current_ua,
+      stats.unsent,
+      stats.dropped);
+    log_last_hour();
+#if CONFIG_TH_BEACON_ENABLE
+    log_beacon();
+#endif
+#if CONFIG_TH_ESS_ENABLE
+    log_ess();
+#endif
   }
+}
+
+void dht11_task(void *param) {
+  gpio_set_pull_mode(DATA_PIN, GPIO_PULLUP_ONLY);
+  // readings are still logged when there is no history partition
+  history_init();
+#if CONFIG_TH_BEACON_ENABLE
+  battery_init();
+  // readings are still logged and stored without the beacon
+#if CONFIG_TH_ESS_ENABLE
+  ess_init(READ_INTERVAL_MS / 1000);
+#else
+  beacon_init(NULL);
+#endif
+#endif
+  vTaskDelay(pdMS_TO_TICKS(SENSOR_WARMUP_MS));
 
-  return ESP_OK;
+  while (1) {
+    sample_once();
+    power_sleep(READ_INTERVAL_MS);
+  }
 };
 
-static inline int16_t convert_data(uint8_t most_sig_bit) {
-  int16_t data = most_sig_bit * 10;
-  return data;
+#if CONFIG_BENCH_ENABLE
+static void bench_decode(void *ctx) {
+  int16_t humidity, temperature;
+  dht11_decode(ctx, &humidity, &temperature);
 }
 
-esp_err_t read_data(gpio_num_t pin, int16_t *humidity, int16_t *temperature) {
-  if (!humidity && !temperature) {
-    return ESP_ERR_INVALID_ARG;
-  }
-
-  uint8_t data[DATA_BYTES] = {0};
+static void bench_read(void *ctx) {
+  int16_t humidity, temperature;
+  power_sensor_begin();
+  dht_read(DATA_PIN, &humidity, &temperature);
+  power_sensor_end();
+}
 
-  gpio_set_direction(pin, GPIO_MODE_OUTPUT_OD);
-  gpio_set_level(pin, 1);
+// a batch as big as the pipeline takes, spread over both heat index formulas
+typedef struct {
+  int16_t temp[ENV_BATCH_MAX];
+  int16_t hum[ENV_BATCH_MAX];
+  env_filter_t filter[2];
+  int16_t out[4][ENV_BATCH_MAX];
+} env_batch_t;
+
+typedef struct {
+  float temp[ENV_BATCH_MAX];
+  float hum[ENV_BATCH_MAX];
+  env_filter_float_t filter[2];
+  float out[4][ENV_BATCH_MAX];
+} env_batch_float_t;
+
+static void bench_env(void *ctx) {
+  env_batch_t *b = ctx;
+  env_filter_run(&b->filter[0], b->temp, b->out[0], ENV_BATCH_MAX, 2);
+  env_filter_run(&b->filter[1], b->hum, b->out[1], ENV_BATCH_MAX, 2);
+  env_dew_point(b->out[0], b->out[1], b->out[2], ENV_BATCH_MAX);
+  env_heat_index(b->out[0], b->out[1], b->out[3], ENV_BATCH_MAX);
+}
 
-  PORT_ENTER_CRITICAL();
-  esp_err_t res = transmit_data(pin, data);
-  if (res == ESP_OK) {
-    PORT_EXIT_CRITICAL();
-  }
+static void bench_env_float(void *ctx) {
+  env_batch_float_t *b = ctx;
+  env_filter_float_run(&b->filter[0], b->temp, b->out[0], ENV_BATCH_MAX, 0.25f);
+  env_filter_float_run(&b->filter[1], b->hum, b->out[1], ENV_BATCH_MAX, 0.25f);
+  env_dew_point_float(b->out[0], b->out[1], b->out[2], ENV_BATCH_MAX);
+  env_heat_index_float(b->out[0], b->out[1], b->out[3], ENV_BATCH_MAX);
+}
 
-  gpio_set_direction(pin, GPIO_MODE_OUTPUT_OD);
-  gpio_set_level(pin, 1);
+static void run_benchmarks(void) {
+  bench_result_t result;
 
-  if (res != ESP_OK) {
-    return res;
+  // 45% / 23C frame: 45, 0, 23, 0, 68
+  static const uint8_t frame[DHT11_DATA_BYTES] = {45, 0, 23, 0, 68};
+  static dht11_pulses_t pulses;
+  for (int i = 0; i < DHT11_DATA_BITS; i++) {
+    bool one = frame[i / 8] & (0x80 >> (i % 8));
+    pulses.low[i] = 50;
+    pulses.high[i] = one ? 70 : 26;
   }
 
-  if (data[4] != ((data[0] + data[1] + data[2] + data[3]) & 0xFF)) {
-    ESP_LOGE(TAG, "checksum failed");
-    return ESP_ERR_INVALID_CRC;
+  bench_opts_t opts = {
+    .warmup = CONFIG_BENCH_WARMUP,
+    .iterations = CONFIG_BENCH_ITERATIONS,
+  };
+  bench_print_header();
+  if (bench_run("dht11_decode", bench_decode, &pulses, &opts, &result) == 0) {
+    bench_print(&result);
   }
 
-  if (humidity) {
-    *humidity = convert_data(data[0]);
+  // same cases as components/env/host/env_bench.c
+  static env_batch_t env_batch;
+  static env_batch_float_t env_batch_float;
+  for (int i = 0; i < ENV_BATCH_MAX; i++) {
+    env_batch.temp[i] = (int16_t)(150 + i * 15);
+    env_batch.hum[i] = (int16_t)(300 + i * 40);
+    env_batch_float.temp[i] = env_batch.temp[i] / 10.0f;
+    env_batch_float.hum[i] = env_batch.hum[i] / 10.0f;
   }
-  if (temperature) {
-    *temperature = convert_data(data[2]);
+  if (bench_run("env_fix_batch", bench_env, &env_batch, &opts, &result) == 0) {
+    bench_print(&result);
   }
-
-  ESP_LOGD(TAG, "Data: humidity=%d, temperature=%d", *humidity, *temperature);
-
-  return ESP_OK;
-};
-
-esp_err_t read_float_data(gpio_num_t pin, float *humidity, float *temperature) {
-  if (!humidity && !temperature) {
-    return ESP_ERR_INVALID_ARG;
+  if (bench_run("env_float_batch",
+        bench_env_float,
+        &env_batch_float,
+        &opts,
+        &result) == 0) {
+    bench_print(&result);
   }
 
-  int16_t i_humidity, i_temp;
-
-  esp_err_t res =
-    read_data(pin, humidity ? &i_humidity : NULL, temperature ? &i_temp : NULL);
-  if (res != ESP_OK) {
-    return res;
+  // the sensor wants at least a second between reads
+  bench_opts_t read_opts = {
+    .warmup = 1,
+    .iterations = 10,
+    .pause_ms = 1100,
+  };
+  gpio_set_pull_mode(DATA_PIN, GPIO_PULLUP_ONLY);
+  vTaskDelay(pdMS_TO_TICKS(SENSOR_WARMUP_MS));
+  if (bench_run("dht11_read", bench_read, NULL, &read_opts, &result) == 0) {
+    bench_print(&result);
   }
+}
+#endif
 
-  if (humidity) {
-    *humidity = i_humidity / 10.0;
-  }
-  if (temperature) {
-    *temperature = i_temp / 10.0;
+void app_main(void) {
+  if (power_init(DATA_PIN) != ESP_OK) {
+    return;
   }
 
-  return ESP_OK;
-};
+  // before the sensor task exists, both would poll the DHT11
+#if CONFIG_BENCH_ENABLE
+  run_benchmarks();
+#endif
 
-void dht11_task(void *param) {
-  float temperature, humidity;
+  if (task_table_start(app_tasks, app_task_count) != ESP_OK) {
+    return;
+  }
 
+#if POWER_MODE == POWER_MODE_DEEP_SLEEP
   gpio_set_pull_mode(DATA_PIN, GPIO_PULLUP_ONLY);
-  vTaskDelay(pdMS_TO_TICKS(2000));
-
-  while (1) {
-    if (read_float_data(DATA_PIN, &humidity, &temperature) == ESP_OK)
-      printf("Humidity: %.1f%% Temperature: %.1fC\n", humidity, temperature);
-    else
-      printf("Could not read data from sensor\n");
-    vTaskDelay(pdMS_TO_TICKS(2000));
+  if (!power_woke_from_sleep()) {
+    vTaskDelay(pdMS_TO_TICKS(SENSOR_WARMUP_MS));
   }
-};
-
-void app_main(void) {
-  xTaskCreate(dht11_task, "dht11_task", 2048, NULL, 5, NULL);
-  // xTaskCreate(
-  //   dht11_task, "dht11_task", configMINIMAL_STACK_SIZE * 3, NULL, 5, NULL);
-}
\ No newline at end of file
+  sample_once();
+  // the log task never runs again before deep sleep
+  dlog_flush();
+  power_sleep(READ_INTERVAL_MS);
+#endif
+}
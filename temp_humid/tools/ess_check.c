@@ -0,0 +1,322 @@
+/*
+  host check of the ESS codec and history chunks in ../lib: a day of
+  temperature readings through the default triggers, compared with a
+  client reading the characteristic after every reading, then history
+  fetches at the common ATT MTUs from a ring that wrapped, and the
+  notification chain of a stream with FETCH, STOP and failures on the way.
+
+    gcc -O2 -I../lib ess_check.c ../lib/ess_codec.c ../lib/ess_hist.c \
+      -o ess_check
+    ./ess_check
+
+  the airtime figures count ATT PDU bytes only, link layer overhead is
+  about the same per packet either way. exits 1 when a check fails.
+*/
+#include "ess_codec.h"
+#include "ess_hist.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the defaults in Kconfig.projbuild
+#define READ_S 2
+#define MIN_INTERVAL_S 10
+#define TEMP_DEADBAND 50 // hundredths
+#define TRACE_S (24 * 3600)
+#define HIST_CAP 100
+#define HIST_PUSHES 250
+// opcode + handle + value, read request + response, notification
+#define READ_BYTES (3 + 3)
+#define NOTIFY_BYTES (3 + 2)
+
+static int failures;
+
+static void check(int ok, const char *what) {
+  if (!ok) {
+    printf("FAIL %s\n", what);
+    failures++;
+  }
+}
+
+static ess_triggers_t default_triggers(void) {
+  ess_triggers_t t = {
+    .trigger =
+      {
+        {.condition = ESS_TRIG_CHANGED},
+        {.condition = ESS_TRIG_MIN_TIME, .operand = MIN_INTERVAL_S},
+      },
+    .logic = ESS_LOGIC_AND,
+    .value_signed = true,
+    .deadband = TEMP_DEADBAND,
+  };
+  return t;
+}
+
+// a slow daily swing in whole degrees like a DHT11, smoothed the way
+// env_filter does, plus a warm spell in the afternoon
+static int32_t trace_value(int s, int32_t *ema) {
+  int32_t day = (s % 86400) < 43200 ? s % 43200 : 43200 - s % 43200;
+  int32_t raw = 1800 + day * 600 / 43200;
+  if (s > 50000 && s < 53000) {
+    raw += 400;
+  }
+  raw = raw / 100 * 100 + (rand() % 3 - 1) * 100;
+  *ema += (raw - *ema) / 4;
+  return *ema;
+}
+
+static void check_triggers(void) {
+  ess_triggers_t triggers = default_triggers();
+  ess_sent_t last = {0};
+  int32_t ema = 1800;
+  uint32_t notified = 0;
+  uint32_t polled = 0;
+  int32_t max_lag = 0;
+  int64_t behind_since = -1;
+
+  srand(1);
+  for (int s = 0; s < TRACE_S; s += READ_S) {
+    int32_t value = trace_value(s, &ema);
+    int64_t now_us = (int64_t)s * 1000000;
+    polled++;
+    bool was_sent = last.sent;
+    ess_sent_t prev = last;
+
+    if (ess_trigger_due(&triggers, &last, value, now_us)) {
+      if (was_sent) {
+        check(now_us - prev.at_us >= (int64_t)MIN_INTERVAL_S * 1000000,
+          "notification inside the minimum interval");
+        check(abs(value - prev.value) >= TEMP_DEADBAND,
+          "notification inside the deadband");
+      }
+      last = (ess_sent_t){.sent = true, .value = value, .at_us = now_us};
+      notified++;
+      behind_since = -1;
+    } else if (abs(value - last.value) >= TEMP_DEADBAND) {
+      // a real move waits for the minimum interval at most
+      if (behind_since < 0) {
+        behind_since = s;
+      }
+      if (s - behind_since > max_lag) {
+        max_lag = (int32_t)(s - behind_since);
+      }
+    }
+  }
+  check(max_lag < MIN_INTERVAL_S, "a move waited past the minimum interval");
+
+  uint64_t poll_bytes = (uint64_t)polled * READ_BYTES;
+  uint64_t notify_bytes = (uint64_t)notified * NOTIFY_BYTES;
+  printf("triggers    %u notifications against %u polled reads a day, "
+         "%llu vs %llu ATT bytes (%.1f%%), longest wait %d s\n",
+    (unsigned)notified,
+    (unsigned)polled,
+    (unsigned long long)notify_bytes,
+    (unsigned long long)poll_bytes,
+    100.0 * notify_bytes / poll_bytes,
+    max_lag);
+}
+
+static void check_logic(void) {
+  ess_sent_t last = {.sent = true, .value = 2000, .at_us = 0};
+  ess_triggers_t t = {
+    .trigger =
+      {
+        {.condition = ESS_TRIG_GT, .operand = 3000},
+        {.condition = ESS_TRIG_INTERVAL, .operand = 60},
+      },
+    .logic = ESS_LOGIC_OR,
+    .value_signed = true,
+  };
+  check(!ess_trigger_due(&t, &last, 2500, 1000000), "OR, neither met");
+  check(ess_trigger_due(&t, &last, 3100, 1000000), "OR, over the limit");
+  check(ess_trigger_due(&t, &last, 2500, 60000000), "OR, interval");
+  t.logic = ESS_LOGIC_AND;
+  check(!ess_trigger_due(&t, &last, 3100, 1000000), "AND, one met");
+  check(ess_trigger_due(&t, &last, 3100, 60000000), "AND, both met");
+  t.trigger[0].condition = ESS_TRIG_INACTIVE;
+  t.trigger[1].condition = ESS_TRIG_INACTIVE;
+  check(!ess_trigger_due(&t, &last, 3100, 60000000), "all inactive");
+  ess_sent_t none = {0};
+  t.trigger[0] = (ess_trigger_t){.condition = ESS_TRIG_CHANGED};
+  t.deadband = 100;
+  check(ess_trigger_due(&t, &none, 2000, 0), "first value after subscribe");
+}
+
+static void check_codec(void) {
+  const ess_trigger_t cases[] = {
+    {.condition = ESS_TRIG_INACTIVE},
+    {.condition = ESS_TRIG_INTERVAL, .operand = 0xabcdef},
+    {.condition = ESS_TRIG_MIN_TIME, .operand = 10},
+    {.condition = ESS_TRIG_CHANGED},
+    {.condition = ESS_TRIG_LT, .operand = -4000},
+    {.condition = ESS_TRIG_NE, .operand = 2550},
+  };
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    uint8_t buf[ESS_TRIGGER_MAX_LEN];
+    ess_trigger_t out;
+    size_t len = ess_trigger_encode(&cases[i], true, buf, sizeof(buf));
+    check(len > 0 && ess_trigger_decode(buf, len, true, &out) == 0 &&
+            out.condition == cases[i].condition &&
+            out.operand == cases[i].operand,
+      "trigger round trip");
+  }
+  const uint8_t unknown[] = {0x0a};
+  const uint8_t short_time[] = {ESS_TRIG_MIN_TIME, 10, 0};
+  const uint8_t long_changed[] = {ESS_TRIG_CHANGED, 0};
+  ess_trigger_t out;
+  check(ess_trigger_decode(unknown, sizeof(unknown), true, &out) != 0,
+    "unknown condition accepted");
+  check(ess_trigger_decode(short_time, sizeof(short_time), true, &out) != 0,
+    "short operand accepted");
+  check(ess_trigger_decode(long_changed, sizeof(long_changed), true, &out) !=
+          0,
+    "operand on changed accepted");
+  const uint8_t humid[] = {ESS_TRIG_GT, 0x10, 0x27};
+  check(ess_trigger_decode(humid, sizeof(humid), false, &out) == 0 &&
+          out.operand == 10000,
+    "unsigned operand");
+  const uint8_t cold[] = {ESS_TRIG_LT, 0x60, 0xf0};
+  check(ess_trigger_decode(cold, sizeof(cold), true, &out) == 0 &&
+          out.operand == -4000,
+    "signed operand");
+
+  uint8_t meas[ESS_MEAS_LEN];
+  check(ess_measurement_encode(READ_S, meas, sizeof(meas)) == ESS_MEAS_LEN &&
+          meas[6] == READ_S && meas[9] == 0x01,
+    "measurement descriptor");
+}
+
+static ess_record_t record_for(uint32_t seq) {
+  ess_record_t r = {
+    .t_s = 1700000000 + seq * 60,
+    .temperature = (int16_t)(seq * 7 - 500),
+    .humidity = (uint16_t)(seq * 13),
+  };
+  return r;
+}
+
+// fetches like a client until the empty chunk, returns the chunk count
+static int fetch(const ess_hist_t *h, uint32_t since, uint16_t mtu) {
+  uint8_t buf[512];
+  ess_record_t got[64];
+  uint32_t seq = since;
+  uint32_t expect = since - ess_hist_oldest(h) > h->count
+                      ? ess_hist_oldest(h)
+                      : since;
+  int chunks = 0;
+  for (;;) {
+    size_t len = ess_hist_chunk(h, &seq, buf, (size_t)mtu - 3);
+    uint32_t first;
+    int n = ess_hist_decode(buf, len, &first, got, 64);
+    chunks++;
+    if (n < 0 || first != expect) {
+      check(0, "chunk sequence");
+      return chunks;
+    }
+    if (n == 0) {
+      check(expect == h->next_seq, "fetch ended early");
+      return chunks;
+    }
+    for (int i = 0; i < n; i++) {
+      ess_record_t want = record_for(expect + (uint32_t)i);
+      check(memcmp(&got[i], &want, sizeof(want)) == 0, "record contents");
+    }
+    expect += (uint32_t)n;
+  }
+}
+
+static void check_history(void) {
+  static ess_record_t records[HIST_CAP];
+  ess_hist_t h;
+  ess_hist_init(&h, records, HIST_CAP);
+  uint8_t buf[32];
+  uint32_t seq = 0;
+  check(ess_hist_chunk(&h, &seq, buf, sizeof(buf)) == ESS_HIST_HEADER_LEN,
+    "empty history");
+  for (uint32_t i = 0; i < HIST_PUSHES; i++) {
+    ess_record_t r = record_for(i);
+    ess_hist_push(&h, &r);
+  }
+  check(ess_hist_oldest(&h) == HIST_PUSHES - HIST_CAP, "oldest after wrap");
+
+  const uint16_t mtus[] = {23, 185, 247};
+  for (size_t i = 0; i < sizeof(mtus) / sizeof(mtus[0]); i++) {
+    int all = fetch(&h, 0, mtus[i]);
+    int recent = fetch(&h, HIST_PUSHES - 10, mtus[i]);
+    int stale = fetch(&h, HIST_PUSHES + 500, mtus[i]);
+    printf("history     MTU %3u: %d records in %d notifications, last 10 in "
+           "%d, unknown seq restarts in %d\n",
+      mtus[i],
+      HIST_CAP,
+      all,
+      recent,
+      stale);
+  }
+}
+
+// the host side of a stream: one chunk in flight, the next sent on its
+// NOTIFY_TX. returns the first seq of the chunk that went out, -1 for none
+static int64_t stream_step(ess_stream_t *s, const ess_hist_t *h) {
+  uint8_t buf[20]; // MTU 23, one record per chunk
+  size_t len = ess_stream_chunk(s, h, buf, sizeof(buf));
+  uint32_t first;
+  ess_record_t got[1];
+  if (len == 0 || ess_hist_decode(buf, len, &first, got, 1) < 0) {
+    return -1;
+  }
+  return first;
+}
+
+static void check_stream(void) {
+  static ess_record_t records[HIST_CAP];
+  ess_hist_t h;
+  ess_hist_init(&h, records, HIST_CAP);
+  for (uint32_t i = 0; i < HIST_PUSHES; i++) {
+    ess_record_t r = record_for(i);
+    ess_hist_push(&h, &r);
+  }
+  const uint32_t oldest = ess_hist_oldest(&h);
+  ess_stream_t s = {0};
+
+  ess_stream_fetch(&s, oldest);
+  check(stream_step(&s, &h) == oldest, "first chunk");
+  check(stream_step(&s, &h) == -1, "second chunk while one is in flight");
+  check(ess_stream_sent(&s, true) && stream_step(&s, &h) == oldest + 1,
+    "chunk after NOTIFY_TX");
+
+  // a FETCH mid-stream moves the running chain, it doesn't start another
+  ess_stream_fetch(&s, HIST_PUSHES - 3);
+  check(stream_step(&s, &h) == -1, "second chain on a fetch mid-stream");
+  int64_t seqs[8];
+  int n = 0;
+  // up to the empty chunk, whose NOTIFY_TX is still to come
+  while (n < 8 && s.active && ess_stream_sent(&s, true)) {
+    seqs[n++] = stream_step(&s, &h);
+  }
+  check(n == 4 && seqs[0] == HIST_PUSHES - 3 && seqs[1] == HIST_PUSHES - 2 &&
+          seqs[2] == HIST_PUSHES - 1 && seqs[3] == HIST_PUSHES,
+    "chunks after a fetch mid-stream");
+  check(!s.active && s.in_flight, "stream ends with the empty chunk");
+
+  // the empty chunk is still in flight, its NOTIFY_TX carries on
+  ess_stream_fetch(&s, HIST_PUSHES - 1);
+  check(stream_step(&s, &h) == -1, "second chain behind the empty chunk");
+  check(ess_stream_sent(&s, true) && stream_step(&s, &h) == HIST_PUSHES - 1,
+    "fetch behind the empty chunk");
+
+  check(!ess_stream_sent(&s, false) && stream_step(&s, &h) == -1,
+    "stream after a failed notification");
+  ess_stream_fetch(&s, HIST_PUSHES - 1);
+  ess_stream_stop(&s);
+  check(stream_step(&s, &h) == -1, "stream after STOP");
+}
+
+int main(void) {
+  check_triggers();
+  check_logic();
+  check_codec();
+  check_history();
+  check_stream();
+  printf("%s\n", failures ? "FAILED" : "ok");
+  return failures > 0;
+}
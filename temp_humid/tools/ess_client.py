@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+"""Environmental Sensing Service client for temp_humid, see lib/ess.h.
+
+Connects to a node, fetches the history it missed since the last run and
+then prints temperature and humidity notifications as the node's triggers
+let them through. Needs bleak (pip install bleak) and a BLE adapter.
+
+    python ess_client.py                      # first TEMP_HUMID found
+    python ess_client.py -a AA:BB:CC:DD:EE:FF -t 600
+    python ess_client.py --since 0 -t 0       # whole history, then quit
+    python ess_client.py --min-interval 60    # at most one a minute
+
+The last sequence number fetched is kept per node in --state, so the next
+run only asks for what is new.
+"""
+import argparse
+import asyncio
+import json
+import os
+import struct
+import time
+
+NAME = "TEMP_HUMID"
+ESS_SVC = "0000181a-0000-1000-8000-00805f9b34fb"
+TEMP_CHAR = "00002a6e-0000-1000-8000-00805f9b34fb"
+HUM_CHAR = "00002a6f-0000-1000-8000-00805f9b34fb"
+TRIGGER_DSC = "0000290d-0000-1000-8000-00805f9b34fb"
+HIST_CHAR = "c7a10002-3b5e-4f6d-9a2b-81e2f0d4a5b6"
+OP_FETCH = 0x01
+TRIG_MIN_TIME = 0x02
+HEADER = struct.Struct("<IB")
+RECORD = struct.Struct("<IhH")
+INFO = struct.Struct("<IIH")
+
+
+def decode_chunk(data):
+    """returns (first seq, [(t_s, temperature, humidity)]) or None"""
+    if len(data) < HEADER.size:
+        return None
+    first, count = HEADER.unpack_from(data)
+    if len(data) != HEADER.size + count * RECORD.size:
+        return None
+    records = [
+        RECORD.unpack_from(data, HEADER.size + i * RECORD.size)
+        for i in range(count)
+    ]
+    return first, records
+
+
+def fmt_record(t_s, temp, hum):
+    when = time.strftime("%Y-%m-%d %H:%M:%S", time.localtime(t_s))
+    return f"{when} {temp / 100:.2f}C {hum / 100:.2f}%"
+
+
+async def fetch_history(client, since):
+    """returns the next seq to ask for"""
+    done = asyncio.Event()
+    state = {"next": since}
+
+    def on_chunk(_, data):
+        chunk = decode_chunk(bytes(data))
+        if chunk is None:
+            print("bad history chunk")
+            done.set()
+            return
+        first, records = chunk
+        if first != state["next"]:
+            print(f"records {state['next']}..{first - 1} are gone")
+        for i, r in enumerate(records):
+            print(f"#{first + i} {fmt_record(*r)}")
+        state["next"] = first + len(records)
+        if not records:
+            done.set()
+
+    oldest, nxt, period = INFO.unpack(await client.read_gatt_char(HIST_CHAR))
+    print(f"history holds {oldest}..{nxt - 1}, one every {period} s")
+    await client.start_notify(HIST_CHAR, on_chunk)
+    await client.write_gatt_char(
+        HIST_CHAR, struct.pack("<BI", OP_FETCH, since), response=True
+    )
+    await asyncio.wait_for(done.wait(), 60)
+    await client.stop_notify(HIST_CHAR)
+    return state["next"]
+
+
+async def set_min_interval(client, char_uuid, seconds):
+    """the second trigger of each characteristic is the minimum interval"""
+    char = client.services.get_characteristic(char_uuid)
+    triggers = [d for d in char.descriptors if d.uuid == TRIGGER_DSC]
+    value = bytes([TRIG_MIN_TIME]) + seconds.to_bytes(3, "little")
+    await client.write_gatt_descriptor(triggers[1].handle, value)
+
+
+async def run(args, state):
+    from bleak import BleakClient, BleakScanner
+
+    if args.address:
+        target = args.address
+    else:
+        target = await BleakScanner.find_device_by_name(NAME, timeout=20)
+        if target is None:
+            raise SystemExit(f"no {NAME} found")
+    async with BleakClient(target) as client:
+        addr = client.address
+        since = args.since if args.since is not None else state.get(addr, 0)
+        state[addr] = await fetch_history(client, since)
+        if not args.time:
+            return
+
+        if args.min_interval is not None:
+            for uuid in (TEMP_CHAR, HUM_CHAR):
+                await set_min_interval(client, uuid, args.min_interval)
+
+        def on_value(name, signed):
+            def cb(_, data):
+                value = int.from_bytes(data, "little", signed=signed)
+                stamp = time.strftime("%H:%M:%S")
+                print(f"{stamp} {name} {value / 100:.2f}", flush=True)
+
+            return cb
+
+        await client.start_notify(TEMP_CHAR, on_value("temperature", True))
+        await client.start_notify(HUM_CHAR, on_value("humidity", False))
+        await asyncio.sleep(args.time)
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("-a", "--address", help="node address, else by name")
+    ap.add_argument("-t", "--time", type=float, default=60,
+                    help="seconds of notifications after the history, 0 none")
+    ap.add_argument("--since", type=int, help="history from this seq")
+    ap.add_argument("--min-interval", type=int,
+                    help="seconds between notifications, replaces the default")
+    ap.add_argument("--state", default=os.path.expanduser("~/.ess_client.json"),
+                    help="where the last seq of every node is kept")
+    args = ap.parse_args()
+
+    state = {}
+    if os.path.exists(args.state):
+        with open(args.state) as f:
+            state = json.load(f)
+    try:
+        asyncio.run(run(args, state))
+    except KeyboardInterrupt:
+        pass
+    with open(args.state, "w") as f:
+        json.dump(state, f, indent=1)
+
+
+if __name__ == "__main__":
+    main()